@@ -0,0 +1,1729 @@
+/*!
+ * Copyright (c) 2023 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-keyboard.
+ *
+ * tuxedo-keyboard is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <ctype.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "host_harness.h"
+
+struct module host_this_module = { .name = "tuxedo_keyboard", .version = "host" };
+
+/* ::::  Tasks and time  :::: */
+static struct task_struct host_task_main = { .pid = 1, .comm = "main" };
+struct task_struct host_task_worker = { .pid = 2, .comm = "kworker" };
+struct task_struct *current = &host_task_main;
+
+// Uptime at load, the driver treats the first seconds as early boot
+u64 host_time_ns = NSEC_PER_SEC;
+unsigned long volatile jiffies = NSEC_PER_SEC / (NSEC_PER_SEC / HZ);
+
+void host_advance_ns(u64 ns)
+{
+	host_time_ns += ns;
+	jiffies = host_time_ns / (NSEC_PER_SEC / HZ);
+}
+
+void host_bug(const char *fmt, ...)
+{
+	va_list args;
+
+	fprintf(stderr, "BUG (%s): ", current->comm);
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	abort();
+}
+
+/* ::::  Logging  :::: */
+int host_log_level = -1;
+unsigned long host_printk_count[8];
+
+int printk(const char *fmt, ...)
+{
+	va_list args;
+	int level = 4;
+	const char *env;
+
+	if (fmt[0] == '\001' && fmt[1] >= '0' && fmt[1] <= '7') {
+		level = fmt[1] - '0';
+		fmt += 2;
+	}
+	host_printk_count[level]++;
+
+	if (host_log_level < 0) {
+		env = getenv("HOST_LOG_LEVEL");
+		host_log_level = env ? atoi(env) : 4;
+	}
+	if (level > host_log_level)
+		return 0;
+
+	fprintf(stderr, "[%5llu.%06llu] ", host_time_ns / NSEC_PER_SEC, (host_time_ns % NSEC_PER_SEC) / NSEC_PER_USEC);
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+
+	return 0;
+}
+
+/* ::::  Helpers  :::: */
+u32 crc32_le(u32 crc, const unsigned char *p, size_t len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; ++i)
+			crc = (crc >> 1) ^ (crc & 1 ? 0xedb88320 : 0);
+	}
+	return crc;
+}
+
+void sort(void *base, size_t num, size_t size, int (*cmp)(const void *, const void *),
+	  void (*swap_func)(void *, void *, int))
+{
+	qsort(base, num, size, cmp);
+}
+
+u32 get_random_u32(void)
+{
+	// Fixed seed, runs are reproducible
+	static u32 state = 0x2545f491;
+
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+unsigned long get_zeroed_page(gfp_t gfp)
+{
+	void *page = aligned_alloc(PAGE_SIZE, PAGE_SIZE);
+
+	if (page)
+		memset(page, 0, PAGE_SIZE);
+	return (unsigned long)page;
+}
+
+void free_page(unsigned long addr)
+{
+	free((void *)addr);
+}
+
+/* ::::  Strings  :::: */
+int scnprintf(char *buf, size_t size, const char *fmt, ...)
+{
+	va_list args;
+	int len;
+
+	if (size == 0)
+		return 0;
+	va_start(args, fmt);
+	len = vsnprintf(buf, size, fmt, args);
+	va_end(args);
+
+	return len < (int)size ? len : (int)size - 1;
+}
+
+int sysfs_emit(char *buf, const char *fmt, ...)
+{
+	va_list args;
+	int len;
+
+	va_start(args, fmt);
+	len = vsnprintf(buf, PAGE_SIZE, fmt, args);
+	va_end(args);
+
+	return len < (int)PAGE_SIZE ? len : (int)PAGE_SIZE - 1;
+}
+
+size_t strscpy(char *dest, const char *src, size_t count)
+{
+	size_t len = strnlen(src, count);
+
+	if (count == 0)
+		return -E2BIG;
+	if (len == count) {
+		memcpy(dest, src, count - 1);
+		dest[count - 1] = '\0';
+		return -E2BIG;
+	}
+	memcpy(dest, src, len + 1);
+	return len;
+}
+
+char *strstrip(char *s)
+{
+	size_t len = strlen(s);
+
+	while (len && (s[len - 1] == ' ' || s[len - 1] == '\t' || s[len - 1] == '\n'))
+		s[--len] = '\0';
+	while (*s == ' ' || *s == '\t' || *s == '\n')
+		s++;
+	return s;
+}
+
+char *kstrdup(const char *s, gfp_t gfp)
+{
+	return s ? strdup(s) : NULL;
+}
+
+// Kernel semantics: base 0 detects 0x/0 prefixes, one trailing newline is allowed
+static int host_kstrtoull(const char *s, unsigned int base, unsigned long long *res)
+{
+	unsigned long long value = 0;
+	unsigned int digit;
+	bool any = false;
+
+	if (*s == '+')
+		s++;
+	if (base == 0) {
+		if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X') && isxdigit((unsigned char)s[2]))
+			base = 16, s += 2;
+		else if (s[0] == '0')
+			base = 8;
+		else
+			base = 10;
+	} else if (base == 16 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+		s += 2;
+	}
+
+	for (; *s; ++s, any = true) {
+		if (*s >= '0' && *s <= '9')
+			digit = *s - '0';
+		else if (*s >= 'a' && *s <= 'f')
+			digit = *s - 'a' + 10;
+		else if (*s >= 'A' && *s <= 'F')
+			digit = *s - 'A' + 10;
+		else
+			break;
+		if (digit >= base)
+			return -EINVAL;
+		if (value > (ULLONG_MAX - digit) / base)
+			return -ERANGE;
+		value = value * base + digit;
+	}
+
+	if (!any)
+		return -EINVAL;
+	if (*s == '\n')
+		s++;
+	if (*s)
+		return -EINVAL;
+
+	*res = value;
+	return 0;
+}
+
+static int host_kstrtoull_max(const char *s, unsigned int base, unsigned long long max, unsigned long long *res)
+{
+	int ret = host_kstrtoull(s, base, res);
+
+	if (ret)
+		return ret;
+	return *res > max ? -ERANGE : 0;
+}
+
+int kstrtouint(const char *s, unsigned int base, unsigned int *res)
+{
+	unsigned long long value;
+	int ret = host_kstrtoull_max(s, base, UINT_MAX, &value);
+
+	if (!ret)
+		*res = value;
+	return ret;
+}
+
+int kstrtou32(const char *s, unsigned int base, u32 *res)
+{
+	return kstrtouint(s, base, res);
+}
+
+int kstrtou16(const char *s, unsigned int base, u16 *res)
+{
+	unsigned long long value;
+	int ret = host_kstrtoull_max(s, base, U16_MAX, &value);
+
+	if (!ret)
+		*res = value;
+	return ret;
+}
+
+int kstrtou8(const char *s, unsigned int base, u8 *res)
+{
+	unsigned long long value;
+	int ret = host_kstrtoull_max(s, base, U8_MAX, &value);
+
+	if (!ret)
+		*res = value;
+	return ret;
+}
+
+int kstrtoint(const char *s, unsigned int base, int *res)
+{
+	unsigned long long value;
+	int ret;
+
+	if (*s == '-') {
+		ret = host_kstrtoull_max(s + 1, base, (unsigned long long)INT_MAX + 1, &value);
+		if (!ret)
+			*res = -(long long)value;
+		return ret;
+	}
+	ret = host_kstrtoull_max(s, base, INT_MAX, &value);
+	if (!ret)
+		*res = value;
+	return ret;
+}
+
+int kstrtobool(const char *s, bool *res)
+{
+	if (!s)
+		return -EINVAL;
+
+	switch (s[0]) {
+	case 'y': case 'Y': case 't': case 'T': case '1':
+		*res = true;
+		return 0;
+	case 'n': case 'N': case 'f': case 'F': case '0':
+		*res = false;
+		return 0;
+	case 'o': case 'O':
+		if (s[1] == 'n' || s[1] == 'N') {
+			*res = true;
+			return 0;
+		}
+		if (s[1] == 'f' || s[1] == 'F') {
+			*res = false;
+			return 0;
+		}
+		break;
+	}
+	return -EINVAL;
+}
+
+int kstrtouint_from_user(const char __user *s, size_t count, unsigned int base, unsigned int *res)
+{
+	char buf[32];
+
+	count = min(count, sizeof(buf) - 1);
+	memcpy(buf, s, count);
+	buf[count] = '\0';
+	return kstrtouint(buf, base, res);
+}
+
+bool sysfs_streq(const char *s1, const char *s2)
+{
+	while (*s1 && *s1 == *s2) {
+		s1++;
+		s2++;
+	}
+
+	if (*s1 == *s2)
+		return true;
+	if (!*s1 && *s2 == '\n' && !s2[1])
+		return true;
+	if (*s1 == '\n' && !s1[1] && !*s2)
+		return true;
+	return false;
+}
+
+int match_string(const char * const *array, size_t n, const char *string)
+{
+	size_t i;
+
+	for (i = 0; i < n && array[i]; ++i)
+		if (!strcmp(array[i], string))
+			return i;
+	return -EINVAL;
+}
+
+int __sysfs_match_string(const char * const *array, size_t n, const char *str)
+{
+	size_t i;
+
+	for (i = 0; i < n && array[i]; ++i)
+		if (sysfs_streq(array[i], str))
+			return i;
+	return -EINVAL;
+}
+
+/* ::::  Module parameters  :::: */
+int param_set_int(const char *val, const struct kernel_param *kp)
+{
+	return kstrtoint(val, 0, kp->arg);
+}
+
+int param_get_int(char *buffer, const struct kernel_param *kp)
+{
+	return scnprintf(buffer, PAGE_SIZE, "%i\n", *(int *)kp->arg);
+}
+
+int param_set_uint(const char *val, const struct kernel_param *kp)
+{
+	return kstrtouint(val, 0, kp->arg);
+}
+
+int param_get_uint(char *buffer, const struct kernel_param *kp)
+{
+	return scnprintf(buffer, PAGE_SIZE, "%u\n", *(unsigned int *)kp->arg);
+}
+
+int param_set_bool(const char *val, const struct kernel_param *kp)
+{
+	// No value means true, as for a bare option on the command line
+	return kstrtobool(val ? val : "1", kp->arg);
+}
+
+int param_get_bool(char *buffer, const struct kernel_param *kp)
+{
+	return scnprintf(buffer, PAGE_SIZE, "%c\n", *(bool *)kp->arg ? 'Y' : 'N');
+}
+
+const struct kernel_param_ops param_ops_int = { .set = param_set_int, .get = param_get_int };
+const struct kernel_param_ops param_ops_uint = { .set = param_set_uint, .get = param_get_uint };
+const struct kernel_param_ops param_ops_bool = { .set = param_set_bool, .get = param_get_bool };
+
+/* ::::  Deferred execution  :::: */
+static struct workqueue_struct host_system_wq = { .name = "events" };
+struct workqueue_struct *system_wq = &host_system_wq;
+struct workqueue_struct *system_unbound_wq = &host_system_wq;
+struct workqueue_struct *system_long_wq = &host_system_wq;
+struct workqueue_struct *system_freezable_wq = &host_system_wq;
+struct workqueue_struct *system_power_efficient_wq = &host_system_wq;
+
+static struct work_struct *host_works;
+static struct timer_list *host_timers;
+static struct hrtimer *host_hrtimers;
+
+#define HOST_NS_PER_JIFFY	(NSEC_PER_SEC / HZ)
+
+struct workqueue_struct *alloc_workqueue(const char *fmt, unsigned int flags, int max_active, ...)
+{
+	struct workqueue_struct *wq = calloc(1, sizeof(*wq));
+
+	if (wq)
+		wq->name = fmt;
+	return wq;
+}
+
+struct workqueue_struct *alloc_ordered_workqueue(const char *fmt, unsigned int flags, ...)
+{
+	return alloc_workqueue(fmt, flags, 1);
+}
+
+void destroy_workqueue(struct workqueue_struct *wq)
+{
+	flush_workqueue(wq);
+	if (wq != &host_system_wq)
+		free(wq);
+}
+
+static void host_work_unlink(struct work_struct *work)
+{
+	struct work_struct **p;
+
+	for (p = &host_works; *p; p = &(*p)->next) {
+		if (*p == work) {
+			*p = work->next;
+			break;
+		}
+	}
+	work->next = NULL;
+	work->pending = false;
+}
+
+bool queue_delayed_work(struct workqueue_struct *wq, struct delayed_work *dwork, unsigned long delay)
+{
+	struct work_struct *work = &dwork->work;
+
+	if (work->pending)
+		return false;
+	work->pending = true;
+	work->due_ns = host_time_ns + (u64)delay * HOST_NS_PER_JIFFY;
+	work->next = host_works;
+	host_works = work;
+	return true;
+}
+
+bool mod_delayed_work(struct workqueue_struct *wq, struct delayed_work *dwork, unsigned long delay)
+{
+	bool pending = dwork->work.pending;
+
+	if (pending)
+		dwork->work.due_ns = host_time_ns + (u64)delay * HOST_NS_PER_JIFFY;
+	else
+		queue_delayed_work(wq, dwork, delay);
+	return pending;
+}
+
+static void host_work_run(struct work_struct *work)
+{
+	struct task_struct *caller = current;
+
+	host_work_unlink(work);
+	current = &host_task_worker;
+	work->func(work);
+	current = caller;
+}
+
+// A delayed work is flushed like flush_delayed_work(), its timer fires right away
+bool flush_work(struct work_struct *work)
+{
+	if (!work->pending)
+		return false;
+	host_work_run(work);
+	return true;
+}
+
+bool cancel_work_sync(struct work_struct *work)
+{
+	bool pending = work->pending;
+
+	if (pending)
+		host_work_unlink(work);
+	return pending;
+}
+
+void flush_workqueue(struct workqueue_struct *wq)
+{
+	struct work_struct *work;
+	bool ran;
+
+	do {
+		ran = false;
+		for (work = host_works; work; work = work->next) {
+			if (work->due_ns <= host_time_ns) {
+				host_work_run(work);
+				ran = true;
+				break;
+			}
+		}
+	} while (ran);
+}
+
+void timer_setup(struct timer_list *timer, void (*func)(struct timer_list *), unsigned int flags)
+{
+	memset(timer, 0, sizeof(*timer));
+	timer->function = func;
+}
+
+int del_timer(struct timer_list *timer)
+{
+	struct timer_list **p;
+
+	if (!timer->pending)
+		return 0;
+	for (p = &host_timers; *p; p = &(*p)->next) {
+		if (*p == timer) {
+			*p = timer->next;
+			break;
+		}
+	}
+	timer->next = NULL;
+	timer->pending = false;
+	return 1;
+}
+
+int mod_timer(struct timer_list *timer, unsigned long expires)
+{
+	int pending = del_timer(timer);
+
+	timer->expires = expires;
+	timer->pending = true;
+	timer->next = host_timers;
+	host_timers = timer;
+	return pending;
+}
+
+void hrtimer_init(struct hrtimer *timer, int clock_id, int mode)
+{
+	memset(timer, 0, sizeof(*timer));
+}
+
+int hrtimer_cancel(struct hrtimer *timer)
+{
+	struct hrtimer **p;
+
+	if (!timer->pending)
+		return 0;
+	for (p = &host_hrtimers; *p; p = &(*p)->next) {
+		if (*p == timer) {
+			*p = timer->next;
+			break;
+		}
+	}
+	timer->next = NULL;
+	timer->pending = false;
+	return 1;
+}
+
+static void host_hrtimer_enqueue(struct hrtimer *timer)
+{
+	timer->pending = true;
+	timer->next = host_hrtimers;
+	host_hrtimers = timer;
+}
+
+void hrtimer_start(struct hrtimer *timer, ktime_t tim, int mode)
+{
+	hrtimer_cancel(timer);
+	timer->expires_ns = host_time_ns + tim;
+	host_hrtimer_enqueue(timer);
+}
+
+u64 hrtimer_forward_now(struct hrtimer *timer, ktime_t interval)
+{
+	u64 overruns = 0;
+
+	while (timer->expires_ns <= host_time_ns) {
+		timer->expires_ns += interval;
+		overruns++;
+	}
+	return overruns;
+}
+
+/**
+ * Finds the work item, timer or hrtimer due first, not later than deadline,
+ * advances the clock to its time and runs it
+ */
+static bool host_run_next(u64 deadline_ns)
+{
+	struct work_struct *work, *next_work = NULL;
+	struct timer_list *timer, *next_timer = NULL;
+	struct hrtimer *hrtimer, *next_hrtimer = NULL;
+	struct task_struct *caller = current;
+	u64 due = deadline_ns;
+	bool found = false;
+
+	for (work = host_works; work; work = work->next) {
+		if (work->due_ns <= due) {
+			due = work->due_ns;
+			next_work = work;
+			found = true;
+		}
+	}
+	for (timer = host_timers; timer; timer = timer->next) {
+		if ((u64)timer->expires * HOST_NS_PER_JIFFY <= due) {
+			due = (u64)timer->expires * HOST_NS_PER_JIFFY;
+			next_timer = timer;
+			next_work = NULL;
+			found = true;
+		}
+	}
+	for (hrtimer = host_hrtimers; hrtimer; hrtimer = hrtimer->next) {
+		if (hrtimer->expires_ns <= due) {
+			due = hrtimer->expires_ns;
+			next_hrtimer = hrtimer;
+			next_timer = NULL;
+			next_work = NULL;
+			found = true;
+		}
+	}
+	if (!found)
+		return false;
+
+	if (due > host_time_ns)
+		host_advance_ns(due - host_time_ns);
+
+	if (next_work) {
+		host_work_run(next_work);
+	} else if (next_timer) {
+		del_timer(next_timer);
+		current = &host_task_worker;
+		next_timer->function(next_timer);
+		current = caller;
+	} else {
+		hrtimer_cancel(next_hrtimer);
+		current = &host_task_worker;
+		if (next_hrtimer->function(next_hrtimer) == HRTIMER_RESTART)
+			host_hrtimer_enqueue(next_hrtimer);
+		current = caller;
+	}
+
+	return true;
+}
+
+#define HOST_RUN_PENDING_MAX	1000000
+
+unsigned int host_run_pending(void)
+{
+	unsigned int count = 0;
+
+	while (host_run_next(host_time_ns)) {
+		if (++count == HOST_RUN_PENDING_MAX)
+			host_bug("deferred callbacks keep rescheduling themselves without delay\n");
+	}
+	return count;
+}
+
+void host_run_until(u64 deadline_ns)
+{
+	while (host_run_next(deadline_ns))
+		;
+	if (deadline_ns > host_time_ns)
+		host_advance_ns(deadline_ns - host_time_ns);
+}
+
+unsigned int host_pending_count(void)
+{
+	unsigned int count = 0;
+	struct work_struct *work;
+	struct timer_list *timer;
+	struct hrtimer *hrtimer;
+
+	for (work = host_works; work; work = work->next)
+		count++;
+	for (timer = host_timers; timer; timer = timer->next)
+		count++;
+	for (hrtimer = host_hrtimers; hrtimer; hrtimer = hrtimer->next)
+		count++;
+	return count;
+}
+
+static void host_completion_consume(struct completion *x)
+{
+	if (x->done != UINT32_MAX)
+		x->done--;
+}
+
+void wait_for_completion(struct completion *x)
+{
+	while (!x->done) {
+		if (!host_run_next(U64_MAX))
+			host_bug("waiting for a completion nothing is left to complete\n");
+	}
+	host_completion_consume(x);
+}
+
+unsigned long wait_for_completion_timeout(struct completion *x, unsigned long timeout)
+{
+	u64 deadline_ns = host_time_ns + (u64)timeout * HOST_NS_PER_JIFFY;
+	unsigned long left;
+
+	while (!x->done) {
+		if (!host_run_next(deadline_ns)) {
+			if (deadline_ns > host_time_ns)
+				host_advance_ns(deadline_ns - host_time_ns);
+			return 0;
+		}
+	}
+	host_completion_consume(x);
+
+	left = (deadline_ns - min(deadline_ns, host_time_ns)) / HOST_NS_PER_JIFFY;
+	return left ? left : 1;
+}
+
+/* ::::  seq_file  :::: */
+#define HOST_SEQ_BUF_SIZE	(64 * 1024)
+
+void seq_printf(struct seq_file *m, const char *fmt, ...)
+{
+	va_list args;
+	int len;
+
+	if (m->count >= m->size)
+		return;
+	va_start(args, fmt);
+	len = vsnprintf(m->buf + m->count, m->size - m->count, fmt, args);
+	va_end(args);
+	m->count = min(m->count + len, m->size);
+}
+
+void seq_puts(struct seq_file *m, const char *s)
+{
+	seq_printf(m, "%s", s);
+}
+
+void seq_putc(struct seq_file *m, char c)
+{
+	if (m->count < m->size)
+		m->buf[m->count++] = c;
+}
+
+int single_open(struct file *file, int (*show)(struct seq_file *, void *), void *data)
+{
+	struct seq_file *m = calloc(1, sizeof(*m));
+
+	if (!m)
+		return -ENOMEM;
+	m->show = show;
+	m->private = data;
+	file->private_data = m;
+	return 0;
+}
+
+int single_release(struct inode *inode, struct file *file)
+{
+	struct seq_file *m = file->private_data;
+
+	free(m->buf);
+	free(m);
+	return 0;
+}
+
+ssize_t seq_read(struct file *file, char __user *buf, size_t size, loff_t *ppos)
+{
+	struct seq_file *m = file->private_data;
+	int ret;
+
+	if (!m->shown) {
+		m->buf = malloc(HOST_SEQ_BUF_SIZE);
+		if (!m->buf)
+			return -ENOMEM;
+		m->size = HOST_SEQ_BUF_SIZE;
+		m->count = 0;
+		m->shown = true;
+		ret = m->show(m, NULL);
+		if (ret < 0)
+			return ret;
+		if (m->count >= m->size)
+			host_bug("seq_file output over %d bytes\n", HOST_SEQ_BUF_SIZE);
+	}
+
+	return simple_read_from_buffer(buf, size, ppos, m->buf, m->count);
+}
+
+loff_t seq_lseek(struct file *file, loff_t offset, int whence)
+{
+	return default_llseek(file, offset, whence);
+}
+
+ssize_t simple_read_from_buffer(void __user *to, size_t count, loff_t *ppos, const void *from, size_t available)
+{
+	loff_t pos = *ppos;
+
+	if (pos < 0)
+		return -EINVAL;
+	if ((size_t)pos >= available || !count)
+		return 0;
+	count = min(count, available - pos);
+	memcpy(to, (const char *)from + pos, count);
+	*ppos = pos + count;
+	return count;
+}
+
+ssize_t simple_write_to_buffer(void *to, size_t available, loff_t *ppos, const void __user *from, size_t count)
+{
+	loff_t pos = *ppos;
+
+	if (pos < 0)
+		return -EINVAL;
+	if ((size_t)pos >= available || !count)
+		return 0;
+	count = min(count, available - pos);
+	memcpy((char *)to + pos, from, count);
+	*ppos = pos + count;
+	return count;
+}
+
+int simple_open(struct inode *inode, struct file *file)
+{
+	if (inode->i_private)
+		file->private_data = inode->i_private;
+	return 0;
+}
+
+int nonseekable_open(struct inode *inode, struct file *file)
+{
+	return 0;
+}
+
+// Only the start is tracked, reads go through the harness from offset 0
+loff_t default_llseek(struct file *file, loff_t offset, int whence)
+{
+	return whence == SEEK_SET && offset >= 0 ? offset : -EINVAL;
+}
+
+loff_t no_llseek(struct file *file, loff_t offset, int whence)
+{
+	return -ESPIPE;
+}
+
+/* ::::  debugfs  :::: */
+enum host_dentry_kind {
+	HOST_DENTRY_DIR,
+	HOST_DENTRY_FILE,
+	HOST_DENTRY_U16,
+	HOST_DENTRY_X16,
+	HOST_DENTRY_U32,
+	HOST_DENTRY_X32,
+	HOST_DENTRY_U64,
+	HOST_DENTRY_BOOL,
+};
+
+struct dentry {
+	char name[64];
+	struct dentry *parent;
+	enum host_dentry_kind kind;
+	const struct file_operations *fops;
+	void *data;
+	struct dentry *next;
+};
+
+static struct dentry *host_dentries;
+
+static struct dentry *host_debugfs_create(const char *name, struct dentry *parent, enum host_dentry_kind kind,
+					  void *data, const struct file_operations *fops)
+{
+	struct dentry *dentry;
+
+	if (IS_ERR(parent))
+		return parent;
+	if (debugfs_lookup(name, parent))
+		return ERR_PTR(-EEXIST);
+
+	dentry = calloc(1, sizeof(*dentry));
+	if (!dentry)
+		return ERR_PTR(-ENOMEM);
+	snprintf(dentry->name, sizeof(dentry->name), "%s", name);
+	dentry->parent = parent;
+	dentry->kind = kind;
+	dentry->data = data;
+	dentry->fops = fops;
+	dentry->next = host_dentries;
+	host_dentries = dentry;
+	return dentry;
+}
+
+struct dentry *debugfs_create_dir(const char *name, struct dentry *parent)
+{
+	return host_debugfs_create(name, parent, HOST_DENTRY_DIR, NULL, NULL);
+}
+
+struct dentry *debugfs_create_file(const char *name, umode_t mode, struct dentry *parent, void *data,
+				   const struct file_operations *fops)
+{
+	return host_debugfs_create(name, parent, HOST_DENTRY_FILE, data, fops);
+}
+
+void debugfs_create_u16(const char *name, umode_t mode, struct dentry *parent, u16 *value)
+{
+	host_debugfs_create(name, parent, HOST_DENTRY_U16, value, NULL);
+}
+
+void debugfs_create_x16(const char *name, umode_t mode, struct dentry *parent, u16 *value)
+{
+	host_debugfs_create(name, parent, HOST_DENTRY_X16, value, NULL);
+}
+
+void debugfs_create_u32(const char *name, umode_t mode, struct dentry *parent, u32 *value)
+{
+	host_debugfs_create(name, parent, HOST_DENTRY_U32, value, NULL);
+}
+
+void debugfs_create_x32(const char *name, umode_t mode, struct dentry *parent, u32 *value)
+{
+	host_debugfs_create(name, parent, HOST_DENTRY_X32, value, NULL);
+}
+
+void debugfs_create_u64(const char *name, umode_t mode, struct dentry *parent, u64 *value)
+{
+	host_debugfs_create(name, parent, HOST_DENTRY_U64, value, NULL);
+}
+
+void debugfs_create_bool(const char *name, umode_t mode, struct dentry *parent, bool *value)
+{
+	host_debugfs_create(name, parent, HOST_DENTRY_BOOL, value, NULL);
+}
+
+struct dentry *debugfs_lookup(const char *name, struct dentry *parent)
+{
+	struct dentry *dentry;
+
+	for (dentry = host_dentries; dentry; dentry = dentry->next)
+		if (dentry->parent == parent && !strcmp(dentry->name, name))
+			return dentry;
+	return NULL;
+}
+
+static void host_debugfs_unlink(struct dentry *dentry)
+{
+	struct dentry **p;
+
+	for (p = &host_dentries; *p; p = &(*p)->next) {
+		if (*p == dentry) {
+			*p = dentry->next;
+			break;
+		}
+	}
+}
+
+void debugfs_remove_recursive(struct dentry *dentry)
+{
+	struct dentry *child;
+
+	if (IS_ERR_OR_NULL(dentry))
+		return;
+
+	do {
+		for (child = host_dentries; child; child = child->next)
+			if (child->parent == dentry)
+				break;
+		if (child)
+			debugfs_remove_recursive(child);
+	} while (child);
+
+	host_debugfs_unlink(dentry);
+	free(dentry);
+}
+
+void debugfs_remove(struct dentry *dentry)
+{
+	debugfs_remove_recursive(dentry);
+}
+
+struct dentry *host_debugfs_find(const char *path)
+{
+	struct dentry *dentry = NULL;
+	char component[64];
+	const char *end;
+	size_t len;
+
+	while (*path) {
+		end = strchrnul(path, '/');
+		len = min((size_t)(end - path), sizeof(component) - 1);
+		memcpy(component, path, len);
+		component[len] = '\0';
+		dentry = debugfs_lookup(component, dentry);
+		if (!dentry)
+			return NULL;
+		path = *end ? end + 1 : end;
+	}
+	return dentry;
+}
+
+ssize_t host_debugfs_read(const char *path, char *buf, size_t size)
+{
+	struct dentry *dentry = host_debugfs_find(path);
+	struct inode inode = { 0 };
+	struct file file = { .f_mode = FMODE_READ };
+	loff_t pos = 0;
+	ssize_t ret, len = 0;
+
+	if (!dentry)
+		return -ENOENT;
+	if (size == 0)
+		return -EINVAL;
+
+	switch (dentry->kind) {
+	case HOST_DENTRY_DIR:
+		return -EISDIR;
+	case HOST_DENTRY_U16:
+		return scnprintf(buf, size, "%u\n", *(u16 *)dentry->data);
+	case HOST_DENTRY_X16:
+		return scnprintf(buf, size, "0x%04x\n", *(u16 *)dentry->data);
+	case HOST_DENTRY_U32:
+		return scnprintf(buf, size, "%u\n", *(u32 *)dentry->data);
+	case HOST_DENTRY_X32:
+		return scnprintf(buf, size, "0x%08x\n", *(u32 *)dentry->data);
+	case HOST_DENTRY_U64:
+		return scnprintf(buf, size, "%llu\n", *(u64 *)dentry->data);
+	case HOST_DENTRY_BOOL:
+		return scnprintf(buf, size, "%c\n", *(bool *)dentry->data ? 'Y' : 'N');
+	case HOST_DENTRY_FILE:
+		break;
+	}
+
+	if (!dentry->fops->read)
+		return -EINVAL;
+	inode.i_private = dentry->data;
+	file.private_data = dentry->data;
+	if (dentry->fops->open) {
+		ret = dentry->fops->open(&inode, &file);
+		if (ret)
+			return ret;
+	}
+	do {
+		ret = dentry->fops->read(&file, buf + len, size - 1 - len, &pos);
+		if (ret > 0)
+			len += ret;
+	} while (ret > 0 && (size_t)len < size - 1);
+	buf[len] = '\0';
+	if (dentry->fops->release)
+		dentry->fops->release(&inode, &file);
+
+	return ret < 0 ? ret : len;
+}
+
+ssize_t host_debugfs_write(const char *path, const char *value)
+{
+	struct dentry *dentry = host_debugfs_find(path);
+	struct inode inode = { 0 };
+	struct file file = { .f_mode = FMODE_WRITE };
+	size_t count = strlen(value);
+	unsigned long long parsed;
+	loff_t pos = 0;
+	ssize_t ret;
+	bool flag;
+
+	if (!dentry)
+		return -ENOENT;
+
+	switch (dentry->kind) {
+	case HOST_DENTRY_DIR:
+		return -EISDIR;
+	case HOST_DENTRY_U16:
+	case HOST_DENTRY_X16:
+		ret = host_kstrtoull_max(value, 0, U16_MAX, &parsed);
+		if (!ret)
+			*(u16 *)dentry->data = parsed;
+		return ret ? ret : (ssize_t)count;
+	case HOST_DENTRY_U32:
+	case HOST_DENTRY_X32:
+		ret = host_kstrtoull_max(value, 0, U32_MAX, &parsed);
+		if (!ret)
+			*(u32 *)dentry->data = parsed;
+		return ret ? ret : (ssize_t)count;
+	case HOST_DENTRY_U64:
+		ret = host_kstrtoull(value, 0, &parsed);
+		if (!ret)
+			*(u64 *)dentry->data = parsed;
+		return ret ? ret : (ssize_t)count;
+	case HOST_DENTRY_BOOL:
+		ret = kstrtobool(value, &flag);
+		if (!ret)
+			*(bool *)dentry->data = flag;
+		return ret ? ret : (ssize_t)count;
+	case HOST_DENTRY_FILE:
+		break;
+	}
+
+	if (!dentry->fops->write)
+		return -EINVAL;
+	inode.i_private = dentry->data;
+	file.private_data = dentry->data;
+	if (dentry->fops->open) {
+		ret = dentry->fops->open(&inode, &file);
+		if (ret)
+			return ret;
+	}
+	ret = dentry->fops->write(&file, value, count, &pos);
+	if (dentry->fops->release)
+		dentry->fops->release(&inode, &file);
+
+	return ret;
+}
+
+unsigned int host_debugfs_count(void)
+{
+	unsigned int count = 0;
+	struct dentry *dentry;
+
+	for (dentry = host_dentries; dentry; dentry = dentry->next)
+		count++;
+	return count;
+}
+
+/* ::::  sysfs  :::: */
+struct host_sysfs_attr {
+	struct kobject *kobj;
+	const char *group;
+	struct device_attribute *attr;
+	struct host_sysfs_attr *next;
+};
+
+static struct host_sysfs_attr *host_sysfs_attrs;
+
+static struct host_sysfs_attr *host_sysfs_lookup(struct kobject *kobj, const char *group, const char *name)
+{
+	struct host_sysfs_attr *entry;
+
+	for (entry = host_sysfs_attrs; entry; entry = entry->next) {
+		if ((!kobj || entry->kobj == kobj) &&
+		    (group ? entry->group && !strcmp(entry->group, group) : !entry->group) &&
+		    !strcmp(entry->attr->attr.name, name))
+			return entry;
+	}
+	return NULL;
+}
+
+static int host_sysfs_add(struct kobject *kobj, const char *group, const struct device_attribute *attr)
+{
+	struct host_sysfs_attr *entry;
+
+	if (host_sysfs_lookup(kobj, group, attr->attr.name))
+		return -EEXIST;
+	entry = calloc(1, sizeof(*entry));
+	if (!entry)
+		return -ENOMEM;
+	entry->kobj = kobj;
+	entry->group = group;
+	entry->attr = (struct device_attribute *)attr;
+	entry->next = host_sysfs_attrs;
+	host_sysfs_attrs = entry;
+	return 0;
+}
+
+static void host_sysfs_del(struct kobject *kobj, const char *group, const char *name)
+{
+	struct host_sysfs_attr *entry = host_sysfs_lookup(kobj, group, name);
+	struct host_sysfs_attr **p;
+
+	if (!entry)
+		return;
+	for (p = &host_sysfs_attrs; *p; p = &(*p)->next) {
+		if (*p == entry) {
+			*p = entry->next;
+			break;
+		}
+	}
+	free(entry);
+}
+
+int device_create_file(struct device *dev, const struct device_attribute *attr)
+{
+	return host_sysfs_add(&dev->kobj, NULL, attr);
+}
+
+void device_remove_file(struct device *dev, const struct device_attribute *attr)
+{
+	host_sysfs_del(&dev->kobj, NULL, attr->attr.name);
+}
+
+// Groups of the driver only hold device attributes
+int sysfs_create_group(struct kobject *kobj, const struct attribute_group *grp)
+{
+	struct attribute **attr;
+	int ret;
+
+	for (attr = grp->attrs; *attr; ++attr) {
+		ret = host_sysfs_add(kobj, grp->name, container_of(*attr, struct device_attribute, attr));
+		if (ret) {
+			while (attr-- != grp->attrs)
+				host_sysfs_del(kobj, grp->name, (*attr)->name);
+			return ret;
+		}
+	}
+	return 0;
+}
+
+void sysfs_remove_group(struct kobject *kobj, const struct attribute_group *grp)
+{
+	struct attribute **attr;
+
+	for (attr = grp->attrs; *attr; ++attr)
+		host_sysfs_del(kobj, grp->name, (*attr)->name);
+}
+
+ssize_t host_sysfs_show(const char *group, const char *name, char *buf)
+{
+	struct host_sysfs_attr *entry = host_sysfs_lookup(NULL, group, name);
+
+	if (!entry)
+		return -ENOENT;
+	if (!entry->attr->show)
+		return -EACCES;
+	// Like the kernel, the buffer is a zeroed page
+	memset(buf, 0, PAGE_SIZE);
+	return entry->attr->show(container_of(entry->kobj, struct device, kobj), entry->attr, buf);
+}
+
+ssize_t host_sysfs_store(const char *group, const char *name, const char *value)
+{
+	struct host_sysfs_attr *entry = host_sysfs_lookup(NULL, group, name);
+
+	if (!entry)
+		return -ENOENT;
+	if (!entry->attr->store)
+		return -EACCES;
+	return entry->attr->store(container_of(entry->kobj, struct device, kobj), entry->attr, value, strlen(value));
+}
+
+unsigned int host_sysfs_count(void)
+{
+	unsigned int count = 0;
+	struct host_sysfs_attr *entry;
+
+	for (entry = host_sysfs_attrs; entry; entry = entry->next)
+		count++;
+	return count;
+}
+
+/* ::::  Character devices  :::: */
+struct host_chrdev {
+	struct device dev;
+	char name[64];
+	dev_t devt;
+	struct class *cls;
+	struct host_chrdev *next;
+};
+
+static struct host_chrdev *host_chrdevs;
+static struct cdev *host_cdevs[8];
+static struct miscdevice *host_miscs[8];
+static unsigned int host_next_major = 240;
+
+int alloc_chrdev_region(dev_t *dev, unsigned int baseminor, unsigned int count, const char *name)
+{
+	*dev = MKDEV(host_next_major, baseminor);
+	host_next_major++;
+	return 0;
+}
+
+void unregister_chrdev_region(dev_t from, unsigned int count)
+{
+}
+
+void cdev_init(struct cdev *cdev, const struct file_operations *fops)
+{
+	memset(cdev, 0, sizeof(*cdev));
+	cdev->ops = fops;
+}
+
+int cdev_add(struct cdev *cdev, dev_t dev, unsigned int count)
+{
+	unsigned int i;
+
+	cdev->dev = dev;
+	for (i = 0; i < ARRAY_SIZE(host_cdevs); ++i) {
+		if (!host_cdevs[i]) {
+			host_cdevs[i] = cdev;
+			return 0;
+		}
+	}
+	return -ENOSPC;
+}
+
+void cdev_del(struct cdev *cdev)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(host_cdevs); ++i)
+		if (host_cdevs[i] == cdev)
+			host_cdevs[i] = NULL;
+}
+
+struct class *class_create(const char *name)
+{
+	struct class *cls = calloc(1, sizeof(*cls));
+
+	if (!cls)
+		return ERR_PTR(-ENOMEM);
+	cls->name = name;
+	return cls;
+}
+
+void class_destroy(struct class *cls)
+{
+	if (!IS_ERR_OR_NULL(cls))
+		free(cls);
+}
+
+struct device *device_create(struct class *cls, struct device *parent, dev_t devt, void *drvdata, const char *fmt, ...)
+{
+	struct host_chrdev *chrdev = calloc(1, sizeof(*chrdev));
+	va_list args;
+
+	if (!chrdev)
+		return ERR_PTR(-ENOMEM);
+	va_start(args, fmt);
+	vsnprintf(chrdev->name, sizeof(chrdev->name), fmt, args);
+	va_end(args);
+	chrdev->dev.kobj.name = chrdev->name;
+	chrdev->dev.parent = parent;
+	chrdev->dev.driver_data = drvdata;
+	chrdev->devt = devt;
+	chrdev->cls = cls;
+	chrdev->next = host_chrdevs;
+	host_chrdevs = chrdev;
+	return &chrdev->dev;
+}
+
+void device_destroy(struct class *cls, dev_t devt)
+{
+	struct host_chrdev **p, *chrdev;
+
+	for (p = &host_chrdevs; *p; p = &(*p)->next) {
+		if ((*p)->cls == cls && (*p)->devt == devt) {
+			chrdev = *p;
+			*p = chrdev->next;
+			free(chrdev);
+			return;
+		}
+	}
+}
+
+int misc_register(struct miscdevice *misc)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(host_miscs); ++i) {
+		if (!host_miscs[i]) {
+			host_miscs[i] = misc;
+			return 0;
+		}
+	}
+	return -EBUSY;
+}
+
+void misc_deregister(struct miscdevice *misc)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(host_miscs); ++i)
+		if (host_miscs[i] == misc)
+			host_miscs[i] = NULL;
+}
+
+static const struct file_operations *host_chrdev_fops(const char *name, struct inode *inode)
+{
+	struct host_chrdev *chrdev;
+	unsigned int i;
+
+	for (chrdev = host_chrdevs; chrdev; chrdev = chrdev->next) {
+		if (strcmp(chrdev->name, name))
+			continue;
+		for (i = 0; i < ARRAY_SIZE(host_cdevs); ++i) {
+			if (host_cdevs[i] && host_cdevs[i]->dev == chrdev->devt) {
+				inode->i_rdev = chrdev->devt;
+				return host_cdevs[i]->ops;
+			}
+		}
+	}
+	for (i = 0; i < ARRAY_SIZE(host_miscs); ++i)
+		if (host_miscs[i] && !strcmp(host_miscs[i]->name, name))
+			return host_miscs[i]->fops;
+	return NULL;
+}
+
+long host_chrdev_ioctl(const char *name, unsigned int cmd, unsigned long arg)
+{
+	struct inode inode = { 0 };
+	struct file file = { .f_mode = FMODE_READ | FMODE_WRITE };
+	const struct file_operations *fops = host_chrdev_fops(name, &inode);
+	long ret;
+
+	if (!fops)
+		return -ENOENT;
+	if (!fops->unlocked_ioctl)
+		return -ENOTTY;
+
+	if (fops->open) {
+		ret = fops->open(&inode, &file);
+		if (ret)
+			return ret;
+	}
+	ret = fops->unlocked_ioctl(&file, cmd, arg);
+	if (fops->release)
+		fops->release(&inode, &file);
+
+	return ret;
+}
+
+ssize_t host_chrdev_write(const char *name, const void *buf, size_t count)
+{
+	struct inode inode = { 0 };
+	struct file file = { .f_mode = FMODE_WRITE };
+	const struct file_operations *fops = host_chrdev_fops(name, &inode);
+	loff_t pos = 0;
+	ssize_t ret;
+
+	if (!fops)
+		return -ENOENT;
+	if (!fops->write)
+		return -EINVAL;
+
+	if (fops->open) {
+		ret = fops->open(&inode, &file);
+		if (ret)
+			return ret;
+	}
+	ret = fops->write(&file, (const char __user *)buf, count, &pos);
+	if (fops->release)
+		fops->release(&inode, &file);
+
+	return ret;
+}
+
+/* ::::  Platform devices  :::: */
+static struct platform_driver *host_pdriver;
+static struct platform_device *host_pdev;
+
+struct platform_device *platform_create_bundle(struct platform_driver *driver, int (*probe)(struct platform_device *),
+					       void *res, unsigned int n_res, const void *data, size_t size)
+{
+	struct platform_device *pdev;
+	int ret;
+
+	if (host_pdev)
+		return ERR_PTR(-EBUSY);
+	pdev = calloc(1, sizeof(*pdev));
+	if (!pdev)
+		return ERR_PTR(-ENOMEM);
+	pdev->name = driver->driver.name;
+	pdev->id = -1;
+	pdev->dev.kobj.name = driver->driver.name;
+
+	ret = probe(pdev);
+	if (ret) {
+		free(pdev);
+		return ERR_PTR(ret);
+	}
+
+	host_pdriver = driver;
+	host_pdev = pdev;
+	return pdev;
+}
+
+void platform_device_unregister(struct platform_device *pdev)
+{
+	struct host_sysfs_attr *entry;
+
+	if (IS_ERR_OR_NULL(pdev))
+		return;
+	if (pdev == host_pdev && host_pdriver->remove)
+		host_pdriver->remove(pdev);
+
+	// Attributes not removed by the driver go with the device
+	for (entry = host_sysfs_attrs; entry; entry = entry->next) {
+		if (entry->kobj == &pdev->dev.kobj) {
+			pr_warn("%s: sysfs attribute %s/%s left on remove\n", pdev->name,
+				entry->group ? entry->group : ".", entry->attr->attr.name);
+			host_sysfs_del(entry->kobj, entry->group, entry->attr->attr.name);
+			entry = host_sysfs_attrs;
+			if (!entry)
+				break;
+		}
+	}
+
+	if (pdev == host_pdev)
+		host_pdev = NULL;
+	free(pdev);
+}
+
+void platform_driver_unregister(struct platform_driver *drv)
+{
+	if (drv == host_pdriver && !host_pdev)
+		host_pdriver = NULL;
+}
+
+struct platform_device *host_platform_device(void)
+{
+	return host_pdev;
+}
+
+int host_platform_suspend(void)
+{
+	pm_message_t state = { 0 };
+
+	if (!host_pdev)
+		return -ENODEV;
+	return host_pdriver->suspend ? host_pdriver->suspend(host_pdev, state) : 0;
+}
+
+int host_platform_resume(void)
+{
+	if (!host_pdev)
+		return -ENODEV;
+	return host_pdriver->resume ? host_pdriver->resume(host_pdev) : 0;
+}
+
+/* ::::  LED class  :::: */
+static struct led_classdev *host_leds;
+
+int led_classdev_register(struct device *parent, struct led_classdev *led_cdev)
+{
+	unsigned int i;
+
+	snprintf(led_cdev->host_name, sizeof(led_cdev->host_name), "%s", led_cdev->name);
+	for (i = 1; host_led_find(led_cdev->host_name); ++i)
+		snprintf(led_cdev->host_name, sizeof(led_cdev->host_name), "%s_%u", led_cdev->name, i);
+
+	if (!led_cdev->max_brightness)
+		led_cdev->max_brightness = LED_FULL;
+	led_cdev->dev = parent;
+	led_cdev->host_next = host_leds;
+	host_leds = led_cdev;
+	return 0;
+}
+
+void led_classdev_unregister(struct led_classdev *led_cdev)
+{
+	struct led_classdev **p;
+
+	for (p = &host_leds; *p; p = &(*p)->host_next) {
+		if (*p == led_cdev) {
+			*p = led_cdev->host_next;
+			break;
+		}
+	}
+	led_cdev->host_next = NULL;
+}
+
+int led_mc_calc_color_components(struct led_classdev_mc *mcled_cdev, enum led_brightness brightness)
+{
+	unsigned int i;
+
+	for (i = 0; i < mcled_cdev->num_colors; ++i)
+		mcled_cdev->subled_info[i].brightness =
+			brightness * mcled_cdev->subled_info[i].intensity / mcled_cdev->led_cdev.max_brightness;
+	return 0;
+}
+
+struct led_classdev *host_led_find(const char *name)
+{
+	struct led_classdev *led_cdev;
+
+	for (led_cdev = host_leds; led_cdev; led_cdev = led_cdev->host_next)
+		if (!strcmp(led_cdev->host_name, name))
+			return led_cdev;
+	return NULL;
+}
+
+// As led_set_brightness(): the non-blocking callback if there is one
+void host_led_set(struct led_classdev *led_cdev, unsigned int brightness)
+{
+	brightness = min(brightness, led_cdev->max_brightness);
+	led_cdev->brightness = brightness;
+	if (led_cdev->brightness_set)
+		led_cdev->brightness_set(led_cdev, brightness);
+	else if (led_cdev->brightness_set_blocking)
+		led_cdev->brightness_set_blocking(led_cdev, brightness);
+}
+
+void host_led_mc_set(struct led_classdev *led_cdev, const unsigned int *intensity, unsigned int brightness)
+{
+	struct led_classdev_mc *mcled_cdev = lcdev_to_mccdev(led_cdev);
+	unsigned int i;
+
+	for (i = 0; i < mcled_cdev->num_colors; ++i)
+		mcled_cdev->subled_info[i].intensity = min(intensity[i], led_cdev->max_brightness);
+	host_led_set(led_cdev, brightness);
+}
+
+unsigned int host_led_count(void)
+{
+	unsigned int count = 0;
+	struct led_classdev *led_cdev;
+
+	for (led_cdev = host_leds; led_cdev; led_cdev = led_cdev->host_next)
+		count++;
+	return count;
+}
+
+/* ::::  DMI  :::: */
+static const char *host_dmi_strings[DMI_STRING_MAX] = {
+	[DMI_SYS_VENDOR] = "TUXEDO",
+	[DMI_BOARD_VENDOR] = "TUXEDO",
+};
+
+void host_dmi_set(enum dmi_field field, const char *value)
+{
+	host_dmi_strings[field] = value;
+}
+
+const char *dmi_get_system_info(int field)
+{
+	return field > DMI_NONE && field < DMI_STRING_MAX ? host_dmi_strings[field] : NULL;
+}
+
+bool dmi_match(enum dmi_field f, const char *str)
+{
+	const char *info = dmi_get_system_info(f);
+
+	return info && str && !strcmp(info, str);
+}
+
+static bool host_dmi_matches(const struct dmi_system_id *dmi)
+{
+	const char *info;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(dmi->matches); ++i) {
+		if (dmi->matches[i].slot == DMI_NONE)
+			break;
+		info = dmi_get_system_info(dmi->matches[i].slot);
+		if (info && (dmi->matches[i].exact_match ? !strcmp(info, dmi->matches[i].substr)
+							 : strstr(info, dmi->matches[i].substr) != NULL))
+			continue;
+		return false;
+	}
+	return true;
+}
+
+int dmi_check_system(const struct dmi_system_id *list)
+{
+	const struct dmi_system_id *dmi;
+	int count = 0;
+
+	for (dmi = list; dmi->matches[0].slot != DMI_NONE; ++dmi) {
+		if (host_dmi_matches(dmi)) {
+			count++;
+			if (dmi->callback && dmi->callback(dmi))
+				break;
+		}
+	}
+	return count;
+}
+
+const struct dmi_system_id *dmi_first_match(const struct dmi_system_id *list)
+{
+	const struct dmi_system_id *dmi;
+
+	for (dmi = list; dmi->matches[0].slot != DMI_NONE; ++dmi)
+		if (host_dmi_matches(dmi))
+			return dmi;
+	return NULL;
+}
+
+/* ::::  Isolation  :::: */
+int host_run_forked(int (*fn)(void))
+{
+	pid_t pid;
+	int status;
+
+	fflush(stdout);
+	fflush(stderr);
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return -1;
+	}
+	if (pid == 0) {
+		status = fn();
+		fflush(stdout);
+		_exit(status);
+	}
+
+	if (waitpid(pid, &status, 0) < 0) {
+		perror("waitpid");
+		return -1;
+	}
+	if (WIFSIGNALED(status)) {
+		fprintf(stderr, "killed by signal %d\n", WTERMSIG(status));
+		return -1;
+	}
+	return WEXITSTATUS(status);
+}
+
+/* ::::  Power supply and input  :::: */
+static bool host_power_supplied = true;
+
+int power_supply_is_system_supplied(void)
+{
+	return host_power_supplied;
+}
+
+void host_power_supply_set(bool supplied)
+{
+	host_power_supplied = supplied;
+}
+
+unsigned long host_input_keys_reported;
@@ -0,0 +1,94 @@
+/*!
+ * Copyright (c) 2023 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-keyboard.
+ *
+ * tuxedo-keyboard is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef HOST_HARNESS_H
+#define HOST_HARNESS_H
+
+#include "host_kernel.h"
+
+/**
+ * Harness side of the host build: what userspace, the LED core and the PM
+ * core would do to the driver, plus inspection of the shim state
+ */
+
+// Driver objects, see module_init() in host_kernel.h
+int host_init_tuxedo_keyboard(void);
+void host_exit_tuxedo_keyboard(void);
+int host_init_tuxedo_io(void);
+void host_exit_tuxedo_io(void);
+
+// Module parameter variable by parameter name, e.g. *host_param(bool, deferred_resume) = false
+#define host_param(type, name) \
+	({ extern void *const host_param_##name; (type *)host_param_##name; })
+
+// printk() prints up to this level, default KERN_WARNING or $HOST_LOG_LEVEL
+extern int host_log_level;
+// Messages per level, printed or not
+extern unsigned long host_printk_count[8];
+
+// Task running work items, timers and hrtimers
+extern struct task_struct host_task_worker;
+
+// Work items, timers and hrtimers queued
+unsigned int host_pending_count(void);
+
+/**
+ * debugfs access by path relative to the debugfs root, e.g.
+ * "tuxedo_keyboard/clevo_op_budget/stats". Read returns the length read
+ * (always NUL terminated), write the length written, both -errno on error.
+ */
+struct dentry *host_debugfs_find(const char *path);
+ssize_t host_debugfs_read(const char *path, char *buf, size_t size);
+ssize_t host_debugfs_write(const char *path, const char *value);
+unsigned int host_debugfs_count(void);
+
+/**
+ * sysfs attributes of any device by group (NULL for attributes directly on
+ * the device) and name, like a read or write of the sysfs file
+ */
+ssize_t host_sysfs_show(const char *group, const char *name, char *buf);
+ssize_t host_sysfs_store(const char *group, const char *name, const char *value);
+unsigned int host_sysfs_count(void);
+
+/**
+ * LED class devices by the name the LED core gave them (duplicates get _1,
+ * _2, ... appended). Setting brightness behaves like a write to the
+ * brightness file, the multicolor variant writes multi_intensity first.
+ */
+struct led_classdev *host_led_find(const char *name);
+void host_led_set(struct led_classdev *led_cdev, unsigned int brightness);
+void host_led_mc_set(struct led_classdev *led_cdev, const unsigned int *intensity, unsigned int brightness);
+unsigned int host_led_count(void);
+
+// ioctl() and write() on a character device created with device_create() or misc_register()
+long host_chrdev_ioctl(const char *name, unsigned int cmd, unsigned long arg);
+ssize_t host_chrdev_write(const char *name, const void *buf, size_t count);
+
+/**
+ * Runs fn in a forked process, so it starts with the static state of freshly
+ * loaded driver objects. Returns the exit status of fn, -1 if the process
+ * could not be run or was killed.
+ */
+int host_run_forked(int (*fn)(void));
+
+// Platform device of the last platform_create_bundle(), NULL if none
+struct platform_device *host_platform_device(void);
+int host_platform_suspend(void);
+int host_platform_resume(void);
+
+#endif // HOST_HARNESS_H
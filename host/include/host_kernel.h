@@ -0,0 +1,951 @@
+/*!
+ * Copyright (c) 2023 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-keyboard.
+ *
+ * tuxedo-keyboard is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef HOST_KERNEL_H
+#define HOST_KERNEL_H
+
+/**
+ * Userspace stand-in for the kernel API used by the driver
+ *
+ * Every <linux/...> and <asm/...> include of the driver resolves to this
+ * header (see host/Makefile). It is single threaded: locks only check for
+ * misuse, work items, timers and completions run when the harness or a
+ * waiting caller asks for it. Time is simulated, sleeps and backend latency
+ * advance the clock without waiting, so runs are fast and reproducible.
+ */
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+
+/* ::::  Types  :::: */
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef unsigned long long u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef long long s64;
+typedef u16 __le16;
+typedef u32 __le32;
+typedef unsigned short umode_t;
+typedef unsigned int gfp_t;
+typedef unsigned int fmode_t;
+typedef u64 phys_addr_t;
+typedef s64 ktime_t;
+typedef u64 acpi_size;
+typedef u32 acpi_status;
+typedef void *acpi_handle;
+typedef struct { u8 b[16]; } guid_t;
+
+/* ::::  Compiler and module boilerplate  :::: */
+#define __user
+#define __init
+#define __exit
+#define __initconst
+#define __rcu
+#define __always_unused		__attribute__((unused))
+#define __maybe_unused		__attribute__((unused))
+#define __packed		__attribute__((packed))
+#define fallthrough		__attribute__((__fallthrough__))
+#define likely(x)		__builtin_expect(!!(x), 1)
+#define unlikely(x)		__builtin_expect(!!(x), 0)
+
+#define KERNEL_VERSION(a, b, c)	(((a) << 16) + ((b) << 8) + (c))
+#define LINUX_VERSION_CODE	KERNEL_VERSION(6, 5, 0)
+#define CONFIG_PM		1
+
+struct module { const char *name; const char *version; };
+extern struct module host_this_module;
+#define THIS_MODULE		(&host_this_module)
+#define MODULE_AUTHOR(x)
+#define MODULE_DESCRIPTION(x)
+#define MODULE_LICENSE(x)
+#define MODULE_VERSION(x)
+#define MODULE_ALIAS(x)
+#define MODULE_DEVICE_TABLE(type, name)
+#define MODULE_PARM_DESC(name, desc)
+#define EXPORT_SYMBOL(sym)
+#define EXPORT_SYMBOL_GPL(sym)
+
+// Init and exit of a driver object are host_init_<HOST_MODULE>() and host_exit_<HOST_MODULE>()
+#define __host_module_fn(prefix, module)	prefix##_##module
+#define _host_module_fn(prefix, module)		__host_module_fn(prefix, module)
+#define module_init(fn)		int _host_module_fn(host_init, HOST_MODULE)(void) { return fn(); }
+#define module_exit(fn)		void _host_module_fn(host_exit, HOST_MODULE)(void) { fn(); }
+
+struct kernel_param { void *arg; };
+struct kernel_param_ops {
+	int (*set)(const char *, const struct kernel_param *);
+	int (*get)(char *, const struct kernel_param *);
+};
+extern const struct kernel_param_ops param_ops_bool, param_ops_int, param_ops_uint;
+int param_set_int(const char *val, const struct kernel_param *kp);
+int param_get_int(char *buffer, const struct kernel_param *kp);
+int param_set_uint(const char *val, const struct kernel_param *kp);
+int param_get_uint(char *buffer, const struct kernel_param *kp);
+int param_set_bool(const char *val, const struct kernel_param *kp);
+int param_get_bool(char *buffer, const struct kernel_param *kp);
+#define module_param_cb(name, ops, arg, perm) \
+	static const struct kernel_param_ops *__host_param_ops_##name __attribute__((unused)) = (ops)
+// Variable of a plain module parameter, set it with host_param() before init
+#define module_param(name, type, perm) \
+	void *const host_param_##name = &(name)
+#define module_param_named(name, value, type, perm) \
+	void *const host_param_##name = &(value)
+
+/* ::::  Logging  :::: */
+#define KERN_ERR		"\0013"
+#define KERN_WARNING		"\0014"
+#define KERN_NOTICE		"\0015"
+#define KERN_INFO		"\0016"
+#define KERN_DEBUG		"\0017"
+#ifndef pr_fmt
+#define pr_fmt(fmt) fmt
+#endif
+int printk(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+#define pr_err(fmt, ...)		printk(KERN_ERR pr_fmt(fmt), ##__VA_ARGS__)
+#define pr_warn(fmt, ...)		printk(KERN_WARNING pr_fmt(fmt), ##__VA_ARGS__)
+#define pr_notice(fmt, ...)		printk(KERN_NOTICE pr_fmt(fmt), ##__VA_ARGS__)
+#define pr_info(fmt, ...)		printk(KERN_INFO pr_fmt(fmt), ##__VA_ARGS__)
+#define pr_debug(fmt, ...)		printk(KERN_DEBUG pr_fmt(fmt), ##__VA_ARGS__)
+#define pr_err_ratelimited		pr_err
+#define pr_warn_ratelimited		pr_warn
+#define pr_info_ratelimited		pr_info
+#define pr_warn_once			pr_warn
+#define dev_err(dev, fmt, ...)		pr_err(fmt, ##__VA_ARGS__)
+#define dev_warn(dev, fmt, ...)		pr_warn(fmt, ##__VA_ARGS__)
+#define dev_info(dev, fmt, ...)		pr_info(fmt, ##__VA_ARGS__)
+#define dev_dbg(dev, fmt, ...)		pr_debug(fmt, ##__VA_ARGS__)
+
+struct ratelimit_state { int unused; };
+#define DEFINE_RATELIMIT_STATE(name, interval, burst)	struct ratelimit_state name
+static inline int __ratelimit(struct ratelimit_state *rs) { return 1; }
+
+/* ::::  Errors and pointers  :::: */
+#define ENOTSUPP		524
+#define ENOIOCTLCMD		515
+#define MAX_ERRNO		4095
+#define IS_ERR_VALUE(x)		((unsigned long)(void *)(x) >= (unsigned long)-MAX_ERRNO)
+static inline void *ERR_PTR(long error) { return (void *)error; }
+static inline long PTR_ERR(const void *ptr) { return (long)ptr; }
+static inline bool IS_ERR(const void *ptr) { return IS_ERR_VALUE(ptr); }
+static inline bool IS_ERR_OR_NULL(const void *ptr) { return !ptr || IS_ERR_VALUE(ptr); }
+#define ZERO_OR_NULL_PTR(x)	((unsigned long)(x) <= 16)
+
+/* ::::  Helpers  :::: */
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
+#define BIT(nr)			(1UL << (nr))
+#define BITS_PER_LONG		64
+#define BIT_MASK(nr)		(1UL << ((nr) % BITS_PER_LONG))
+#define BIT_WORD(nr)		((nr) / BITS_PER_LONG)
+#define BITS_TO_LONGS(nr)	(((nr) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+#define DECLARE_BITMAP(name, bits)	unsigned long name[BITS_TO_LONGS(bits)]
+#define min(a, b)		({ __typeof__(a) __a = (a); __typeof__(b) __b = (b); __a < __b ? __a : __b; })
+#define max(a, b)		({ __typeof__(a) __a = (a); __typeof__(b) __b = (b); __a > __b ? __a : __b; })
+#define min_t(t, a, b)		min((t)(a), (t)(b))
+#define max_t(t, a, b)		max((t)(a), (t)(b))
+#define clamp(v, lo, hi)	min(max(v, lo), hi)
+#define clamp_t(t, v, lo, hi)	min_t(t, max_t(t, v, lo), hi)
+#define clamp_val(v, lo, hi)	clamp_t(__typeof__(v), v, lo, hi)
+#define DIV_ROUND_UP(n, d)	(((n) + (d) - 1) / (d))
+#define container_of(ptr, type, member)	((type *)((char *)(ptr) - offsetof(type, member)))
+#define READ_ONCE(x)		(*(volatile __typeof__(x) *)&(x))
+#define WRITE_ONCE(x, val)	(*(volatile __typeof__(x) *)&(x) = (val))
+#define smp_wmb()		__sync_synchronize()
+#define smp_rmb()		__sync_synchronize()
+#define smp_mb()		__sync_synchronize()
+#define smp_store_release(p, v)	WRITE_ONCE(*(p), v)
+#define smp_load_acquire(p)	READ_ONCE(*(p))
+#define BUILD_BUG_ON(cond)	((void)sizeof(char[1 - 2 * !!(cond)]))
+#define swap(a, b)		do { __typeof__(a) __t = (a); (a) = (b); (b) = __t; } while (0)
+#define U8_MAX			0xff
+#define U16_MAX			0xffff
+#define U32_MAX			0xffffffffU
+#define S32_MAX			0x7fffffff
+#define U64_MAX			(~0ULL)
+#define PAGE_SIZE		4096UL
+#define PAGE_SHIFT		12
+
+static inline u32 get_unaligned_le32(const void *p) { u32 v; memcpy(&v, p, sizeof(v)); return v; }
+static inline u16 get_unaligned_le16(const void *p) { u16 v; memcpy(&v, p, sizeof(v)); return v; }
+#define le32_to_cpu(x)		((u32)(x))
+#define le16_to_cpu(x)		((u16)(x))
+u32 crc32_le(u32 crc, const unsigned char *p, size_t len);
+void sort(void *base, size_t num, size_t size, int (*cmp)(const void *, const void *),
+	  void (*swap_func)(void *, void *, int));
+u32 get_random_u32(void);
+
+/* ::::  Strings  :::: */
+int scnprintf(char *buf, size_t size, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+int sysfs_emit(char *buf, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+size_t strscpy(char *dest, const char *src, size_t count);
+char *strstrip(char *s);
+char *kstrdup(const char *s, gfp_t gfp);
+int kstrtouint(const char *s, unsigned int base, unsigned int *res);
+int kstrtoint(const char *s, unsigned int base, int *res);
+int kstrtou8(const char *s, unsigned int base, u8 *res);
+int kstrtou16(const char *s, unsigned int base, u16 *res);
+int kstrtou32(const char *s, unsigned int base, u32 *res);
+int kstrtobool(const char *s, bool *res);
+int kstrtouint_from_user(const char __user *s, size_t count, unsigned int base, unsigned int *res);
+bool sysfs_streq(const char *s1, const char *s2);
+int match_string(const char * const *array, size_t n, const char *string);
+int __sysfs_match_string(const char * const *array, size_t n, const char *str);
+#define sysfs_match_string(array, str)	__sysfs_match_string(array, ARRAY_SIZE(array), str)
+
+/* ::::  Memory  :::: */
+#define GFP_KERNEL		0x0u
+#define GFP_ATOMIC		0x1u
+#define __GFP_ZERO		0x100u
+static inline void *kmalloc(size_t size, gfp_t flags) { return (flags & __GFP_ZERO) ? calloc(1, size ? size : 1) : malloc(size ? size : 1); }
+static inline void *kzalloc(size_t size, gfp_t flags) { return calloc(1, size ? size : 1); }
+static inline void *kcalloc(size_t n, size_t size, gfp_t flags) { return calloc(n ? n : 1, size ? size : 1); }
+static inline void *kmalloc_array(size_t n, size_t size, gfp_t flags) { return n && size > SIZE_MAX / n ? NULL : kmalloc(n * size, flags); }
+static inline void *krealloc(const void *p, size_t size, gfp_t flags) { return realloc((void *)p, size); }
+static inline void *kmemdup(const void *src, size_t len, gfp_t gfp) { void *p = malloc(len ? len : 1); if (p) memcpy(p, src, len); return p; }
+static inline void kfree(const void *p) { free((void *)p); }
+static inline void *kvmalloc(size_t size, gfp_t flags) { return kmalloc(size, flags); }
+static inline void *kvzalloc(size_t size, gfp_t flags) { return kzalloc(size, flags); }
+static inline void *kvmalloc_array(size_t n, size_t size, gfp_t flags) { return kmalloc_array(n, size, flags); }
+static inline void kvfree(const void *p) { free((void *)p); }
+static inline void *vmalloc(unsigned long size) { return malloc(size); }
+static inline void vfree(const void *p) { free((void *)p); }
+#define kfree_rcu(p, field)	kfree(p)
+unsigned long get_zeroed_page(gfp_t gfp);
+void free_page(unsigned long addr);
+
+/* ::::  Simulated time  :::: */
+#define HZ			250
+#define MSEC_PER_SEC		1000L
+#define USEC_PER_MSEC		1000L
+#define USEC_PER_SEC		1000000L
+#define NSEC_PER_USEC		1000L
+#define NSEC_PER_MSEC		1000000L
+#define NSEC_PER_SEC		1000000000L
+
+extern u64 host_time_ns;
+extern unsigned long volatile jiffies;
+
+// Advances the clock, nothing runs meanwhile (see host_run_until())
+void host_advance_ns(u64 ns);
+
+static inline ktime_t ktime_get(void) { return (ktime_t)host_time_ns; }
+static inline u64 ktime_get_ns(void) { return host_time_ns; }
+static inline u64 ktime_get_boottime_ns(void) { return host_time_ns; }
+static inline s64 ktime_to_ns(ktime_t kt) { return kt; }
+static inline s64 ktime_to_us(ktime_t kt) { return kt / NSEC_PER_USEC; }
+static inline s64 ktime_to_ms(ktime_t kt) { return kt / NSEC_PER_MSEC; }
+static inline ktime_t ktime_sub(ktime_t a, ktime_t b) { return a - b; }
+static inline ktime_t ktime_add(ktime_t a, ktime_t b) { return a + b; }
+static inline ktime_t ktime_add_ns(ktime_t kt, u64 ns) { return kt + (s64)ns; }
+static inline ktime_t ktime_add_us(ktime_t kt, u64 us) { return kt + (s64)us * NSEC_PER_USEC; }
+static inline s64 ktime_us_delta(ktime_t later, ktime_t earlier) { return (later - earlier) / NSEC_PER_USEC; }
+static inline s64 ktime_ms_delta(ktime_t later, ktime_t earlier) { return (later - earlier) / NSEC_PER_MSEC; }
+static inline ktime_t ns_to_ktime(u64 ns) { return (ktime_t)ns; }
+static inline ktime_t ms_to_ktime(u64 ms) { return (ktime_t)ms * NSEC_PER_MSEC; }
+static inline unsigned long msecs_to_jiffies(unsigned int ms) { return DIV_ROUND_UP((unsigned long)ms * HZ, MSEC_PER_SEC); }
+static inline unsigned int jiffies_to_msecs(unsigned long j) { return j * (MSEC_PER_SEC / HZ); }
+#define time_after(a, b)	((long)((b) - (a)) < 0)
+#define time_before(a, b)	time_after(b, a)
+#define time_after_eq(a, b)	((long)((a) - (b)) >= 0)
+#define time_is_after_jiffies(a)	time_after(a, jiffies)
+#define time_is_before_jiffies(a)	time_before(a, jiffies)
+
+static inline void msleep(unsigned int msecs) { host_advance_ns((u64)msecs * NSEC_PER_MSEC); }
+static inline void usleep_range(unsigned long min, unsigned long max) { host_advance_ns((u64)min * NSEC_PER_USEC); }
+static inline void udelay(unsigned long usecs) { host_advance_ns((u64)usecs * NSEC_PER_USEC); }
+static inline void might_sleep(void) { }
+static inline void cond_resched(void) { }
+
+static inline u64 div_u64(u64 dividend, u32 divisor) { return dividend / divisor; }
+static inline s64 div_s64(s64 dividend, s32 divisor) { return dividend / divisor; }
+static inline u64 div64_u64(u64 dividend, u64 divisor) { return dividend / divisor; }
+static inline u64 div_u64_rem(u64 dividend, u32 divisor, u32 *remainder) { *remainder = dividend % divisor; return dividend / divisor; }
+
+/* ::::  Atomics and bit operations  :::: */
+typedef struct { int counter; } atomic_t;
+typedef struct { s64 counter; } atomic64_t;
+#define ATOMIC_INIT(i)		{ (i) }
+#define ATOMIC64_INIT(i)	{ (i) }
+static inline int atomic_read(const atomic_t *v) { return v->counter; }
+static inline void atomic_set(atomic_t *v, int i) { v->counter = i; }
+static inline void atomic_inc(atomic_t *v) { v->counter++; }
+static inline void atomic_dec(atomic_t *v) { v->counter--; }
+static inline void atomic_add(int i, atomic_t *v) { v->counter += i; }
+static inline int atomic_inc_return(atomic_t *v) { return ++v->counter; }
+static inline int atomic_dec_return(atomic_t *v) { return --v->counter; }
+static inline bool atomic_dec_and_test(atomic_t *v) { return --v->counter == 0; }
+static inline int atomic_xchg(atomic_t *v, int i) { int old = v->counter; v->counter = i; return old; }
+static inline int atomic_cmpxchg(atomic_t *v, int old, int i) { int cur = v->counter; if (cur == old) v->counter = i; return cur; }
+static inline s64 atomic64_read(const atomic64_t *v) { return v->counter; }
+static inline void atomic64_set(atomic64_t *v, s64 i) { v->counter = i; }
+static inline void atomic64_inc(atomic64_t *v) { v->counter++; }
+static inline void atomic64_add(s64 i, atomic64_t *v) { v->counter += i; }
+static inline s64 atomic64_xchg(atomic64_t *v, s64 i) { s64 old = v->counter; v->counter = i; return old; }
+
+static inline void set_bit(long nr, volatile unsigned long *addr) { addr[BIT_WORD(nr)] |= BIT_MASK(nr); }
+static inline void clear_bit(long nr, volatile unsigned long *addr) { addr[BIT_WORD(nr)] &= ~BIT_MASK(nr); }
+#define __set_bit		set_bit
+#define __clear_bit		clear_bit
+static inline bool test_bit(long nr, const volatile unsigned long *addr) { return addr[BIT_WORD(nr)] & BIT_MASK(nr); }
+static inline bool test_and_set_bit(long nr, volatile unsigned long *addr) { bool old = test_bit(nr, addr); set_bit(nr, addr); return old; }
+static inline bool test_and_clear_bit(long nr, volatile unsigned long *addr) { bool old = test_bit(nr, addr); clear_bit(nr, addr); return old; }
+static inline void bitmap_zero(unsigned long *dst, unsigned int nbits) { memset(dst, 0, BITS_TO_LONGS(nbits) * sizeof(long)); }
+static inline void bitmap_fill(unsigned long *dst, unsigned int nbits) { unsigned int i; bitmap_zero(dst, nbits); for (i = 0; i < nbits; ++i) set_bit(i, dst); }
+static inline void bitmap_copy(unsigned long *dst, const unsigned long *src, unsigned int nbits) { memcpy(dst, src, BITS_TO_LONGS(nbits) * sizeof(long)); }
+static inline unsigned long find_next_bit(const unsigned long *addr, unsigned long size, unsigned long offset) { while (offset < size && !test_bit(offset, addr)) offset++; return offset < size ? offset : size; }
+static inline unsigned long find_first_bit(const unsigned long *addr, unsigned long size) { return find_next_bit(addr, size, 0); }
+#define for_each_set_bit(bit, addr, size) \
+	for ((bit) = find_first_bit((addr), (size)); (bit) < (size); (bit) = find_next_bit((addr), (size), (bit) + 1))
+
+/* ::::  Tasks and locking  :::: */
+struct task_struct { int pid; const char *comm; };
+extern struct task_struct *current;
+static inline bool fatal_signal_pending(struct task_struct *p) { return false; }
+
+// Reports a misuse the kernel would deadlock or crash on and aborts
+void host_bug(const char *fmt, ...) __attribute__((format(printf, 1, 2), noreturn));
+
+struct mutex { struct task_struct *owner; };
+#define __MUTEX_INITIALIZER(name)	{ .owner = NULL }
+#define DEFINE_MUTEX(name)		struct mutex name = __MUTEX_INITIALIZER(name)
+static inline void mutex_init(struct mutex *lock) { lock->owner = NULL; }
+static inline bool mutex_is_locked(struct mutex *lock) { return lock->owner != NULL; }
+static inline int mutex_trylock(struct mutex *lock) { if (lock->owner) return 0; lock->owner = current; return 1; }
+static inline void mutex_lock(struct mutex *lock) { if (!mutex_trylock(lock)) host_bug("mutex %p: locked again, deadlock\n", (void *)lock); }
+static inline int mutex_lock_interruptible(struct mutex *lock) { mutex_lock(lock); return 0; }
+static inline void mutex_unlock(struct mutex *lock) { if (!lock->owner) host_bug("mutex %p: unlocked while not held\n", (void *)lock); lock->owner = NULL; }
+#define lockdep_assert_held(lock)	((void)(lock))
+#define lockdep_is_held(lock)		1
+
+typedef struct { int locked; } spinlock_t;
+#define __SPIN_LOCK_UNLOCKED(name)	{ .locked = 0 }
+#define DEFINE_SPINLOCK(name)		spinlock_t name = __SPIN_LOCK_UNLOCKED(name)
+static inline void spin_lock_init(spinlock_t *lock) { lock->locked = 0; }
+static inline void spin_lock(spinlock_t *lock) { if (lock->locked) host_bug("spinlock %p: locked again, deadlock\n", (void *)lock); lock->locked = 1; }
+static inline void spin_unlock(spinlock_t *lock) { if (!lock->locked) host_bug("spinlock %p: unlocked while not held\n", (void *)lock); lock->locked = 0; }
+#define spin_lock_irq		spin_lock
+#define spin_unlock_irq		spin_unlock
+#define spin_lock_bh		spin_lock
+#define spin_unlock_bh		spin_unlock
+#define spin_lock_irqsave(lock, flags)		do { (flags) = 0; spin_lock(lock); } while (0)
+#define spin_unlock_irqrestore(lock, flags)	do { (void)(flags); spin_unlock(lock); } while (0)
+
+struct srcu_struct { int readers; };
+#define DEFINE_STATIC_SRCU(name)	static struct srcu_struct name
+#define DEFINE_SRCU(name)		struct srcu_struct name
+static inline int srcu_read_lock(struct srcu_struct *ssp) { ssp->readers++; return 0; }
+static inline void srcu_read_unlock(struct srcu_struct *ssp, int idx) { ssp->readers--; }
+static inline void synchronize_srcu(struct srcu_struct *ssp) { if (ssp->readers) host_bug("srcu %p: synchronize inside read section, deadlock\n", (void *)ssp); }
+static inline void rcu_read_lock(void) { }
+static inline void rcu_read_unlock(void) { }
+static inline void synchronize_rcu(void) { }
+struct rcu_head { void *next; };
+#define srcu_dereference(p, ssp)	(p)
+#define rcu_dereference(p)		(p)
+#define rcu_dereference_protected(p, c)	(p)
+#define rcu_access_pointer(p)		(p)
+#define rcu_assign_pointer(p, v)	((p) = (v))
+#define RCU_INIT_POINTER(p, v)		((p) = (v))
+
+/* ::::  Deferred execution  :::: */
+struct work_struct;
+typedef void (*work_func_t)(struct work_struct *work);
+struct work_struct {
+	work_func_t func;
+	bool pending;
+	u64 due_ns;
+	struct work_struct *next;
+};
+struct delayed_work { struct work_struct work; };
+struct workqueue_struct { const char *name; };
+#define __WORK_INITIALIZER(name, f)	{ .func = (f) }
+#define DECLARE_WORK(name, f)		struct work_struct name = __WORK_INITIALIZER(name, f)
+#define DECLARE_DELAYED_WORK(name, f)	struct delayed_work name = { .work = __WORK_INITIALIZER(name.work, f) }
+#define DECLARE_DEFERRABLE_WORK		DECLARE_DELAYED_WORK
+#define INIT_WORK(w, f)			do { memset((w), 0, sizeof(*(w))); (w)->func = (f); } while (0)
+#define INIT_DELAYED_WORK(w, f)		INIT_WORK(&(w)->work, f)
+#define WQ_FREEZABLE		0x1
+#define WQ_UNBOUND		0x2
+#define WQ_HIGHPRI		0x4
+#define WQ_MEM_RECLAIM		0x8
+extern struct workqueue_struct *system_wq, *system_unbound_wq, *system_long_wq;
+extern struct workqueue_struct *system_freezable_wq, *system_power_efficient_wq;
+struct workqueue_struct *alloc_workqueue(const char *fmt, unsigned int flags, int max_active, ...);
+struct workqueue_struct *alloc_ordered_workqueue(const char *fmt, unsigned int flags, ...);
+void destroy_workqueue(struct workqueue_struct *wq);
+bool queue_delayed_work(struct workqueue_struct *wq, struct delayed_work *dwork, unsigned long delay);
+bool mod_delayed_work(struct workqueue_struct *wq, struct delayed_work *dwork, unsigned long delay);
+static inline bool queue_work(struct workqueue_struct *wq, struct work_struct *work) { return queue_delayed_work(wq, container_of(work, struct delayed_work, work), 0); }
+static inline bool schedule_work(struct work_struct *work) { return queue_work(system_wq, work); }
+static inline bool schedule_delayed_work(struct delayed_work *dwork, unsigned long delay) { return queue_delayed_work(system_wq, dwork, delay); }
+bool flush_work(struct work_struct *work);
+bool cancel_work_sync(struct work_struct *work);
+static inline bool flush_delayed_work(struct delayed_work *dwork) { return flush_work(&dwork->work); }
+static inline bool cancel_delayed_work(struct delayed_work *dwork) { return cancel_work_sync(&dwork->work); }
+static inline bool cancel_delayed_work_sync(struct delayed_work *dwork) { return cancel_work_sync(&dwork->work); }
+void flush_workqueue(struct workqueue_struct *wq);
+static inline bool work_pending(struct work_struct *work) { return work->pending; }
+static inline bool delayed_work_pending(struct delayed_work *dwork) { return dwork->work.pending; }
+static inline struct delayed_work *to_delayed_work(struct work_struct *work) { return container_of(work, struct delayed_work, work); }
+
+struct timer_list {
+	unsigned long expires;
+	void (*function)(struct timer_list *timer);
+	bool pending;
+	struct timer_list *next;
+};
+#define TIMER_DEFERRABLE	0x1
+#define from_timer(var, timer, field)	container_of(timer, __typeof__(*var), field)
+void timer_setup(struct timer_list *timer, void (*func)(struct timer_list *), unsigned int flags);
+int mod_timer(struct timer_list *timer, unsigned long expires);
+int del_timer(struct timer_list *timer);
+#define del_timer_sync		del_timer
+
+enum hrtimer_restart { HRTIMER_NORESTART, HRTIMER_RESTART };
+struct hrtimer {
+	enum hrtimer_restart (*function)(struct hrtimer *timer);
+	u64 expires_ns;
+	bool pending;
+	struct hrtimer *next;
+};
+#define CLOCK_MONOTONIC		1
+#define HRTIMER_MODE_REL	0
+void hrtimer_init(struct hrtimer *timer, int clock_id, int mode);
+void hrtimer_start(struct hrtimer *timer, ktime_t tim, int mode);
+int hrtimer_cancel(struct hrtimer *timer);
+u64 hrtimer_forward_now(struct hrtimer *timer, ktime_t interval);
+static inline bool hrtimer_active(const struct hrtimer *timer) { return timer->pending; }
+
+struct completion { unsigned int done; };
+#define DECLARE_COMPLETION(name)	struct completion name = { 0 }
+static inline void init_completion(struct completion *x) { x->done = 0; }
+static inline void reinit_completion(struct completion *x) { x->done = 0; }
+static inline bool completion_done(struct completion *x) { return x->done != 0; }
+static inline void complete(struct completion *x) { if (x->done != UINT32_MAX) x->done++; }
+static inline void complete_all(struct completion *x) { x->done = UINT32_MAX; }
+void wait_for_completion(struct completion *x);
+unsigned long wait_for_completion_timeout(struct completion *x, unsigned long timeout);
+
+/**
+ * Runs work items, timers and hrtimers due at the current time until none
+ * is left, returns the number of callbacks run
+ */
+unsigned int host_run_pending(void);
+
+/**
+ * Advances the clock to the deadline, running everything that becomes due
+ * on the way at its time
+ */
+void host_run_until(u64 deadline_ns);
+
+/* ::::  Files, seq_file and debugfs  :::: */
+struct inode { dev_t i_rdev; void *i_private; };
+struct file { void *private_data; fmode_t f_mode; unsigned int f_flags; };
+struct vm_area_struct;
+struct file_operations {
+	struct module *owner;
+	loff_t (*llseek)(struct file *, loff_t, int);
+	ssize_t (*read)(struct file *, char __user *, size_t, loff_t *);
+	ssize_t (*write)(struct file *, const char __user *, size_t, loff_t *);
+	long (*unlocked_ioctl)(struct file *, unsigned int, unsigned long);
+	long (*compat_ioctl)(struct file *, unsigned int, unsigned long);
+	int (*mmap)(struct file *, struct vm_area_struct *);
+	int (*open)(struct inode *, struct file *);
+	int (*release)(struct inode *, struct file *);
+};
+#define FMODE_READ		0x1
+#define FMODE_WRITE		0x2
+
+struct seq_file {
+	char *buf;
+	size_t size;
+	size_t count;
+	bool shown;
+	int (*show)(struct seq_file *, void *);
+	void *private;
+};
+void seq_printf(struct seq_file *m, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void seq_puts(struct seq_file *m, const char *s);
+void seq_putc(struct seq_file *m, char c);
+int single_open(struct file *file, int (*show)(struct seq_file *, void *), void *data);
+int single_release(struct inode *inode, struct file *file);
+ssize_t seq_read(struct file *file, char __user *buf, size_t size, loff_t *ppos);
+loff_t seq_lseek(struct file *file, loff_t offset, int whence);
+#define DEFINE_SHOW_ATTRIBUTE(__name)								\
+static int __name ## _open(struct inode *inode, struct file *file)				\
+{												\
+	return single_open(file, __name ## _show, inode->i_private);				\
+}												\
+static const struct file_operations __name ## _fops = {						\
+	.owner = THIS_MODULE,									\
+	.open = __name ## _open,								\
+	.read = seq_read,									\
+	.llseek = seq_lseek,									\
+	.release = single_release,								\
+}
+ssize_t simple_read_from_buffer(void __user *to, size_t count, loff_t *ppos, const void *from, size_t available);
+ssize_t simple_write_to_buffer(void *to, size_t available, loff_t *ppos, const void __user *from, size_t count);
+int simple_open(struct inode *inode, struct file *file);
+int nonseekable_open(struct inode *inode, struct file *file);
+loff_t default_llseek(struct file *file, loff_t offset, int whence);
+loff_t no_llseek(struct file *file, loff_t offset, int whence);
+
+struct dentry;
+struct dentry *debugfs_create_dir(const char *name, struct dentry *parent);
+struct dentry *debugfs_create_file(const char *name, umode_t mode, struct dentry *parent, void *data,
+				   const struct file_operations *fops);
+void debugfs_create_u32(const char *name, umode_t mode, struct dentry *parent, u32 *value);
+void debugfs_create_u16(const char *name, umode_t mode, struct dentry *parent, u16 *value);
+void debugfs_create_x16(const char *name, umode_t mode, struct dentry *parent, u16 *value);
+void debugfs_create_x32(const char *name, umode_t mode, struct dentry *parent, u32 *value);
+void debugfs_create_u64(const char *name, umode_t mode, struct dentry *parent, u64 *value);
+void debugfs_create_bool(const char *name, umode_t mode, struct dentry *parent, bool *value);
+void debugfs_remove(struct dentry *dentry);
+void debugfs_remove_recursive(struct dentry *dentry);
+struct dentry *debugfs_lookup(const char *name, struct dentry *parent);
+
+/* ::::  User memory  :::: */
+static inline unsigned long copy_to_user(void __user *to, const void *from, unsigned long n) { memcpy(to, from, n); return 0; }
+static inline unsigned long copy_from_user(void *to, const void __user *from, unsigned long n) { memcpy(to, from, n); return 0; }
+static inline void *memdup_user(const void __user *src, size_t len) { void *p = kmemdup(src, len, GFP_KERNEL); return p ? p : ERR_PTR(-ENOMEM); }
+#define get_user(x, ptr)	({ (x) = *(ptr); 0; })
+#define put_user(x, ptr)	({ *(ptr) = (x); 0; })
+#define u64_to_user_ptr(x)	((void __user *)(uintptr_t)(x))
+
+#define _IOC_NRBITS		8
+#define _IOC_TYPEBITS		8
+#define _IOC_SIZEBITS		14
+#define _IOC_NRSHIFT		0
+#define _IOC_TYPESHIFT		(_IOC_NRSHIFT + _IOC_NRBITS)
+#define _IOC_SIZESHIFT		(_IOC_TYPESHIFT + _IOC_TYPEBITS)
+#define _IOC_DIRSHIFT		(_IOC_SIZESHIFT + _IOC_SIZEBITS)
+#define _IOC_NONE		0U
+#define _IOC_WRITE		1U
+#define _IOC_READ		2U
+#define _IOC(dir, type, nr, size) \
+	(((dir) << _IOC_DIRSHIFT) | ((type) << _IOC_TYPESHIFT) | ((nr) << _IOC_NRSHIFT) | ((size) << _IOC_SIZESHIFT))
+#define _IO(type, nr)			_IOC(_IOC_NONE, (type), (nr), 0)
+#define _IOR(type, nr, arg)		_IOC(_IOC_READ, (type), (nr), sizeof(arg))
+#define _IOW(type, nr, arg)		_IOC(_IOC_WRITE, (type), (nr), sizeof(arg))
+#define _IOWR(type, nr, arg)		_IOC(_IOC_READ | _IOC_WRITE, (type), (nr), sizeof(arg))
+#define _IOC_DIR(nr)			(((nr) >> _IOC_DIRSHIFT) & ((1 << 2) - 1))
+#define _IOC_TYPE(nr)			(((nr) >> _IOC_TYPESHIFT) & ((1 << _IOC_TYPEBITS) - 1))
+#define _IOC_NR(nr)			(((nr) >> _IOC_NRSHIFT) & ((1 << _IOC_NRBITS) - 1))
+#define _IOC_SIZE(nr)			(((nr) >> _IOC_SIZESHIFT) & ((1 << _IOC_SIZEBITS) - 1))
+
+/* ::::  Memory mapping  :::: */
+typedef struct { unsigned long pgprot; } pgprot_t;
+struct vm_operations_struct {
+	void (*open)(struct vm_area_struct *area);
+	void (*close)(struct vm_area_struct *area);
+};
+struct vm_area_struct {
+	unsigned long vm_start, vm_end, vm_pgoff, vm_flags;
+	pgprot_t vm_page_prot;
+	const struct vm_operations_struct *vm_ops;
+	void *vm_private_data;
+	struct file *vm_file;
+};
+#define VM_WRITE		0x2
+#define VM_SHARED		0x8
+#define VM_MAYWRITE		0x20
+#define VM_DONTDUMP		0x4000000
+#define VM_DONTEXPAND		0x40000
+struct page;
+static inline void vm_flags_set(struct vm_area_struct *vma, unsigned long flags) { vma->vm_flags |= flags; }
+static inline void vm_flags_clear(struct vm_area_struct *vma, unsigned long flags) { vma->vm_flags &= ~flags; }
+static inline struct page *virt_to_page(const void *addr) { return (struct page *)addr; }
+static inline unsigned long virt_to_phys(const void *addr) { return (unsigned long)addr; }
+static inline int vm_insert_page(struct vm_area_struct *vma, unsigned long addr, struct page *page) { return 0; }
+static inline int remap_pfn_range(struct vm_area_struct *vma, unsigned long addr, unsigned long pfn,
+				  unsigned long size, pgprot_t prot) { return 0; }
+
+/* ::::  Device model  :::: */
+struct kobject { const char *name; };
+struct device_driver {
+	const char *name;
+	struct module *owner;
+	const struct dev_pm_ops *pm;
+	int probe_type;
+};
+struct device {
+	struct kobject kobj;
+	struct device *parent;
+	void *driver_data;
+};
+static inline void *dev_get_drvdata(const struct device *dev) { return dev->driver_data; }
+static inline void dev_set_drvdata(struct device *dev, void *data) { dev->driver_data = data; }
+static inline void *devm_kzalloc(struct device *dev, size_t size, gfp_t gfp) { return kzalloc(size, gfp); }
+
+struct attribute { const char *name; umode_t mode; };
+struct device_attribute {
+	struct attribute attr;
+	ssize_t (*show)(struct device *dev, struct device_attribute *attr, char *buf);
+	ssize_t (*store)(struct device *dev, struct device_attribute *attr, const char *buf, size_t count);
+};
+struct bin_attribute {
+	struct attribute attr;
+	size_t size;
+	ssize_t (*read)(struct file *, struct kobject *, struct bin_attribute *, char *, loff_t, size_t);
+	ssize_t (*write)(struct file *, struct kobject *, struct bin_attribute *, char *, loff_t, size_t);
+};
+struct attribute_group {
+	const char *name;
+	struct attribute **attrs;
+	struct bin_attribute **bin_attrs;
+};
+#define __ATTR(_name, _mode, _show, _store)	{ .attr = { .name = #_name, .mode = _mode }, .show = _show, .store = _store }
+#define __ATTR_RO(_name)	__ATTR(_name, 0444, _name##_show, NULL)
+#define __ATTR_RW(_name)	__ATTR(_name, 0644, _name##_show, _name##_store)
+#define __ATTR_WO(_name)	__ATTR(_name, 0200, NULL, _name##_store)
+#define DEVICE_ATTR(_name, _mode, _show, _store)	struct device_attribute dev_attr_##_name = __ATTR(_name, _mode, _show, _store)
+#define DEVICE_ATTR_RO(_name)	struct device_attribute dev_attr_##_name = __ATTR_RO(_name)
+#define DEVICE_ATTR_RW(_name)	struct device_attribute dev_attr_##_name = __ATTR_RW(_name)
+#define DEVICE_ATTR_WO(_name)	struct device_attribute dev_attr_##_name = __ATTR_WO(_name)
+int device_create_file(struct device *dev, const struct device_attribute *attr);
+void device_remove_file(struct device *dev, const struct device_attribute *attr);
+int sysfs_create_group(struct kobject *kobj, const struct attribute_group *grp);
+void sysfs_remove_group(struct kobject *kobj, const struct attribute_group *grp);
+static inline void sysfs_notify(struct kobject *kobj, const char *dir, const char *attr) { }
+
+struct class { const char *name; };
+struct class *class_create(const char *name);
+void class_destroy(struct class *cls);
+struct device *device_create(struct class *cls, struct device *parent, dev_t devt, void *drvdata, const char *fmt, ...);
+void device_destroy(struct class *cls, dev_t devt);
+
+struct cdev { const struct file_operations *ops; dev_t dev; };
+#define MAJOR(dev)		((unsigned int)((dev) >> 20))
+#define MINOR(dev)		((unsigned int)((dev) & 0xfffff))
+#define MKDEV(ma, mi)		(((ma) << 20) | (mi))
+int alloc_chrdev_region(dev_t *dev, unsigned int baseminor, unsigned int count, const char *name);
+void unregister_chrdev_region(dev_t from, unsigned int count);
+void cdev_init(struct cdev *cdev, const struct file_operations *fops);
+int cdev_add(struct cdev *cdev, dev_t dev, unsigned int count);
+void cdev_del(struct cdev *cdev);
+
+struct miscdevice {
+	int minor;
+	const char *name;
+	const struct file_operations *fops;
+	umode_t mode;
+};
+#define MISC_DYNAMIC_MINOR	255
+int misc_register(struct miscdevice *misc);
+void misc_deregister(struct miscdevice *misc);
+
+typedef struct { int event; } pm_message_t;
+struct dev_pm_ops {
+	int (*suspend)(struct device *dev);
+	int (*resume)(struct device *dev);
+};
+#define SIMPLE_DEV_PM_OPS(name, suspend_fn, resume_fn) \
+	const struct dev_pm_ops name = { .suspend = suspend_fn, .resume = resume_fn }
+#define PROBE_PREFER_ASYNCHRONOUS	1
+#define PROBE_FORCE_SYNCHRONOUS		2
+
+struct platform_device {
+	const char *name;
+	int id;
+	struct device dev;
+};
+struct platform_driver {
+	int (*probe)(struct platform_device *);
+	int (*remove)(struct platform_device *);
+	int (*suspend)(struct platform_device *, pm_message_t state);
+	int (*resume)(struct platform_device *);
+	struct device_driver driver;
+};
+struct platform_device *platform_create_bundle(struct platform_driver *driver, int (*probe)(struct platform_device *),
+					       void *res, unsigned int n_res, const void *data, size_t size);
+void platform_device_unregister(struct platform_device *pdev);
+void platform_driver_unregister(struct platform_driver *drv);
+static inline void *platform_get_drvdata(const struct platform_device *pdev) { return dev_get_drvdata(&pdev->dev); }
+static inline void platform_set_drvdata(struct platform_device *pdev, void *data) { dev_set_drvdata(&pdev->dev, data); }
+
+struct firmware { size_t size; const u8 *data; };
+static inline int request_firmware(const struct firmware **fw, const char *name, struct device *dev) { *fw = NULL; return -ENOENT; }
+static inline int request_firmware_direct(const struct firmware **fw, const char *name, struct device *dev) { return request_firmware(fw, name, dev); }
+static inline int firmware_request_nowarn(const struct firmware **fw, const char *name, struct device *dev) { return request_firmware(fw, name, dev); }
+static inline void release_firmware(const struct firmware *fw) { }
+
+/* ::::  DMI and CPU identification  :::: */
+enum dmi_field {
+	DMI_NONE,
+	DMI_BIOS_VENDOR,
+	DMI_BIOS_VERSION,
+	DMI_BIOS_DATE,
+	DMI_SYS_VENDOR,
+	DMI_PRODUCT_NAME,
+	DMI_PRODUCT_VERSION,
+	DMI_PRODUCT_SERIAL,
+	DMI_PRODUCT_UUID,
+	DMI_PRODUCT_SKU,
+	DMI_PRODUCT_FAMILY,
+	DMI_BOARD_VENDOR,
+	DMI_BOARD_NAME,
+	DMI_BOARD_VERSION,
+	DMI_BOARD_SERIAL,
+	DMI_BOARD_ASSET_TAG,
+	DMI_CHASSIS_VENDOR,
+	DMI_CHASSIS_TYPE,
+	DMI_CHASSIS_VERSION,
+	DMI_CHASSIS_SERIAL,
+	DMI_CHASSIS_ASSET_TAG,
+	DMI_STRING_MAX,
+};
+struct dmi_strmatch {
+	unsigned char slot:7;
+	unsigned char exact_match:1;
+	char substr[79];
+};
+struct dmi_system_id {
+	int (*callback)(const struct dmi_system_id *);
+	const char *ident;
+	struct dmi_strmatch matches[4];
+	void *driver_data;
+};
+#define DMI_MATCH(a, b)		{ .slot = a, .substr = b }
+#define DMI_EXACT_MATCH(a, b)	{ .slot = a, .substr = b, .exact_match = 1 }
+// Set with host_dmi_set()
+const char *dmi_get_system_info(int field);
+bool dmi_match(enum dmi_field f, const char *str);
+int dmi_check_system(const struct dmi_system_id *list);
+const struct dmi_system_id *dmi_first_match(const struct dmi_system_id *list);
+void host_dmi_set(enum dmi_field field, const char *value);
+
+struct x86_cpu_id { u16 vendor; u16 family; u16 model; };
+#define X86_MATCH_INTEL_FAM6_MODEL(m, d)		{ .vendor = 1 }
+#define X86_MATCH_VENDOR_FAM_MODEL(v, f, m, d)		{ .vendor = 1 }
+#define X86_MATCH_VENDOR_FAM(v, f, d)			{ .vendor = 1 }
+#define INTEL_FAM5_QUARK_X1000	0x09
+static inline const struct x86_cpu_id *x86_match_cpu(const struct x86_cpu_id *match) { return NULL; }
+
+/* ::::  ACPI and WMI  :::: */
+#define ACPI_TYPE_INTEGER	0x01
+#define ACPI_TYPE_STRING	0x02
+#define ACPI_TYPE_BUFFER	0x03
+#define ACPI_TYPE_PACKAGE	0x04
+#define ACPI_ALLOCATE_BUFFER	((acpi_size)-1)
+#define AE_OK			((acpi_status)0)
+#define ACPI_FAILURE(status)	((status) != AE_OK)
+#define ACPI_SUCCESS(status)	((status) == AE_OK)
+#define ACPI_FREE(p)		kfree(p)
+union acpi_object {
+	u32 type;
+	struct { u32 type; u64 value; } integer;
+	struct { u32 type; u32 length; char *pointer; } string;
+	struct { u32 type; u32 length; u8 *pointer; } buffer;
+	struct { u32 type; u32 count; union acpi_object *elements; } package;
+};
+struct acpi_buffer { acpi_size length; void *pointer; };
+static inline int ec_read(u8 addr, u8 *val) { return -ENODEV; }
+static inline int ec_write(u8 addr, u8 val) { return -ENODEV; }
+// Set with host_power_supply_set()
+int power_supply_is_system_supplied(void);
+void host_power_supply_set(bool supplied);
+
+/* ::::  Input  :::: */
+#define EV_SYN			0x00
+#define EV_KEY			0x01
+#define EV_MSC			0x04
+#define EV_MAX			0x1f
+#define KEY_MAX			0x2ff
+#define BUS_I8042		0x11
+#define BUS_HOST		0x19
+#define KEY_LEFTCTRL		29
+#define KEY_LEFTALT		56
+#define KEY_F6			64
+#define KEY_ZENKAKUHANKAKU	85
+#define KEY_LEFTMETA		125
+#define KEY_F21			191
+#define KEY_KBDILLUMTOGGLE	228
+#define KEY_KBDILLUMDOWN	229
+#define KEY_KBDILLUMUP		230
+#define KEY_UNKNOWN		240
+#define KEY_RFKILL		247
+#define KEY_TOUCHPAD_TOGGLE	0x212
+#define KEY_LIGHTS_TOGGLE	0x21e
+#define INPUT_DEVICE_ID_MATCH_BUS	0x001
+#define INPUT_DEVICE_ID_MATCH_EVBIT	0x080
+#define INPUT_DEVICE_ID_MATCH_KEYBIT	0x100
+struct input_id { u16 bustype, vendor, product, version; };
+struct input_device_id {
+	unsigned long flags;
+	u16 bustype, vendor, product, version;
+	unsigned long evbit[BITS_TO_LONGS(EV_MAX + 1)];
+	unsigned long keybit[BITS_TO_LONGS(KEY_MAX + 1)];
+	unsigned long driver_info;
+};
+struct input_dev {
+	const char *name;
+	const char *phys;
+	struct input_id id;
+	struct device dev;
+	unsigned long evbit[BITS_TO_LONGS(EV_MAX + 1)];
+	unsigned long keybit[BITS_TO_LONGS(KEY_MAX + 1)];
+};
+struct input_handler;
+struct input_handle {
+	void *private;
+	const char *name;
+	struct input_dev *dev;
+	struct input_handler *handler;
+};
+struct input_handler {
+	void *private;
+	void (*event)(struct input_handle *handle, unsigned int type, unsigned int code, int value);
+	bool (*filter)(struct input_handle *handle, unsigned int type, unsigned int code, int value);
+	bool (*match)(struct input_handler *handler, struct input_dev *dev);
+	int (*connect)(struct input_handler *handler, struct input_dev *dev, const struct input_device_id *id);
+	void (*disconnect)(struct input_handle *handle);
+	const char *name;
+	const struct input_device_id *id_table;
+};
+static inline int input_register_handler(struct input_handler *handler) { return 0; }
+static inline void input_unregister_handler(struct input_handler *handler) { }
+static inline int input_register_handle(struct input_handle *handle) { return 0; }
+static inline void input_unregister_handle(struct input_handle *handle) { }
+static inline int input_open_device(struct input_handle *handle) { return 0; }
+static inline void input_close_device(struct input_handle *handle) { }
+static inline struct input_dev *input_allocate_device(void) { return kzalloc(sizeof(struct input_dev), GFP_KERNEL); }
+static inline void input_free_device(struct input_dev *dev) { kfree(dev); }
+static inline int input_register_device(struct input_dev *dev) { return 0; }
+static inline void input_unregister_device(struct input_dev *dev) { kfree(dev); }
+// Counts reported keys for the harness
+extern unsigned long host_input_keys_reported;
+static inline void input_report_key(struct input_dev *dev, unsigned int code, int value) { host_input_keys_reported++; }
+static inline void input_sync(struct input_dev *dev) { }
+
+#define KE_END			0
+#define KE_KEY			1
+#define KE_IGNORE		5
+struct key_entry {
+	int type;
+	u32 code;
+	union {
+		u16 keycode;
+	};
+};
+static inline int sparse_keymap_setup(struct input_dev *dev, const struct key_entry *keymap, void *setup) { return 0; }
+static inline struct key_entry *sparse_keymap_entry_from_scancode(struct input_dev *dev, unsigned int code) { return NULL; }
+static inline void sparse_keymap_report_entry(struct input_dev *dev, const struct key_entry *ke, unsigned int value,
+					      bool autorelease) { host_input_keys_reported++; }
+static inline bool sparse_keymap_report_event(struct input_dev *dev, unsigned int code, unsigned int value,
+					      bool autorelease) { host_input_keys_reported++; return true; }
+
+/* ::::  LED class  :::: */
+enum led_brightness { LED_OFF = 0, LED_ON = 1, LED_HALF = 127, LED_FULL = 255 };
+#define LED_CORE_SUSPENDRESUME		(1U << 16)
+#define LED_BRIGHT_HW_CHANGED		(1U << 21)
+#define LED_FUNCTION_KBD_BACKLIGHT	"kbd_backlight"
+#define LED_FUNCTION_STATUS		"status"
+#define LED_COLOR_ID_WHITE		0
+#define LED_COLOR_ID_RED		1
+#define LED_COLOR_ID_GREEN		2
+#define LED_COLOR_ID_BLUE		3
+#define LED_COLOR_ID_MULTI		8
+#define LED_COLOR_ID_RGB		9
+struct led_classdev {
+	const char *name;
+	unsigned int brightness;
+	unsigned int max_brightness;
+	unsigned long flags;
+	void (*brightness_set)(struct led_classdev *led_cdev, enum led_brightness brightness);
+	int (*brightness_set_blocking)(struct led_classdev *led_cdev, enum led_brightness brightness);
+	enum led_brightness (*brightness_get)(struct led_classdev *led_cdev);
+	struct device *dev;
+	const struct attribute_group **groups;
+	const char *default_trigger;
+	// Registered with the host LED class
+	char host_name[64];
+	struct led_classdev *host_next;
+};
+struct mc_subled {
+	unsigned int color_index;
+	unsigned int brightness;
+	unsigned int intensity;
+	unsigned int channel;
+};
+struct led_classdev_mc {
+	struct led_classdev led_cdev;
+	unsigned int num_colors;
+	struct mc_subled *subled_info;
+};
+static inline struct led_classdev_mc *lcdev_to_mccdev(struct led_classdev *led_cdev)
+{
+	return container_of(led_cdev, struct led_classdev_mc, led_cdev);
+}
+int led_mc_calc_color_components(struct led_classdev_mc *mcled_cdev, enum led_brightness brightness);
+int led_classdev_register(struct device *parent, struct led_classdev *led_cdev);
+void led_classdev_unregister(struct led_classdev *led_cdev);
+#define devm_led_classdev_register	led_classdev_register
+static inline void devm_led_classdev_unregister(struct device *parent, struct led_classdev *led_cdev) { led_classdev_unregister(led_cdev); }
+static inline int led_classdev_multicolor_register(struct device *parent, struct led_classdev_mc *mcled_cdev) { return led_classdev_register(parent, &mcled_cdev->led_cdev); }
+static inline void led_classdev_multicolor_unregister(struct led_classdev_mc *mcled_cdev) { led_classdev_unregister(&mcled_cdev->led_cdev); }
+#define devm_led_classdev_multicolor_register	led_classdev_multicolor_register
+static inline void devm_led_classdev_multicolor_unregister(struct device *parent, struct led_classdev_mc *mcled_cdev) { led_classdev_multicolor_unregister(mcled_cdev); }
+static inline void led_classdev_notify_brightness_hw_changed(struct led_classdev *led_cdev, unsigned int brightness) { }
+
+/* ::::  Keyboard notifier  :::: */
+struct notifier_block { int (*notifier_call)(struct notifier_block *nb, unsigned long action, void *data); };
+struct keyboard_notifier_param { int down; unsigned int value; };
+#define KBD_KEYCODE		0x0001
+#define NOTIFY_DONE		0x0000
+#define NOTIFY_OK		0x0001
+static inline int register_keyboard_notifier(struct notifier_block *nb) { return 0; }
+static inline int unregister_keyboard_notifier(struct notifier_block *nb) { return 0; }
+
+/* ::::  FIFO  :::: */
+#define DECLARE_KFIFO(fifo, type, size)	struct { type buf[size]; unsigned int in, out; } fifo
+#define INIT_KFIFO(fifo)		((fifo).in = (fifo).out = 0)
+#define kfifo_size(fifo)		(ARRAY_SIZE((fifo)->buf))
+#define kfifo_len(fifo)			((fifo)->in - (fifo)->out)
+#define kfifo_is_empty(fifo)		((fifo)->in == (fifo)->out)
+#define kfifo_is_full(fifo)		(kfifo_len(fifo) >= kfifo_size(fifo))
+#define kfifo_reset(fifo)		((fifo)->in = (fifo)->out = 0)
+#define kfifo_put(fifo, val) ({								\
+	int __ok = !kfifo_is_full(fifo);						\
+	if (__ok)									\
+		(fifo)->buf[(fifo)->in++ % kfifo_size(fifo)] = (val);			\
+	__ok;										\
+})
+#define kfifo_get(fifo, val) ({								\
+	int __ok = !kfifo_is_empty(fifo);						\
+	if (__ok)									\
+		*(val) = (fifo)->buf[(fifo)->out++ % kfifo_size(fifo)];			\
+	__ok;										\
+})
+#define kfifo_out(fifo, vals, n) ({							\
+	unsigned int __i = 0;								\
+	while (__i < (n) && !kfifo_is_empty(fifo)) {					\
+		(vals)[__i++] = (fifo)->buf[(fifo)->out++ % kfifo_size(fifo)];		\
+	}										\
+	__i;										\
+})
+
+#endif // HOST_KERNEL_H
@@ -0,0 +1,254 @@
+/*!
+ * Copyright (c) 2023 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-keyboard.
+ *
+ * tuxedo-keyboard is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "sim_backends.h"
+#include "clevo_interfaces.h"
+#include "uniwill_interfaces.h"
+
+/* ::::  Uniwill EC  :::: */
+struct sim_uniwill sim_uw;
+
+static int sim_uniwill_read_ec_ram(u16 address, u8 *data)
+{
+	usleep_range(sim_uw.latency_us, sim_uw.latency_us);
+	sim_uw.reads++;
+	if (sim_uw.fail_addr && address == sim_uw.fail_addr)
+		return -EIO;
+	*data = sim_uw.ram[address];
+	return 0;
+}
+
+static int sim_uniwill_write_ec_ram(u16 address, u8 data)
+{
+	usleep_range(sim_uw.latency_us, sim_uw.latency_us);
+	sim_uw.writes++;
+	sim_uw.writes_per_addr[address]++;
+	if (sim_uw.fail_addr && address == sim_uw.fail_addr)
+		return -EIO;
+	sim_uw.ram[address] = data;
+	return 0;
+}
+
+static struct uniwill_interface_t sim_uniwill_interface = {
+	.string_id = UNIWILL_INTERFACE_WMI_STRID,
+	.read_ec_ram = sim_uniwill_read_ec_ram,
+	.write_ec_ram = sim_uniwill_write_ec_ram,
+};
+
+void sim_uniwill_setup(const struct sim_uniwill_config *config)
+{
+	memset(&sim_uw, 0, sizeof(sim_uw));
+	sim_uw.latency_us = SIM_UW_LATENCY_US_DEFAULT;
+
+	sim_uw.ram[UW_EC_REG_BAREBONE_ID] = config->model;
+	if (config->rgb_1_zone) {
+		sim_uw.ram[UW_EC_REG_FEATURES_1] |= UW_EC_REG_FEATURES_1_BIT_1_ZONE_RGB_KB;
+		sim_uw.ram[UW_EC_REG_KBD_BL_MAX_BRIGHTNESS] = 0xff;
+	} else {
+		sim_uw.ram[UW_EC_REG_KBD_BL_STATUS] |= UW_EC_REG_KBD_BL_STATUS_BIT_WHITE_ONLY_KB;
+	}
+	if (config->charging_prio)
+		sim_uw.ram[0x0742] |= 1 << 5;
+	if (config->charging_profile)
+		sim_uw.ram[0x078e] |= 1 << 3;
+	if (config->universal_fan)
+		sim_uw.ram[0x078e] |= 1 << 6;
+}
+
+int sim_uniwill_add(void)
+{
+	return uniwill_add_interface(&sim_uniwill_interface);
+}
+
+int sim_uniwill_remove(void)
+{
+	return uniwill_remove_interface(&sim_uniwill_interface);
+}
+
+unsigned long sim_uniwill_ops(void)
+{
+	return sim_uw.reads + sim_uw.writes;
+}
+
+void sim_uniwill_reset_counters(void)
+{
+	sim_uw.reads = 0;
+	sim_uw.writes = 0;
+	memset(sim_uw.writes_per_addr, 0, sizeof(sim_uw.writes_per_addr));
+}
+
+/* ::::  Clevo ACPI methods  :::: */
+struct sim_clevo sim_cl;
+
+static union acpi_object *sim_clevo_integer(u32 value)
+{
+	union acpi_object *obj = kzalloc(sizeof(*obj), GFP_KERNEL);
+
+	if (obj) {
+		obj->type = ACPI_TYPE_INTEGER;
+		obj->integer.value = value;
+	}
+	return obj;
+}
+
+// One allocation like acpi_evaluate_dsm(), ACPI_FREE() releases the data too
+static union acpi_object *sim_clevo_buffer(const u8 *data, u32 length)
+{
+	union acpi_object *obj = kzalloc(sizeof(*obj) + length, GFP_KERNEL);
+
+	if (obj) {
+		obj->type = ACPI_TYPE_BUFFER;
+		obj->buffer.length = length;
+		obj->buffer.pointer = (u8 *)(obj + 1);
+		memcpy(obj->buffer.pointer, data, length);
+	}
+	return obj;
+}
+
+static void sim_clevo_set_kb_rgb_leds(u32 arg)
+{
+	u32 sub = arg & 0xff000000;
+
+	switch (sub) {
+	case CLEVO_CMD_SET_KB_LEDS_SUB_RGB_ZONE_0:
+	case CLEVO_CMD_SET_KB_LEDS_SUB_RGB_ZONE_1:
+	case CLEVO_CMD_SET_KB_LEDS_SUB_RGB_ZONE_2:
+	case CLEVO_CMD_SET_KB_LEDS_SUB_RGB_ZONE_3:
+		sim_cl.zone_raw[(sub >> 24) & 0x03] = arg & 0x00ffffff;
+		return;
+	case CLEVO_CMD_SET_KB_LEDS_SUB_RGB_BRIGHTNESS:
+		sim_cl.brightness = arg & 0xff;
+		return;
+	}
+
+	if (arg == 0xE0003001)
+		sim_cl.kbd_on = false;
+	else if (arg == 0xE007F001)
+		sim_cl.kbd_on = true;
+	else
+		sim_cl.mode = arg;
+}
+
+static int sim_clevo_method_call(u8 cmd, u32 arg, union acpi_object **result)
+{
+	union acpi_object *obj = NULL;
+	u32 value = 0;
+
+	usleep_range(sim_cl.latency_us, sim_cl.latency_us);
+	sim_cl.calls++;
+	sim_cl.calls_per_cmd[cmd]++;
+	if (sim_cl.fail_cmd && cmd == sim_cl.fail_cmd)
+		return -EIO;
+
+	switch (cmd) {
+	case CLEVO_CMD_GET_SPECS:
+		obj = sim_clevo_buffer(sim_cl.specs, sizeof(sim_cl.specs));
+		break;
+	case CLEVO_CMD_GET_BIOS_FEATURES_1:
+		value = sim_cl.features_1;
+		break;
+	case CLEVO_CMD_GET_BIOS_FEATURES_2:
+		value = sim_cl.features_2;
+		break;
+	case CLEVO_CMD_GET_EVENT:
+		value = sim_cl.event;
+		break;
+	case CLEVO_CMD_GET_KB_WHITE_LEDS:
+		value = sim_cl.white_brightness;
+		break;
+	case CLEVO_CMD_SET_KB_WHITE_LEDS:
+		sim_cl.white_brightness = arg;
+		break;
+	case CLEVO_CMD_SET_KB_RGB_LEDS:
+		sim_clevo_set_kb_rgb_leds(arg);
+		break;
+	case CLEVO_CMD_SET_EVENTS_ENABLED:
+		sim_cl.events_enabled = true;
+		break;
+	case CLEVO_CMD_OPT:
+		if ((arg >> 24) == CLEVO_CMD_OPT_SUB_SET_PERF_PROF)
+			sim_cl.perf_profile = arg & 0xff;
+		break;
+	case CLEVO_CMD_GET_FANINFO1:
+		value = sim_cl.fan_info[0];
+		break;
+	case CLEVO_CMD_GET_FANINFO2:
+		value = sim_cl.fan_info[1];
+		break;
+	case CLEVO_CMD_GET_FANINFO3:
+		value = sim_cl.fan_info[2];
+		break;
+	}
+
+	if (IS_ERR_OR_NULL(result)) {
+		kfree(obj);
+		return 0;
+	}
+	if (!obj)
+		obj = sim_clevo_integer(value);
+	if (!obj)
+		return -ENOMEM;
+	*result = obj;
+	return 0;
+}
+
+static struct clevo_interface_t sim_clevo_interface = {
+	.string_id = CLEVO_INTERFACE_ACPI_STRID,
+	.method_call = sim_clevo_method_call,
+};
+
+void sim_clevo_setup(const struct sim_clevo_config *config)
+{
+	memset(&sim_cl, 0, sizeof(sim_cl));
+	sim_cl.latency_us = SIM_CLEVO_LATENCY_US_DEFAULT;
+	sim_cl.specs[0x0f] = config->backlight_type;
+	if (config->white_max_5)
+		sim_cl.features_2 |= CLEVO_CMD_GET_BIOS_FEATURES_2_SUB_WHITE_ONLY_KB_MAX_5;
+	sim_cl.kbd_on = true;
+}
+
+int sim_clevo_add(void)
+{
+	return clevo_keyboard_add_interface(&sim_clevo_interface);
+}
+
+int sim_clevo_remove(void)
+{
+	return clevo_keyboard_remove_interface(&sim_clevo_interface);
+}
+
+u32 sim_clevo_zone_color(unsigned int zone)
+{
+	u32 raw = sim_cl.zone_raw[zone & 0x03];
+
+	// Sent as blue, red, green
+	return ((raw & 0x00ff00) << 8) | ((raw & 0x0000ff) << 8) | ((raw & 0xff0000) >> 16);
+}
+
+void sim_clevo_event(u32 event)
+{
+	sim_cl.event = event;
+	if (sim_clevo_interface.event_callb)
+		sim_clevo_interface.event_callb(event);
+}
+
+void sim_clevo_reset_counters(void)
+{
+	sim_cl.calls = 0;
+	memset(sim_cl.calls_per_cmd, 0, sizeof(sim_cl.calls_per_cmd));
+}
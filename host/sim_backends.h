@@ -0,0 +1,100 @@
+/*!
+ * Copyright (c) 2023 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-keyboard.
+ *
+ * tuxedo-keyboard is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef SIM_BACKENDS_H
+#define SIM_BACKENDS_H
+
+#include "host_harness.h"
+
+/**
+ * Simulated firmware behind the interfaces clevo_wmi/clevo_acpi and
+ * uniwill_wmi register with the driver. Every round trip costs the
+ * configured latency in simulated time and is counted.
+ */
+
+/* ::::  Uniwill EC  :::: */
+#define SIM_UW_LATENCY_US_DEFAULT	10000
+
+struct sim_uniwill_config {
+	u8 model;		// UW_EC_REG_BAREBONE_ID
+	bool rgb_1_zone;	// else white only
+	bool charging_prio;
+	bool charging_profile;
+	bool universal_fan;
+};
+
+struct sim_uniwill {
+	u8 ram[0x10000];
+	u32 latency_us;
+	unsigned long reads;
+	unsigned long writes;
+	// Reads and writes of these registers fail, 0 for none
+	u16 fail_addr;
+	unsigned long writes_per_addr[0x10000];
+};
+
+extern struct sim_uniwill sim_uw;
+
+void sim_uniwill_setup(const struct sim_uniwill_config *config);
+int sim_uniwill_add(void);
+int sim_uniwill_remove(void);
+unsigned long sim_uniwill_ops(void);
+void sim_uniwill_reset_counters(void);
+
+/* ::::  Clevo ACPI methods  :::: */
+#define SIM_CLEVO_LATENCY_US_DEFAULT	15000
+#define SIM_CLEVO_SPECS_SIZE		0x20
+
+struct sim_clevo_config {
+	u8 backlight_type;	// CLEVO_SPECS_* value of GET_SPECS byte 0x0f
+	bool white_max_5;
+};
+
+struct sim_clevo {
+	u32 latency_us;
+	unsigned long calls;
+	unsigned long calls_per_cmd[0x100];
+	// Calls of this command fail, 0 for none
+	u8 fail_cmd;
+
+	u32 features_1;
+	u32 features_2;
+	u8 specs[SIM_CLEVO_SPECS_SIZE];
+	// Firmware order blue, red, green as sent
+	u32 zone_raw[4];
+	u8 brightness;
+	bool kbd_on;
+	u32 mode;
+	u8 white_brightness;
+	u8 perf_profile;
+	bool events_enabled;
+	u32 fan_info[3];
+	u32 event;
+};
+
+extern struct sim_clevo sim_cl;
+
+void sim_clevo_setup(const struct sim_clevo_config *config);
+int sim_clevo_add(void);
+int sim_clevo_remove(void);
+// Zone color as 0xRRGGBB
+u32 sim_clevo_zone_color(unsigned int zone);
+void sim_clevo_event(u32 event);
+void sim_clevo_reset_counters(void);
+
+#endif // SIM_BACKENDS_H
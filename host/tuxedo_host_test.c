@@ -0,0 +1,928 @@
+/*!
+ * Copyright (c) 2023 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-keyboard.
+ *
+ * tuxedo-keyboard is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <time.h>
+
+#include "sim_backends.h"
+#include "tuxedo_pack.h"
+#include "clevo_interfaces.h"
+#include "uniwill_interfaces.h"
+#include "tuxedo_io/tuxedo_io_ioctl.h"
+
+/**
+ * Unit tests and microbenchmarks of the driver built for the host
+ *
+ * Every scenario runs in its own process, so it starts with the static
+ * state of a freshly loaded module. Times in scenarios are simulated, the
+ * microbenchmarks measure real CPU time.
+ */
+
+static int failures;
+
+#define CHECK(cond) do {									\
+	if (!(cond)) {										\
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);	\
+		failures++;									\
+	}											\
+} while (0)
+
+#define CHECK_EQ(a, b) do {									\
+	long long __a = (a), __b = (b);								\
+	if (__a != __b) {									\
+		fprintf(stderr, "%s:%d: check failed: %s == %s (0x%llx != 0x%llx)\n",		\
+			__FILE__, __LINE__, #a, #b, __a, __b);					\
+		failures++;									\
+	}											\
+} while (0)
+
+/* ::::  Packing  :::: */
+static void test_pack(void)
+{
+	unsigned int r, g, b, data, mask, shift, value, brightness;
+	u32 color;
+
+	for (r = 0; r < 256; ++r) {
+		for (g = 0; g < 256; ++g) {
+			for (b = 0; b < 256; b += 15) {
+				color = tuxedo_rgb_pack(r, g, b);
+				if (color != ((r << 16) | (g << 8) | b) || tuxedo_rgb_red(color) != r ||
+				    tuxedo_rgb_green(color) != g || tuxedo_rgb_blue(color) != b) {
+					CHECK(!"rgb pack/unpack round trip");
+					return;
+				}
+			}
+		}
+	}
+
+	for (brightness = 0; brightness <= 0xff; ++brightness) {
+		color = tuxedo_rgb_scale(0xff8001, brightness, 0xff);
+		CHECK_EQ(tuxedo_rgb_red(color), brightness);
+		CHECK_EQ(tuxedo_rgb_green(color), 0x80 * brightness / 0xff);
+		CHECK_EQ(tuxedo_rgb_blue(color), brightness / 0xff);
+	}
+	CHECK_EQ(tuxedo_rgb_scale(0x123456, 0xff, 0xff), 0x123456);
+	CHECK_EQ(tuxedo_rgb_scale(0x123456, 0, 0xff), 0);
+
+	for (data = 0; data < 256; ++data) {
+		for (mask = 1; mask < 256; mask = (mask << 1) | 1) {
+			for (shift = 0; shift + __builtin_popcount(mask) <= 8; ++shift) {
+				if (tuxedo_field_get(data, mask, shift) != ((data >> shift) & mask)) {
+					CHECK(!"field get");
+					return;
+				}
+				for (value = 0; value <= mask; ++value) {
+					u8 set = tuxedo_field_set(data, mask, shift, value);
+
+					if (tuxedo_field_get(set, mask, shift) != value ||
+					    (set & ~(mask << shift) & 0xff) != (data & ~(mask << shift) & 0xff)) {
+						CHECK(!"field set");
+						return;
+					}
+				}
+			}
+		}
+	}
+	// Value bits outside of the mask are dropped
+	CHECK_EQ(tuxedo_field_set(0x00, 0x03, 4, 0xff), 0x30);
+}
+
+/* ::::  Shim  :::: */
+static void test_shim_strings(void)
+{
+	unsigned int u;
+	bool flag;
+	int i;
+
+	CHECK(kstrtouint("42\n", 0, &u) == 0 && u == 42);
+	CHECK(kstrtouint("0x1f", 0, &u) == 0 && u == 0x1f);
+	CHECK(kstrtouint("017", 0, &u) == 0 && u == 017);
+	CHECK_EQ(kstrtouint("4294967296", 10, &u), -ERANGE);
+	CHECK_EQ(kstrtouint("12a", 10, &u), -EINVAL);
+	CHECK_EQ(kstrtouint("", 10, &u), -EINVAL);
+	CHECK_EQ(kstrtouint("1\n\n", 10, &u), -EINVAL);
+	CHECK(kstrtoint("-5", 10, &i) == 0 && i == -5);
+	CHECK(kstrtobool("on", &flag) == 0 && flag);
+	CHECK(kstrtobool("N", &flag) == 0 && !flag);
+	CHECK(sysfs_streq("performance\n", "performance"));
+	CHECK(!sysfs_streq("perf", "performance"));
+}
+
+static unsigned int test_work_runs;
+
+static void test_work_func(struct work_struct *work)
+{
+	test_work_runs++;
+}
+
+static void test_shim_deferred(void)
+{
+	struct delayed_work dwork;
+	u64 start;
+
+	INIT_DELAYED_WORK(&dwork, test_work_func);
+	start = host_time_ns;
+	CHECK(queue_delayed_work(system_wq, &dwork, msecs_to_jiffies(100)));
+	CHECK(!queue_delayed_work(system_wq, &dwork, 1));
+	CHECK_EQ(host_run_pending(), 0);
+	host_run_until(start + 99 * NSEC_PER_MSEC);
+	CHECK_EQ(test_work_runs, 0);
+	host_run_until(start + 100 * NSEC_PER_MSEC);
+	CHECK_EQ(test_work_runs, 1);
+	CHECK_EQ(host_pending_count(), 0);
+
+	CHECK(queue_delayed_work(system_wq, &dwork, 10));
+	CHECK(cancel_delayed_work_sync(&dwork));
+	host_run_until(host_time_ns + NSEC_PER_SEC);
+	CHECK_EQ(test_work_runs, 1);
+}
+
+/* ::::  Scenarios  :::: */
+static void load_tuxedo_keyboard(void)
+{
+	CHECK_EQ(host_init_tuxedo_keyboard(), 0);
+}
+
+/**
+ * Unload in module dependency order and check nothing is left behind
+ */
+static void unload_all(int (*remove_interface)(void))
+{
+	host_exit_tuxedo_io();
+	CHECK_EQ(remove_interface(), 0);
+	host_exit_tuxedo_keyboard();
+	host_run_pending();
+
+	CHECK_EQ(host_pending_count(), 0);
+	CHECK_EQ(host_led_count(), 0);
+	CHECK_EQ(host_sysfs_count(), 0);
+	CHECK_EQ(host_debugfs_count(), 0);
+	CHECK(host_platform_device() == NULL);
+}
+
+static long ioctl_write(unsigned int cmd, int32_t value)
+{
+	return host_chrdev_ioctl("tuxedo_io", cmd, (unsigned long)&value);
+}
+
+struct op_sample {
+	unsigned long ops;
+	u64 start_ns;
+};
+
+static void op_sample_start(struct op_sample *sample, unsigned long ops)
+{
+	sample->ops = ops;
+	sample->start_ns = host_time_ns;
+}
+
+static void op_sample_print(const char *vendor, const char *action, struct op_sample *sample, unsigned long ops)
+{
+	printf("  %-8s %-22s %4lu ops %8.1f ms\n", vendor, action, ops - sample->ops,
+	       (double)(host_time_ns - sample->start_ns) / NSEC_PER_MSEC);
+}
+
+static void scenario_clevo_3zone(void)
+{
+	struct sim_clevo_config config = { .backlight_type = 0x02 };
+	unsigned int color[3] = { 0x12, 0x34, 0x56 };
+	struct led_classdev *zones[3];
+	struct op_sample sample;
+	char buf[PAGE_SIZE];
+	int i;
+
+	sim_clevo_setup(&config);
+	load_tuxedo_keyboard();
+	op_sample_start(&sample, sim_cl.calls);
+	CHECK_EQ(sim_clevo_add(), 0);
+	CHECK(host_platform_device() != NULL);
+	host_run_pending();
+	op_sample_print("clevo", "probe", &sample, sim_cl.calls);
+	CHECK(sim_cl.events_enabled);
+	CHECK_EQ(host_init_tuxedo_io(), 0);
+
+	zones[0] = host_led_find("rgb:kbd_backlight");
+	zones[1] = host_led_find("rgb:kbd_backlight_1");
+	zones[2] = host_led_find("rgb:kbd_backlight_2");
+	CHECK(zones[0] && zones[1] && zones[2]);
+	CHECK(host_led_find("white:kbd_backlight") == NULL);
+	if (!zones[0] || !zones[1] || !zones[2])
+		return;
+
+	// Requests are coalesced, only the last one reaches the firmware
+	op_sample_start(&sample, sim_cl.calls);
+	for (i = 0; i < 100; ++i) {
+		color[0] = i;
+		host_led_mc_set(zones[0], color, 0x80);
+	}
+	host_run_pending();
+	op_sample_print("clevo", "set_color x100", &sample, sim_cl.calls);
+	CHECK_EQ(sim_cl.calls - sample.ops, 2);
+	CHECK_EQ(sim_clevo_zone_color(0), 0x633456);
+	CHECK_EQ(sim_cl.brightness, 0x80);
+
+	// Same brightness: only the zone color is sent
+	color[0] = 0xab;
+	op_sample_start(&sample, sim_cl.calls);
+	host_led_mc_set(zones[2], color, 0x80);
+	host_run_pending();
+	op_sample_print("clevo", "set_color", &sample, sim_cl.calls);
+	CHECK_EQ(sim_cl.calls - sample.ops, 1);
+	CHECK_EQ(sim_clevo_zone_color(2), 0xab3456);
+
+	// Unchanged state is not sent again
+	op_sample_start(&sample, sim_cl.calls);
+	host_led_mc_set(zones[2], color, 0x80);
+	host_run_pending();
+	CHECK_EQ(sim_cl.calls - sample.ops, 0);
+
+	op_sample_start(&sample, sim_cl.calls);
+	host_led_mc_set(zones[1], color, 0x20);
+	host_run_pending();
+	op_sample_print("clevo", "set_brightness", &sample, sim_cl.calls);
+	CHECK_EQ(sim_cl.brightness, 0x20);
+	CHECK_EQ(zones[0]->brightness, 0x20);
+
+	op_sample_start(&sample, sim_cl.calls);
+	CHECK_EQ(host_sysfs_store(NULL, "kbd_backlight_mode", "2\n"), 2);
+	op_sample_print("clevo", "set_mode", &sample, sim_cl.calls);
+	CHECK_EQ(sim_cl.calls - sample.ops, 1);
+	CHECK(host_sysfs_show(NULL, "kbd_backlight_mode", buf) > 0 && !strcmp(buf, "2\n"));
+	CHECK_EQ(host_sysfs_store(NULL, "kbd_backlight_mode", "x"), -EINVAL);
+
+	// The firmware mode changed the displayed colors, back in custom mode
+	// the same state has to be sent again
+	CHECK_EQ(host_sysfs_store(NULL, "kbd_backlight_mode", "0\n"), 2);
+	op_sample_start(&sample, sim_cl.calls);
+	host_led_mc_set(zones[2], color, 0x20);
+	host_run_pending();
+	CHECK_EQ(sim_cl.calls - sample.ops, 2);
+
+	op_sample_start(&sample, sim_cl.calls);
+	CHECK_EQ(ioctl_write(W_CL_PERF_PROFILE, 3), 0);
+	op_sample_print("clevo", "set_profile", &sample, sim_cl.calls);
+	CHECK_EQ(sim_cl.perf_profile, 3);
+
+	// Firmware forgets its state over suspend, resume must restore it
+	CHECK_EQ(host_platform_suspend(), 0);
+	CHECK(!sim_cl.kbd_on);
+	memset(sim_cl.zone_raw, 0, sizeof(sim_cl.zone_raw));
+	sim_cl.brightness = 0;
+	sim_cl.events_enabled = false;
+	op_sample_start(&sample, sim_cl.calls);
+	CHECK_EQ(host_platform_resume(), 0);
+	host_run_pending();
+	op_sample_print("clevo", "resume", &sample, sim_cl.calls);
+	CHECK(sim_cl.kbd_on);
+	CHECK(sim_cl.events_enabled);
+	CHECK_EQ(sim_cl.brightness, 0x20);
+	CHECK_EQ(sim_clevo_zone_color(0), 0x633456);
+	CHECK_EQ(sim_clevo_zone_color(2), 0xab3456);
+
+	CHECK(host_debugfs_read("tuxedo_keyboard/clevo_op_budget/stats", buf, sizeof(buf)) > 0);
+	CHECK(strstr(buf, "set_color: runs ") != NULL);
+
+	unload_all(sim_clevo_remove);
+}
+
+static void frame_fps_print(const char *vendor, const char *action, struct op_sample *sample)
+{
+	u64 ns = host_time_ns - sample->start_ns;
+
+	printf("  %-8s %-22s %17.1f fps\n", vendor, action, ns ? (double)NSEC_PER_SEC / ns : 0.0);
+}
+
+static void scenario_clevo_frame(void)
+{
+	struct sim_clevo_config config = { .backlight_type = 0x02 };
+	const u8 full[9] = { 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80, 0x90 };
+	u8 frame[9];
+	struct op_sample sample;
+	char buf[PAGE_SIZE];
+
+	sim_clevo_setup(&config);
+	load_tuxedo_keyboard();
+	CHECK_EQ(sim_clevo_add(), 0);
+	host_run_pending();
+
+	// One method call per changed zone, brightness is not part of a frame
+	op_sample_start(&sample, sim_cl.calls);
+	CHECK_EQ(host_chrdev_write("tuxedo_kbd_frame", full, sizeof(full)), sizeof(full));
+	op_sample_print("clevo", "frame full", &sample, sim_cl.calls);
+	frame_fps_print("clevo", "frame full", &sample);
+	CHECK_EQ(sim_cl.calls - sample.ops, 3);
+	CHECK_EQ(sim_clevo_zone_color(0), 0x102030);
+	CHECK_EQ(sim_clevo_zone_color(1), 0x405060);
+	CHECK_EQ(sim_clevo_zone_color(2), 0x708090);
+
+	// Unchanged keys cost no call
+	op_sample_start(&sample, sim_cl.calls);
+	CHECK_EQ(host_chrdev_write("tuxedo_kbd_frame", full, sizeof(full)), sizeof(full));
+	CHECK_EQ(sim_cl.calls - sample.ops, 0);
+
+	memcpy(frame, full, sizeof(frame));
+	frame[4] = 0x55;
+	op_sample_start(&sample, sim_cl.calls);
+	CHECK_EQ(host_chrdev_write("tuxedo_kbd_frame", frame, sizeof(frame)), sizeof(frame));
+	op_sample_print("clevo", "frame one key", &sample, sim_cl.calls);
+	frame_fps_print("clevo", "frame one key", &sample);
+	CHECK_EQ(sim_cl.calls - sample.ops, 1);
+	CHECK_EQ(sim_clevo_zone_color(1), 0x405560);
+
+	CHECK_EQ(host_chrdev_write("tuxedo_kbd_frame", frame, 6), -EINVAL);
+
+	CHECK(host_debugfs_read("tuxedo_keyboard/clevo_kbd_frame_stats", buf, sizeof(buf)) > 0);
+	CHECK(strstr(buf, "keys: 3\n") != NULL);
+	CHECK(strstr(buf, "frames: 3\n") != NULL);
+	CHECK(strstr(buf, "keys_written: 4\n") != NULL);
+	CHECK(strstr(buf, "keys_skipped: 5\n") != NULL);
+
+	// Firmware state is lost over suspend, the next frame goes out in full
+	CHECK_EQ(host_platform_suspend(), 0);
+	CHECK_EQ(host_platform_resume(), 0);
+	host_run_pending();
+	memset(sim_cl.zone_raw, 0, sizeof(sim_cl.zone_raw));
+	op_sample_start(&sample, sim_cl.calls);
+	CHECK_EQ(host_chrdev_write("tuxedo_kbd_frame", frame, sizeof(frame)), sizeof(frame));
+	CHECK_EQ(sim_cl.calls - sample.ops, 3);
+	CHECK_EQ(sim_clevo_zone_color(0), 0x102030);
+
+	unload_all(sim_clevo_remove);
+	CHECK_EQ(host_chrdev_write("tuxedo_kbd_frame", full, sizeof(full)), -ENOENT);
+}
+
+static void scenario_clevo_per_key(void)
+{
+	struct sim_clevo_config config = { .backlight_type = 0xf3 };
+	const u8 frame[3] = { 0x12, 0x34, 0x56 };
+	struct op_sample sample;
+
+	sim_clevo_setup(&config);
+	load_tuxedo_keyboard();
+	CHECK_EQ(sim_clevo_add(), 0);
+	host_run_pending();
+	CHECK(host_led_find("rgb:kbd_backlight") != NULL);
+
+	// The method interface only sets the whole keyboard
+	op_sample_start(&sample, sim_cl.calls);
+	CHECK_EQ(host_chrdev_write("tuxedo_kbd_frame", frame, sizeof(frame)), sizeof(frame));
+	CHECK_EQ(sim_cl.calls - sample.ops, 1);
+	CHECK_EQ(sim_clevo_zone_color(0), 0x123456);
+
+	unload_all(sim_clevo_remove);
+}
+
+static unsigned long long clevo_health_calls(const char *interface)
+{
+	char buf[PAGE_SIZE];
+	unsigned long long calls = 0;
+	char *line;
+
+	if (host_sysfs_show("method_interface", "stats", buf) <= 0)
+		return 0;
+	line = strstr(buf, interface);
+	if (line)
+		sscanf(line + strlen(interface), ": registered %*d calls %llu", &calls);
+	return calls;
+}
+
+static void scenario_clevo_health(void)
+{
+	struct sim_clevo_config config = { .backlight_type = 0x02 };
+	unsigned long long calls;
+	u32 result;
+	int i;
+
+	sim_clevo_setup(&config);
+	load_tuxedo_keyboard();
+	CHECK_EQ(sim_clevo_add(), 0);
+	host_run_pending();
+
+	// Capability queries may be cache hits, they don't count for health
+	calls = clevo_health_calls(CLEVO_INTERFACE_ACPI_STRID);
+	CHECK(calls > 0);
+	for (i = 0; i < 10; ++i)
+		CHECK_EQ(clevo_evaluate_method(CLEVO_CMD_GET_BIOS_FEATURES_1, 0, &result), 0);
+	CHECK_EQ(clevo_health_calls(CLEVO_INTERFACE_ACPI_STRID), calls);
+	CHECK_EQ(clevo_evaluate_method(CLEVO_CMD_GET_EVENT, 0, &result), 0);
+	CHECK_EQ(clevo_health_calls(CLEVO_INTERFACE_ACPI_STRID), calls + 1);
+
+	unload_all(sim_clevo_remove);
+}
+
+static void scenario_clevo_white(void)
+{
+	struct sim_clevo_config config = { .backlight_type = 0x01 };
+	struct led_classdev *led;
+	struct op_sample sample;
+
+	sim_clevo_setup(&config);
+	load_tuxedo_keyboard();
+	CHECK_EQ(sim_clevo_add(), 0);
+	host_run_pending();
+	CHECK_EQ(host_init_tuxedo_io(), 0);
+
+	led = host_led_find("white:kbd_backlight");
+	CHECK(led != NULL);
+	CHECK(host_led_find("rgb:kbd_backlight") == NULL);
+	CHECK(host_sysfs_show(NULL, "kbd_backlight_mode", (char [PAGE_SIZE]){ 0 }) == -ENOENT);
+	if (!led)
+		return;
+	CHECK_EQ(led->max_brightness, 2);
+
+	op_sample_start(&sample, sim_cl.calls);
+	host_led_set(led, 5);
+	host_run_pending();
+	op_sample_print("clevo", "set_brightness white", &sample, sim_cl.calls);
+	CHECK_EQ(sim_cl.calls - sample.ops, 1);
+	CHECK_EQ(sim_cl.white_brightness, 2);
+
+	unload_all(sim_clevo_remove);
+}
+
+static void scenario_clevo_white_max_5(void)
+{
+	struct sim_clevo_config config = { .backlight_type = 0x01, .white_max_5 = true };
+	struct led_classdev *led;
+
+	sim_clevo_setup(&config);
+	load_tuxedo_keyboard();
+	CHECK_EQ(sim_clevo_add(), 0);
+	host_run_pending();
+	CHECK_EQ(host_init_tuxedo_io(), 0);
+
+	led = host_led_find("white:kbd_backlight");
+	CHECK(led != NULL && led->max_brightness == 5);
+
+	unload_all(sim_clevo_remove);
+}
+
+static void scenario_clevo_specs_missing(void)
+{
+	struct sim_clevo_config config = { .backlight_type = 0x00 };
+
+	// Old firmware: no GET_SPECS, 3-zone RGB from the BIOS features
+	sim_clevo_setup(&config);
+	sim_cl.fail_cmd = CLEVO_CMD_GET_SPECS;
+	sim_cl.features_1 = CLEVO_CMD_GET_BIOS_FEATURES_1_SUB_3_ZONE_RGB_KB;
+	load_tuxedo_keyboard();
+	CHECK_EQ(sim_clevo_add(), 0);
+	host_run_pending();
+	CHECK_EQ(host_init_tuxedo_io(), 0);
+
+	CHECK_EQ(sim_cl.calls_per_cmd[CLEVO_CMD_GET_SPECS], 3);
+	CHECK(host_led_find("rgb:kbd_backlight_2") != NULL);
+
+	unload_all(sim_clevo_remove);
+}
+
+static void scenario_uniwill_rgb(void)
+{
+	struct sim_uniwill_config config = {
+		.model = 0x20,
+		.rgb_1_zone = true,
+		.charging_prio = true,
+		.charging_profile = true,
+		.universal_fan = true,
+	};
+	unsigned int color[3] = { 0x12, 0x34, 0x56 };
+	struct led_classdev *led;
+	struct op_sample sample;
+	char buf[PAGE_SIZE];
+	int i;
+
+	sim_uniwill_setup(&config);
+	load_tuxedo_keyboard();
+	op_sample_start(&sample, sim_uniwill_ops());
+	CHECK_EQ(sim_uniwill_add(), 0);
+	op_sample_print("uniwill", "probe", &sample, sim_uniwill_ops());
+	CHECK(host_platform_device() != NULL);
+	CHECK_EQ(sim_uw.ram[0x0741], 0x01);
+
+	// Shortly after boot the EC may still run its boot animation
+	CHECK(host_debugfs_read("tuxedo_keyboard/uniwill_kbd_bl_init", buf, sizeof(buf)) > 0);
+	CHECK(strstr(buf, "state: pending\n") != NULL);
+	host_run_until(host_time_ns + 5 * NSEC_PER_SEC);
+	CHECK(host_debugfs_read("tuxedo_keyboard/uniwill_kbd_bl_init", buf, sizeof(buf)) > 0);
+	CHECK(strstr(buf, "state: done\n") != NULL);
+	CHECK_EQ(host_init_tuxedo_io(), 0);
+	led = host_led_find("rgb:kbd_backlight");
+	CHECK(led != NULL);
+	CHECK(host_led_find("white:kbd_backlight") == NULL);
+	if (!led)
+		return;
+
+	op_sample_start(&sample, sim_uniwill_ops());
+	host_led_mc_set(led, color, 0xff);
+	host_run_pending();
+	op_sample_print("uniwill", "set_color", &sample, sim_uniwill_ops());
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_RGB_RED_BRIGHTNESS], 0x12);
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_RGB_GREEN_BRIGHTNESS], 0x34);
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_RGB_BLUE_BRIGHTNESS], 0x56);
+
+	// Only channels that change are written
+	color[1] = 0x35;
+	op_sample_start(&sample, sim_uniwill_ops());
+	host_led_mc_set(led, color, 0xff);
+	host_run_pending();
+	CHECK_EQ(sim_uniwill_ops() - sample.ops, 1);
+
+	op_sample_start(&sample, sim_uniwill_ops());
+	host_led_mc_set(led, color, 0x80);
+	host_run_pending();
+	op_sample_print("uniwill", "set_brightness rgb", &sample, sim_uniwill_ops());
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_RGB_RED_BRIGHTNESS], 0x12 * 0x80 / 0xff);
+
+	op_sample_start(&sample, sim_uniwill_ops());
+	CHECK_EQ(host_sysfs_store("charging_priority", "charging_prio", "performance\n"), 12);
+	op_sample_print("uniwill", "set_charging_priority", &sample, sim_uniwill_ops());
+	CHECK(sim_uw.ram[0x07cc] & 0x80);
+	CHECK(host_sysfs_show("charging_priority", "charging_prio", buf) > 0 && !strcmp(buf, "performance\n"));
+	CHECK_EQ(host_sysfs_store("charging_priority", "charging_prio", "fast"), -EINVAL);
+
+	op_sample_start(&sample, sim_uniwill_ops());
+	CHECK_EQ(ioctl_write(W_UW_PERF_PROF, 1), 0);
+	op_sample_print("uniwill", "set_profile", &sample, sim_uniwill_ops());
+
+	// First manual fan speed sets up the custom fan tables
+	op_sample_start(&sample, sim_uniwill_ops());
+	CHECK_EQ(ioctl_write(W_UW_FANSPEED, 0x80), 0);
+	op_sample_print("uniwill", "fanspeed incl. init_fan", &sample, sim_uniwill_ops());
+	CHECK(sim_uw.ram[0x07c5] & 0x80);
+	CHECK(sim_uw.ram[0x07c6] & 0x04);
+	for (i = 0x1; i <= 0xf; ++i) {
+		CHECK_EQ(sim_uw.ram[0x0f00 + i], 0xff);
+		CHECK_EQ(sim_uw.ram[0x0f40 + i], 0xff);
+	}
+	op_sample_start(&sample, sim_uniwill_ops());
+	CHECK_EQ(ioctl_write(W_UW_FANSPEED, 0x90), 0);
+	CHECK(sim_uniwill_ops() - sample.ops < 10);
+
+	CHECK_EQ(host_platform_suspend(), 0);
+	memset(&sim_uw.ram[0x1803], 0, 6);
+	op_sample_start(&sample, sim_uniwill_ops());
+	CHECK_EQ(host_platform_resume(), 0);
+	host_run_pending();
+	op_sample_print("uniwill", "resume", &sample, sim_uniwill_ops());
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_RGB_GREEN_BRIGHTNESS], 0x35 * 0x80 / 0xff);
+
+	unload_all(sim_uniwill_remove);
+	CHECK_EQ(sim_uw.ram[0x0741], 0x00);
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_RGB_RED_BRIGHTNESS], 0x00);
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_RGB_GREEN_BRIGHTNESS], 0x00);
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_RGB_BLUE_BRIGHTNESS], 0x00);
+}
+
+static void scenario_uniwill_rgb_dimmer(void)
+{
+	struct sim_uniwill_config config = { .model = 0x20, .rgb_1_zone = true };
+	unsigned int color[3] = { 0xff, 0x80, 0x00 };
+	struct led_classdev *led;
+
+	*host_param(bool, uw_kbd_bl_global_dimmer) = true;
+	sim_uniwill_setup(&config);
+	load_tuxedo_keyboard();
+	CHECK_EQ(sim_uniwill_add(), 0);
+	host_run_until(host_time_ns + 5 * NSEC_PER_SEC);
+	led = host_led_find("rgb:kbd_backlight");
+	CHECK(led != NULL);
+	if (!led)
+		return;
+
+	// Color unscaled, brightness through the dimmer
+	host_led_mc_set(led, color, 0x40);
+	host_run_pending();
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_RGB_RED_BRIGHTNESS], 0xff);
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_RGB_GREEN_BRIGHTNESS], 0x80);
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_MAX_BRIGHTNESS], 0x40);
+
+	// Unload leaves the keyboard dark with the dimmer reset to full
+	unload_all(sim_uniwill_remove);
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_RGB_RED_BRIGHTNESS], 0x00);
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_RGB_GREEN_BRIGHTNESS], 0x00);
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_RGB_BLUE_BRIGHTNESS], 0x00);
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_MAX_BRIGHTNESS], 0xc8);
+}
+
+static void scenario_uniwill_frame(void)
+{
+	struct sim_uniwill_config config = { .model = 0x20, .rgb_1_zone = true };
+	const unsigned int white[3] = { 0xff, 0xff, 0xff };
+	u8 frame[3] = { 0x12, 0x34, 0x56 };
+	struct led_classdev *led;
+	struct op_sample sample;
+	char buf[PAGE_SIZE];
+
+	sim_uniwill_setup(&config);
+	load_tuxedo_keyboard();
+	CHECK_EQ(sim_uniwill_add(), 0);
+
+	// Bound once the boot animation is over
+	CHECK_EQ(host_chrdev_write("tuxedo_kbd_frame", frame, sizeof(frame)), -ENOENT);
+	host_run_until(host_time_ns + 5 * NSEC_PER_SEC);
+
+	// Frames carry the color, the LED class brightness applies
+	led = host_led_find("rgb:kbd_backlight");
+	CHECK(led != NULL);
+	if (!led)
+		return;
+	host_led_mc_set(led, white, 0xff);
+	host_run_pending();
+	op_sample_start(&sample, sim_uniwill_ops());
+	CHECK_EQ(host_chrdev_write("tuxedo_kbd_frame", frame, sizeof(frame)), sizeof(frame));
+	op_sample_print("uniwill", "frame", &sample, sim_uniwill_ops());
+	frame_fps_print("uniwill", "frame", &sample);
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_RGB_RED_BRIGHTNESS], 0x12);
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_RGB_GREEN_BRIGHTNESS], 0x34);
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_RGB_BLUE_BRIGHTNESS], 0x56);
+
+	// Unchanged frames cost no EC access, changed ones only their channels
+	op_sample_start(&sample, sim_uniwill_ops());
+	CHECK_EQ(host_chrdev_write("tuxedo_kbd_frame", frame, sizeof(frame)), sizeof(frame));
+	CHECK_EQ(sim_uniwill_ops() - sample.ops, 0);
+	frame[1] = 0x35;
+	op_sample_start(&sample, sim_uniwill_ops());
+	CHECK_EQ(host_chrdev_write("tuxedo_kbd_frame", frame, sizeof(frame)), sizeof(frame));
+	op_sample_print("uniwill", "frame one channel", &sample, sim_uniwill_ops());
+	frame_fps_print("uniwill", "frame one channel", &sample);
+	CHECK_EQ(sim_uniwill_ops() - sample.ops, 1);
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_RGB_GREEN_BRIGHTNESS], 0x35);
+
+	CHECK(host_debugfs_read("tuxedo_keyboard/uniwill_kbd_frame_stats", buf, sizeof(buf)) > 0);
+	CHECK(strstr(buf, "keys: 1\n") != NULL);
+	CHECK(strstr(buf, "frames: 3\n") != NULL);
+	CHECK(strstr(buf, "keys_written: 2\n") != NULL);
+
+	// EC state is unknown after resume, the next frame goes out in full
+	CHECK_EQ(host_platform_suspend(), 0);
+	CHECK_EQ(host_platform_resume(), 0);
+	host_run_pending();
+	memset(&sim_uw.ram[UW_EC_REG_KBD_BL_RGB_RED_BRIGHTNESS], 0, 3);
+	CHECK_EQ(host_chrdev_write("tuxedo_kbd_frame", frame, sizeof(frame)), sizeof(frame));
+	CHECK_EQ(sim_uw.ram[UW_EC_REG_KBD_BL_RGB_RED_BRIGHTNESS], 0x12);
+
+	unload_all(sim_uniwill_remove);
+	CHECK_EQ(host_chrdev_write("tuxedo_kbd_frame", frame, sizeof(frame)), -ENOENT);
+}
+
+static void scenario_uniwill_white(void)
+{
+	struct sim_uniwill_config config = { .model = 0x13 };
+	struct led_classdev *led;
+	struct op_sample sample;
+
+	sim_uniwill_setup(&config);
+	load_tuxedo_keyboard();
+	CHECK_EQ(sim_uniwill_add(), 0);
+	CHECK_EQ(host_init_tuxedo_io(), 0);
+
+	// No boot animation to wait for
+	led = host_led_find("white:kbd_backlight");
+	CHECK(led != NULL);
+	CHECK(host_sysfs_show("charging_priority", "charging_prio", (char [PAGE_SIZE]){ 0 }) == -ENOENT);
+	if (!led)
+		return;
+
+	op_sample_start(&sample, sim_uniwill_ops());
+	host_led_set(led, 2);
+	host_run_pending();
+	op_sample_print("uniwill", "set_brightness white", &sample, sim_uniwill_ops());
+	CHECK_EQ(tuxedo_field_get(sim_uw.ram[UW_EC_REG_KBD_BL_STATUS], 0x07, 5), 2);
+	CHECK(sim_uw.ram[UW_EC_REG_KBD_BL_STATUS] & UW_EC_REG_KBD_BL_STATUS_BIT_WHITE_ONLY_KB);
+
+	unload_all(sim_uniwill_remove);
+}
+
+/* ::::  Stress  :::: */
+static void scenario_clevo_stress(void)
+{
+	struct sim_clevo_config config = { .backlight_type = 0x02 };
+	unsigned int color[3], brightness = 0;
+	struct led_classdev *led;
+	unsigned long calls;
+	int i, j, burst;
+
+	sim_clevo_setup(&config);
+	load_tuxedo_keyboard();
+	CHECK_EQ(sim_clevo_add(), 0);
+	host_run_pending();
+	CHECK_EQ(host_init_tuxedo_io(), 0);
+	led = host_led_find("rgb:kbd_backlight");
+	CHECK(led != NULL);
+	if (!led)
+		return;
+
+	for (i = 0; i < 2000; ++i) {
+		burst = 1 + get_random_u32() % 4;
+		for (j = 0; j < burst; ++j) {
+			color[0] = get_random_u32() % 0x100;
+			color[1] = get_random_u32() % 0x100;
+			color[2] = get_random_u32() % 0x100;
+			brightness = get_random_u32() % 0x100;
+			host_led_mc_set(led, color, brightness);
+		}
+		calls = sim_cl.calls;
+		host_run_pending();
+		if (sim_cl.calls - calls > 2 || sim_cl.brightness != brightness ||
+		    sim_clevo_zone_color(0) != tuxedo_rgb_pack(color[0], color[1], color[2])) {
+			CHECK(!"firmware state follows the last request");
+			break;
+		}
+	}
+
+	unload_all(sim_clevo_remove);
+}
+
+/* ::::  Microbenchmarks  :::: */
+static u64 bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static volatile u32 bench_sink;
+
+static void bench_print(const char *name, u64 ns, unsigned long iterations)
+{
+	printf("  %-34s %10.2f ns/op\n", name, (double)ns / iterations);
+}
+
+static void bench_pack(void)
+{
+	const unsigned long iterations = 20000000;
+	unsigned long i;
+	u32 acc = 0;
+	u64 start;
+
+	start = bench_now_ns();
+	for (i = 0; i < iterations; ++i)
+		acc += tuxedo_rgb_scale(i ^ bench_sink, i & 0xff, 0xff);
+	bench_sink = acc;
+	bench_print("tuxedo_rgb_scale", bench_now_ns() - start, iterations);
+
+	start = bench_now_ns();
+	for (i = 0; i < iterations; ++i)
+		acc += tuxedo_field_set(i ^ bench_sink, 0x03, 4, i >> 8);
+	bench_sink = acc;
+	bench_print("tuxedo_field_set", bench_now_ns() - start, iterations);
+}
+
+/**
+ * CPU cost of the driver side of an action, firmware latency set to zero
+ */
+static void bench_clevo_control_path(void)
+{
+	struct sim_clevo_config config = { .backlight_type = 0x02 };
+	const unsigned long iterations = 100000;
+	unsigned int color[3] = { 0, 0, 0 };
+	struct led_classdev *led;
+	unsigned long i;
+	u64 start;
+
+	host_log_level = 3;
+	sim_clevo_setup(&config);
+	sim_cl.latency_us = 0;
+	load_tuxedo_keyboard();
+	CHECK_EQ(sim_clevo_add(), 0);
+	host_run_pending();
+	led = host_led_find("rgb:kbd_backlight");
+	CHECK(led != NULL);
+	if (!led)
+		return;
+
+	start = bench_now_ns();
+	for (i = 0; i < iterations; ++i) {
+		color[i % 3] = i & 0xff;
+		host_led_mc_set(led, color, 0xff);
+		host_run_pending();
+	}
+	bench_print("clevo set_color (driver only)", bench_now_ns() - start, iterations);
+
+	start = bench_now_ns();
+	for (i = 0; i < iterations; ++i) {
+		host_led_mc_set(led, color, i & 0xff);
+		host_run_pending();
+	}
+	bench_print("clevo set_brightness (driver only)", bench_now_ns() - start, iterations);
+
+	CHECK_EQ(sim_clevo_remove(), 0);
+	host_exit_tuxedo_keyboard();
+}
+
+static void bench_uniwill_control_path(void)
+{
+	struct sim_uniwill_config config = { .model = 0x20, .rgb_1_zone = true };
+	const unsigned long iterations = 100000;
+	unsigned int color[3] = { 0, 0, 0 };
+	struct led_classdev *led;
+	unsigned long i;
+	u64 start;
+
+	host_log_level = 3;
+	sim_uniwill_setup(&config);
+	sim_uw.latency_us = 0;
+	// Past the boot animation window
+	host_advance_ns(60 * NSEC_PER_SEC);
+	load_tuxedo_keyboard();
+	CHECK_EQ(sim_uniwill_add(), 0);
+	host_run_pending();
+	led = host_led_find("rgb:kbd_backlight");
+	CHECK(led != NULL);
+	if (!led)
+		return;
+
+	start = bench_now_ns();
+	for (i = 0; i < iterations; ++i) {
+		color[i % 3] = i & 0xff;
+		host_led_mc_set(led, color, 0xff);
+		host_run_pending();
+	}
+	bench_print("uniwill set_color (driver only)", bench_now_ns() - start, iterations);
+
+	CHECK_EQ(sim_uniwill_remove(), 0);
+	host_exit_tuxedo_keyboard();
+}
+
+/* ::::  Runner  :::: */
+struct host_test {
+	const char *name;
+	void (*run)(void);
+};
+
+static const struct host_test host_tests[] = {
+	{ "pack", test_pack },
+	{ "shim_strings", test_shim_strings },
+	{ "shim_deferred", test_shim_deferred },
+	{ "clevo_3zone", scenario_clevo_3zone },
+	{ "clevo_frame", scenario_clevo_frame },
+	{ "clevo_health", scenario_clevo_health },
+	{ "clevo_per_key", scenario_clevo_per_key },
+	{ "clevo_white", scenario_clevo_white },
+	{ "clevo_white_max_5", scenario_clevo_white_max_5 },
+	{ "clevo_specs_missing", scenario_clevo_specs_missing },
+	{ "clevo_stress", scenario_clevo_stress },
+	{ "uniwill_rgb", scenario_uniwill_rgb },
+	{ "uniwill_rgb_dimmer", scenario_uniwill_rgb_dimmer },
+	{ "uniwill_frame", scenario_uniwill_frame },
+	{ "uniwill_white", scenario_uniwill_white },
+	{ "bench_pack", bench_pack },
+	{ "bench_clevo_control_path", bench_clevo_control_path },
+	{ "bench_uniwill_control_path", bench_uniwill_control_path },
+};
+
+static const struct host_test *host_test_current;
+
+static int host_test_child(void)
+{
+	host_test_current->run();
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static bool host_test_run(const struct host_test *test)
+{
+	printf("%s\n", test->name);
+	host_test_current = test;
+	if (host_run_forked(host_test_child)) {
+		printf("  FAILED\n");
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i, failed = 0, run = 0;
+	int arg;
+
+	for (i = 0; i < ARRAY_SIZE(host_tests); ++i) {
+		// Optional test names as filter
+		if (argc > 1) {
+			for (arg = 1; arg < argc && strcmp(argv[arg], host_tests[i].name); ++arg)
+				;
+			if (arg == argc)
+				continue;
+		}
+		run++;
+		if (!host_test_run(&host_tests[i]))
+			failed++;
+	}
+
+	printf("%u of %u passed\n", run - failed, run);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
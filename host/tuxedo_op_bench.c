@@ -0,0 +1,391 @@
+/*!
+ * Copyright (c) 2023 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-keyboard.
+ *
+ * tuxedo-keyboard is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "sim_backends.h"
+#include "clevo_interfaces.h"
+#include "uniwill_interfaces.h"
+#include "tuxedo_io/tuxedo_io_ioctl.h"
+
+/**
+ * Firmware op count regression benchmark
+ *
+ * Drives the user visible actions through the simulated Clevo methods and
+ * Uniwill EC and reads back what the driver measured itself, the
+ * <vendor>_op_budget/stats debugfs file of tuxedo_op_budget.h. An action
+ * fails when any of its runs takes more firmware ops or more simulated time
+ * than the budget the driver defines for it. Budgets are changed in the
+ * driver, not here.
+ *
+ * The simulators count every round trip as well, the driver has to account
+ * at least one op per run and never more than the simulator saw.
+ */
+
+#define BENCH_ITERATIONS	16
+
+struct op_stats {
+	unsigned long long runs;
+	unsigned long long over_budget;
+	unsigned long long busy;
+	unsigned int ops_last;
+	unsigned int ops_max;
+	unsigned int ops_budget;
+	unsigned long long us_last;
+	unsigned long long us_max;
+	unsigned int us_budget;
+};
+
+static int op_stats_read(const char *vendor, const char *action, struct op_stats *stats)
+{
+	char path[96], buf[4096], prefix[48];
+	char *line;
+
+	snprintf(path, sizeof(path), "tuxedo_keyboard/%s_op_budget/stats", vendor);
+	if (host_debugfs_read(path, buf, sizeof(buf)) <= 0)
+		return -ENOENT;
+
+	snprintf(prefix, sizeof(prefix), "%s: ", action);
+	for (line = strtok(buf, "\n"); line; line = strtok(NULL, "\n")) {
+		if (strncmp(line, prefix, strlen(prefix)))
+			continue;
+		if (sscanf(line + strlen(prefix),
+			   "runs %llu over_budget %llu busy %llu ops last %u max %u budget %u"
+			   " us last %llu max %llu budget %u",
+			   &stats->runs, &stats->over_budget, &stats->busy,
+			   &stats->ops_last, &stats->ops_max, &stats->ops_budget,
+			   &stats->us_last, &stats->us_max, &stats->us_budget) != 9)
+			return -EINVAL;
+		return 0;
+	}
+
+	return -ENOENT;
+}
+
+struct bench_action {
+	const char *vendor;
+	const char *action;
+	const char *description;
+	unsigned int iterations;
+	// Loads the driver up to the point the action can run, not measured
+	void (*setup)(void);
+	// One run of the action, i counts the runs from 0
+	void (*run)(unsigned int i);
+	void (*teardown)(void);
+};
+
+static unsigned long bench_sim_ops(const char *vendor)
+{
+	return strcmp(vendor, "clevo") ? sim_uniwill_ops() : sim_cl.calls;
+}
+
+/* ::::  Clevo  :::: */
+static void clevo_load(u8 backlight_type)
+{
+	struct sim_clevo_config config = { .backlight_type = backlight_type };
+
+	sim_clevo_setup(&config);
+	host_init_tuxedo_keyboard();
+	sim_clevo_add();
+	host_run_pending();
+	host_init_tuxedo_io();
+}
+
+static void clevo_setup_3zone(void)
+{
+	clevo_load(0x02);
+}
+
+static void clevo_setup_white(void)
+{
+	clevo_load(0x01);
+}
+
+static void clevo_setup_probe(void)
+{
+	struct sim_clevo_config config = { .backlight_type = 0x02 };
+
+	sim_clevo_setup(&config);
+	host_init_tuxedo_keyboard();
+}
+
+static void clevo_run_probe(unsigned int i)
+{
+	sim_clevo_add();
+	host_run_pending();
+}
+
+static void clevo_teardown(void)
+{
+	host_exit_tuxedo_io();
+	sim_clevo_remove();
+	host_exit_tuxedo_keyboard();
+}
+
+static void clevo_run_set_color(unsigned int i)
+{
+	unsigned int color[3] = { i * 16, 0xff - i * 16, 0x80 };
+
+	host_led_mc_set(host_led_find("rgb:kbd_backlight"), color, 0x80 + i);
+	host_run_pending();
+}
+
+static void clevo_run_set_brightness(unsigned int i)
+{
+	host_led_set(host_led_find("white:kbd_backlight"), i % 3);
+	host_run_pending();
+}
+
+static void clevo_run_set_mode(unsigned int i)
+{
+	char value[8];
+
+	snprintf(value, sizeof(value), "%u\n", i % 8);
+	host_sysfs_store(NULL, "kbd_backlight_mode", value);
+}
+
+static void clevo_run_set_profile(unsigned int i)
+{
+	int32_t profile = i % 4;
+
+	host_chrdev_ioctl("tuxedo_io", W_CL_PERF_PROFILE, (unsigned long)&profile);
+}
+
+static void clevo_run_resume(unsigned int i)
+{
+	host_platform_resume();
+	host_run_pending();
+	// Suspend of the next run, not measured
+	host_platform_suspend();
+}
+
+/* ::::  Uniwill  :::: */
+static void uniwill_load(const struct sim_uniwill_config *config)
+{
+	sim_uniwill_setup(config);
+	// Past the boot animation window, the LEDs are set right away
+	host_advance_ns(60 * NSEC_PER_SEC);
+	host_init_tuxedo_keyboard();
+	sim_uniwill_add();
+	host_run_pending();
+	host_init_tuxedo_io();
+}
+
+static const struct sim_uniwill_config uniwill_config_rgb = {
+	.model = 0x20,
+	.rgb_1_zone = true,
+	.charging_prio = true,
+	.charging_profile = true,
+	.universal_fan = true,
+};
+
+static void uniwill_setup_rgb(void)
+{
+	uniwill_load(&uniwill_config_rgb);
+}
+
+static void uniwill_setup_white(void)
+{
+	struct sim_uniwill_config config = { .model = 0x13 };
+
+	uniwill_load(&config);
+}
+
+static void uniwill_setup_probe(void)
+{
+	sim_uniwill_setup(&uniwill_config_rgb);
+	host_init_tuxedo_keyboard();
+}
+
+static void uniwill_run_probe(unsigned int i)
+{
+	sim_uniwill_add();
+}
+
+static void uniwill_teardown(void)
+{
+	host_exit_tuxedo_io();
+	sim_uniwill_remove();
+	host_exit_tuxedo_keyboard();
+}
+
+static void uniwill_run_set_color(unsigned int i)
+{
+	unsigned int color[3] = { i * 16, 0xff - i * 16, 0x80 + i };
+
+	host_led_mc_set(host_led_find("rgb:kbd_backlight"), color, 0xff);
+	host_run_pending();
+}
+
+static void uniwill_run_set_brightness(unsigned int i)
+{
+	host_led_set(host_led_find("white:kbd_backlight"), (i + 1) % 3);
+	host_run_pending();
+}
+
+static void uniwill_run_set_profile(unsigned int i)
+{
+	int32_t profile = 1 + i % 3;
+
+	host_chrdev_ioctl("tuxedo_io", W_UW_PERF_PROF, (unsigned long)&profile);
+}
+
+static void uniwill_run_init_fan(unsigned int i)
+{
+	int32_t speed = 0x80;
+
+	// The first manual fan speed enables the custom fan tables
+	host_chrdev_ioctl("tuxedo_io", W_UW_FANSPEED, (unsigned long)&speed);
+}
+
+static void uniwill_run_set_charging_priority(unsigned int i)
+{
+	host_sysfs_store("charging_priority", "charging_prio", i % 2 ? "charge_battery" : "performance");
+}
+
+static void uniwill_run_resume(unsigned int i)
+{
+	host_platform_resume();
+	host_run_pending();
+	host_platform_suspend();
+}
+
+static void resume_setup_clevo(void)
+{
+	clevo_setup_3zone();
+	host_platform_suspend();
+}
+
+static void resume_setup_uniwill(void)
+{
+	uniwill_setup_rgb();
+	host_platform_suspend();
+}
+
+static const struct bench_action bench_actions[] = {
+	{ "clevo", "probe", "3-zone RGB", 1, clevo_setup_probe, clevo_run_probe, clevo_teardown },
+	{ "clevo", "set_color", "one zone, color and brightness", BENCH_ITERATIONS,
+	  clevo_setup_3zone, clevo_run_set_color, clevo_teardown },
+	{ "clevo", "set_brightness", "white keyboard", BENCH_ITERATIONS,
+	  clevo_setup_white, clevo_run_set_brightness, clevo_teardown },
+	{ "clevo", "set_mode", "cycle all modes", BENCH_ITERATIONS,
+	  clevo_setup_3zone, clevo_run_set_mode, clevo_teardown },
+	{ "clevo", "set_profile", "W_CL_PERF_PROFILE", BENCH_ITERATIONS,
+	  clevo_setup_3zone, clevo_run_set_profile, clevo_teardown },
+	{ "clevo", "resume", "3-zone RGB restore", BENCH_ITERATIONS,
+	  resume_setup_clevo, clevo_run_resume, clevo_teardown },
+	{ "uniwill", "probe", "1-zone RGB, all features", 1,
+	  uniwill_setup_probe, uniwill_run_probe, uniwill_teardown },
+	{ "uniwill", "set_color", "1-zone RGB", BENCH_ITERATIONS,
+	  uniwill_setup_rgb, uniwill_run_set_color, uniwill_teardown },
+	{ "uniwill", "set_brightness", "white keyboard", BENCH_ITERATIONS,
+	  uniwill_setup_white, uniwill_run_set_brightness, uniwill_teardown },
+	{ "uniwill", "set_profile", "W_UW_PERF_PROF", BENCH_ITERATIONS,
+	  uniwill_setup_rgb, uniwill_run_set_profile, uniwill_teardown },
+	{ "uniwill", "init_fan", "first W_UW_FANSPEED", 1,
+	  uniwill_setup_rgb, uniwill_run_init_fan, uniwill_teardown },
+	{ "uniwill", "set_charging_priority", "sysfs charging_prio", BENCH_ITERATIONS,
+	  uniwill_setup_rgb, uniwill_run_set_charging_priority, uniwill_teardown },
+	{ "uniwill", "resume", "1-zone RGB restore", BENCH_ITERATIONS,
+	  resume_setup_uniwill, uniwill_run_resume, uniwill_teardown },
+};
+
+static const struct bench_action *bench_current;
+
+/**
+ * Runs one action in a fresh driver instance, prints its line of the report
+ * and returns non-zero if it is over budget or not measured correctly
+ */
+static int bench_action_run(void)
+{
+	const struct bench_action *bench = bench_current;
+	struct op_stats before, after = { 0 };
+	unsigned int i, ops_max = 0, problems = 0;
+	unsigned long sim_ops, sim_ops_max = 0;
+	unsigned long long us_max = 0;
+	char problem[160] = "";
+
+	// The report is the result, not driver messages
+	host_log_level = 3;
+	bench->setup();
+
+	for (i = 0; i < bench->iterations; ++i) {
+		if (op_stats_read(bench->vendor, bench->action, &before))
+			memset(&before, 0, sizeof(before));
+		sim_ops = bench_sim_ops(bench->vendor);
+
+		bench->run(i);
+
+		sim_ops = bench_sim_ops(bench->vendor) - sim_ops;
+		if (op_stats_read(bench->vendor, bench->action, &after)) {
+			snprintf(problem, sizeof(problem), "no stats in debugfs");
+			problems++;
+			break;
+		}
+		if (after.runs != before.runs + 1) {
+			snprintf(problem, sizeof(problem), "run %u: %llu runs measured", i, after.runs - before.runs);
+			problems++;
+			continue;
+		}
+		if (after.ops_last == 0 || after.ops_last > sim_ops) {
+			snprintf(problem, sizeof(problem), "run %u: %u ops accounted, %lu seen by the simulator",
+				 i, after.ops_last, sim_ops);
+			problems++;
+		}
+		if (after.ops_last > after.ops_budget || after.us_last > after.us_budget) {
+			snprintf(problem, sizeof(problem), "run %u: over budget", i);
+			problems++;
+		}
+		if (after.over_budget != before.over_budget) {
+			snprintf(problem, sizeof(problem), "run %u: over budget in the driver", i);
+			problems++;
+		}
+		ops_max = max(ops_max, after.ops_last);
+		us_max = max(us_max, after.us_last);
+		sim_ops_max = max(sim_ops_max, sim_ops);
+	}
+
+	printf("%-8s %-22s %4u %6u /%6u %9llu /%9u %7lu  %s\n",
+	       bench->vendor, bench->action, bench->iterations,
+	       ops_max, after.ops_budget, us_max, after.us_budget, sim_ops_max,
+	       problems ? "FAIL" : "ok");
+	if (problems)
+		printf("         %s (%s)\n", problem, bench->description);
+
+	bench->teardown();
+
+	return problems ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i, failed = 0;
+
+	printf("Firmware ops per action, Clevo method calls %u us, Uniwill EC accesses %u us\n\n",
+	       SIM_CLEVO_LATENCY_US_DEFAULT, SIM_UW_LATENCY_US_DEFAULT);
+	printf("%-8s %-22s %4s %14s %20s %7s\n",
+	       "vendor", "action", "runs", "ops max/budget", "us max/budget", "sim ops");
+
+	for (i = 0; i < ARRAY_SIZE(bench_actions); ++i) {
+		bench_current = &bench_actions[i];
+		if (host_run_forked(bench_action_run))
+			failed++;
+	}
+
+	printf("\n%u of %zu actions within budget\n", (unsigned int)ARRAY_SIZE(bench_actions) - failed,
+	       ARRAY_SIZE(bench_actions));
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
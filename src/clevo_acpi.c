@@ -20,22 +20,106 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/acpi.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/string.h>
 #include <linux/version.h>
 #include "clevo_interfaces.h"
 
 #define DRIVER_NAME			"clevo_acpi"
 
+/**
+ * Cache slots for clevo_cmd_is_immutable() commands. Results are kept until
+ * the next resume, see clevo_acpi_cacheable() for early boot values.
+ */
+static const u8 clevo_acpi_immutable_cmds[] = {
+	CLEVO_CMD_GET_SPECS,
+	CLEVO_CMD_GET_BIOS_FEATURES_1,
+	CLEVO_CMD_GET_BIOS_FEATURES_2,
+};
+
+#define CLEVO_ACPI_CACHE_SIZE		ARRAY_SIZE(clevo_acpi_immutable_cmds)
+
+struct clevo_acpi_cache_entry_t {
+	u32 arg;
+	// NULL if not cached
+	union acpi_object *obj;
+};
+
 struct clevo_acpi_driver_data_t {
 	struct acpi_device *adev;
 	struct clevo_interface_t *clevo_interface;
+	// _DSM context, resolved once on add
+	acpi_handle handle;
+	guid_t dsm_guid;
+	struct mutex cache_lock;
+	struct clevo_acpi_cache_entry_t cache[CLEVO_ACPI_CACHE_SIZE];
 };
 
 static struct clevo_acpi_driver_data_t *active_driver_data = NULL;
 
-static int clevo_acpi_evaluate(struct acpi_device *device, u8 cmd, u32 arg, union acpi_object **result)
+static int clevo_acpi_cache_index(u8 cmd)
 {
-	int status;
-	acpi_handle handle;
+	int i;
+
+	for (i = 0; i < CLEVO_ACPI_CACHE_SIZE; ++i)
+		if (clevo_acpi_immutable_cmds[i] == cmd)
+			return i;
+	return -1;
+}
+
+/**
+ * The backlight type byte of CLEVO_CMD_GET_SPECS often reads 0x00 early in
+ * boot and is retried by the caller, only cache it once it is set
+ */
+static bool clevo_acpi_cacheable(u8 cmd, const union acpi_object *obj)
+{
+	if (cmd != CLEVO_CMD_GET_SPECS)
+		return true;
+
+	return obj->type == ACPI_TYPE_BUFFER && obj->buffer.length > 0x0f && obj->buffer.pointer[0x0f] != 0x00;
+}
+
+/**
+ * Copy of an integer or buffer object in one allocation, to be freed by the
+ * caller with ACPI_FREE() like a result of acpi_evaluate_dsm(). Other types
+ * are not cached.
+ */
+static union acpi_object *clevo_acpi_object_dup(const union acpi_object *obj)
+{
+	union acpi_object *copy;
+
+	switch (obj->type) {
+	case ACPI_TYPE_INTEGER:
+		return kmemdup(obj, sizeof(*obj), GFP_KERNEL);
+	case ACPI_TYPE_BUFFER:
+		copy = kmalloc(sizeof(*obj) + obj->buffer.length, GFP_KERNEL);
+		if (!copy)
+			return NULL;
+		*copy = *obj;
+		copy->buffer.pointer = (u8 *)(copy + 1);
+		memcpy(copy->buffer.pointer, obj->buffer.pointer, obj->buffer.length);
+		return copy;
+	default:
+		return NULL;
+	}
+}
+
+static void clevo_acpi_cache_invalidate(struct clevo_acpi_driver_data_t *driver_data)
+{
+	int i;
+
+	mutex_lock(&driver_data->cache_lock);
+	for (i = 0; i < CLEVO_ACPI_CACHE_SIZE; ++i) {
+		kfree(driver_data->cache[i].obj);
+		driver_data->cache[i].obj = NULL;
+	}
+	mutex_unlock(&driver_data->cache_lock);
+}
+
+static int clevo_acpi_evaluate(struct clevo_acpi_driver_data_t *driver_data, u8 cmd, u32 arg, union acpi_object **result)
+{
+	int status = 0;
 	u64 dsm_rev_dummy = 0x00; // Dummy 0 value since not used
 	u64 dsm_func = cmd;
 	// Integer package data for argument
@@ -54,28 +138,43 @@ static int clevo_acpi_evaluate(struct acpi_device *device, u8 cmd, u32 arg, unio
 	};
 
 	union acpi_object *out_obj;
+	struct clevo_acpi_cache_entry_t *entry = NULL;
+	int cache_index = clevo_acpi_cache_index(cmd);
+
+	if (cache_index >= 0) {
+		entry = &driver_data->cache[cache_index];
+		mutex_lock(&driver_data->cache_lock);
+		if (entry->obj && entry->arg == arg) {
+			if (!IS_ERR_OR_NULL(result)) {
+				*result = clevo_acpi_object_dup(entry->obj);
+				if (!*result)
+					status = -ENOMEM;
+			}
+			mutex_unlock(&driver_data->cache_lock);
+			return status;
+		}
+		mutex_unlock(&driver_data->cache_lock);
+	}
 
-	guid_t clevo_acpi_dsm_uuid;
-
-	status = guid_parse(CLEVO_ACPI_DSM_UUID, &clevo_acpi_dsm_uuid);
-	if (status < 0)
-		return -ENOENT;
-
-	handle = acpi_device_handle(device);
-	if (handle == NULL)
-		return -ENODEV;
-
-	out_obj = acpi_evaluate_dsm(handle, &clevo_acpi_dsm_uuid, dsm_rev_dummy, dsm_func, &dsm_argv4);
+	out_obj = acpi_evaluate_dsm(driver_data->handle, &driver_data->dsm_guid, dsm_rev_dummy, dsm_func, &dsm_argv4);
 	if (!out_obj) {
 		pr_err("failed to evaluate _DSM\n");
-		status = -1;
+		return -EIO;
 	}
-	else {
-		if (!IS_ERR_OR_NULL(result)) {
-			*result = out_obj;
-		}
+
+	if (entry && clevo_acpi_cacheable(cmd, out_obj)) {
+		mutex_lock(&driver_data->cache_lock);
+		kfree(entry->obj);
+		entry->obj = clevo_acpi_object_dup(out_obj);
+		entry->arg = arg;
+		mutex_unlock(&driver_data->cache_lock);
 	}
 
+	if (!IS_ERR_OR_NULL(result))
+		*result = out_obj;
+	else
+		ACPI_FREE(out_obj);
+
 	return status;
 }
 
@@ -84,7 +183,7 @@ int clevo_acpi_interface_method_call(u8 cmd, u32 arg, union acpi_object **result
 	int status = 0;
 
 	if (!IS_ERR_OR_NULL(active_driver_data)) {
-		status = clevo_acpi_evaluate(active_driver_data->adev, cmd, arg, result_value);
+		status = clevo_acpi_evaluate(active_driver_data, cmd, arg, result_value);
 	} else {
 		pr_err("acpi method call exec, no driver data found\n");
 		pr_err("..for method_call: %0#4x arg: %0#10x\n", cmd, arg);
@@ -110,7 +209,16 @@ static int clevo_acpi_add(struct acpi_device *device)
 
 	driver_data->adev = device;
 	driver_data->clevo_interface = &clevo_acpi_interface;
+	mutex_init(&driver_data->cache_lock);
+
+	if (guid_parse(CLEVO_ACPI_DSM_UUID, &driver_data->dsm_guid))
+		return -ENOENT;
+
+	driver_data->handle = acpi_device_handle(device);
+	if (driver_data->handle == NULL)
+		return -ENODEV;
 
+	device->driver_data = driver_data;
 	active_driver_data = driver_data;
 
 	pr_debug("clevo_acpi driver add\n");
@@ -131,6 +239,7 @@ static void clevo_acpi_remove(struct acpi_device *device)
 {
 	pr_debug("clevo_acpi driver remove\n");
 	clevo_keyboard_remove_interface(&clevo_acpi_interface);
+	clevo_acpi_cache_invalidate(acpi_driver_data(device));
 	active_driver_data = NULL;
 #if LINUX_VERSION_CODE < KERNEL_VERSION(6, 2, 0)
 	return 0;
@@ -144,7 +253,7 @@ void clevo_acpi_notify(struct acpi_device *device, u32 event)
 	int status;
 	// struct clevo_acpi_driver_data_t *clevo_acpi_driver_data;
 
-	status = clevo_acpi_evaluate(device, 0x01, 0, &out_obj);
+	status = clevo_acpi_evaluate(acpi_driver_data(device), 0x01, 0, &out_obj);
 	if (!status) {
 			if (out_obj->type == ACPI_TYPE_INTEGER) {
 				event_value = (u32)out_obj->integer.value;
@@ -172,6 +281,8 @@ static int driver_suspend_callb(struct device *dev)
 static int driver_resume_callb(struct device *dev)
 {
 	pr_debug("driver resume\n");
+	// Firmware could have been changed in the meantime (hibernation)
+	clevo_acpi_cache_invalidate(acpi_driver_data(to_acpi_device(dev)));
 	return 0;
 }
 
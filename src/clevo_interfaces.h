@@ -71,6 +71,17 @@
 #define CLEVO_CMD_OPT			0x79
 #define CLEVO_CMD_OPT_SUB_SET_PERF_PROF	0x19
 
+/**
+ * Queries whose result is fixed once the firmware is up. Interfaces may
+ * answer them from a cache, so they say nothing about interface health.
+ */
+static inline bool clevo_cmd_is_immutable(u8 cmd)
+{
+	return cmd == CLEVO_CMD_GET_SPECS ||
+	       cmd == CLEVO_CMD_GET_BIOS_FEATURES_1 ||
+	       cmd == CLEVO_CMD_GET_BIOS_FEATURES_2;
+}
+
 struct clevo_interface_t {
 	char *string_id;
 	void (*event_callb)(u32);
@@ -82,6 +93,22 @@ int clevo_keyboard_remove_interface(struct clevo_interface_t *interface);
 int clevo_evaluate_method(u8 cmd, u32 arg, u32 *result);
 int clevo_evaluate_method2(u8 cmd, u32 arg, union acpi_object **result);
 int clevo_get_active_interface_id(char **id_str);
+void clevo_method_session_begin(void);
+void clevo_method_session_end(void);
+
+// User visible actions with a firmware op budget, see clevo_action_begin()
+enum clevo_action {
+	CLEVO_ACTION_SET_BRIGHTNESS = 0,
+	CLEVO_ACTION_SET_COLOR,
+	CLEVO_ACTION_SET_MODE,
+	CLEVO_ACTION_SET_PROFILE,
+	CLEVO_ACTION_RESUME,
+	CLEVO_ACTION_PROBE,
+	CLEVO_ACTION_MAX
+};
+
+void clevo_action_begin(enum clevo_action action);
+void clevo_action_end(enum clevo_action action);
 
 #define MODULE_ALIAS_CLEVO_WMI() \
 	MODULE_ALIAS("wmi:" CLEVO_WMI_EVENT_GUID); \
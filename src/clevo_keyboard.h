@@ -20,8 +20,18 @@
 #define CLEVO_KEYBOARD_H
 
 #include "tuxedo_keyboard_common.h"
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/ktime.h>
+#include <linux/delay.h>
+#include <linux/random.h>
+#include <linux/srcu.h>
 #include "clevo_interfaces.h"
 #include "clevo_leds.h"
+#include "tuxedo_quirks.h"
+#include "tuxedo_resume.h"
+#include "tuxedo_event_queue.h"
+#include "tuxedo_op_budget.h"
 
 // Clevo event codes
 #define CLEVO_EVENT_KB_LEDS_DECREASE		0x81
@@ -50,12 +60,25 @@ static struct clevo_interfaces_t {
 	struct clevo_interface_t *acpi;
 } clevo_interfaces;
 
-static struct clevo_interface_t *active_clevo_interface;
+/**
+ * Interface used for method calls. Published via SRCU: method calls only
+ * enter a read side section (they sleep, so no plain RCU), changes are made
+ * under clevo_keyboard_interface_modification_lock and removal waits for
+ * calls still in flight on the old interface.
+ */
+static struct clevo_interface_t __rcu *active_clevo_interface;
+DEFINE_STATIC_SRCU(clevo_interface_srcu);
 
 static struct tuxedo_keyboard_driver clevo_keyboard_driver;
 
 static DEFINE_MUTEX(clevo_keyboard_interface_modification_lock);
 
+static struct clevo_interface_t *clevo_active_interface_locked(void)
+{
+	return rcu_dereference_protected(active_clevo_interface,
+					 lockdep_is_held(&clevo_keyboard_interface_modification_lock));
+}
+
 static struct key_entry clevo_keymap[] = {
 	// Keyboard backlight (RGB versions)
 	{ KE_KEY, CLEVO_EVENT_KB_LEDS_DECREASE, { KEY_KBDILLUMDOWN } },
@@ -124,13 +147,256 @@ static struct kbd_backlight_mode_t {
         { .key = 7, .value = 0xB0000000, .name = "WAVE"}
 };
 
+static DEFINE_TUXEDO_SESSION_LOCK(clevo_method_session);
+
+/**
+ * Hold the method interface for the calling task over several calls so that
+ * a sequence of commands can not be interleaved with other calls
+ */
+void clevo_method_session_begin(void)
+{
+	tuxedo_session_begin(&clevo_method_session);
+}
+EXPORT_SYMBOL(clevo_method_session_begin);
+
+void clevo_method_session_end(void)
+{
+	tuxedo_session_end(&clevo_method_session);
+}
+EXPORT_SYMBOL(clevo_method_session_end);
+
+/**
+ * Method calls and time per action, about 20 ms per call
+ */
+static struct tuxedo_op_budget_t clevo_action_budgets[] = {
+	[CLEVO_ACTION_SET_BRIGHTNESS] = TUXEDO_OP_BUDGET("set_brightness", 1, 20000),
+	[CLEVO_ACTION_SET_COLOR] = TUXEDO_OP_BUDGET("set_color", 2, 40000),
+	[CLEVO_ACTION_SET_MODE] = TUXEDO_OP_BUDGET("set_mode", 1, 20000),
+	[CLEVO_ACTION_SET_PROFILE] = TUXEDO_OP_BUDGET("set_profile", 1, 20000),
+	[CLEVO_ACTION_RESUME] = TUXEDO_OP_BUDGET("resume", 7, 140000),
+	// Without backlight detection retries
+	[CLEVO_ACTION_PROBE] = TUXEDO_OP_BUDGET("probe", 10, 200000),
+};
+
+static struct tuxedo_op_account_t clevo_op_account =
+	TUXEDO_OP_ACCOUNT_INIT(clevo_op_account, "clevo", clevo_action_budgets);
+
+void clevo_action_begin(enum clevo_action action)
+{
+	tuxedo_op_budget_begin(&clevo_op_account, action);
+}
+EXPORT_SYMBOL(clevo_action_begin);
+
+void clevo_action_end(enum clevo_action action)
+{
+	tuxedo_op_budget_end(&clevo_op_account, action);
+}
+EXPORT_SYMBOL(clevo_action_end);
+
+/**
+ * Interface health
+ *
+ * Success rate and latency of every method call are tracked per interface
+ * (EWMA, 1/8 weight). The cost of an interface is its average latency plus a
+ * penalty per error. Method calls are moved to the other registered
+ * interface if it is known to be cheaper by a margin, or, if it was not used
+ * yet, once the active one fails most calls. A minimum number of calls
+ * between switches keeps the decision from flapping.
+ */
+enum clevo_interface_index {
+	CLEVO_INTERFACE_INDEX_WMI = 0,
+	CLEVO_INTERFACE_INDEX_ACPI,
+	CLEVO_INTERFACE_INDEX_MAX
+};
+
+static const char * const clevo_interface_names[] = {
+	[CLEVO_INTERFACE_INDEX_WMI] = CLEVO_INTERFACE_WMI_STRID,
+	[CLEVO_INTERFACE_INDEX_ACPI] = CLEVO_INTERFACE_ACPI_STRID,
+};
+
+#define CLEVO_HEALTH_ERROR_PENALTY_NS		(50 * NSEC_PER_MSEC)
+#define CLEVO_HEALTH_FAILING_PERMILLE		500
+#define CLEVO_HEALTH_MIN_CALLS			32
+// Switch if the other interface costs less than 2/3
+#define CLEVO_HEALTH_MARGIN_NUM			3
+#define CLEVO_HEALTH_MARGIN_DEN			2
+
+struct clevo_interface_health_t {
+	u64 calls;
+	u64 errors;
+	u64 latency_avg_ns;
+	u32 error_avg_permille;
+	// Fault injection to simulate backends of different quality, debugfs
+	u32 sim_delay_us;
+	u32 sim_error_permille;
+};
+
+// Protected by the method session
+static struct clevo_interface_health_t clevo_interface_health[CLEVO_INTERFACE_INDEX_MAX];
+static u64 clevo_interface_calls_since_switch;
+static u64 clevo_interface_switches;
+static bool clevo_interface_failover = true;
+
+static struct clevo_interface_t *clevo_interface_by_index(int index)
+{
+	return index == CLEVO_INTERFACE_INDEX_WMI ? clevo_interfaces.wmi : clevo_interfaces.acpi;
+}
+
+/**
+ * Index by identity, -1 for an interface not known here
+ */
+static int clevo_interface_index(struct clevo_interface_t *interface)
+{
+	if (strcmp(interface->string_id, CLEVO_INTERFACE_WMI_STRID) == 0)
+		return CLEVO_INTERFACE_INDEX_WMI;
+	if (strcmp(interface->string_id, CLEVO_INTERFACE_ACPI_STRID) == 0)
+		return CLEVO_INTERFACE_INDEX_ACPI;
+	return -1;
+}
+
+static u64 clevo_interface_cost_ns(struct clevo_interface_health_t *health)
+{
+	return health->latency_avg_ns +
+	       div_u64((u64)health->error_avg_permille * CLEVO_HEALTH_ERROR_PENALTY_NS, 1000);
+}
+
+/**
+ * Only failures of the transport count against an interface: evaluation
+ * failed (-EIO) or no result object (-ENODATA). Other errors, e.g. a
+ * command the firmware does not support, say nothing about its health.
+ */
+static bool clevo_interface_transport_error(int status)
+{
+	return status == -EIO || status == -ENODATA;
+}
+
+static void clevo_interface_account(int index, ktime_t start, int status)
+{
+	struct clevo_interface_health_t *health;
+	s64 latency_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	bool failed = clevo_interface_transport_error(status);
+	u32 error_permille = failed ? 1000 : 0;
+
+	if (index < 0)
+		return;
+	health = &clevo_interface_health[index];
+
+	if (health->calls == 0) {
+		health->latency_avg_ns = latency_ns;
+		health->error_avg_permille = error_permille;
+	} else {
+		health->latency_avg_ns = health->latency_avg_ns - (health->latency_avg_ns >> 3) + (latency_ns >> 3);
+		health->error_avg_permille = health->error_avg_permille - (health->error_avg_permille >> 3) +
+					     (error_permille >> 3);
+	}
+	health->calls++;
+	if (failed)
+		health->errors++;
+	clevo_interface_calls_since_switch++;
+}
+
+/**
+ * Called with the method session held
+ */
+static void clevo_interface_evaluate_health(void)
+{
+	int active, other;
+	struct clevo_interface_t *active_interface, *other_interface;
+	struct clevo_interface_health_t *active_health, *other_health;
+	bool switch_interface;
+
+	if (!clevo_interface_failover || clevo_interface_calls_since_switch < CLEVO_HEALTH_MIN_CALLS)
+		return;
+
+	// Interfaces coming or going, decide on the next call
+	if (!mutex_trylock(&clevo_keyboard_interface_modification_lock))
+		return;
+
+	active_interface = clevo_active_interface_locked();
+	if (IS_ERR_OR_NULL(active_interface))
+		goto out;
+
+	active = clevo_interface_index(active_interface);
+	if (active < 0)
+		goto out;
+	other = active == CLEVO_INTERFACE_INDEX_WMI ? CLEVO_INTERFACE_INDEX_ACPI : CLEVO_INTERFACE_INDEX_WMI;
+	other_interface = clevo_interface_by_index(other);
+	if (IS_ERR_OR_NULL(other_interface))
+		goto out;
+
+	active_health = &clevo_interface_health[active];
+	other_health = &clevo_interface_health[other];
+
+	if (other_health->calls == 0)
+		switch_interface = active_health->error_avg_permille >= CLEVO_HEALTH_FAILING_PERMILLE;
+	else
+		switch_interface = clevo_interface_cost_ns(other_health) * CLEVO_HEALTH_MARGIN_NUM <
+				   clevo_interface_cost_ns(active_health) * CLEVO_HEALTH_MARGIN_DEN;
+
+	if (switch_interface) {
+		TUXEDO_INFO("Switching method interface %s -> %s (cost %llu us -> %llu us)\n",
+			    active_interface->string_id, other_interface->string_id,
+			    div_u64(clevo_interface_cost_ns(active_health), NSEC_PER_USEC),
+			    div_u64(clevo_interface_cost_ns(other_health), NSEC_PER_USEC));
+		other_interface->method_call(CLEVO_CMD_SET_EVENTS_ENABLED, 0, NULL);
+		// Both stay registered, removal of the old one waits for its calls
+		rcu_assign_pointer(active_clevo_interface, other_interface);
+		clevo_interface_switches++;
+		clevo_interface_calls_since_switch = 0;
+	}
+
+out:
+	mutex_unlock(&clevo_keyboard_interface_modification_lock);
+}
+
+static int clevo_interface_call(struct clevo_interface_t *interface, u8 cmd, u32 arg, union acpi_object **result)
+{
+	int index = clevo_interface_index(interface);
+	struct clevo_interface_health_t *health;
+
+	if (index < 0)
+		return interface->method_call(cmd, arg, result);
+	health = &clevo_interface_health[index];
+
+	if (health->sim_delay_us)
+		usleep_range(health->sim_delay_us, health->sim_delay_us + health->sim_delay_us / 8 + 1);
+	if (health->sim_error_permille && get_random_u32() % 1000 < health->sim_error_permille)
+		return -EIO;
+
+	return interface->method_call(cmd, arg, result);
+}
+
 int clevo_evaluate_method2(u8 cmd, u32 arg, union acpi_object **result)
 {
-	if (IS_ERR_OR_NULL(active_clevo_interface)) {
+	int status, srcu_idx;
+	bool locked;
+	ktime_t start;
+	struct clevo_interface_t *interface;
+
+	locked = tuxedo_session_get(&clevo_method_session);
+	srcu_idx = srcu_read_lock(&clevo_interface_srcu);
+
+	interface = srcu_dereference(active_clevo_interface, &clevo_interface_srcu);
+	if (IS_ERR_OR_NULL(interface)) {
+		srcu_read_unlock(&clevo_interface_srcu, srcu_idx);
+		tuxedo_session_put(&clevo_method_session, locked);
 		pr_err("clevo_keyboard: no active interface while attempting cmd %02x arg %08x\n", cmd, arg);
 		return -ENODEV;
 	}
-	return active_clevo_interface->method_call(cmd, arg, result);
+
+	start = ktime_get();
+	status = clevo_interface_call(interface, cmd, arg, result);
+	// Possibly a cache hit of the interface
+	if (!clevo_cmd_is_immutable(cmd)) {
+		clevo_interface_account(clevo_interface_index(interface), start, status);
+		clevo_interface_evaluate_health();
+	}
+	tuxedo_op_account_op(&clevo_op_account);
+
+	srcu_read_unlock(&clevo_interface_srcu, srcu_idx);
+	tuxedo_session_put(&clevo_method_session, locked);
+
+	return status;
 }
 EXPORT_SYMBOL(clevo_evaluate_method2);
 
@@ -160,11 +426,19 @@ EXPORT_SYMBOL(clevo_evaluate_method);
 
 int clevo_get_active_interface_id(char **id_str)
 {
-	if (IS_ERR_OR_NULL(active_clevo_interface))
+	int srcu_idx;
+	struct clevo_interface_t *interface;
+
+	srcu_idx = srcu_read_lock(&clevo_interface_srcu);
+	interface = srcu_dereference(active_clevo_interface, &clevo_interface_srcu);
+	if (IS_ERR_OR_NULL(interface)) {
+		srcu_read_unlock(&clevo_interface_srcu, srcu_idx);
 		return -ENODEV;
+	}
 
 	if (!IS_ERR_OR_NULL(id_str))
-		*id_str = active_clevo_interface->string_id;
+		*id_str = interface->string_id;
+	srcu_read_unlock(&clevo_interface_srcu, srcu_idx);
 
 	return 0;
 }
@@ -194,10 +468,14 @@ static void set_kbd_backlight_mode(u8 kbd_backlight_mode)
 {
 	TUXEDO_INFO("Set keyboard backlight mode on %s", kbd_backlight_modes[kbd_backlight_mode].name);
 
+	clevo_action_begin(CLEVO_ACTION_SET_MODE);
 	if (!clevo_evaluate_method(CLEVO_CMD_SET_KB_RGB_LEDS, kbd_backlight_modes[kbd_backlight_mode].value, NULL)) {
 		// method was succesfull so update ur internal state struct
 		kbd_led_state.mode = kbd_backlight_mode;
+		// Firmware modes change the displayed colors
+		clevo_leds_shadow_invalidate();
 	}
+	clevo_action_end(CLEVO_ACTION_SET_MODE);
 }
 
 // Sysfs Interface for the keyboard backlight mode
@@ -263,7 +541,10 @@ static void clevo_send_cc_combo(void)
 	input_sync(clevo_keyboard_driver.input_device);
 }
 
-static void clevo_keyboard_event_callb(u32 event)
+// Backlight detection and initial programming done, see clevo_keyboard_probe()
+static DECLARE_COMPLETION(clevo_keyboard_init_done);
+
+static void clevo_keyboard_event_handle(u32 event)
 {
 	u32 key_event = event;
 
@@ -274,6 +555,8 @@ static void clevo_keyboard_event_callb(u32 event)
 			clevo_send_cc_combo();
 			break;
 		case CLEVO_EVENT_KB_LEDS_CYCLE_MODE:
+			if (!completion_done(&clevo_keyboard_init_done))
+				break;
 			if (clevo_leds_get_backlight_type() == CLEVO_KB_BACKLIGHT_TYPE_FIXED_COLOR) {
 				clevo_send_cc_combo();
 			} else {
@@ -281,7 +564,8 @@ static void clevo_keyboard_event_callb(u32 event)
 			}
 			break;
 		case CLEVO_EVENT_KB_LEDS_CYCLE_BRIGHTNESS:
-			clevo_leds_notify_brightness_change_extern();
+			if (completion_done(&clevo_keyboard_init_done))
+				clevo_leds_notify_brightness_change_extern();
 			break;
 		default:
 			break;
@@ -294,6 +578,33 @@ static void clevo_keyboard_event_callb(u32 event)
 	}
 }
 
+// Brightness cycled by the firmware, only the latest state needs to be read back
+static u32 clevo_keyboard_event_coalesce_class(u32 event)
+{
+	return event == CLEVO_EVENT_KB_LEDS_CYCLE_BRIGHTNESS ? 1 : 0;
+}
+
+static struct tuxedo_event_queue_t clevo_keyboard_events =
+	TUXEDO_EVENT_QUEUE_INIT(clevo_keyboard_events, clevo_keyboard_event_handle,
+				clevo_keyboard_event_coalesce_class);
+static struct dentry *clevo_keyboard_events_dentry;
+
+static int clevo_keyboard_events_show(struct seq_file *s, void *unused)
+{
+	tuxedo_event_queue_stats_show(s, &clevo_keyboard_events);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(clevo_keyboard_events);
+
+/**
+ * Called from the interface notify handlers, handling is deferred to keep the
+ * ACPI notify workqueue free
+ */
+static void clevo_keyboard_event_callb(u32 event)
+{
+	tuxedo_event_queue_push(&clevo_keyboard_events, event);
+}
+
 static void clevo_keyboard_init_device_interface(struct platform_device *dev)
 {
 	// Setup sysfs
@@ -307,23 +618,8 @@ static void clevo_keyboard_init_device_interface(struct platform_device *dev)
 	}
 }
 
-/**
- * strstr version of dmi_match
- */
-static bool dmi_string_in(enum dmi_field f, const char *str)
-{
-	const char *info = dmi_get_system_info(f);
-
-	if (info == NULL || str == NULL)
-		return info == str;
-
-	return strstr(info, str) != NULL;
-}
-
 static void clevo_keyboard_init(void)
 {
-	bool performance_profile_set_workaround;
-
 	kbd_led_state.mode = param_kbd_backlight_mode;
 	set_kbd_backlight_mode(kbd_led_state.mode);
 
@@ -332,32 +628,180 @@ static void clevo_keyboard_init(void)
 	// Workaround for firmware issue not setting selected performance profile.
 	// Explicitly set "performance" perf. profile on init regardless of what is chosen
 	// for these devices (Aura, XP14, IBS14v5)
-	performance_profile_set_workaround = false
-		|| dmi_string_in(DMI_BOARD_NAME, "AURA1501")
-		|| dmi_string_in(DMI_BOARD_NAME, "EDUBOOK1502")
-		|| dmi_string_in(DMI_BOARD_NAME, "NL5xRU")
-		|| dmi_string_in(DMI_BOARD_NAME, "NV4XMB,ME,MZ")
-		|| dmi_string_in(DMI_BOARD_NAME, "L140CU")
-		|| dmi_string_in(DMI_BOARD_NAME, "NS50MU")
-		|| dmi_string_in(DMI_BOARD_NAME, "NS50_70MU")
-		|| dmi_string_in(DMI_BOARD_NAME, "PCX0DX")
-		|| dmi_string_in(DMI_BOARD_NAME, "PCx0Dx_GN20")
-		|| dmi_string_in(DMI_BOARD_NAME, "L14xMU")
-		;
-	if (performance_profile_set_workaround) {
+	if (tuxedo_quirk(TUXEDO_QUIRK_CL_PERF_PROFILE_WORKAROUND)) {
 		TUXEDO_INFO("Performance profile 'performance' set workaround applied\n");
 		clevo_evaluate_method(CLEVO_CMD_OPT, 0x19000002, NULL);
 	}
 }
 
-static int clevo_keyboard_probe(struct platform_device *dev)
+static ssize_t clevo_method_interface_active_show(struct device *child,
+						  struct device_attribute *attr, char *buffer)
+{
+	char *id_str = NULL;
+
+	if (clevo_get_active_interface_id(&id_str))
+		return -ENODEV;
+	return sprintf(buffer, "%s\n", id_str);
+}
+
+static ssize_t clevo_method_interface_failover_show(struct device *child,
+						    struct device_attribute *attr, char *buffer)
+{
+	return sprintf(buffer, "%d\n", clevo_interface_failover);
+}
+
+static ssize_t clevo_method_interface_failover_store(struct device *child,
+						     struct device_attribute *attr,
+						     const char *buffer, size_t size)
 {
+	bool value;
+
+	if (kstrtobool(buffer, &value))
+		return -EINVAL;
+	clevo_interface_failover = value;
+	return size;
+}
+
+static ssize_t clevo_method_interface_stats_show(struct device *child,
+						 struct device_attribute *attr, char *buffer)
+{
+	int i;
+	ssize_t len = 0;
+	struct clevo_interface_health_t *health;
+
+	clevo_method_session_begin();
+	for (i = 0; i < CLEVO_INTERFACE_INDEX_MAX; ++i) {
+		health = &clevo_interface_health[i];
+		len += scnprintf(buffer + len, PAGE_SIZE - len,
+				 "%s: registered %d calls %llu errors %llu error_rate_permille %u latency_avg_us %llu\n",
+				 clevo_interface_names[i], !IS_ERR_OR_NULL(clevo_interface_by_index(i)),
+				 health->calls, health->errors, health->error_avg_permille,
+				 div_u64(health->latency_avg_ns, NSEC_PER_USEC));
+	}
+	len += scnprintf(buffer + len, PAGE_SIZE - len, "switches: %llu\n", clevo_interface_switches);
+	clevo_method_session_end();
+
+	return len;
+}
+
+struct clevo_method_interface_attrs_t {
+	struct device_attribute active;
+	struct device_attribute failover;
+	struct device_attribute stats;
+} clevo_method_interface_attrs = {
+	.active = __ATTR(active, 0444, clevo_method_interface_active_show, NULL),
+	.failover = __ATTR(failover, 0644, clevo_method_interface_failover_show, clevo_method_interface_failover_store),
+	.stats = __ATTR(stats, 0444, clevo_method_interface_stats_show, NULL)
+};
+
+static struct attribute *clevo_method_interface_attrs_list[] = {
+	&clevo_method_interface_attrs.active.attr,
+	&clevo_method_interface_attrs.failover.attr,
+	&clevo_method_interface_attrs.stats.attr,
+	NULL
+};
+
+static struct attribute_group clevo_method_interface_attr_group = {
+	.name = "method_interface",
+	.attrs = clevo_method_interface_attrs_list
+};
+
+static bool clevo_method_interface_loaded;
+static struct dentry *clevo_interface_sim_dentry;
+
+static void clevo_method_interface_init(struct platform_device *dev)
+{
+	int i;
+	struct dentry *dir;
+
+	clevo_method_interface_loaded = sysfs_create_group(&dev->dev.kobj, &clevo_method_interface_attr_group) == 0;
+
+	clevo_interface_sim_dentry = debugfs_create_dir("clevo_interface_sim", tuxedo_debugfs_root);
+	for (i = 0; i < CLEVO_INTERFACE_INDEX_MAX; ++i) {
+		dir = debugfs_create_dir(clevo_interface_names[i], clevo_interface_sim_dentry);
+		debugfs_create_u32("delay_us", 0644, dir, &clevo_interface_health[i].sim_delay_us);
+		debugfs_create_u32("error_permille", 0644, dir, &clevo_interface_health[i].sim_error_permille);
+	}
+}
+
+static void clevo_method_interface_remove(struct platform_device *dev)
+{
+	debugfs_remove_recursive(clevo_interface_sim_dentry);
+	clevo_interface_sim_dentry = NULL;
+	if (clevo_method_interface_loaded)
+		sysfs_remove_group(&dev->dev.kobj, &clevo_method_interface_attr_group);
+	clevo_method_interface_loaded = false;
+}
+
+/**
+ * Backlight detection retries with sleeps and the initial programming takes
+ * a series of firmware calls. Keep both off the module load path, probe only
+ * queues them so the input device is registered right away.
+ */
+static struct platform_device *clevo_keyboard_init_pdev;
+static ktime_t clevo_keyboard_load_time;
+
+static void clevo_keyboard_init_work_func(struct work_struct *work)
+{
+	struct platform_device *dev = clevo_keyboard_init_pdev;
+
+	clevo_action_begin(CLEVO_ACTION_PROBE);
 	clevo_leds_init(dev);
 	// clevo_keyboard_init_device_interface() must come after clevo_leds_init()
 	// to know keyboard backlight type
 	clevo_keyboard_init_device_interface(dev);
 	clevo_keyboard_init();
 
+	if (clevo_leds_get_backlight_type() == CLEVO_KB_BACKLIGHT_TYPE_1_ZONE_RGB ||
+	    clevo_leds_get_backlight_type() == CLEVO_KB_BACKLIGHT_TYPE_PER_KEY_RGB)
+		tuxedo_kbd_effects_init(dev, &clevo_leds_effects_ops_1_zone);
+	else if (clevo_leds_get_backlight_type() == CLEVO_KB_BACKLIGHT_TYPE_3_ZONE_RGB)
+		tuxedo_kbd_effects_init(dev, &clevo_leds_effects_ops_3_zone);
+	clevo_action_end(CLEVO_ACTION_PROBE);
+
+	complete_all(&clevo_keyboard_init_done);
+	TUXEDO_INFO("Backlight ready after %lld us\n",
+		    ktime_us_delta(ktime_get(), clevo_keyboard_load_time));
+}
+
+static DECLARE_WORK(clevo_keyboard_init_work, clevo_keyboard_init_work_func);
+
+static struct tuxedo_resume_t clevo_keyboard_resume_restore;
+static struct dentry *clevo_keyboard_resume_dentry;
+
+static void clevo_keyboard_restore(void)
+{
+	clevo_action_begin(CLEVO_ACTION_RESUME);
+	clevo_evaluate_method(CLEVO_CMD_SET_EVENTS_ENABLED, 0, NULL);
+	clevo_leds_restore_state_extern(); // Sometimes clevo devices forget their last state after
+					   // suspend, so let the kernel ensure it.
+	clevo_leds_resume(clevo_keyboard_init_pdev);
+	tuxedo_kbd_effects_resume();
+	clevo_action_end(CLEVO_ACTION_RESUME);
+}
+
+static int clevo_keyboard_resume_show(struct seq_file *s, void *unused)
+{
+	tuxedo_resume_stats_show(s, &clevo_keyboard_resume_restore);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(clevo_keyboard_resume);
+
+static int clevo_keyboard_probe(struct platform_device *dev)
+{
+	clevo_keyboard_init_pdev = dev;
+	reinit_completion(&clevo_keyboard_init_done);
+	schedule_work(&clevo_keyboard_init_work);
+
+	clevo_method_interface_init(dev);
+	tuxedo_op_account_debugfs_create(&clevo_op_account, tuxedo_debugfs_root);
+	tuxedo_event_queue_start(&clevo_keyboard_events);
+	clevo_keyboard_events_dentry = debugfs_create_file("clevo_events", 0444, tuxedo_debugfs_root,
+							   NULL, &clevo_keyboard_events_fops);
+	tuxedo_resume_init(&clevo_keyboard_resume_restore, clevo_keyboard_restore);
+	clevo_keyboard_resume_dentry = debugfs_create_file("clevo_resume_stats", 0444, tuxedo_debugfs_root,
+							   NULL, &clevo_keyboard_resume_fops);
+
 	return 0;
 }
 
@@ -370,23 +814,34 @@ static void clevo_keyboard_remove_device_interface(struct platform_device *dev)
 
 static int clevo_keyboard_remove(struct platform_device *dev)
 {
+	debugfs_remove(clevo_keyboard_resume_dentry);
+	clevo_keyboard_resume_dentry = NULL;
+	clevo_method_interface_remove(dev);
+	tuxedo_op_account_debugfs_remove(&clevo_op_account);
+	debugfs_remove(clevo_keyboard_events_dentry);
+	clevo_keyboard_events_dentry = NULL;
+	tuxedo_event_queue_stop(&clevo_keyboard_events);
+	cancel_work_sync(&clevo_keyboard_init_work);
+	tuxedo_resume_flush(&clevo_keyboard_resume_restore);
+	tuxedo_kbd_effects_remove(dev);
 	clevo_keyboard_remove_device_interface(dev);
 	clevo_leds_remove(dev);
+	clevo_keyboard_init_pdev = NULL;
 	return 0;
 }
 
 static int clevo_keyboard_suspend(struct platform_device *dev, pm_message_t state)
 {
+	flush_work(&clevo_keyboard_init_work);
+	tuxedo_resume_flush(&clevo_keyboard_resume_restore);
+	tuxedo_kbd_effects_suspend();
 	clevo_leds_suspend(dev);
 	return 0;
 }
 
 static int clevo_keyboard_resume(struct platform_device *dev)
 {
-	clevo_evaluate_method(CLEVO_CMD_SET_EVENTS_ENABLED, 0, NULL);
-	clevo_leds_restore_state_extern(); // Sometimes clevo devices forget their last state after
-					   // suspend, so let the kernel ensure it.
-	clevo_leds_resume(dev);
+	tuxedo_resume_run(&clevo_keyboard_resume_restore);
 	return 0;
 }
 
@@ -416,11 +871,11 @@ int clevo_keyboard_add_interface(struct clevo_interface_t *new_interface)
 		clevo_interfaces.wmi->event_callb = clevo_keyboard_event_callb;
 
 		// Only use wmi if there is no other current interface
-		if (ZERO_OR_NULL_PTR(active_clevo_interface)) {
+		if (ZERO_OR_NULL_PTR(clevo_active_interface_locked())) {
 			pr_debug("enable wmi events\n");
 			clevo_interfaces.wmi->method_call(CLEVO_CMD_SET_EVENTS_ENABLED, 0, NULL);
 
-			active_clevo_interface = clevo_interfaces.wmi;
+			rcu_assign_pointer(active_clevo_interface, clevo_interfaces.wmi);
 		}
 	} else if (strcmp(new_interface->string_id, CLEVO_INTERFACE_ACPI_STRID) == 0) {
 		clevo_interfaces.acpi = new_interface;
@@ -428,7 +883,7 @@ int clevo_keyboard_add_interface(struct clevo_interface_t *new_interface)
 
 		pr_debug("enable acpi events (takes priority)\n");
 		clevo_interfaces.acpi->method_call(CLEVO_CMD_SET_EVENTS_ENABLED, 0, NULL);
-		active_clevo_interface = clevo_interfaces.acpi;
+		rcu_assign_pointer(active_clevo_interface, clevo_interfaces.acpi);
 	} else {
 		// Not recognized interface
 		pr_err("unrecognized interface\n");
@@ -438,8 +893,13 @@ int clevo_keyboard_add_interface(struct clevo_interface_t *new_interface)
 
 	mutex_unlock(&clevo_keyboard_interface_modification_lock);
 
-	if (active_clevo_interface != NULL)
-		tuxedo_keyboard_init_driver(&clevo_keyboard_driver);
+	if (rcu_access_pointer(active_clevo_interface) != NULL) {
+		if (!clevo_keyboard_init_pdev)
+			clevo_keyboard_load_time = ktime_get();
+		if (!IS_ERR_OR_NULL(tuxedo_keyboard_init_driver(&clevo_keyboard_driver)))
+			TUXEDO_INFO("Input ready after %lld us\n",
+				    ktime_us_delta(ktime_get(), clevo_keyboard_load_time));
+	}
 
 	return 0;
 }
@@ -447,6 +907,8 @@ EXPORT_SYMBOL(clevo_keyboard_add_interface);
 
 int clevo_keyboard_remove_interface(struct clevo_interface_t *interface)
 {
+	struct clevo_interface_t *remaining;
+
 	mutex_lock(&clevo_keyboard_interface_modification_lock);
 
 	if (strcmp(interface->string_id, CLEVO_INTERFACE_WMI_STRID) == 0) {
@@ -458,11 +920,22 @@ int clevo_keyboard_remove_interface(struct clevo_interface_t *interface)
 		return -EINVAL;
 	}
 
-	if (active_clevo_interface == interface) {
-		tuxedo_keyboard_remove_driver(&clevo_keyboard_driver);
-		active_clevo_interface = NULL;
+	if (clevo_active_interface_locked() == interface) {
+		remaining = clevo_interfaces.acpi ? clevo_interfaces.acpi : clevo_interfaces.wmi;
+		if (remaining) {
+			// Hand over to the interface still registered
+			pr_debug("switching to %s\n", remaining->string_id);
+			remaining->method_call(CLEVO_CMD_SET_EVENTS_ENABLED, 0, NULL);
+			rcu_assign_pointer(active_clevo_interface, remaining);
+		} else {
+			tuxedo_keyboard_remove_driver(&clevo_keyboard_driver);
+			RCU_INIT_POINTER(active_clevo_interface, NULL);
+		}
 	}
 
+	// Calls still running on the removed interface have to finish before it
+	// goes away, also if failover made another one active in the meantime
+	synchronize_srcu(&clevo_interface_srcu);
 
 	mutex_unlock(&clevo_keyboard_interface_modification_lock);
 
@@ -50,6 +50,10 @@ void clevo_leds_set_color_extern(u32 color);
 
 #include <linux/led-class-multicolor.h>
 #include <linux/delay.h>
+#include "tuxedo_kbd_effects.h"
+#include "tuxedo_led_commit.h"
+#include "tuxedo_kbd_frame.h"
+#include "tuxedo_pack.h"
 
 #define CLEVO_KBD_BRIGHTNESS_MAX			0xff
 #define CLEVO_KBD_BRIGHTNESS_DEFAULT			0x00
@@ -68,6 +72,16 @@ void clevo_leds_set_color_extern(u32 color);
 static enum clevo_kb_backlight_types clevo_kb_backlight_type = CLEVO_KB_BACKLIGHT_TYPE_NONE;
 static bool leds_initialized = false;
 
+/**
+ * Keyboards driven as a single RGB zone. Per-key keyboards get the firmware
+ * whole-keyboard (zone 0) commands for the LED class interface.
+ */
+static bool clevo_leds_single_zone_rgb(void)
+{
+	return clevo_kb_backlight_type == CLEVO_KB_BACKLIGHT_TYPE_1_ZONE_RGB ||
+	       clevo_kb_backlight_type == CLEVO_KB_BACKLIGHT_TYPE_PER_KEY_RGB;
+}
+
 /**
  * Color scaling quirk list
  */
@@ -95,7 +109,8 @@ static int clevo_evaluate_set_rgb_brightness(u8 brightness)
 
 static int clevo_evaluate_set_rgb_color(u32 zone, u32 color)
 {
-	u32 cset = ((color & 0x0000FF) << 16) | ((color & 0xFF0000) >> 8) | ((color & 0x00FF00) >> 8);
+	// Firmware expects blue, red, green
+	u32 cset = tuxedo_rgb_pack(tuxedo_rgb_blue(color), tuxedo_rgb_red(color), tuxedo_rgb_green(color));
 	u32 clevo_submethod_arg = zone | cset;
 
 	pr_debug("Set Color 0x%08x for region 0x%08x\n", color, zone);
@@ -103,8 +118,81 @@ static int clevo_evaluate_set_rgb_color(u32 zone, u32 color)
 	return clevo_evaluate_method(CLEVO_CMD_SET_KB_RGB_LEDS, clevo_submethod_arg, NULL);
 }
 
+/**
+ * Last state applied to the RGB firmware interface. Brightness is global for
+ * all zones, so applying one zone must not resend it, and zones whose color
+ * did not change are not written again. Invalidated whenever the firmware
+ * might have changed state on its own (suspend, brightness hotkey).
+ * Protected by the method session, so check and write are one transaction.
+ */
+#define CLEVO_KBD_ZONES		3
+
+static struct clevo_leds_shadow_t {
+	bool brightness_valid;
+	u8 brightness;
+	bool color_valid[CLEVO_KBD_ZONES];
+	u32 color[CLEVO_KBD_ZONES];
+	// Statistics
+	u64 writes;
+	u64 skipped;
+} clevo_leds_shadow;
+
+static const u32 clevo_leds_zone_channels[CLEVO_KBD_ZONES] = {
+	CLEVO_CMD_SET_KB_LEDS_SUB_RGB_ZONE_0,
+	CLEVO_CMD_SET_KB_LEDS_SUB_RGB_ZONE_1,
+	CLEVO_CMD_SET_KB_LEDS_SUB_RGB_ZONE_2
+};
+
+static void clevo_leds_shadow_invalidate(void)
+{
+	int i;
+
+	clevo_method_session_begin();
+	clevo_leds_shadow.brightness_valid = false;
+	for (i = 0; i < CLEVO_KBD_ZONES; ++i)
+		clevo_leds_shadow.color_valid[i] = false;
+	clevo_method_session_end();
+}
+
+static int clevo_leds_shadow_set_rgb_brightness(u8 brightness)
+{
+	int ret = 0;
+
+	clevo_method_session_begin();
+	if (clevo_leds_shadow.brightness_valid && clevo_leds_shadow.brightness == brightness) {
+		clevo_leds_shadow.skipped++;
+		goto out;
+	}
+	clevo_leds_shadow.writes++;
+	ret = clevo_evaluate_set_rgb_brightness(brightness);
+	clevo_leds_shadow.brightness_valid = !ret;
+	clevo_leds_shadow.brightness = brightness;
+out:
+	clevo_method_session_end();
+	return ret;
+}
+
+static int clevo_leds_shadow_set_rgb_color(int zone, u32 color)
+{
+	int ret = 0;
+
+	clevo_method_session_begin();
+	if (clevo_leds_shadow.color_valid[zone] && clevo_leds_shadow.color[zone] == color) {
+		clevo_leds_shadow.skipped++;
+		goto out;
+	}
+	clevo_leds_shadow.writes++;
+	ret = clevo_evaluate_set_rgb_color(clevo_leds_zone_channels[zone], color);
+	clevo_leds_shadow.color_valid[zone] = !ret;
+	clevo_leds_shadow.color[zone] = color;
+out:
+	clevo_method_session_end();
+	return ret;
+}
+
 static int clevo_evaluate_set_keyboard_status(u8 state)
 {
+	int ret;
 	u32 cmd = 0xE0000000;
 	TUXEDO_INFO("Set keyboard enabled to: %d\n", state);
 
@@ -114,16 +202,25 @@ static int clevo_evaluate_set_keyboard_status(u8 state)
 		cmd |= 0x07F001;
 	}
 
-	return clevo_evaluate_method(CLEVO_CMD_SET_KB_RGB_LEDS, cmd, NULL);
+	ret = clevo_evaluate_method(CLEVO_CMD_SET_KB_RGB_LEDS, cmd, NULL);
+	// Firmware restores colors and brightness on its own
+	clevo_leds_shadow_invalidate();
+
+	return ret;
 }
 
-static void clevo_leds_set_brightness(struct led_classdev *led_cdev __always_unused, enum led_brightness brightness) {
-	int ret = clevo_evaluate_set_white_brightness(brightness);
+static int clevo_leds_apply_brightness(struct led_classdev *led_cdev, enum led_brightness brightness) {
+	int ret;
+
+	clevo_action_begin(CLEVO_ACTION_SET_BRIGHTNESS);
+	ret = clevo_evaluate_set_white_brightness(brightness);
+	clevo_action_end(CLEVO_ACTION_SET_BRIGHTNESS);
 	if (ret) {
-		pr_debug("clevo_leds_set_brightness(): clevo_evaluate_set_white_brightness() failed\n");
-		return;
+		pr_debug("clevo_leds_apply_brightness(): clevo_evaluate_set_white_brightness() failed\n");
+		return ret;
 	}
 	led_cdev->brightness = brightness;
+	return 0;
 }
 
 /*static void clevo_leds_set_brightness_mc(struct led_classdev *led_cdev, enum led_brightness brightness) {
@@ -159,24 +256,24 @@ static void clevo_leds_set_brightness(struct led_classdev *led_cdev __always_unu
 // -> update all clevo_mcled_cdevs brightness levels to refect that the firmware method sets the
 //    the whole keyboard brightness and not just one zone
 // This is a temporary fix until KDE handles multiple keyboard backlights correctly
+static struct led_classdev clevo_led_cdev; // forward declaration
 static struct led_classdev_mc clevo_mcled_cdevs[3]; // forward declaration
-static void clevo_leds_set_brightness_mc(struct led_classdev *led_cdev, enum led_brightness brightness) {
+static int clevo_leds_apply_brightness_mc(struct led_classdev *led_cdev, enum led_brightness brightness) {
 	int ret;
-	u32 zone, color;
+	u32 color;
 	u8 red, green, blue;
 	struct led_classdev_mc *mcled_cdev = lcdev_to_mccdev(led_cdev);
 
-	ret = clevo_evaluate_set_rgb_brightness(brightness);
+	clevo_action_begin(CLEVO_ACTION_SET_COLOR);
+	ret = clevo_leds_shadow_set_rgb_brightness(brightness);
 	if (ret) {
-		pr_debug("clevo_leds_set_brightness_mc(): clevo_evaluate_set_rgb_brightness() failed\n");
-		return;
+		pr_debug("clevo_leds_apply_brightness_mc(): clevo_leds_shadow_set_rgb_brightness() failed\n");
+		goto out;
 	}
 	clevo_mcled_cdevs[0].led_cdev.brightness = brightness;
 	clevo_mcled_cdevs[1].led_cdev.brightness = brightness;
 	clevo_mcled_cdevs[2].led_cdev.brightness = brightness;
 
-	zone = mcled_cdev->subled_info[0].channel;
-
 	red = mcled_cdev->subled_info[0].intensity;
 	green = mcled_cdev->subled_info[1].intensity;
 	blue = mcled_cdev->subled_info[2].intensity;
@@ -187,16 +284,172 @@ static void clevo_leds_set_brightness_mc(struct led_classdev *led_cdev, enum led
 		(green << 8) +
 		blue;
 
-	ret = clevo_evaluate_set_rgb_color(zone, color);
+	ret = clevo_leds_shadow_set_rgb_color(mcled_cdev - clevo_mcled_cdevs, color);
 	if (ret) {
-		pr_debug("clevo_leds_set_brightness_mc(): clevo_evaluate_set_rgb_color() failed\n");
+		pr_debug("clevo_leds_apply_brightness_mc(): clevo_leds_shadow_set_rgb_color() failed\n");
 	}
+
+out:
+	clevo_action_end(CLEVO_ACTION_SET_COLOR);
+	return ret;
+}
+
+// WMI/ACPI calls sleep, brightness_set only records the state for the commit work
+static struct tuxedo_led_commit_t clevo_led_commit;
+static struct tuxedo_led_commit_t clevo_mcled_commits[3];
+static struct dentry *clevo_leds_commit_stats_dentry;
+
+static struct tuxedo_led_commit_t *clevo_leds_mc_commit(struct led_classdev *led_cdev)
+{
+	return &clevo_mcled_commits[lcdev_to_mccdev(led_cdev) - clevo_mcled_cdevs];
+}
+
+static void clevo_leds_set_brightness(struct led_classdev *led_cdev __always_unused, enum led_brightness brightness) {
+	tuxedo_led_commit_request(&clevo_led_commit, brightness);
+}
+
+static int clevo_leds_set_brightness_blocking(struct led_classdev *led_cdev __always_unused, enum led_brightness brightness) {
+	return tuxedo_led_commit_sync(&clevo_led_commit, brightness);
+}
+
+static void clevo_leds_set_brightness_mc(struct led_classdev *led_cdev, enum led_brightness brightness) {
+	tuxedo_led_commit_request(clevo_leds_mc_commit(led_cdev), brightness);
+}
+
+static int clevo_leds_set_brightness_mc_blocking(struct led_classdev *led_cdev, enum led_brightness brightness) {
+	return tuxedo_led_commit_sync(clevo_leds_mc_commit(led_cdev), brightness);
+}
+
+static void clevo_leds_commit_init(void)
+{
+	int i;
+
+	tuxedo_led_commit_init(&clevo_led_commit, &clevo_led_cdev, clevo_leds_apply_brightness);
+	for (i = 0; i < ARRAY_SIZE(clevo_mcled_commits); ++i)
+		tuxedo_led_commit_init(&clevo_mcled_commits[i], &clevo_mcled_cdevs[i].led_cdev,
+				       clevo_leds_apply_brightness_mc);
+}
+
+static void clevo_leds_commit_cancel(void)
+{
+	int i;
+
+	tuxedo_led_commit_cancel(&clevo_led_commit);
+	for (i = 0; i < ARRAY_SIZE(clevo_mcled_commits); ++i)
+		tuxedo_led_commit_cancel(&clevo_mcled_commits[i]);
+}
+
+static int clevo_leds_commit_stats_show(struct seq_file *s, void *unused)
+{
+	if (clevo_kb_backlight_type == CLEVO_KB_BACKLIGHT_TYPE_FIXED_COLOR) {
+		tuxedo_led_commit_stats_show(s, "white", &clevo_led_commit);
+	}
+	else if (clevo_leds_single_zone_rgb()) {
+		tuxedo_led_commit_stats_show(s, "rgb zone 0", &clevo_mcled_commits[0]);
+	}
+	else if (clevo_kb_backlight_type == CLEVO_KB_BACKLIGHT_TYPE_3_ZONE_RGB) {
+		tuxedo_led_commit_stats_show(s, "rgb zone 0", &clevo_mcled_commits[0]);
+		tuxedo_led_commit_stats_show(s, "rgb zone 1", &clevo_mcled_commits[1]);
+		tuxedo_led_commit_stats_show(s, "rgb zone 2", &clevo_mcled_commits[2]);
+	}
+	if (clevo_kb_backlight_type != CLEVO_KB_BACKLIGHT_TYPE_FIXED_COLOR) {
+		clevo_method_session_begin();
+		seq_printf(s, "firmware: writes %llu skipped %llu\n",
+			   clevo_leds_shadow.writes, clevo_leds_shadow.skipped);
+		clevo_method_session_end();
+	}
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(clevo_leds_commit_stats);
+
+// Effect frames carry the color only, brightness stays with the firmware
+static int clevo_leds_effects_write_zone(int zone, u32 color)
+{
+	u8 red = (color >> 16) & 0xff;
+	u8 green = (color >> 8) & 0xff;
+	u8 blue = color & 0xff;
+
+	color_scaling(&clevo_kb_backlight_type, &red, &green, &blue);
+
+	return clevo_leds_shadow_set_rgb_color(zone, (red << 16) + (green << 8) + blue);
+}
+
+static const struct tuxedo_kbd_effects_ops_t clevo_leds_effects_ops_1_zone = {
+	.zones = 1,
+	.frame_begin = clevo_method_session_begin,
+	.frame_end = clevo_method_session_end,
+	.write_zone = clevo_leds_effects_write_zone,
+	.restore = clevo_leds_restore_state_extern
+};
+
+static const struct tuxedo_kbd_effects_ops_t clevo_leds_effects_ops_3_zone = {
+	.zones = 3,
+	.frame_begin = clevo_method_session_begin,
+	.frame_end = clevo_method_session_end,
+	.write_zone = clevo_leds_effects_write_zone,
+	.restore = clevo_leds_restore_state_extern
+};
+
+/**
+ * Frame interface, one "key" per addressable unit of the firmware interface.
+ * There is no per-key color command in the WMI/ACPI interface, per-key
+ * keyboards take frames of one (whole keyboard) color.
+ */
+static struct tuxedo_kbd_frame_t clevo_kbd_frame;
+static struct tuxedo_kbd_frame_ops_t clevo_kbd_frame_ops;
+static bool clevo_kbd_frame_loaded;
+static struct dentry *clevo_kbd_frame_stats_dentry;
+
+static int clevo_kbd_frame_stats_show(struct seq_file *s, void *unused)
+{
+	tuxedo_kbd_frame_stats_show(s, &clevo_kbd_frame);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(clevo_kbd_frame_stats);
+
+static void clevo_kbd_frame_batch_begin(void *priv)
+{
+	clevo_method_session_begin();
+}
+
+static void clevo_kbd_frame_batch_end(void *priv)
+{
+	clevo_method_session_end();
+}
+
+static int clevo_kbd_frame_write_key(void *priv, unsigned int key, u32 color)
+{
+	return clevo_leds_effects_write_zone(key, color);
+}
+
+static void clevo_kbd_frame_init(void)
+{
+	clevo_kbd_frame_ops.keys = clevo_kb_backlight_type == CLEVO_KB_BACKLIGHT_TYPE_3_ZONE_RGB ? 3 : 1;
+	clevo_kbd_frame_ops.batch_begin = clevo_kbd_frame_batch_begin;
+	clevo_kbd_frame_ops.batch_end = clevo_kbd_frame_batch_end;
+	clevo_kbd_frame_ops.write_key = clevo_kbd_frame_write_key;
+	tuxedo_kbd_frame_init(&clevo_kbd_frame, &clevo_kbd_frame_ops, NULL);
+	clevo_kbd_frame_loaded = tuxedo_kbd_frame_dev_register(&clevo_kbd_frame) == 0;
+	if (clevo_kbd_frame_loaded)
+		clevo_kbd_frame_stats_dentry = debugfs_create_file("clevo_kbd_frame_stats", 0444, tuxedo_debugfs_root,
+								   NULL, &clevo_kbd_frame_stats_fops);
+}
+
+static void clevo_kbd_frame_remove(void)
+{
+	if (clevo_kbd_frame_loaded) {
+		debugfs_remove(clevo_kbd_frame_stats_dentry);
+		clevo_kbd_frame_stats_dentry = NULL;
+		tuxedo_kbd_frame_dev_unregister();
+	}
+	clevo_kbd_frame_loaded = false;
 }
 
 static struct led_classdev clevo_led_cdev = {
 	.name = "white:" LED_FUNCTION_KBD_BACKLIGHT,
 	.max_brightness = CLEVO_KBD_BRIGHTNESS_WHITE_MAX,
 	.brightness_set = &clevo_leds_set_brightness,
+	.brightness_set_blocking = &clevo_leds_set_brightness_blocking,
 	.brightness = CLEVO_KBD_BRIGHTNESS_WHITE_DEFAULT,
 	.flags = LED_BRIGHT_HW_CHANGED
 };
@@ -269,6 +522,7 @@ static struct led_classdev_mc clevo_mcled_cdevs[3] = {
 		.led_cdev.name = "rgb:" LED_FUNCTION_KBD_BACKLIGHT,
 		.led_cdev.max_brightness = CLEVO_KBD_BRIGHTNESS_MAX,
 		.led_cdev.brightness_set = &clevo_leds_set_brightness_mc,
+		.led_cdev.brightness_set_blocking = &clevo_leds_set_brightness_mc_blocking,
 		.led_cdev.brightness = CLEVO_KBD_BRIGHTNESS_DEFAULT,
 		.num_colors = 3,
 		.subled_info = clevo_mcled_cdevs_subleds[0]
@@ -277,6 +531,7 @@ static struct led_classdev_mc clevo_mcled_cdevs[3] = {
 		.led_cdev.name = "rgb:" LED_FUNCTION_KBD_BACKLIGHT,
 		.led_cdev.max_brightness = CLEVO_KBD_BRIGHTNESS_MAX,
 		.led_cdev.brightness_set = &clevo_leds_set_brightness_mc,
+		.led_cdev.brightness_set_blocking = &clevo_leds_set_brightness_mc_blocking,
 		.led_cdev.brightness = CLEVO_KBD_BRIGHTNESS_DEFAULT,
 		.num_colors = 3,
 		.subled_info = clevo_mcled_cdevs_subleds[1]
@@ -285,6 +540,7 @@ static struct led_classdev_mc clevo_mcled_cdevs[3] = {
 		.led_cdev.name = "rgb:" LED_FUNCTION_KBD_BACKLIGHT,
 		.led_cdev.max_brightness = CLEVO_KBD_BRIGHTNESS_MAX,
 		.led_cdev.brightness_set = &clevo_leds_set_brightness_mc,
+		.led_cdev.brightness_set_blocking = &clevo_leds_set_brightness_mc_blocking,
 		.led_cdev.brightness = CLEVO_KBD_BRIGHTNESS_DEFAULT,
 		.num_colors = 3,
 		.subled_info = clevo_mcled_cdevs_subleds[2]
@@ -296,7 +552,9 @@ int clevo_leds_init(struct platform_device *dev)
 	int ret, i;
 	int status;
 	union acpi_object *result;
-	u32 result_fallback;
+	u32 result_fallback = 0;
+
+	clevo_leds_commit_init();
 
 	for (i = 0; i < 3; ++i) {
 		status = clevo_evaluate_method2(CLEVO_CMD_GET_SPECS, 0, &result);
@@ -373,7 +631,7 @@ int clevo_leds_init(struct platform_device *dev)
 			return ret;
 		}
 	}
-	else if (clevo_kb_backlight_type == CLEVO_KB_BACKLIGHT_TYPE_1_ZONE_RGB) {
+	else if (clevo_leds_single_zone_rgb()) {
 		clevo_evaluate_set_keyboard_status(1);
 		pr_debug("Registering single zone rgb leds interface\n");
 		ret = devm_led_classdev_multicolor_register(&dev->dev, &clevo_mcled_cdevs[0]);
@@ -405,6 +663,12 @@ int clevo_leds_init(struct platform_device *dev)
 		}
 	}
 
+	clevo_leds_commit_stats_dentry = debugfs_create_file("clevo_leds_commit_stats", 0444, tuxedo_debugfs_root,
+							     NULL, &clevo_leds_commit_stats_fops);
+
+	if (clevo_kb_backlight_type == CLEVO_KB_BACKLIGHT_TYPE_3_ZONE_RGB || clevo_leds_single_zone_rgb())
+		clevo_kbd_frame_init();
+
 	leds_initialized = true;
 	return 0;
 }
@@ -415,6 +679,7 @@ int clevo_leds_suspend(struct platform_device *dev)
 	switch (clevo_kb_backlight_type) {
 	case CLEVO_KB_BACKLIGHT_TYPE_1_ZONE_RGB:
 	case CLEVO_KB_BACKLIGHT_TYPE_3_ZONE_RGB:
+	case CLEVO_KB_BACKLIGHT_TYPE_PER_KEY_RGB:
 		clevo_evaluate_set_keyboard_status(0);
 		break;
 	default:
@@ -429,21 +694,29 @@ int clevo_leds_resume(struct platform_device *dev)
 	switch (clevo_kb_backlight_type) {
 	case CLEVO_KB_BACKLIGHT_TYPE_1_ZONE_RGB:
 	case CLEVO_KB_BACKLIGHT_TYPE_3_ZONE_RGB:
+	case CLEVO_KB_BACKLIGHT_TYPE_PER_KEY_RGB:
 		clevo_evaluate_set_keyboard_status(1);
 		break;
 	default:
 		break;
 	}
+	if (clevo_kbd_frame_loaded)
+		tuxedo_kbd_frame_invalidate(&clevo_kbd_frame);
 	return 0;
 }
 EXPORT_SYMBOL(clevo_leds_resume);
 
 int clevo_leds_remove(struct platform_device *dev) {
 	if (leds_initialized) {
+		debugfs_remove(clevo_leds_commit_stats_dentry);
+		clevo_leds_commit_stats_dentry = NULL;
+		clevo_kbd_frame_remove();
+		clevo_leds_commit_cancel();
+
 		if (clevo_kb_backlight_type == CLEVO_KB_BACKLIGHT_TYPE_FIXED_COLOR) {
 			led_classdev_unregister(&clevo_led_cdev);
 		}
-		else if (clevo_kb_backlight_type == CLEVO_KB_BACKLIGHT_TYPE_1_ZONE_RGB) {
+		else if (clevo_leds_single_zone_rgb()) {
 			devm_led_classdev_multicolor_unregister(&dev->dev, &clevo_mcled_cdevs[0]);
 		}
 		else if (clevo_kb_backlight_type == CLEVO_KB_BACKLIGHT_TYPE_3_ZONE_RGB) {
@@ -468,29 +741,35 @@ EXPORT_SYMBOL(clevo_leds_get_backlight_type);
 // Reimplement brightness_set instead without writing back brightness value like in uniwill_leds.h.
 void clevo_leds_restore_state_extern(void) {
 	if (clevo_kb_backlight_type == CLEVO_KB_BACKLIGHT_TYPE_FIXED_COLOR) {
-		clevo_led_cdev.brightness_set(&clevo_led_cdev, clevo_led_cdev.brightness);
+		clevo_led_cdev.brightness_set_blocking(&clevo_led_cdev, clevo_led_cdev.brightness);
 	}
-	else if (clevo_kb_backlight_type == CLEVO_KB_BACKLIGHT_TYPE_1_ZONE_RGB) {
-		clevo_mcled_cdevs[0].led_cdev.brightness_set(&clevo_mcled_cdevs[0].led_cdev, clevo_mcled_cdevs[0].led_cdev.brightness);
+	else if (clevo_leds_single_zone_rgb()) {
+		clevo_mcled_cdevs[0].led_cdev.brightness_set_blocking(&clevo_mcled_cdevs[0].led_cdev, clevo_mcled_cdevs[0].led_cdev.brightness);
 	}
 	else if (clevo_kb_backlight_type == CLEVO_KB_BACKLIGHT_TYPE_3_ZONE_RGB) {
-		clevo_mcled_cdevs[0].led_cdev.brightness_set(&clevo_mcled_cdevs[0].led_cdev, clevo_mcled_cdevs[0].led_cdev.brightness);
-		clevo_mcled_cdevs[1].led_cdev.brightness_set(&clevo_mcled_cdevs[1].led_cdev, clevo_mcled_cdevs[1].led_cdev.brightness);
-		clevo_mcled_cdevs[2].led_cdev.brightness_set(&clevo_mcled_cdevs[2].led_cdev, clevo_mcled_cdevs[2].led_cdev.brightness);
+		clevo_mcled_cdevs[0].led_cdev.brightness_set_blocking(&clevo_mcled_cdevs[0].led_cdev, clevo_mcled_cdevs[0].led_cdev.brightness);
+		clevo_mcled_cdevs[1].led_cdev.brightness_set_blocking(&clevo_mcled_cdevs[1].led_cdev, clevo_mcled_cdevs[1].led_cdev.brightness);
+		clevo_mcled_cdevs[2].led_cdev.brightness_set_blocking(&clevo_mcled_cdevs[2].led_cdev, clevo_mcled_cdevs[2].led_cdev.brightness);
 	}
 }
 EXPORT_SYMBOL(clevo_leds_restore_state_extern);
 
 void clevo_leds_notify_brightness_change_extern(void) {
 	int status;
-	u32 result;
+	u32 result = 0;
 
 	if (clevo_kb_backlight_type == CLEVO_KB_BACKLIGHT_TYPE_FIXED_COLOR) {
 		status = clevo_evaluate_method(CLEVO_CMD_GET_KB_WHITE_LEDS, 0, &result);
+		if (status)
+			return;
 		pr_debug("Firmware set brightness: %u\n", result);
 		clevo_led_cdev.brightness = result;
 		led_classdev_notify_brightness_hw_changed(&clevo_led_cdev, result);
 	}
+	else {
+		// Brightness cycled by the firmware, next write has to go through
+		clevo_leds_shadow_invalidate();
+	}
 }
 EXPORT_SYMBOL(clevo_leds_notify_brightness_change_extern);
 
@@ -498,15 +777,15 @@ EXPORT_SYMBOL(clevo_leds_notify_brightness_change_extern);
 // led_classdev_notify_brightness_hw_changed implementation when used outside of init.
 void clevo_leds_set_brightness_extern(enum led_brightness brightness) {
 	if (clevo_kb_backlight_type == CLEVO_KB_BACKLIGHT_TYPE_FIXED_COLOR) {
-		clevo_led_cdev.brightness_set(&clevo_led_cdev, brightness);
+		clevo_led_cdev.brightness_set_blocking(&clevo_led_cdev, brightness);
 	}
-	else if (clevo_kb_backlight_type == CLEVO_KB_BACKLIGHT_TYPE_1_ZONE_RGB) {
-		clevo_mcled_cdevs[0].led_cdev.brightness_set(&clevo_mcled_cdevs[0].led_cdev, brightness);
+	else if (clevo_leds_single_zone_rgb()) {
+		clevo_mcled_cdevs[0].led_cdev.brightness_set_blocking(&clevo_mcled_cdevs[0].led_cdev, brightness);
 	}
 	else if (clevo_kb_backlight_type == CLEVO_KB_BACKLIGHT_TYPE_3_ZONE_RGB) {
-		clevo_mcled_cdevs[0].led_cdev.brightness_set(&clevo_mcled_cdevs[0].led_cdev, brightness);
-		clevo_mcled_cdevs[1].led_cdev.brightness_set(&clevo_mcled_cdevs[1].led_cdev, brightness);
-		clevo_mcled_cdevs[2].led_cdev.brightness_set(&clevo_mcled_cdevs[2].led_cdev, brightness);
+		clevo_mcled_cdevs[0].led_cdev.brightness_set_blocking(&clevo_mcled_cdevs[0].led_cdev, brightness);
+		clevo_mcled_cdevs[1].led_cdev.brightness_set_blocking(&clevo_mcled_cdevs[1].led_cdev, brightness);
+		clevo_mcled_cdevs[2].led_cdev.brightness_set_blocking(&clevo_mcled_cdevs[2].led_cdev, brightness);
 	}
 }
 EXPORT_SYMBOL(clevo_leds_set_brightness_extern);
@@ -514,25 +793,25 @@ EXPORT_SYMBOL(clevo_leds_set_brightness_extern);
 // TODO Not used externaly, but only on init. Should not be exposed because it would require a correct
 // led_classdev_notify_brightness_hw_changed equivalent for color implementation when used outside of init.
 void clevo_leds_set_color_extern(u32 color) {
-	if (clevo_kb_backlight_type == CLEVO_KB_BACKLIGHT_TYPE_1_ZONE_RGB) {
-		clevo_mcled_cdevs[0].subled_info[0].intensity = (color >> 16) & 0xff;
-		clevo_mcled_cdevs[0].subled_info[1].intensity = (color >> 8) & 0xff;
-		clevo_mcled_cdevs[0].subled_info[2].intensity = color & 0xff;
-		clevo_mcled_cdevs[0].led_cdev.brightness_set(&clevo_mcled_cdevs[0].led_cdev, clevo_mcled_cdevs[0].led_cdev.brightness);
+	if (clevo_leds_single_zone_rgb()) {
+		clevo_mcled_cdevs[0].subled_info[0].intensity = tuxedo_rgb_red(color);
+		clevo_mcled_cdevs[0].subled_info[1].intensity = tuxedo_rgb_green(color);
+		clevo_mcled_cdevs[0].subled_info[2].intensity = tuxedo_rgb_blue(color);
+		clevo_mcled_cdevs[0].led_cdev.brightness_set_blocking(&clevo_mcled_cdevs[0].led_cdev, clevo_mcled_cdevs[0].led_cdev.brightness);
 	}
 	else if (clevo_kb_backlight_type == CLEVO_KB_BACKLIGHT_TYPE_3_ZONE_RGB) {
-		clevo_mcled_cdevs[0].subled_info[0].intensity = (color >> 16) & 0xff;
-		clevo_mcled_cdevs[0].subled_info[1].intensity = (color >> 8) & 0xff;
-		clevo_mcled_cdevs[0].subled_info[2].intensity = color & 0xff;
-		clevo_mcled_cdevs[0].led_cdev.brightness_set(&clevo_mcled_cdevs[0].led_cdev, clevo_mcled_cdevs[0].led_cdev.brightness);
-		clevo_mcled_cdevs[1].subled_info[0].intensity = (color >> 16) & 0xff;
-		clevo_mcled_cdevs[1].subled_info[1].intensity = (color >> 8) & 0xff;
-		clevo_mcled_cdevs[1].subled_info[2].intensity = color & 0xff;
-		clevo_mcled_cdevs[1].led_cdev.brightness_set(&clevo_mcled_cdevs[1].led_cdev, clevo_mcled_cdevs[1].led_cdev.brightness);
-		clevo_mcled_cdevs[2].subled_info[0].intensity = (color >> 16) & 0xff;
-		clevo_mcled_cdevs[2].subled_info[1].intensity = (color >> 8) & 0xff;
-		clevo_mcled_cdevs[2].subled_info[2].intensity = color & 0xff;
-		clevo_mcled_cdevs[2].led_cdev.brightness_set(&clevo_mcled_cdevs[2].led_cdev, clevo_mcled_cdevs[2].led_cdev.brightness);
+		clevo_mcled_cdevs[0].subled_info[0].intensity = tuxedo_rgb_red(color);
+		clevo_mcled_cdevs[0].subled_info[1].intensity = tuxedo_rgb_green(color);
+		clevo_mcled_cdevs[0].subled_info[2].intensity = tuxedo_rgb_blue(color);
+		clevo_mcled_cdevs[0].led_cdev.brightness_set_blocking(&clevo_mcled_cdevs[0].led_cdev, clevo_mcled_cdevs[0].led_cdev.brightness);
+		clevo_mcled_cdevs[1].subled_info[0].intensity = tuxedo_rgb_red(color);
+		clevo_mcled_cdevs[1].subled_info[1].intensity = tuxedo_rgb_green(color);
+		clevo_mcled_cdevs[1].subled_info[2].intensity = tuxedo_rgb_blue(color);
+		clevo_mcled_cdevs[1].led_cdev.brightness_set_blocking(&clevo_mcled_cdevs[1].led_cdev, clevo_mcled_cdevs[1].led_cdev.brightness);
+		clevo_mcled_cdevs[2].subled_info[0].intensity = tuxedo_rgb_red(color);
+		clevo_mcled_cdevs[2].subled_info[1].intensity = tuxedo_rgb_green(color);
+		clevo_mcled_cdevs[2].subled_info[2].intensity = tuxedo_rgb_blue(color);
+		clevo_mcled_cdevs[2].led_cdev.brightness_set_blocking(&clevo_mcled_cdevs[2].led_cdev, clevo_mcled_cdevs[2].led_cdev.brightness);
 	}
 }
 EXPORT_SYMBOL(clevo_leds_set_color_extern);
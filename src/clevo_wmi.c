@@ -44,7 +44,7 @@ static int clevo_wmi_evaluate(u32 wmi_method_id, u32 wmi_arg, union acpi_object
 	acpi_result = (union acpi_object *)acpi_buffer_out.pointer;
 	if (!acpi_result) {
 		pr_err("failed to evaluate WMI method\n");
-		return_status = -1;
+		return_status = -ENODATA;
 	}
 	else {
 		if (!IS_ERR_OR_NULL(result)) {
@@ -0,0 +1,184 @@
+/*!
+ * Copyright (c) 2023 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-keyboard.
+ *
+ * tuxedo-keyboard is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef TUXEDO_EVENT_QUEUE_H
+#define TUXEDO_EVENT_QUEUE_H
+
+#include <linux/types.h>
+#include <linux/kfifo.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/seq_file.h>
+
+/**
+ * Deferred hardware event handling
+ *
+ * Notify handlers only push the raw event code, a work item drains the
+ * queue and runs the vendor handler. Events the vendor marks as coalescable
+ * (same non-zero class) are dropped from a drained batch if a later event of
+ * the same class follows, so a burst results in one refresh. The fifo is
+ * read by the work item only; producers can be several notify contexts and
+ * are serialized by a spinlock.
+ */
+#define TUXEDO_EVENT_QUEUE_SIZE		64 // Power of 2
+#define TUXEDO_EVENT_CODES		256
+
+struct tuxedo_event_t {
+	u32 code;
+	ktime_t time;
+};
+
+struct tuxedo_event_queue_t {
+	DECLARE_KFIFO(fifo, struct tuxedo_event_t, TUXEDO_EVENT_QUEUE_SIZE);
+	spinlock_t producer_lock;
+	bool enabled;
+	struct work_struct work;
+	void (*handle)(u32 code);
+	// Returns the coalescing class of a code, 0 if every event counts
+	u32 (*coalesce_class)(u32 code);
+	// Drained batch, used by the work item only
+	struct tuxedo_event_t batch[TUXEDO_EVENT_QUEUE_SIZE];
+	// Statistics, received and dropped under producer_lock, others by the work item
+	u32 received[TUXEDO_EVENT_CODES];
+	u32 coalesced[TUXEDO_EVENT_CODES];
+	u64 received_other;
+	u64 dropped;
+	u64 handled;
+	u64 latency_sum_ns;
+	u64 latency_max_ns;
+};
+
+static void tuxedo_event_queue_work_func(struct work_struct *work);
+
+#define TUXEDO_EVENT_QUEUE_INIT(name, handle_func, coalesce_class_func) {			\
+	.producer_lock = __SPIN_LOCK_UNLOCKED(name.producer_lock),				\
+	.work = __WORK_INITIALIZER(name.work, tuxedo_event_queue_work_func),			\
+	.handle = handle_func,									\
+	.coalesce_class = coalesce_class_func							\
+}
+
+static bool tuxedo_event_queue_superseded(struct tuxedo_event_queue_t *queue, unsigned int index,
+					  unsigned int count)
+{
+	u32 class = queue->coalesce_class ? queue->coalesce_class(queue->batch[index].code) : 0;
+	unsigned int i;
+
+	if (class == 0)
+		return false;
+	for (i = index + 1; i < count; ++i)
+		if (queue->coalesce_class(queue->batch[i].code) == class)
+			return true;
+	return false;
+}
+
+static void tuxedo_event_queue_work_func(struct work_struct *work)
+{
+	struct tuxedo_event_queue_t *queue = container_of(work, struct tuxedo_event_queue_t, work);
+	unsigned int i, count;
+	u64 latency_ns;
+	u32 code;
+
+	while ((count = kfifo_out(&queue->fifo, queue->batch, TUXEDO_EVENT_QUEUE_SIZE)) > 0) {
+		for (i = 0; i < count; ++i) {
+			code = queue->batch[i].code;
+			if (tuxedo_event_queue_superseded(queue, i, count)) {
+				if (code < TUXEDO_EVENT_CODES)
+					queue->coalesced[code]++;
+				continue;
+			}
+
+			queue->handle(code);
+
+			latency_ns = ktime_to_ns(ktime_sub(ktime_get(), queue->batch[i].time));
+			queue->handled++;
+			queue->latency_sum_ns += latency_ns;
+			if (latency_ns > queue->latency_max_ns)
+				queue->latency_max_ns = latency_ns;
+		}
+	}
+}
+
+/**
+ * Start accepting events, anything queued before is dropped
+ */
+static void tuxedo_event_queue_start(struct tuxedo_event_queue_t *queue)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&queue->producer_lock, flags);
+	INIT_KFIFO(queue->fifo);
+	queue->enabled = true;
+	spin_unlock_irqrestore(&queue->producer_lock, flags);
+}
+
+/**
+ * Stop accepting events and wait for the work item to finish
+ */
+static void tuxedo_event_queue_stop(struct tuxedo_event_queue_t *queue)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&queue->producer_lock, flags);
+	queue->enabled = false;
+	spin_unlock_irqrestore(&queue->producer_lock, flags);
+	cancel_work_sync(&queue->work);
+}
+
+/**
+ * Usable from any context
+ */
+static void tuxedo_event_queue_push(struct tuxedo_event_queue_t *queue, u32 code)
+{
+	struct tuxedo_event_t event = { .code = code, .time = ktime_get() };
+	unsigned long flags;
+	bool queued = false;
+
+	spin_lock_irqsave(&queue->producer_lock, flags);
+	if (queue->enabled) {
+		if (code < TUXEDO_EVENT_CODES)
+			queue->received[code]++;
+		else
+			queue->received_other++;
+		queued = kfifo_put(&queue->fifo, event);
+		if (!queued)
+			queue->dropped++;
+	}
+	spin_unlock_irqrestore(&queue->producer_lock, flags);
+
+	if (queued)
+		schedule_work(&queue->work);
+}
+
+static void tuxedo_event_queue_stats_show(struct seq_file *s, struct tuxedo_event_queue_t *queue)
+{
+	unsigned int code;
+
+	seq_printf(s, "handled %llu dropped %llu other %llu latency_avg_us %llu latency_max_us %llu\n",
+		   queue->handled, queue->dropped, queue->received_other,
+		   queue->handled ? div64_u64(queue->latency_sum_ns, queue->handled * NSEC_PER_USEC) : 0,
+		   div_u64(queue->latency_max_ns, NSEC_PER_USEC));
+	for (code = 0; code < TUXEDO_EVENT_CODES; ++code) {
+		if (queue->received[code])
+			seq_printf(s, "%#04x: received %u coalesced %u\n",
+				   code, queue->received[code], queue->coalesced[code]);
+	}
+}
+
+#endif // TUXEDO_EVENT_QUEUE_H
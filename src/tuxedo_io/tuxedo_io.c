@@ -28,8 +28,16 @@
 #include <linux/delay.h>
 #include <linux/version.h>
 #include <linux/dmi.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+#include <linux/mm.h>
+#include <linux/workqueue.h>
+#include <linux/power_supply.h>
+#include <linux/string.h>
 #include "../clevo_interfaces.h"
 #include "../uniwill_interfaces.h"
+#include "../tuxedo_quirks.h"
 #include "tuxedo_io_ioctl.h"
 
 MODULE_DESCRIPTION("Hardware interface for TUXEDO laptops");
@@ -43,11 +51,43 @@ MODULE_ALIAS("wmi:" UNIWILL_WMI_MGMT_GUID_BA);
 MODULE_ALIAS("wmi:" UNIWILL_WMI_MGMT_GUID_BB);
 MODULE_ALIAS("wmi:" UNIWILL_WMI_MGMT_GUID_BC);
 
-// Initialized in module init, global for ioctl interface
-static u32 id_check_clevo;
-static u32 id_check_uniwill;
+/**
+ * Hardware identification as seen by the ioctl interface
+ *
+ * A snapshot is never modified once published. Identification builds a new
+ * one and swaps the pointer, so read-only queries only need rcu_read_lock()
+ * and don't queue behind mutating operations.
+ */
+struct tuxedo_io_ident_t {
+	// 1 = positive, 0 = negative
+	u32 id_check_clevo;
+	u32 id_check_uniwill;
+	// Complete results are kept until an explicit rescan
+	bool clevo_complete;
+	bool uniwill_complete;
+	u8 uw_model;
+	u32 uw_profs_available;
+	bool uw_has_universal_ec_fan_control;
+	// NULL if no TDP limits are known for the device
+	const struct tuxedo_tdp_limits_t *tdp_limits;
+	struct rcu_head rcu;
+};
+
+static struct tuxedo_io_ident_t tuxedo_io_ident_none;
+static struct tuxedo_io_ident_t __rcu *tuxedo_io_ident = &tuxedo_io_ident_none;
+
+/**
+ * Serializes identification and all mutating operations (writes, fan table
+ * state). Lock order: tuxedo_io_lock -> vendor interface sessions.
+ */
+static DEFINE_MUTEX(tuxedo_io_lock);
 
-static struct uniwill_device_features_t *uw_feats;
+static void tuxedo_io_ident_get(struct tuxedo_io_ident_t *ident)
+{
+	rcu_read_lock();
+	*ident = *rcu_dereference(tuxedo_io_ident);
+	rcu_read_unlock();
+}
 
 /**
  * strstr version of dmi_match
@@ -67,125 +107,86 @@ static u32 clevo_identify(void)
 	return clevo_get_active_interface_id(NULL) == 0 ? 1 : 0;
 }
 
-/*
- * TDP boundary definitions per device
- */
-static int tdp_min_ph4tux[] = { 0x05, 0x05, 0x00 };
-static int tdp_max_ph4tux[] = { 0x26, 0x26, 0x00 };
-
-static int tdp_min_ph4trx[] = { 0x05, 0x05, 0x00 };
-static int tdp_max_ph4trx[] = { 0x32, 0x32, 0x00 };
-
-static int tdp_min_ph4tqx[] = { 0x05, 0x05, 0x00 };
-static int tdp_max_ph4tqx[] = { 0x32, 0x32, 0x00 };
-
-static int tdp_min_ph4axx[] = { 0x05, 0x05, 0x00 };
-static int tdp_max_ph4axx[] = { 0x2d, 0x3c, 0x00 };
-
-static int tdp_min_phxpxx[] = { 0x05, 0x05, 0x05 };
-static int tdp_max_phxpxx[] = { 0x2d, 0x3c, 0x6e };
-
-static int tdp_min_pfxluxg[] = { 0x05, 0x05, 0x05 };
-static int tdp_max_pfxluxg[] = { 0x23, 0x23, 0x28 };
-
-static int tdp_min_gmxngxx[] = { 0x05, 0x05, 0x05 };
-static int tdp_max_gmxngxx[] = { 0x50, 0x50, 0x5f };
-
-static int tdp_min_gmxmgxx[] = { 0x05, 0x05, 0x05 };
-static int tdp_max_gmxmgxx[] = { 0x78, 0x78, 0xc8 };
-
-static int tdp_min_gmxtgxx[] = { 0x05, 0x05, 0x05 };
-static int tdp_max_gmxtgxx[] = { 0x78, 0x78, 0xc8 };
-
-static int tdp_min_gmxzgxx[] = { 0x05, 0x05, 0x05 };
-static int tdp_max_gmxzgxx[] = { 0x50, 0x50, 0x5f };
-
-static int tdp_min_gmxagxx[] = { 0x05, 0x05, 0x05 };
-static int tdp_max_gmxagxx[] = { 0x78, 0x78, 0xd7 };
-
-static int tdp_min_gmxrgxx[] = { 0x05, 0x05, 0x05 };
-static int tdp_max_gmxrgxx[] = { 0x64, 0x64, 0x6e };
-
-static int tdp_min_gmxpxxx[] = { 0x05, 0x05, 0x05 };
-static int tdp_max_gmxpxxx[] = { 0x82, 0x82, 0xc8 };
-
-static int tdp_min_gmxxgxx[] = { 0x05, 0x05, 0x05 };
-static int tdp_max_gmxxgxx[] = { 0x50, 0x50, 0x64 };
-
-static int *tdp_min_defs = NULL;
-static int *tdp_max_defs = NULL;
-
-void uw_id_tdp(void)
-{
-	if (uw_feats->model == UW_MODEL_PH4TUX) {
-		tdp_min_defs = tdp_min_ph4tux;
-		tdp_max_defs = tdp_max_ph4tux;
-	} else if (uw_feats->model == UW_MODEL_PH4TRX) {
-		tdp_min_defs = tdp_min_ph4trx;
-		tdp_max_defs = tdp_max_ph4trx;
-	} else if (uw_feats->model == UW_MODEL_PH4TQF) {
-		tdp_min_defs = tdp_min_ph4tqx;
-		tdp_max_defs = tdp_max_ph4tqx;
-	} else if (uw_feats->model == UW_MODEL_PH4AQF_ARX) {
-		tdp_min_defs = tdp_min_ph4axx;
-		tdp_max_defs = tdp_max_ph4axx;
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 18, 0)
-	} else if (dmi_match(DMI_PRODUCT_SKU, "IBP1XI08MK1") ||
-		   dmi_match(DMI_PRODUCT_SKU, "IBP1XI08MK2") ||
-		   dmi_match(DMI_PRODUCT_SKU, "IBP14I08MK2") ||
-		   dmi_match(DMI_PRODUCT_SKU, "IBP16I08MK2") ||
-		   dmi_match(DMI_PRODUCT_SKU, "OMNIA08IMK2")) {
-		tdp_min_defs = tdp_min_phxpxx;
-		tdp_max_defs = tdp_max_phxpxx;
-	} else if (dmi_match(DMI_PRODUCT_SKU, "PULSE1502")) {
-		tdp_min_defs = tdp_min_pfxluxg;
-		tdp_max_defs = tdp_max_pfxluxg;
-	} else if (dmi_match(DMI_PRODUCT_SKU, "POLARIS1XA02")) {
-		tdp_min_defs = tdp_min_gmxngxx;
-		tdp_max_defs = tdp_max_gmxngxx;
-	} else if (dmi_match(DMI_PRODUCT_SKU, "POLARIS1XI02")) {
-		tdp_min_defs = tdp_min_gmxmgxx;
-		tdp_max_defs = tdp_max_gmxmgxx;
-	} else if (dmi_match(DMI_PRODUCT_SKU, "POLARIS1XI03")
-		|| dmi_match(DMI_PRODUCT_SKU, "STELLARIS1XI03")) {
-		tdp_min_defs = tdp_min_gmxtgxx;
-		tdp_max_defs = tdp_max_gmxtgxx;
-	} else if (dmi_match(DMI_PRODUCT_SKU, "POLARIS1XA03")
-		|| dmi_match(DMI_PRODUCT_SKU, "STELLARIS1XA03")) {
-		tdp_min_defs = tdp_min_gmxzgxx;
-		tdp_max_defs = tdp_max_gmxzgxx;
-	} else if (dmi_match(DMI_PRODUCT_SKU, "STELLARIS1XI04")) {
-		tdp_min_defs = tdp_min_gmxagxx;
-		tdp_max_defs = tdp_max_gmxagxx;
-	} else if (dmi_match(DMI_PRODUCT_SKU, "STEPOL1XA04")) {
-		tdp_min_defs = tdp_min_gmxrgxx;
-		tdp_max_defs = tdp_max_gmxrgxx;
-	} else if (dmi_match(DMI_PRODUCT_SKU, "STELLARIS1XI05")) {
-		tdp_min_defs = tdp_min_gmxpxxx;
-		tdp_max_defs = tdp_max_gmxpxxx;
-	} else if (dmi_match(DMI_PRODUCT_SKU, "POLARIS1XA05")) {
-		tdp_min_defs = tdp_min_gmxxgxx;
-		tdp_max_defs = tdp_max_gmxxgxx;
-	} else if (dmi_match(DMI_PRODUCT_SKU, "STELLARIS1XA05")) {
-		tdp_min_defs = tdp_min_gmxxgxx;
-		tdp_max_defs = tdp_max_gmxxgxx;
-#endif
-	} else {
-		tdp_min_defs = NULL;
-		tdp_max_defs = NULL;
-	}
-}
-
-static u32 uniwill_identify(void)
+static u32 uniwill_identify(struct tuxedo_io_ident_t *ident, bool rescan)
 {
+	struct uniwill_device_features_t *uw_feats;
 	u32 result = uniwill_get_active_interface_id(NULL) == 0 ? 1 : 0;
+	ident->uniwill_complete = false;
 	if (result) {
-		uw_feats = uniwill_get_device_features();
-		uw_id_tdp();
+		if (rescan)
+			uw_feats = uniwill_rescan_device_features();
+		else
+			uw_feats = uniwill_get_device_features();
+		ident->uniwill_complete = uniwill_device_features_complete();
+		ident->uw_model = uw_feats->model;
+		ident->uw_has_universal_ec_fan_control = uw_feats->uniwill_has_universal_ec_fan_control;
+		ident->uw_profs_available = 0;
+		if (uw_feats->uniwill_profile_v1_two_profs)
+			ident->uw_profs_available = 2;
+		else if (uw_feats->uniwill_profile_v1_three_profs || uw_feats->uniwill_profile_v1_three_profs_leds_only)
+			ident->uw_profs_available = 3;
+		ident->tdp_limits = tuxedo_quirks_get_tdp_limits(uw_feats->model);
 	}
 	return result;
 }
 
+static bool tuxedo_io_ident_complete(const struct tuxedo_io_ident_t *ident, bool clevo, bool uniwill)
+{
+	return (!clevo || ident->clevo_complete) && (!uniwill || ident->uniwill_complete);
+}
+
+/**
+ * Identify the chosen vendors and publish the result
+ *
+ * Complete identifications are memoized, only incomplete ones (no interface
+ * yet, feature probe partially failed) are repeated. rescan forces a new
+ * identification including the uniwill feature probe.
+ *
+ * Returns the published id checks through ident
+ */
+static int tuxedo_io_identify(bool clevo, bool uniwill, bool rescan, struct tuxedo_io_ident_t *ident)
+{
+	struct tuxedo_io_ident_t *old_ident, *new_ident;
+
+	if (!rescan) {
+		tuxedo_io_ident_get(ident);
+		if (tuxedo_io_ident_complete(ident, clevo, uniwill))
+			return 0;
+	}
+
+	mutex_lock(&tuxedo_io_lock);
+
+	old_ident = rcu_dereference_protected(tuxedo_io_ident, lockdep_is_held(&tuxedo_io_lock));
+	if (!rescan && tuxedo_io_ident_complete(old_ident, clevo, uniwill)) {
+		*ident = *old_ident;
+		mutex_unlock(&tuxedo_io_lock);
+		return 0;
+	}
+
+	new_ident = kmemdup(old_ident, sizeof(*new_ident), GFP_KERNEL);
+	if (new_ident == NULL) {
+		mutex_unlock(&tuxedo_io_lock);
+		return -ENOMEM;
+	}
+
+	if (clevo && (rescan || !new_ident->clevo_complete)) {
+		new_ident->id_check_clevo = clevo_identify();
+		new_ident->clevo_complete = new_ident->id_check_clevo == 1;
+	}
+	if (uniwill && (rescan || !new_ident->uniwill_complete))
+		new_ident->id_check_uniwill = uniwill_identify(new_ident, rescan);
+
+	rcu_assign_pointer(tuxedo_io_ident, new_ident);
+	*ident = *new_ident;
+
+	mutex_unlock(&tuxedo_io_lock);
+
+	if (old_ident != &tuxedo_io_ident_none)
+		kfree_rcu(old_ident, rcu);
+
+	return 0;
+}
+
 /*static int fop_open(struct inode *inode, struct file *file)
 {
 	return 0;
@@ -196,62 +197,99 @@ static int fop_release(struct inode *inode, struct file *file)
 	return 0;
 }*/
 
-static long clevo_ioctl_interface(struct file *file, unsigned int cmd, unsigned long arg)
+/**
+ * Profile state as last written through this interface, used as previous
+ * state for fields that can't be read back. Protected by tuxedo_io_lock.
+ */
+static const unsigned int profile_field_cmds[TUXEDO_IO_PROFILE_FIELDS] = {
+	[TUXEDO_IO_PROFILE_UW_PERF_PROF]	= W_UW_PERF_PROF,
+	[TUXEDO_IO_PROFILE_UW_TDP0]		= W_UW_TDP0,
+	[TUXEDO_IO_PROFILE_UW_TDP1]		= W_UW_TDP1,
+	[TUXEDO_IO_PROFILE_UW_TDP2]		= W_UW_TDP2,
+	[TUXEDO_IO_PROFILE_UW_FANSPEED]		= W_UW_FANSPEED,
+	[TUXEDO_IO_PROFILE_UW_FANSPEED2]	= W_UW_FANSPEED2,
+	[TUXEDO_IO_PROFILE_UW_FANAUTO]		= W_UW_FANAUTO,
+	[TUXEDO_IO_PROFILE_CL_PERF_PROFILE]	= W_CL_PERF_PROFILE,
+};
+
+#define PROFILE_FIELD_BIT(field)	(1U << (field))
+#define PROFILE_FIELDS_UW_FANSPEEDS	(PROFILE_FIELD_BIT(TUXEDO_IO_PROFILE_UW_FANSPEED) | \
+					 PROFILE_FIELD_BIT(TUXEDO_IO_PROFILE_UW_FANSPEED2))
+
+static u32 profile_shadow[TUXEDO_IO_PROFILE_FIELDS];
+static u32 profile_shadow_valid;
+
+static void profile_shadow_update(unsigned int cmd, u32 value)
 {
-	u32 result = 0, status;
-	u32 copy_result;
-	u32 argument = (u32) arg;
+	int field;
+
+	for (field = 0; field < TUXEDO_IO_PROFILE_FIELDS; ++field) {
+		if (profile_field_cmds[field] == cmd)
+			break;
+	}
+	if (field == TUXEDO_IO_PROFILE_FIELDS)
+		return;
+
+	if (field == TUXEDO_IO_PROFILE_UW_FANAUTO) {
+		// Custom speeds are dropped
+		value = 1;
+		profile_shadow_valid &= ~PROFILE_FIELDS_UW_FANSPEEDS;
+	} else if (field == TUXEDO_IO_PROFILE_UW_FANSPEED || field == TUXEDO_IO_PROFILE_UW_FANSPEED2) {
+		profile_shadow[TUXEDO_IO_PROFILE_UW_FANAUTO] = 0;
+		profile_shadow_valid |= PROFILE_FIELD_BIT(TUXEDO_IO_PROFILE_UW_FANAUTO);
+	}
 
+	profile_shadow[field] = value;
+	profile_shadow_valid |= PROFILE_FIELD_BIT(field);
+}
+
+/**
+ * Execute one of the clevo commands taking or returning a single value
+ *
+ * Return value is what the ioctl itself reports (-ENOIOCTLCMD if the command
+ * is not handled here), op_status the status of the underlying method call
+ */
+static long clevo_ioctl_exec(unsigned int cmd, u32 *value, int *op_status)
+{
+	u32 result = 0;
+	u32 argument = *value;
 	u32 clevo_arg;
+	int status = 0;
 
-	const char str_no_if[] = "";
-	char *str_clevo_if;
-	
 	switch (cmd) {
-		case R_CL_HW_IF_STR:
-			if (clevo_get_active_interface_id(&str_clevo_if) == 0) {
-				copy_result = copy_to_user((char *) arg, str_clevo_if, strlen(str_clevo_if) + 1);
-			} else {
-				copy_result = copy_to_user((char *) arg, str_no_if, strlen(str_no_if) + 1);
-			}
-			break;
 		case R_CL_FANINFO1:
 			status = clevo_evaluate_method(CLEVO_CMD_GET_FANINFO1, 0, &result);
-			copy_result = copy_to_user((int32_t *) arg, &result, sizeof(result));
+			*value = result;
 			break;
 		case R_CL_FANINFO2:
 			status = clevo_evaluate_method(CLEVO_CMD_GET_FANINFO2, 0, &result);
-			copy_result = copy_to_user((int32_t *) arg, &result, sizeof(result));
+			*value = result;
 			break;
 		case R_CL_FANINFO3:
 			status = clevo_evaluate_method(CLEVO_CMD_GET_FANINFO3, 0, &result);
-			copy_result = copy_to_user((int32_t *) arg, &result, sizeof(result));
+			*value = result;
 			break;
 		/*case R_CL_FANINFO4:
 			status = clevo_evaluate_method(CLEVO_CMD_GET_FANINFO4, 0);
-			copy_to_user((int32_t *) arg, &result, sizeof(result));
+			*value = result;
 			break;*/
 		case R_CL_WEBCAM_SW:
-			if (dmi_match(DMI_PRODUCT_SKU, "AURA14GEN3") ||
-			    dmi_match(DMI_PRODUCT_SKU, "AURA15GEN3"))
+			if (tuxedo_quirk(TUXEDO_QUIRK_CL_NO_WEBCAM_SW))
 				return -ENODEV;
 			status = clevo_evaluate_method(CLEVO_CMD_GET_WEBCAM_SW, 0, &result);
-			copy_result = copy_to_user((int32_t *) arg, &result, sizeof(result));
+			*value = result;
 			break;
 		case R_CL_FLIGHTMODE_SW:
 			status = clevo_evaluate_method(CLEVO_CMD_GET_FLIGHTMODE_SW, 0, &result);
-			copy_result = copy_to_user((int32_t *) arg, &result, sizeof(result));
+			*value = result;
 			break;
 		case R_CL_TOUCHPAD_SW:
 			status = clevo_evaluate_method(CLEVO_CMD_GET_TOUCHPAD_SW, 0, &result);
-			copy_result = copy_to_user((int32_t *) arg, &result, sizeof(result));
+			*value = result;
 			break;
-	}
 
-	switch (cmd) {
 		case W_CL_FANSPEED:
-			copy_result = copy_from_user(&argument, (int32_t *) arg, sizeof(argument));
-			clevo_evaluate_method(CLEVO_CMD_SET_FANSPEED_VALUE, argument, &result);
+			status = clevo_evaluate_method(CLEVO_CMD_SET_FANSPEED_VALUE, argument, &result);
 			// Note: Delay needed to let hardware catch up with the written value.
 			// No known ready flag. If the value is read too soon, the old value
 			// will still be read out.
@@ -260,36 +298,79 @@ static long clevo_ioctl_interface(struct file *file, unsigned int cmd, unsigned
 			msleep(100);
 			break;
 		case W_CL_FANAUTO:
-			copy_result = copy_from_user(&argument, (int32_t *) arg, sizeof(argument));
-			clevo_evaluate_method(CLEVO_CMD_SET_FANSPEED_AUTO, argument, &result);
+			status = clevo_evaluate_method(CLEVO_CMD_SET_FANSPEED_AUTO, argument, &result);
 			break;
 		case W_CL_WEBCAM_SW:
-			if (dmi_match(DMI_PRODUCT_SKU, "AURA14GEN3") ||
-			    dmi_match(DMI_PRODUCT_SKU, "AURA15GEN3"))
+			if (tuxedo_quirk(TUXEDO_QUIRK_CL_NO_WEBCAM_SW))
 				return -ENODEV;
-			copy_result = copy_from_user(&argument, (int32_t *) arg, sizeof(argument));
 			status = clevo_evaluate_method(CLEVO_CMD_GET_WEBCAM_SW, 0, &result);
 			// Only set status if it isn't already the right value
 			// (workaround for old and/or buggy WMI interfaces that toggle on write)
-			if ((argument & 0x01) != (result & 0x01)) {
-				clevo_evaluate_method(CLEVO_CMD_SET_WEBCAM_SW, argument, &result);
+			if (status == 0 && (argument & 0x01) != (result & 0x01)) {
+				status = clevo_evaluate_method(CLEVO_CMD_SET_WEBCAM_SW, argument, &result);
 			}
 			break;
 		case W_CL_FLIGHTMODE_SW:
-			copy_result = copy_from_user(&argument, (int32_t *) arg, sizeof(argument));
-			clevo_evaluate_method(CLEVO_CMD_SET_FLIGHTMODE_SW, argument, &result);
+			status = clevo_evaluate_method(CLEVO_CMD_SET_FLIGHTMODE_SW, argument, &result);
 			break;
 		case W_CL_TOUCHPAD_SW:
-			copy_result = copy_from_user(&argument, (int32_t *) arg, sizeof(argument));
-			clevo_evaluate_method(CLEVO_CMD_SET_TOUCHPAD_SW, argument, &result);
+			status = clevo_evaluate_method(CLEVO_CMD_SET_TOUCHPAD_SW, argument, &result);
 			break;
 		case W_CL_PERF_PROFILE:
-			copy_result = copy_from_user(&argument, (int32_t *) arg, sizeof(argument));
 			clevo_arg = (CLEVO_CMD_OPT_SUB_SET_PERF_PROF << 0x18) | (argument & 0xff);
-			clevo_evaluate_method(CLEVO_CMD_OPT, clevo_arg, &result);
+			clevo_action_begin(CLEVO_ACTION_SET_PROFILE);
+			status = clevo_evaluate_method(CLEVO_CMD_OPT, clevo_arg, &result);
+			clevo_action_end(CLEVO_ACTION_SET_PROFILE);
 			break;
+		default:
+			return -ENOIOCTLCMD;
 	}
 
+	if (status == 0)
+		profile_shadow_update(cmd, argument);
+
+	*op_status = status;
+
+	return 0;
+}
+
+static long clevo_ioctl_interface(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	u32 copy_result;
+	u32 value = 0;
+	int op_status;
+	long ret;
+
+	const char str_no_if[] = "";
+	char *str_clevo_if;
+
+	if (cmd == R_CL_HW_IF_STR) {
+		if (clevo_get_active_interface_id(&str_clevo_if) == 0) {
+			copy_result = copy_to_user((char *) arg, str_clevo_if, strlen(str_clevo_if) + 1);
+		} else {
+			copy_result = copy_to_user((char *) arg, str_no_if, strlen(str_no_if) + 1);
+		}
+		return 0;
+	}
+
+	if (_IOC_TYPE(cmd) == MAGIC_WRITE_CL)
+		copy_result = copy_from_user(&value, (int32_t *) arg, sizeof(value));
+
+	if (_IOC_TYPE(cmd) == MAGIC_WRITE_CL) {
+		mutex_lock(&tuxedo_io_lock);
+		ret = clevo_ioctl_exec(cmd, &value, &op_status);
+		mutex_unlock(&tuxedo_io_lock);
+	} else {
+		ret = clevo_ioctl_exec(cmd, &value, &op_status);
+	}
+	if (ret == -ENOIOCTLCMD)
+		return 0;
+	if (ret != 0)
+		return ret;
+
+	if (_IOC_TYPE(cmd) == MAGIC_READ_CL)
+		copy_result = copy_to_user((int32_t *) arg, &value, sizeof(value));
+
 	return 0;
 }
 
@@ -310,9 +391,10 @@ static int set_full_fan_mode(bool enable) {
 	return 0;
 }
 
+// Protected by tuxedo_io_lock
 static bool fans_initialized = false;
 
-static int uw_init_fan(void) {
+static int uw_init_fan(const struct tuxedo_io_ident_t *ident) {
 	int i;
 
 	u16 addr_use_custom_fan_table_0 = 0x07c5; // use different tables for both fans (0x0f00-0x0f2f and 0x0f30-0x0f5f respectivly)
@@ -328,7 +410,8 @@ static int uw_init_fan(void) {
 	u16 addr_gpu_custom_fan_table_start_temp = 0x0f40;
 	u16 addr_gpu_custom_fan_table_fan_speed = 0x0f50;
 
-	if (!fans_initialized && uw_feats->uniwill_has_universal_ec_fan_control) {
+	if (!fans_initialized && ident->uw_has_universal_ec_fan_control) {
+		uniwill_action_begin(UNIWILL_ACTION_INIT_FAN);
 		set_full_fan_mode(false);
 
 		uniwill_read_ec_ram(addr_use_custom_fan_table_0, &value_use_custom_fan_table_0);
@@ -355,6 +438,7 @@ static int uw_init_fan(void) {
 		if (!((value_use_custom_fan_table_1 >> offset_use_custom_fan_table_1) & 1)) {
 			uniwill_write_ec_ram_with_retry(addr_use_custom_fan_table_1, value_use_custom_fan_table_1 + (1 << offset_use_custom_fan_table_1), 3);
 		}
+		uniwill_action_end(UNIWILL_ACTION_INIT_FAN);
 	}
 
 	fans_initialized = true;
@@ -362,7 +446,7 @@ static int uw_init_fan(void) {
 	return 0;
 }
 
-static u32 uw_set_fan(u32 fan_index, u8 fan_speed)
+static u32 uw_set_fan(const struct tuxedo_io_ident_t *ident, u32 fan_index, u8 fan_speed)
 {
 	u32 i;
 	u8 mode_data;
@@ -373,8 +457,8 @@ static u32 uw_set_fan(u32 fan_index, u8 fan_speed)
 	u16 addr_cpu_custom_fan_table_fan_speed = 0x0f20;
 	u16 addr_gpu_custom_fan_table_fan_speed = 0x0f50;
 
-	if (uw_feats->uniwill_has_universal_ec_fan_control) {
-		uw_init_fan();
+	if (ident->uw_has_universal_ec_fan_control) {
+		uw_init_fan(ident);
 
 		if (fan_index == 0)
 			addr_for_fan = addr_cpu_custom_fan_table_fan_speed;
@@ -425,11 +509,11 @@ static u32 uw_set_fan(u32 fan_index, u8 fan_speed)
 	return 0;
 }
 
-static u32 uw_set_fan_auto(void)
+static u32 uw_set_fan_auto(const struct tuxedo_io_ident_t *ident)
 {
 	u8 mode_data;
 
-	if (uw_feats->uniwill_has_universal_ec_fan_control) {
+	if (ident->uw_has_universal_ec_fan_control) {
 		u16 addr_use_custom_fan_table_0 = 0x07c5; // use different tables for both fans (0x0f00-0x0f2f and 0x0f30-0x0f5f respectivly)
 		u16 addr_use_custom_fan_table_1 = 0x07c6; // enable 0x0fxx fantables
 		u8 offset_use_custom_fan_table_0 = 7;
@@ -456,37 +540,37 @@ static u32 uw_set_fan_auto(void)
 	return 0;
 }
 
-static int uw_get_tdp_min(u8 tdp_index)
+static int uw_get_tdp_min(const struct tuxedo_io_ident_t *ident, u8 tdp_index)
 {
-	if (tdp_index > 2)
+	if (tdp_index >= TUXEDO_TDP_COUNT)
 		return -EINVAL;
 
-	if (tdp_min_defs == NULL)
+	if (ident->tdp_limits == NULL)
 		return -ENODEV;
 
-	if (tdp_min_defs[tdp_index] <= 0) {
+	if (ident->tdp_limits->min[tdp_index] == 0) {
 		return -ENODEV;
 	}
 
-	return tdp_min_defs[tdp_index];
+	return ident->tdp_limits->min[tdp_index];
 }
 
-static int uw_get_tdp_max(u8 tdp_index)
+static int uw_get_tdp_max(const struct tuxedo_io_ident_t *ident, u8 tdp_index)
 {
-	if (tdp_index > 2)
+	if (tdp_index >= TUXEDO_TDP_COUNT)
 		return -EINVAL;
 
-	if (tdp_max_defs == NULL)
+	if (ident->tdp_limits == NULL)
 		return -ENODEV;
 
-	if (tdp_max_defs[tdp_index] <= 0) {
+	if (ident->tdp_limits->max[tdp_index] == 0) {
 		return -ENODEV;
 	}
 
-	return tdp_max_defs[tdp_index];
+	return ident->tdp_limits->max[tdp_index];
 }
 
-static int uw_get_tdp(u8 tdp_index)
+static int uw_get_tdp(const struct tuxedo_io_ident_t *ident, u8 tdp_index)
 {
 	u8 tdp_data;
 	u16 tdp_base_addr = 0x0783;
@@ -494,7 +578,7 @@ static int uw_get_tdp(u8 tdp_index)
 	int status;
 
 	// Use min tdp to detect support for chosen tdp parameter
-	int min_tdp_status = uw_get_tdp_min(tdp_index);
+	int min_tdp_status = uw_get_tdp_min(ident, tdp_index);
 	if (min_tdp_status < 0)
 		return min_tdp_status;
 
@@ -505,19 +589,19 @@ static int uw_get_tdp(u8 tdp_index)
 	return tdp_data;
 }
 
-static int uw_set_tdp(u8 tdp_index, u8 tdp_data)
+static int uw_set_tdp(const struct tuxedo_io_ident_t *ident, u8 tdp_index, u8 tdp_data)
 {
 	int tdp_min, tdp_max;
 	u16 tdp_base_addr = 0x0783;
 	u16 tdp_current_addr = tdp_base_addr + tdp_index;
 
 	// Use min tdp to detect support for chosen tdp parameter
-	int min_tdp_status = uw_get_tdp_min(tdp_index);
+	int min_tdp_status = uw_get_tdp_min(ident, tdp_index);
 	if (min_tdp_status < 0)
 		return min_tdp_status;
 
-	tdp_min = uw_get_tdp_min(tdp_index);
-	tdp_max = uw_get_tdp_max(tdp_index);
+	tdp_min = uw_get_tdp_min(ident, tdp_index);
+	tdp_max = uw_get_tdp_max(ident, tdp_index);
 	if (tdp_data < tdp_min || tdp_data > tdp_max)
 		return -EINVAL;
 
@@ -561,67 +645,46 @@ static u32 uw_set_performance_profile_v1(u8 profile_index)
 	return result;
 }
 
-static long uniwill_ioctl_interface(struct file *file, unsigned int cmd, unsigned long arg)
+/**
+ * Execute one of the uniwill commands taking or returning a single value
+ *
+ * Return value is what the ioctl itself reports (-ENOIOCTLCMD if the command
+ * is not handled here), op_status the status of the underlying EC access
+ */
+static long uniwill_ioctl_exec(const struct tuxedo_io_ident_t *ident, unsigned int cmd, u32 *value, int *op_status)
 {
-	u32 result = 0;
-	u32 copy_result;
-	u32 argument;
-	u8 byte_data;
-	const char str_no_if[] = "";
-	char *str_uniwill_if;
-
-#ifdef DEBUG
-	union uw_ec_read_return reg_read_return;
-	union uw_ec_write_return reg_write_return;
-	u32 uw_arg[10];
-	u32 uw_result[10];
-	int i;
-	for (i = 0; i < 10; ++i) {
-		uw_result[i] = 0xdeadbeef;
-	}
-#endif
+	u32 argument = *value;
+	int result = 0;
+	int status = 0;
+	u8 byte_data = 0;
 
 	switch (cmd) {
-		case R_UW_HW_IF_STR:
-			if (uniwill_get_active_interface_id(&str_uniwill_if) == 0) {
-				copy_result = copy_to_user((char *) arg, str_uniwill_if, strlen(str_uniwill_if) + 1);
-			} else {
-				copy_result = copy_to_user((char *) arg, str_no_if, strlen(str_no_if) + 1);
-			}
-			break;
 		case R_UW_MODEL_ID:
-			result = uw_feats->model;
-			copy_result = copy_to_user((void *) arg, &result, sizeof(result));
+			*value = ident->uw_model;
 			break;
 		case R_UW_FANSPEED:
-			uniwill_read_ec_ram(0x1804, &byte_data);
-			result = byte_data;
-			copy_result = copy_to_user((void *) arg, &result, sizeof(result));
+			status = uniwill_read_ec_ram(0x1804, &byte_data);
+			*value = byte_data;
 			break;
 		case R_UW_FANSPEED2:
-			uniwill_read_ec_ram(0x1809, &byte_data);
-			result = byte_data;
-			copy_result = copy_to_user((void *) arg, &result, sizeof(result));
+			status = uniwill_read_ec_ram(0x1809, &byte_data);
+			*value = byte_data;
 			break;
 		case R_UW_FAN_TEMP:
-			uniwill_read_ec_ram(0x043e, &byte_data);
-			result = byte_data;
-			copy_result = copy_to_user((void *) arg, &result, sizeof(result));
+			status = uniwill_read_ec_ram(0x043e, &byte_data);
+			*value = byte_data;
 			break;
 		case R_UW_FAN_TEMP2:
-			uniwill_read_ec_ram(0x044f, &byte_data);
-			result = byte_data;
-			copy_result = copy_to_user((void *) arg, &result, sizeof(result));
+			status = uniwill_read_ec_ram(0x044f, &byte_data);
+			*value = byte_data;
 			break;
 		case R_UW_MODE:
-			uniwill_read_ec_ram(0x0751, &byte_data);
-			result = byte_data;
-			copy_result = copy_to_user((void *) arg, &result, sizeof(result));
+			status = uniwill_read_ec_ram(0x0751, &byte_data);
+			*value = byte_data;
 			break;
 		case R_UW_MODE_ENABLE:
-			uniwill_read_ec_ram(0x0741, &byte_data);
-			result = byte_data;
-			copy_result = copy_to_user((void *) arg, &result, sizeof(result));
+			status = uniwill_read_ec_ram(0x0741, &byte_data);
+			*value = byte_data;
 			break;
 		case R_UW_FANS_OFF_AVAILABLE:
 			/*result = uw_feats->uniwill_has_universal_ec_fan_control ? 1 : 0;
@@ -631,8 +694,7 @@ static long uniwill_ioctl_interface(struct file *file, unsigned int cmd, unsigne
 			else if (result == 0) {
 				result = 1;
 			}*/
-			result = 1;
-			copy_result = copy_to_user((void *) arg, &result, sizeof(result));
+			*value = 1;
 			break;
 		case R_UW_FANS_MIN_SPEED:
 			/*result = uw_feats->uniwill_has_universal_ec_fan_control? 1 : 0;
@@ -642,113 +704,123 @@ static long uniwill_ioctl_interface(struct file *file, unsigned int cmd, unsigne
 			else if (result == 0) {
 				result = 0;
 			}*/
-			result = 20;
-			copy_result = copy_to_user((void *) arg, &result, sizeof(result));
+			*value = 20;
 			break;
 		case R_UW_TDP0:
-			result = uw_get_tdp(0);
-			copy_result = copy_to_user((void *) arg, &result, sizeof(result));
-			break;
 		case R_UW_TDP1:
-			result = uw_get_tdp(1);
-			copy_result = copy_to_user((void *) arg, &result, sizeof(result));
-			break;
 		case R_UW_TDP2:
-			result = uw_get_tdp(2);
-			copy_result = copy_to_user((void *) arg, &result, sizeof(result));
+			result = uw_get_tdp(ident, _IOC_NR(cmd) - _IOC_NR(R_UW_TDP0));
+			// Errors are reported through the value as well
+			*value = result;
+			status = result < 0 ? result : 0;
 			break;
 		case R_UW_TDP0_MIN:
-			result = uw_get_tdp_min(0);
-			copy_result = copy_to_user((void *) arg, &result, sizeof(result));
-			break;
 		case R_UW_TDP1_MIN:
-			result = uw_get_tdp_min(1);
-			copy_result = copy_to_user((void *) arg, &result, sizeof(result));
-			break;
 		case R_UW_TDP2_MIN:
-			result = uw_get_tdp_min(2);
-			copy_result = copy_to_user((void *) arg, &result, sizeof(result));
+			result = uw_get_tdp_min(ident, _IOC_NR(cmd) - _IOC_NR(R_UW_TDP0_MIN));
+			*value = result;
+			status = result < 0 ? result : 0;
 			break;
 		case R_UW_TDP0_MAX:
-			result = uw_get_tdp_max(0);
-			copy_result = copy_to_user((void *) arg, &result, sizeof(result));
-			break;
 		case R_UW_TDP1_MAX:
-			result = uw_get_tdp_max(1);
-			copy_result = copy_to_user((void *) arg, &result, sizeof(result));
-			break;
 		case R_UW_TDP2_MAX:
-			result = uw_get_tdp_max(2);
-			copy_result = copy_to_user((void *) arg, &result, sizeof(result));
+			result = uw_get_tdp_max(ident, _IOC_NR(cmd) - _IOC_NR(R_UW_TDP0_MAX));
+			*value = result;
+			status = result < 0 ? result : 0;
 			break;
 		case R_UW_PROFS_AVAILABLE:
-			result = 0;
-			if (uw_feats->uniwill_profile_v1_two_profs)
-				result = 2;
-			else if (uw_feats->uniwill_profile_v1_three_profs || uw_feats->uniwill_profile_v1_three_profs_leds_only)
-				result = 3;
-			copy_result = copy_to_user((void *) arg, &result, sizeof(result));
+			*value = ident->uw_profs_available;
 			break;
-#ifdef DEBUG
-		case R_TF_BC:
-			copy_result = copy_from_user(&uw_arg, (void *) arg, sizeof(uw_arg));
-			reg_read_return.dword = 0;
-			result = uniwill_read_ec_ram((uw_arg[1] << 8) | uw_arg[0], &reg_read_return.bytes.data_low);
-			copy_result = copy_to_user((void *) arg, &reg_read_return.dword, sizeof(reg_read_return.dword));
-			// pr_info("R_TF_BC args [%0#2x, %0#2x, %0#2x, %0#2x]\n", uw_arg[0], uw_arg[1], uw_arg[2], uw_arg[3]);
-			/*if (uniwill_ec_direct) {
-				result = uw_ec_read_addr_direct(uw_arg[0], uw_arg[1], &reg_read_return);
-				copy_result = copy_to_user((void *) arg, &reg_read_return.dword, sizeof(reg_read_return.dword));
-			} else {
-				result = uw_wmi_ec_evaluate(uw_arg[0], uw_arg[1], uw_arg[2], uw_arg[3], 1, uw_result);
-				copy_result = copy_to_user((void *) arg, &uw_result, sizeof(uw_result));
-			}*/
+		case R_UW_KBD_BL_STATUS:
+			status = uniwill_read_ec_ram(UW_EC_REG_KBD_BL_STATUS, &byte_data);
+			*value = byte_data;
 			break;
-#endif
-	}
 
-	switch (cmd) {
 		case W_UW_FANSPEED:
-			// Get fan speed argument
-			copy_result = copy_from_user(&argument, (int32_t *) arg, sizeof(argument));
-			uw_set_fan(0, argument);
+			status = (int) uw_set_fan(ident, 0, argument);
 			break;
 		case W_UW_FANSPEED2:
-			// Get fan speed argument
-			copy_result = copy_from_user(&argument, (int32_t *) arg, sizeof(argument));
-			uw_set_fan(1, argument);
+			status = (int) uw_set_fan(ident, 1, argument);
 			break;
 		case W_UW_MODE:
-			copy_result = copy_from_user(&argument, (int32_t *) arg, sizeof(argument));
-			uniwill_write_ec_ram(0x0751, argument & 0xff);
+			status = uniwill_write_ec_ram(0x0751, argument & 0xff);
 			break;
 		case W_UW_MODE_ENABLE:
 			// Note: Is for the moment set and cleared on init/exit of module (uniwill mode)
 			/*
-			copy_result = copy_from_user(&argument, (int32_t *) arg, sizeof(argument));
-			uniwill_write_ec_ram(0x0741, argument & 0x01);
+			status = uniwill_write_ec_ram(0x0741, argument & 0x01);
 			*/
 			break;
 		case W_UW_FANAUTO:
-			uw_set_fan_auto();
+			status = (int) uw_set_fan_auto(ident);
 			break;
 		case W_UW_TDP0:
-			copy_result = copy_from_user(&argument, (int32_t *) arg, sizeof(argument));
-			uw_set_tdp(0, argument);
-			break;
 		case W_UW_TDP1:
-			copy_result = copy_from_user(&argument, (int32_t *) arg, sizeof(argument));
-			uw_set_tdp(1, argument);
-			break;
 		case W_UW_TDP2:
-			copy_result = copy_from_user(&argument, (int32_t *) arg, sizeof(argument));
-			uw_set_tdp(2, argument);
+			status = uw_set_tdp(ident, _IOC_NR(cmd) - _IOC_NR(W_UW_TDP0), argument);
 			break;
 		case W_UW_PERF_PROF:
-			copy_result = copy_from_user(&argument, (int32_t *) arg, sizeof(argument));
-			uw_set_performance_profile_v1(argument);
+			uniwill_action_begin(UNIWILL_ACTION_SET_PROFILE);
+			status = (int) uw_set_performance_profile_v1(argument);
+			uniwill_action_end(UNIWILL_ACTION_SET_PROFILE);
 			break;
+		default:
+			return -ENOIOCTLCMD;
+	}
+
+	if (status == 0)
+		profile_shadow_update(cmd, argument);
+
+	*op_status = status;
+
+	return 0;
+}
+
+static long uniwill_ioctl_interface(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	u32 copy_result;
+	u32 value = 0;
+	int op_status;
+	long ret;
+	struct tuxedo_io_ident_t ident;
+	const char str_no_if[] = "";
+	char *str_uniwill_if;
+
+#ifdef DEBUG
+	u32 result = 0;
+	union uw_ec_read_return reg_read_return;
+	union uw_ec_write_return reg_write_return;
+	u32 uw_arg[10];
+	u32 uw_result[10];
+	int i;
+	for (i = 0; i < 10; ++i) {
+		uw_result[i] = 0xdeadbeef;
+	}
+#endif
+
+	switch (cmd) {
+		case R_UW_HW_IF_STR:
+			if (uniwill_get_active_interface_id(&str_uniwill_if) == 0) {
+				copy_result = copy_to_user((char *) arg, str_uniwill_if, strlen(str_uniwill_if) + 1);
+			} else {
+				copy_result = copy_to_user((char *) arg, str_no_if, strlen(str_no_if) + 1);
+			}
+			return 0;
 #ifdef DEBUG
+		case R_TF_BC:
+			copy_result = copy_from_user(&uw_arg, (void *) arg, sizeof(uw_arg));
+			reg_read_return.dword = 0;
+			result = uniwill_read_ec_ram((uw_arg[1] << 8) | uw_arg[0], &reg_read_return.bytes.data_low);
+			copy_result = copy_to_user((void *) arg, &reg_read_return.dword, sizeof(reg_read_return.dword));
+			// pr_info("R_TF_BC args [%0#2x, %0#2x, %0#2x, %0#2x]\n", uw_arg[0], uw_arg[1], uw_arg[2], uw_arg[3]);
+			/*if (uniwill_ec_direct) {
+				result = uw_ec_read_addr_direct(uw_arg[0], uw_arg[1], &reg_read_return);
+				copy_result = copy_to_user((void *) arg, &reg_read_return.dword, sizeof(reg_read_return.dword));
+			} else {
+				result = uw_wmi_ec_evaluate(uw_arg[0], uw_arg[1], uw_arg[2], uw_arg[3], 1, uw_result);
+				copy_result = copy_to_user((void *) arg, &uw_result, sizeof(uw_result));
+			}*/
+			return 0;
 		case W_TF_BC:
 			reg_write_return.dword = 0;
 			copy_result = copy_from_user(&uw_arg, (void *) arg, sizeof(uw_arg));
@@ -766,10 +838,506 @@ static long uniwill_ioctl_interface(struct file *file, unsigned int cmd, unsigne
 			pr_info("data_low %0#2x\n", reg_write_return.bytes.data_low);
 			pr_info("addr_high %0#2x\n", reg_write_return.bytes.addr_high);
 			pr_info("addr_low %0#2x\n", reg_write_return.bytes.addr_low);*/
-			break;
+			return 0;
 #endif
 	}
 
+	if (_IOC_TYPE(cmd) == MAGIC_WRITE_UW && (_IOC_DIR(cmd) & _IOC_WRITE))
+		copy_result = copy_from_user(&value, (int32_t *) arg, sizeof(value));
+
+	tuxedo_io_ident_get(&ident);
+
+	if (_IOC_TYPE(cmd) == MAGIC_WRITE_UW) {
+		mutex_lock(&tuxedo_io_lock);
+		ret = uniwill_ioctl_exec(&ident, cmd, &value, &op_status);
+		mutex_unlock(&tuxedo_io_lock);
+	} else {
+		ret = uniwill_ioctl_exec(&ident, cmd, &value, &op_status);
+	}
+	if (ret == -ENOIOCTLCMD)
+		return 0;
+	if (ret != 0)
+		return ret;
+
+	if (_IOC_TYPE(cmd) == MAGIC_READ_UW)
+		copy_result = copy_to_user((void *) arg, &value, sizeof(value));
+
+	return 0;
+}
+
+/**
+ * Execute a single batch entry, vendor commands are only accepted for the
+ * identified vendor
+ */
+static int batch_exec_entry(const struct tuxedo_io_ident_t *ident, struct tuxedo_io_batch_entry *entry)
+{
+	u32 value = entry->value;
+	int op_status = 0;
+	long ret;
+
+	switch (_IOC_TYPE(entry->cmd)) {
+		case MAGIC_READ_CL:
+		case MAGIC_WRITE_CL:
+			if (ident->id_check_clevo != 1)
+				return -ENODEV;
+			ret = clevo_ioctl_exec(entry->cmd, &value, &op_status);
+			break;
+		case MAGIC_READ_UW:
+		case MAGIC_WRITE_UW:
+			if (ident->id_check_uniwill != 1)
+				return -ENODEV;
+			ret = uniwill_ioctl_exec(ident, entry->cmd, &value, &op_status);
+			break;
+		default:
+			return -EINVAL;
+	}
+
+	// Non-scalar commands (interface strings, debug access) are not batchable
+	if (ret == -ENOIOCTLCMD)
+		return -EINVAL;
+	if (ret != 0)
+		return ret;
+
+	entry->value = value;
+
+	return op_status;
+}
+
+/**
+ * Fan speed writes wait for the hardware to catch up (100 ms on Clevo, ramp
+ * up workaround on Uniwill)
+ */
+static bool batch_entry_sleeps(u32 cmd)
+{
+	return cmd == W_CL_FANSPEED || cmd == W_UW_FANSPEED || cmd == W_UW_FANSPEED2;
+}
+
+static void batch_sessions_begin(const struct tuxedo_io_ident_t *ident)
+{
+	if (ident->id_check_clevo == 1)
+		clevo_method_session_begin();
+	if (ident->id_check_uniwill == 1)
+		uniwill_ec_session_begin();
+}
+
+static void batch_sessions_end(const struct tuxedo_io_ident_t *ident)
+{
+	if (ident->id_check_uniwill == 1)
+		uniwill_ec_session_end();
+	if (ident->id_check_clevo == 1)
+		clevo_method_session_end();
+}
+
+/**
+ * Execute a list of commands in order while holding the vendor interface
+ * for the whole batch. Per entry status and result are written back to the
+ * entries, the ioctl itself only fails for an unusable batch.
+ *
+ * Sleeping commands are limited per batch and release the vendor interface
+ * while they run, so LED writes and other EC users are not held off.
+ */
+static long batch_ioctl_interface(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	struct tuxedo_io_batch batch;
+	struct tuxedo_io_batch_entry *entries;
+	struct tuxedo_io_ident_t ident;
+	void __user *user_entries;
+	size_t entries_size;
+	bool stop = false;
+	unsigned int sleeping = 0;
+	long ret = 0;
+	u32 i;
+
+	if (copy_from_user(&batch, (void __user *) arg, sizeof(batch)))
+		return -EFAULT;
+
+	if (batch.count == 0 || batch.count > TUXEDO_IO_BATCH_MAX_ENTRIES)
+		return -EINVAL;
+	if (batch.flags & ~TUXEDO_IO_BATCH_STOP_ON_ERROR)
+		return -EINVAL;
+
+	user_entries = u64_to_user_ptr(batch.entries);
+	entries_size = batch.count * sizeof(*entries);
+	entries = memdup_user(user_entries, entries_size);
+	if (IS_ERR(entries))
+		return PTR_ERR(entries);
+
+	for (i = 0; i < batch.count; ++i)
+		if (batch_entry_sleeps(entries[i].cmd))
+			sleeping++;
+	if (sleeping > TUXEDO_IO_BATCH_MAX_SLEEPING) {
+		kfree(entries);
+		return -EINVAL;
+	}
+
+	mutex_lock(&tuxedo_io_lock);
+	tuxedo_io_ident_get(&ident);
+
+	batch_sessions_begin(&ident);
+
+	for (i = 0; i < batch.count; ++i) {
+		if (stop) {
+			entries[i].status = -ECANCELED;
+			continue;
+		}
+		if (batch_entry_sleeps(entries[i].cmd)) {
+			batch_sessions_end(&ident);
+			entries[i].status = batch_exec_entry(&ident, &entries[i]);
+			batch_sessions_begin(&ident);
+		} else {
+			entries[i].status = batch_exec_entry(&ident, &entries[i]);
+		}
+		if (entries[i].status != 0 && (batch.flags & TUXEDO_IO_BATCH_STOP_ON_ERROR))
+			stop = true;
+	}
+
+	batch_sessions_end(&ident);
+
+	mutex_unlock(&tuxedo_io_lock);
+
+	if (copy_to_user(user_entries, entries, entries_size))
+		ret = -EFAULT;
+
+	kfree(entries);
+
+	return ret;
+}
+
+static long profile_exec_field(const struct tuxedo_io_ident_t *ident, int field, u32 value)
+{
+	unsigned int cmd = profile_field_cmds[field];
+	int op_status = 0;
+	long ret;
+
+	if (_IOC_TYPE(cmd) == MAGIC_WRITE_CL)
+		ret = clevo_ioctl_exec(cmd, &value, &op_status);
+	else
+		ret = uniwill_ioctl_exec(ident, cmd, &value, &op_status);
+
+	return ret != 0 ? ret : op_status;
+}
+
+static int uw_get_performance_profile_v1(void)
+{
+	u8 mode_data;
+	int status = uniwill_read_ec_ram(0x0751, &mode_data);
+	if (status < 0)
+		return status;
+
+	switch (mode_data & (0xa0 | 0x10)) {
+	case 0xa0:
+		return 0x01;
+	case 0x00:
+		return 0x02;
+	case 0x10:
+		return 0x03;
+	}
+
+	return -ENODATA;
+}
+
+/**
+ * Read back a single field, -ENODATA if the field can't be read
+ */
+static int profile_read_field(const struct tuxedo_io_ident_t *ident, int field)
+{
+	switch (field) {
+	case TUXEDO_IO_PROFILE_UW_PERF_PROF:
+		return uw_get_performance_profile_v1();
+	case TUXEDO_IO_PROFILE_UW_TDP0:
+	case TUXEDO_IO_PROFILE_UW_TDP1:
+	case TUXEDO_IO_PROFILE_UW_TDP2:
+		return uw_get_tdp(ident, field - TUXEDO_IO_PROFILE_UW_TDP0);
+	}
+
+	// Fan speeds read back the actual speed, clevo profile has no getter
+	return -ENODATA;
+}
+
+static void profile_read_current(const struct tuxedo_io_ident_t *ident, u32 valid,
+				 u32 *prev, u32 *prev_valid)
+{
+	int field, result;
+
+	memcpy(prev, profile_shadow, sizeof(profile_shadow));
+	*prev_valid = profile_shadow_valid;
+
+	for (field = 0; field < TUXEDO_IO_PROFILE_FIELDS; ++field) {
+		if (!(valid & PROFILE_FIELD_BIT(field)))
+			continue;
+		result = profile_read_field(ident, field);
+		if (result >= 0) {
+			prev[field] = result;
+			*prev_valid |= PROFILE_FIELD_BIT(field);
+		} else if (result != -ENODATA) {
+			*prev_valid &= ~PROFILE_FIELD_BIT(field);
+		}
+	}
+}
+
+static int profile_write_field(const struct tuxedo_io_ident_t *ident, int field, u32 value)
+{
+	int result, err;
+
+	// Manual fan mode is only entered by setting speeds
+	if (field == TUXEDO_IO_PROFILE_UW_FANAUTO && value == 0)
+		return 0;
+
+	err = profile_exec_field(ident, field, value);
+	if (err)
+		return err;
+
+	result = profile_read_field(ident, field);
+	if (result == -ENODATA)
+		return 0;
+	if (result < 0)
+		return result;
+
+	return (u32) result == value ? 0 : -EIO;
+}
+
+static void profile_rollback(const struct tuxedo_io_ident_t *ident, u32 changed,
+			     const u32 *prev, u32 prev_valid)
+{
+	int field, err;
+
+	for (field = TUXEDO_IO_PROFILE_FIELDS - 1; field >= 0; --field) {
+		if (!(changed & PROFILE_FIELD_BIT(field)))
+			continue;
+
+		if (field == TUXEDO_IO_PROFILE_UW_FANAUTO && prev[field] == 0) {
+			// Back to manual mode with the previous speeds if known
+			err = 0;
+			if (prev_valid & PROFILE_FIELD_BIT(TUXEDO_IO_PROFILE_UW_FANSPEED))
+				err = profile_write_field(ident, TUXEDO_IO_PROFILE_UW_FANSPEED,
+							  prev[TUXEDO_IO_PROFILE_UW_FANSPEED]);
+			if (!err && (prev_valid & PROFILE_FIELD_BIT(TUXEDO_IO_PROFILE_UW_FANSPEED2)))
+				err = profile_write_field(ident, TUXEDO_IO_PROFILE_UW_FANSPEED2,
+							  prev[TUXEDO_IO_PROFILE_UW_FANSPEED2]);
+		} else if (prev_valid & PROFILE_FIELD_BIT(field))
+			err = profile_write_field(ident, field, prev[field]);
+		else if (PROFILE_FIELD_BIT(field) & PROFILE_FIELDS_UW_FANSPEEDS)
+			// Unknown previous speed, fall back to automatic fan control
+			err = profile_exec_field(ident, TUXEDO_IO_PROFILE_UW_FANAUTO, 1);
+		else
+			err = -ENODATA;
+
+		if (err)
+			pr_warn("profile rollback of field %d failed (%d)\n", field, err);
+	}
+}
+
+/**
+ * Apply a complete profile in one hold of the vendor interface, see
+ * struct tuxedo_io_profile
+ */
+static long profile_apply_ioctl_interface(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	struct tuxedo_io_profile profile;
+	struct tuxedo_io_ident_t ident;
+	u32 prev[TUXEDO_IO_PROFILE_FIELDS];
+	u32 prev_valid, changed = 0;
+	u32 fields_uw = PROFILE_FIELD_BIT(TUXEDO_IO_PROFILE_CL_PERF_PROFILE) - 1;
+	int field, err = 0;
+
+	if (copy_from_user(&profile, (void __user *) arg, sizeof(profile)))
+		return -EFAULT;
+
+	if (profile.valid & ~(PROFILE_FIELD_BIT(TUXEDO_IO_PROFILE_FIELDS) - 1))
+		return -EINVAL;
+	if ((profile.valid & PROFILE_FIELD_BIT(TUXEDO_IO_PROFILE_UW_FANAUTO)) &&
+	    profile.value[TUXEDO_IO_PROFILE_UW_FANAUTO] != 0 &&
+	    (profile.valid & PROFILE_FIELDS_UW_FANSPEEDS))
+		return -EINVAL;
+
+	profile.failed_field = -1;
+
+	mutex_lock(&tuxedo_io_lock);
+	tuxedo_io_ident_get(&ident);
+
+	if (((profile.valid & fields_uw) && ident.id_check_uniwill != 1) ||
+	    ((profile.valid & ~fields_uw) && ident.id_check_clevo != 1)) {
+		mutex_unlock(&tuxedo_io_lock);
+		return -ENODEV;
+	}
+
+	if (ident.id_check_clevo == 1)
+		clevo_method_session_begin();
+	if (ident.id_check_uniwill == 1)
+		uniwill_ec_session_begin();
+
+	profile_read_current(&ident, profile.valid, prev, &prev_valid);
+
+	for (field = 0; field < TUXEDO_IO_PROFILE_FIELDS; ++field) {
+		if (!(profile.valid & PROFILE_FIELD_BIT(field)))
+			continue;
+		if ((prev_valid & PROFILE_FIELD_BIT(field)) && prev[field] == profile.value[field])
+			continue;
+
+		// Also counts on failure, the write might have partially happened
+		changed |= PROFILE_FIELD_BIT(field);
+		err = profile_write_field(&ident, field, profile.value[field]);
+		if (err) {
+			profile.failed_field = field;
+			break;
+		}
+	}
+
+	if (err) {
+		profile_rollback(&ident, changed, prev, prev_valid);
+		changed = 0;
+	}
+
+	if (ident.id_check_uniwill == 1)
+		uniwill_ec_session_end();
+	if (ident.id_check_clevo == 1)
+		clevo_method_session_end();
+
+	mutex_unlock(&tuxedo_io_lock);
+
+	profile.changed = changed;
+	if (copy_to_user((void __user *) arg, &profile, sizeof(profile)))
+		return -EFAULT;
+
+	return err;
+}
+
+static unsigned int status_interval_ms = 1000;
+module_param(status_interval_ms, uint, 0644);
+MODULE_PARM_DESC(status_interval_ms, "Sample period of the mmap() status page in ms (min 100)");
+
+static struct tuxedo_io_status *status_page;
+static atomic_t status_page_mappings = ATOMIC_INIT(0);
+
+static void status_page_sample_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(status_page_sample_work, status_page_sample_work_fn);
+
+static unsigned long status_page_interval(void)
+{
+	return msecs_to_jiffies(max(status_interval_ms, 100U));
+}
+
+static int32_t status_page_read(struct tuxedo_io_ident_t *ident, unsigned int cmd)
+{
+	u32 value = 0;
+	int op_status = 0;
+	long ret;
+
+	if (_IOC_TYPE(cmd) == MAGIC_READ_UW)
+		ret = uniwill_ioctl_exec(ident, cmd, &value, &op_status);
+	else
+		ret = clevo_ioctl_exec(cmd, &value, &op_status);
+
+	if (ret != 0)
+		return ret;
+	if (op_status != 0)
+		return op_status;
+
+	return value;
+}
+
+/**
+ * Read all status values and publish them on the status page. The hardware
+ * is read into a local copy first so the seq window stays short.
+ */
+static void status_page_sample(void)
+{
+	struct tuxedo_io_status sample;
+	struct tuxedo_io_ident_t ident;
+	u32 seq;
+	int i;
+
+	memset(&sample, 0, sizeof(sample));
+	tuxedo_io_ident_get(&ident);
+
+	if (ident.id_check_uniwill == 1) {
+		uniwill_ec_session_begin();
+		sample.uw_fanspeed[0] = status_page_read(&ident, R_UW_FANSPEED);
+		sample.uw_fanspeed[1] = status_page_read(&ident, R_UW_FANSPEED2);
+		sample.uw_fan_temp[0] = status_page_read(&ident, R_UW_FAN_TEMP);
+		sample.uw_fan_temp[1] = status_page_read(&ident, R_UW_FAN_TEMP2);
+		for (i = 0; i < TUXEDO_TDP_COUNT; ++i)
+			sample.uw_tdp[i] = status_page_read(&ident, R_UW_TDP0 + i);
+		sample.uw_mode = status_page_read(&ident, R_UW_MODE);
+		sample.uw_kbd_bl_status = status_page_read(&ident, R_UW_KBD_BL_STATUS);
+		uniwill_ec_session_end();
+		sample.valid |= TUXEDO_IO_STATUS_VALID_UW;
+	}
+
+	if (ident.id_check_clevo == 1) {
+		clevo_method_session_begin();
+		sample.cl_faninfo[0] = status_page_read(&ident, R_CL_FANINFO1);
+		sample.cl_faninfo[1] = status_page_read(&ident, R_CL_FANINFO2);
+		sample.cl_faninfo[2] = status_page_read(&ident, R_CL_FANINFO3);
+		clevo_method_session_end();
+		sample.valid |= TUXEDO_IO_STATUS_VALID_CL;
+	}
+
+	sample.ac_online = power_supply_is_system_supplied() > 0 ? 1 : 0;
+	sample.valid |= TUXEDO_IO_STATUS_VALID_AC;
+	sample.version = TUXEDO_IO_STATUS_VERSION;
+	sample.timestamp_ns = ktime_get_ns();
+
+	// Open coded seqcount since the layout is shared with user space
+	seq = READ_ONCE(status_page->seq);
+	WRITE_ONCE(status_page->seq, seq + 1);
+	smp_wmb();
+	sample.seq = seq + 1;
+	memcpy(status_page, &sample, sizeof(sample));
+	smp_wmb();
+	WRITE_ONCE(status_page->seq, seq + 2);
+}
+
+static void status_page_sample_work_fn(struct work_struct *work)
+{
+	if (atomic_read(&status_page_mappings) == 0)
+		return;
+
+	status_page_sample();
+	schedule_delayed_work(&status_page_sample_work, status_page_interval());
+}
+
+static void status_page_vm_open(struct vm_area_struct *vma)
+{
+	atomic_inc(&status_page_mappings);
+}
+
+// Sampling stops on the next period once the last mapping is gone
+static void status_page_vm_close(struct vm_area_struct *vma)
+{
+	atomic_dec(&status_page_mappings);
+}
+
+static const struct vm_operations_struct status_page_vm_ops = {
+	.open = status_page_vm_open,
+	.close = status_page_vm_close,
+};
+
+static int fop_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	int err;
+
+	if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start != PAGE_SIZE)
+		return -EINVAL;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 3, 0)
+	vma->vm_flags &= ~VM_MAYWRITE;
+#else
+	vm_flags_clear(vma, VM_MAYWRITE);
+#endif
+
+	err = remap_pfn_range(vma, vma->vm_start,
+			      virt_to_phys(status_page) >> PAGE_SHIFT,
+			      PAGE_SIZE, vma->vm_page_prot);
+	if (err)
+		return err;
+
+	vma->vm_ops = &status_page_vm_ops;
+	if (atomic_inc_return(&status_page_mappings) == 1)
+		mod_delayed_work(system_wq, &status_page_sample_work, 0);
+
 	return 0;
 }
 
@@ -778,6 +1346,8 @@ static long fop_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	u32 status;
 	// u32 result = 0;
 	u32 copy_result;
+	struct tuxedo_io_ident_t ident;
+	int err;
 
 	const char *module_version = THIS_MODULE->version;
 	switch (cmd) {
@@ -786,13 +1356,23 @@ static long fop_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			break;
 		// Hardware id checks, 1 = positive, 0 = negative
 		case R_HWCHECK_CL:
-			id_check_clevo = clevo_identify();
-			copy_result = copy_to_user((void *) arg, (void *) &id_check_clevo, sizeof(id_check_clevo));
+			err = tuxedo_io_identify(true, false, false, &ident);
+			if (err)
+				return err;
+			copy_result = copy_to_user((void *) arg, (void *) &ident.id_check_clevo, sizeof(ident.id_check_clevo));
 			break;
 		case R_HWCHECK_UW:
-			id_check_uniwill = uniwill_identify();
-			copy_result = copy_to_user((void *) arg, (void *) &id_check_uniwill, sizeof(id_check_uniwill));
+			err = tuxedo_io_identify(false, true, false, &ident);
+			if (err)
+				return err;
+			copy_result = copy_to_user((void *) arg, (void *) &ident.id_check_uniwill, sizeof(ident.id_check_uniwill));
 			break;
+		case W_HWRESCAN:
+			return tuxedo_io_identify(true, true, true, &ident);
+		case W_BATCH:
+			return batch_ioctl_interface(file, cmd, arg);
+		case W_PROFILE_APPLY:
+			return profile_apply_ioctl_interface(file, cmd, arg);
 	}
 
 	status = clevo_ioctl_interface(file, cmd, arg);
@@ -805,7 +1385,8 @@ static long fop_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 
 static struct file_operations fops_dev = {
 	.owner              = THIS_MODULE,
-	.unlocked_ioctl     = fop_ioctl
+	.unlocked_ioctl     = fop_ioctl,
+	.mmap               = fop_mmap
 //	.open               = fop_open,
 //	.release            = fop_release
 };
@@ -818,15 +1399,22 @@ static struct cdev tuxedo_io_cdev;
 static int __init tuxedo_io_init(void)
 {
 	int err;
+	struct tuxedo_io_ident_t ident;
 
 	// Hardware identification
-	id_check_clevo = clevo_identify();
-	id_check_uniwill = uniwill_identify();
+	err = tuxedo_io_identify(true, true, false, &ident);
+	if (err)
+		return err;
+
+	status_page = (struct tuxedo_io_status *) get_zeroed_page(GFP_KERNEL);
+	if (status_page == NULL)
+		return -ENOMEM;
+	status_page->version = TUXEDO_IO_STATUS_VERSION;
 
 #ifdef DEBUG
 	pr_debug("DEBUG is defined\n");
 
-	if (id_check_clevo == 0 && id_check_uniwill == 0) {
+	if (ident.id_check_clevo == 0 && ident.id_check_uniwill == 0) {
 		pr_debug("No matching hardware found on module load\n");
 	}
 #endif
@@ -834,6 +1422,7 @@ static int __init tuxedo_io_init(void)
 	err = alloc_chrdev_region(&tuxedo_io_device_handle, 0, 1, "tuxedo_io_cdev");
 	if (err != 0) {
 		pr_err("Failed to allocate chrdev region\n");
+		free_page((unsigned long) status_page);
 		return err;
 	}
 	cdev_init(&tuxedo_io_cdev, &fops_dev);
@@ -857,10 +1446,22 @@ static int __init tuxedo_io_init(void)
 
 static void __exit tuxedo_io_exit(void)
 {
+	struct tuxedo_io_ident_t *ident;
+
 	device_destroy(tuxedo_io_device_class, tuxedo_io_device_handle);
 	class_destroy(tuxedo_io_device_class);
 	cdev_del(&tuxedo_io_cdev);
 	unregister_chrdev_region(tuxedo_io_device_handle, 1);
+
+	cancel_delayed_work_sync(&status_page_sample_work);
+	free_page((unsigned long) status_page);
+
+	ident = rcu_dereference_protected(tuxedo_io_ident, true);
+	RCU_INIT_POINTER(tuxedo_io_ident, &tuxedo_io_ident_none);
+	synchronize_rcu();
+	if (ident != &tuxedo_io_ident_none)
+		kfree(ident);
+
 	pr_debug("Module exit\n");
 }
 
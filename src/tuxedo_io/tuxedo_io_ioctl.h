@@ -33,6 +33,91 @@
 
 #define R_HWCHECK_CL		_IOR(IOCTL_MAGIC, 0x05, int32_t*)
 #define R_HWCHECK_UW		_IOR(IOCTL_MAGIC, 0x06, int32_t*)
+// Hardware checks are memoized once complete, force a new identification
+#define W_HWRESCAN		_IO(IOCTL_MAGIC, 0x07)
+
+/**
+ * Batch of single value commands (R_CL_*, W_CL_*, R_UW_*, W_UW_* except the
+ * interface strings) executed in order within one hold of the vendor
+ * interface lock
+ */
+#define TUXEDO_IO_BATCH_MAX_ENTRIES	64
+
+// Commands waiting for the hardware (W_CL_FANSPEED, W_UW_FANSPEED,
+// W_UW_FANSPEED2) allowed per batch, they run outside the interface hold
+#define TUXEDO_IO_BATCH_MAX_SLEEPING	2
+
+// Skip (-ECANCELED) all entries after the first failing one
+#define TUXEDO_IO_BATCH_STOP_ON_ERROR	0x01
+
+struct tuxedo_io_batch_entry {
+	uint32_t cmd;		// in: command
+	int32_t status;		// out: 0 or negative error code
+	uint32_t value;		// in: argument of W_* commands, out: result of R_* commands
+};
+
+struct tuxedo_io_batch {
+	uint32_t count;		// number of entries, max TUXEDO_IO_BATCH_MAX_ENTRIES
+	uint32_t flags;
+	uint64_t entries;	// pointer to struct tuxedo_io_batch_entry[count]
+};
+
+#define W_BATCH			_IOWR(IOCTL_MAGIC, 0x10, struct tuxedo_io_batch*)
+
+/**
+ * Complete target profile applied as one transaction
+ *
+ * Fields already at the target value are skipped, written values are read
+ * back where the hardware allows it. If any step fails all changed fields
+ * are restored to their previous state.
+ */
+#define TUXEDO_IO_PROFILE_UW_PERF_PROF		0	// as W_UW_PERF_PROF
+#define TUXEDO_IO_PROFILE_UW_TDP0		1	// as W_UW_TDP0
+#define TUXEDO_IO_PROFILE_UW_TDP1		2	// as W_UW_TDP1
+#define TUXEDO_IO_PROFILE_UW_TDP2		3	// as W_UW_TDP2
+#define TUXEDO_IO_PROFILE_UW_FANSPEED		4	// as W_UW_FANSPEED
+#define TUXEDO_IO_PROFILE_UW_FANSPEED2		5	// as W_UW_FANSPEED2
+#define TUXEDO_IO_PROFILE_UW_FANAUTO		6	// 1 = W_UW_FANAUTO, excludes fan speeds
+#define TUXEDO_IO_PROFILE_CL_PERF_PROFILE	7	// as W_CL_PERF_PROFILE
+#define TUXEDO_IO_PROFILE_FIELDS		8
+
+struct tuxedo_io_profile {
+	uint32_t valid;					// in: bit (1 << field) per field to apply
+	uint32_t value[TUXEDO_IO_PROFILE_FIELDS];	// in: target value per field
+	uint32_t changed;				// out: fields written (0 after rollback)
+	int32_t failed_field;				// out: field that failed or -1
+};
+
+#define W_PROFILE_APPLY		_IOWR(IOCTL_MAGIC, 0x11, struct tuxedo_io_profile*)
+
+/**
+ * Status page, mmap() a single read-only page at offset 0 of the device
+ *
+ * Sampled periodically by the module while at least one mapping exists.
+ * seq is odd while an update is in progress, readers retry until they read
+ * the same even seq before and after copying the fields.
+ */
+#define TUXEDO_IO_STATUS_VERSION	1
+
+#define TUXEDO_IO_STATUS_VALID_UW	0x01	// uw_* fields are sampled
+#define TUXEDO_IO_STATUS_VALID_CL	0x02	// cl_* fields are sampled
+#define TUXEDO_IO_STATUS_VALID_AC	0x04	// ac_online is sampled
+
+struct tuxedo_io_status {
+	uint32_t seq;
+	uint32_t version;
+	uint64_t timestamp_ns;		// CLOCK_MONOTONIC of the last sample
+	uint32_t valid;
+	uint32_t ac_online;
+	// Values as returned by the corresponding R_UW_* command
+	int32_t uw_fanspeed[2];
+	int32_t uw_fan_temp[2];
+	int32_t uw_tdp[3];
+	int32_t uw_mode;
+	int32_t uw_kbd_bl_status;
+	// Values as returned by R_CL_FANINFO1-3
+	int32_t cl_faninfo[3];
+};
 
 /**
  * Clevo interface
@@ -94,6 +179,7 @@
 #define R_UW_TDP2_MAX		_IOR(MAGIC_READ_UW, 0x20, int32_t*)
 
 #define R_UW_PROFS_AVAILABLE	_IOR(MAGIC_READ_UW, 0x21, int32_t*)
+#define R_UW_KBD_BL_STATUS	_IOR(MAGIC_READ_UW, 0x22, int32_t*)
 
 // Write
 #define W_UW_FANSPEED		_IOW(MAGIC_WRITE_UW, 0x10, int32_t*)
@@ -0,0 +1,499 @@
+/*!
+ * Copyright (c) 2023 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-keyboard.
+ *
+ * tuxedo-keyboard is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef TUXEDO_KBD_EFFECTS_H
+#define TUXEDO_KBD_EFFECTS_H
+
+#include <linux/types.h>
+#include <linux/platform_device.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/seq_file.h>
+#include <linux/version.h>
+#include "tuxedo_keyboard_common.h"
+
+/**
+ * Software keyboard lighting effects for RGB keyboards without (suitable)
+ * firmware animations.
+ *
+ * An hrtimer ticks the frames, the zone writes happen in a work item. A tick
+ * arriving while the previous frame is still being written is dropped, frames
+ * never queue up. The interval follows the measured cost of a frame so that
+ * the effect occupies at most 1/TUXEDO_KBD_EFFECT_DUTY_DIVISOR of the EC/WMI
+ * bandwidth and fan control and other users always get their turn.
+ */
+
+#define TUXEDO_KBD_EFFECT_MAX_ZONES		3
+
+#define TUXEDO_KBD_EFFECT_INTERVAL_MIN_MS	33
+#define TUXEDO_KBD_EFFECT_INTERVAL_MAX_MS	200
+#define TUXEDO_KBD_EFFECT_DUTY_DIVISOR		4
+
+#define TUXEDO_KBD_EFFECT_PERIOD_MIN_MS		500
+#define TUXEDO_KBD_EFFECT_PERIOD_MAX_MS		60000
+#define TUXEDO_KBD_EFFECT_PERIOD_DEFAULT_MS	4000
+
+// Hue in 1/256 steps per color wheel sector
+#define TUXEDO_KBD_EFFECT_HUE_MAX		(6 * 256)
+
+enum tuxedo_kbd_effect {
+	TUXEDO_KBD_EFFECT_NONE = 0,
+	TUXEDO_KBD_EFFECT_BREATHE,
+	TUXEDO_KBD_EFFECT_CYCLE,
+	TUXEDO_KBD_EFFECT_WAVE,
+	TUXEDO_KBD_EFFECT_MAX
+};
+
+static const char * const tuxedo_kbd_effect_names[TUXEDO_KBD_EFFECT_MAX] = {
+	[TUXEDO_KBD_EFFECT_NONE] = "none",
+	[TUXEDO_KBD_EFFECT_BREATHE] = "breathe",
+	[TUXEDO_KBD_EFFECT_CYCLE] = "cycle",
+	[TUXEDO_KBD_EFFECT_WAVE] = "wave"
+};
+
+/**
+ * Vendor backend of the effect engine
+ *
+ * frame_begin/frame_end (optional) bracket the zone writes of one frame, e.g.
+ * to hold the vendor session. write_zone gets a 0xRRGGBB color at full scale,
+ * brightness is up to the backend. restore writes back the LED class state
+ * once an effect is stopped.
+ */
+struct tuxedo_kbd_effects_ops_t {
+	int zones;
+	void (*frame_begin)(void);
+	void (*frame_end)(void);
+	int (*write_zone)(int zone, u32 color);
+	void (*restore)(void);
+};
+
+static struct tuxedo_kbd_effects_t {
+	const struct tuxedo_kbd_effects_ops_t *ops;
+	bool initialized;
+	bool suspended;
+	// Serializes effect switching, suspend/resume and remove
+	struct mutex control_lock;
+	// Protects the effect parameters, held while a frame is written
+	struct mutex lock;
+	enum tuxedo_kbd_effect effect;
+	u32 color;
+	u32 period_ms;
+	ktime_t start;
+	struct hrtimer timer;
+	struct work_struct frame_work;
+	unsigned long frame_busy;
+	u64 interval_ns;
+	u64 cost_avg_ns;
+	// Statistics
+	u64 frames;
+	u64 frames_skipped;
+	u64 frame_errors;
+	u64 cost_max_ns;
+	struct dentry *stats_dentry;
+} tuxedo_kbd_effects = {
+	.control_lock = __MUTEX_INITIALIZER(tuxedo_kbd_effects.control_lock),
+	.lock = __MUTEX_INITIALIZER(tuxedo_kbd_effects.lock),
+	.color = 0xffffff,
+	.period_ms = TUXEDO_KBD_EFFECT_PERIOD_DEFAULT_MS,
+};
+
+static u32 tuxedo_kbd_effects_hue_to_rgb(u32 hue)
+{
+	u32 f = hue & 0xff;
+
+	switch ((hue % TUXEDO_KBD_EFFECT_HUE_MAX) >> 8) {
+	case 0:
+		return 0xff0000 | (f << 8);
+	case 1:
+		return ((0xff - f) << 16) | 0x00ff00;
+	case 2:
+		return 0x00ff00 | f;
+	case 3:
+		return ((0xff - f) << 8) | 0x0000ff;
+	case 4:
+		return (f << 16) | 0x0000ff;
+	default:
+		return 0xff0000 | (0xff - f);
+	}
+}
+
+static u32 tuxedo_kbd_effects_scale(u32 color, u32 level)
+{
+	u32 red = (((color >> 16) & 0xff) * level) >> 8;
+	u32 green = (((color >> 8) & 0xff) * level) >> 8;
+	u32 blue = ((color & 0xff) * level) >> 8;
+
+	return (red << 16) | (green << 8) | blue;
+}
+
+/**
+ * Compute the zone colors of the current effect, elapsed time since the
+ * effect started
+ */
+static void tuxedo_kbd_effects_render(struct tuxedo_kbd_effects_t *fx, ktime_t elapsed, u32 *colors)
+{
+	int zone, zones = fx->ops->zones;
+	u32 phase, level, hue;
+
+	div_u64_rem(ktime_to_ms(elapsed), fx->period_ms, &phase);
+
+	switch (fx->effect) {
+	case TUXEDO_KBD_EFFECT_BREATHE:
+		// Triangle wave 0..256, squared for a perceptually smoother fade
+		if (phase < fx->period_ms / 2)
+			level = (phase * 512) / fx->period_ms;
+		else
+			level = ((fx->period_ms - phase) * 512) / fx->period_ms;
+		level = (level * level) >> 8;
+		for (zone = 0; zone < zones; ++zone)
+			colors[zone] = tuxedo_kbd_effects_scale(fx->color, level);
+		break;
+	case TUXEDO_KBD_EFFECT_CYCLE:
+	case TUXEDO_KBD_EFFECT_WAVE:
+		hue = (phase * TUXEDO_KBD_EFFECT_HUE_MAX) / fx->period_ms;
+		for (zone = 0; zone < zones; ++zone) {
+			colors[zone] = tuxedo_kbd_effects_hue_to_rgb(hue);
+			if (fx->effect == TUXEDO_KBD_EFFECT_WAVE)
+				hue += TUXEDO_KBD_EFFECT_HUE_MAX / zones;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static void tuxedo_kbd_effects_frame_work_func(struct work_struct *work)
+{
+	struct tuxedo_kbd_effects_t *fx = &tuxedo_kbd_effects;
+	u32 colors[TUXEDO_KBD_EFFECT_MAX_ZONES];
+	ktime_t frame_start;
+	u64 cost_ns, interval_ns;
+	int zone, result = 0;
+
+	mutex_lock(&fx->lock);
+	if (fx->effect == TUXEDO_KBD_EFFECT_NONE || fx->suspended)
+		goto out;
+
+	tuxedo_kbd_effects_render(fx, ktime_sub(ktime_get(), fx->start), colors);
+
+	frame_start = ktime_get();
+	if (fx->ops->frame_begin)
+		fx->ops->frame_begin();
+	for (zone = 0; zone < fx->ops->zones && !result; ++zone)
+		result = fx->ops->write_zone(zone, colors[zone]);
+	if (fx->ops->frame_end)
+		fx->ops->frame_end();
+	cost_ns = ktime_to_ns(ktime_sub(ktime_get(), frame_start));
+
+	fx->frames++;
+	if (result)
+		fx->frame_errors++;
+	if (cost_ns > fx->cost_max_ns)
+		fx->cost_max_ns = cost_ns;
+
+	// Exponentially weighted average, 1/8 weight for the new sample
+	if (fx->cost_avg_ns == 0)
+		fx->cost_avg_ns = cost_ns;
+	else
+		fx->cost_avg_ns = fx->cost_avg_ns - (fx->cost_avg_ns >> 3) + (cost_ns >> 3);
+
+	interval_ns = clamp_t(u64, fx->cost_avg_ns * TUXEDO_KBD_EFFECT_DUTY_DIVISOR,
+			      TUXEDO_KBD_EFFECT_INTERVAL_MIN_MS * NSEC_PER_MSEC,
+			      TUXEDO_KBD_EFFECT_INTERVAL_MAX_MS * NSEC_PER_MSEC);
+	WRITE_ONCE(fx->interval_ns, interval_ns);
+
+out:
+	mutex_unlock(&fx->lock);
+	clear_bit(0, &fx->frame_busy);
+}
+
+static enum hrtimer_restart tuxedo_kbd_effects_timer_func(struct hrtimer *timer)
+{
+	struct tuxedo_kbd_effects_t *fx = container_of(timer, struct tuxedo_kbd_effects_t, timer);
+
+	// Previous frame still in flight, drop this one instead of queueing
+	if (test_and_set_bit(0, &fx->frame_busy))
+		fx->frames_skipped++;
+	else
+		schedule_work(&fx->frame_work);
+
+	hrtimer_forward_now(timer, ns_to_ktime(READ_ONCE(fx->interval_ns)));
+	return HRTIMER_RESTART;
+}
+
+// Called with control_lock held
+static void tuxedo_kbd_effects_start_timer(struct tuxedo_kbd_effects_t *fx)
+{
+	fx->cost_avg_ns = 0;
+	fx->interval_ns = TUXEDO_KBD_EFFECT_INTERVAL_MIN_MS * NSEC_PER_MSEC;
+	hrtimer_start(&fx->timer, ns_to_ktime(fx->interval_ns), HRTIMER_MODE_REL);
+}
+
+// Called with control_lock held
+static void tuxedo_kbd_effects_stop_timer(struct tuxedo_kbd_effects_t *fx)
+{
+	hrtimer_cancel(&fx->timer);
+	cancel_work_sync(&fx->frame_work);
+	clear_bit(0, &fx->frame_busy);
+}
+
+static void tuxedo_kbd_effects_set(enum tuxedo_kbd_effect effect)
+{
+	struct tuxedo_kbd_effects_t *fx = &tuxedo_kbd_effects;
+	enum tuxedo_kbd_effect previous;
+
+	mutex_lock(&fx->control_lock);
+
+	mutex_lock(&fx->lock);
+	previous = fx->effect;
+	fx->effect = effect;
+	fx->start = ktime_get();
+	mutex_unlock(&fx->lock);
+
+	if (!fx->suspended) {
+		if (previous == TUXEDO_KBD_EFFECT_NONE && effect != TUXEDO_KBD_EFFECT_NONE) {
+			tuxedo_kbd_effects_start_timer(fx);
+		}
+		else if (previous != TUXEDO_KBD_EFFECT_NONE && effect == TUXEDO_KBD_EFFECT_NONE) {
+			tuxedo_kbd_effects_stop_timer(fx);
+			fx->ops->restore();
+		}
+	}
+
+	mutex_unlock(&fx->control_lock);
+}
+
+static ssize_t tuxedo_kbd_effects_available_show(struct device *child,
+						 struct device_attribute *attr, char *buffer)
+{
+	int i;
+
+	buffer[0] = '\0';
+	for (i = 0; i < TUXEDO_KBD_EFFECT_MAX; ++i)
+		sprintf(buffer + strlen(buffer), "%s%s", tuxedo_kbd_effect_names[i],
+			i < TUXEDO_KBD_EFFECT_MAX - 1 ? " " : "\n");
+
+	return strlen(buffer);
+}
+
+static ssize_t tuxedo_kbd_effect_show(struct device *child,
+				      struct device_attribute *attr, char *buffer)
+{
+	return sprintf(buffer, "%s\n", tuxedo_kbd_effect_names[READ_ONCE(tuxedo_kbd_effects.effect)]);
+}
+
+static ssize_t tuxedo_kbd_effect_store(struct device *child,
+				       struct device_attribute *attr,
+				       const char *buffer, size_t size)
+{
+	int i;
+
+	for (i = 0; i < TUXEDO_KBD_EFFECT_MAX; ++i)
+		if (sysfs_streq(buffer, tuxedo_kbd_effect_names[i]))
+			break;
+
+	if (i == TUXEDO_KBD_EFFECT_MAX)
+		return -EINVAL;
+
+	tuxedo_kbd_effects_set(i);
+
+	return size;
+}
+
+static ssize_t tuxedo_kbd_effect_color_show(struct device *child,
+					    struct device_attribute *attr, char *buffer)
+{
+	return sprintf(buffer, "0x%06x\n", READ_ONCE(tuxedo_kbd_effects.color));
+}
+
+static ssize_t tuxedo_kbd_effect_color_store(struct device *child,
+					     struct device_attribute *attr,
+					     const char *buffer, size_t size)
+{
+	u32 color;
+	int err = kstrtouint(buffer, 0, &color);
+
+	if (err)
+		return err;
+	if (color > 0xffffff)
+		return -EINVAL;
+
+	mutex_lock(&tuxedo_kbd_effects.lock);
+	tuxedo_kbd_effects.color = color;
+	mutex_unlock(&tuxedo_kbd_effects.lock);
+
+	return size;
+}
+
+static ssize_t tuxedo_kbd_effect_period_ms_show(struct device *child,
+						struct device_attribute *attr, char *buffer)
+{
+	return sprintf(buffer, "%u\n", READ_ONCE(tuxedo_kbd_effects.period_ms));
+}
+
+static ssize_t tuxedo_kbd_effect_period_ms_store(struct device *child,
+						 struct device_attribute *attr,
+						 const char *buffer, size_t size)
+{
+	u32 period_ms;
+	int err = kstrtouint(buffer, 0, &period_ms);
+
+	if (err)
+		return err;
+	if (period_ms < TUXEDO_KBD_EFFECT_PERIOD_MIN_MS || period_ms > TUXEDO_KBD_EFFECT_PERIOD_MAX_MS)
+		return -EINVAL;
+
+	mutex_lock(&tuxedo_kbd_effects.lock);
+	tuxedo_kbd_effects.period_ms = period_ms;
+	mutex_unlock(&tuxedo_kbd_effects.lock);
+
+	return size;
+}
+
+struct tuxedo_kbd_effects_attrs_t {
+	struct device_attribute effects_available;
+	struct device_attribute effect;
+	struct device_attribute color;
+	struct device_attribute period_ms;
+} tuxedo_kbd_effects_attrs = {
+	.effects_available = __ATTR(effects_available, 0444, tuxedo_kbd_effects_available_show, NULL),
+	.effect = __ATTR(effect, 0644, tuxedo_kbd_effect_show, tuxedo_kbd_effect_store),
+	.color = __ATTR(color, 0644, tuxedo_kbd_effect_color_show, tuxedo_kbd_effect_color_store),
+	.period_ms = __ATTR(period_ms, 0644, tuxedo_kbd_effect_period_ms_show, tuxedo_kbd_effect_period_ms_store)
+};
+
+static struct attribute *tuxedo_kbd_effects_attrs_list[] = {
+	&tuxedo_kbd_effects_attrs.effects_available.attr,
+	&tuxedo_kbd_effects_attrs.effect.attr,
+	&tuxedo_kbd_effects_attrs.color.attr,
+	&tuxedo_kbd_effects_attrs.period_ms.attr,
+	NULL
+};
+
+static struct attribute_group tuxedo_kbd_effects_attr_group = {
+	.name = "kbd_effect",
+	.attrs = tuxedo_kbd_effects_attrs_list
+};
+
+static int tuxedo_kbd_effects_stats_show(struct seq_file *s, void *unused)
+{
+	struct tuxedo_kbd_effects_t *fx = &tuxedo_kbd_effects;
+
+	mutex_lock(&fx->lock);
+	seq_printf(s, "effect: %s\n", tuxedo_kbd_effect_names[fx->effect]);
+	seq_printf(s, "zones: %d\n", fx->ops->zones);
+	seq_printf(s, "frames: %llu\n", fx->frames);
+	seq_printf(s, "frames_skipped: %llu\n", fx->frames_skipped);
+	seq_printf(s, "frame_errors: %llu\n", fx->frame_errors);
+	seq_printf(s, "frame_cost_avg_us: %llu\n", div_u64(fx->cost_avg_ns, NSEC_PER_USEC));
+	seq_printf(s, "frame_cost_max_us: %llu\n", div_u64(fx->cost_max_ns, NSEC_PER_USEC));
+	seq_printf(s, "interval_ms: %llu\n", div_u64(READ_ONCE(fx->interval_ns), NSEC_PER_MSEC));
+	mutex_unlock(&fx->lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(tuxedo_kbd_effects_stats);
+
+/**
+ * Register the effect engine for a keyboard, ops must stay valid until
+ * tuxedo_kbd_effects_remove()
+ */
+static int tuxedo_kbd_effects_init(struct platform_device *dev, const struct tuxedo_kbd_effects_ops_t *ops)
+{
+	struct tuxedo_kbd_effects_t *fx = &tuxedo_kbd_effects;
+	int result;
+
+	if (fx->initialized)
+		return -EBUSY;
+	if (ops->zones < 1 || ops->zones > TUXEDO_KBD_EFFECT_MAX_ZONES)
+		return -EINVAL;
+
+	fx->ops = ops;
+	fx->effect = TUXEDO_KBD_EFFECT_NONE;
+	fx->suspended = false;
+	fx->frame_busy = 0;
+	INIT_WORK(&fx->frame_work, tuxedo_kbd_effects_frame_work_func);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+	hrtimer_setup(&fx->timer, tuxedo_kbd_effects_timer_func, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+#else
+	hrtimer_init(&fx->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	fx->timer.function = tuxedo_kbd_effects_timer_func;
+#endif
+
+	result = sysfs_create_group(&dev->dev.kobj, &tuxedo_kbd_effects_attr_group);
+	if (result) {
+		pr_err("Keyboard effects sysfs group creation failed\n");
+		return result;
+	}
+
+	fx->stats_dentry = debugfs_create_file("kbd_effects_stats", 0444, tuxedo_debugfs_root,
+					       NULL, &tuxedo_kbd_effects_stats_fops);
+	fx->initialized = true;
+
+	return 0;
+}
+
+static void tuxedo_kbd_effects_remove(struct platform_device *dev)
+{
+	struct tuxedo_kbd_effects_t *fx = &tuxedo_kbd_effects;
+
+	if (!fx->initialized)
+		return;
+
+	sysfs_remove_group(&dev->dev.kobj, &tuxedo_kbd_effects_attr_group);
+	debugfs_remove(fx->stats_dentry);
+	fx->stats_dentry = NULL;
+
+	mutex_lock(&fx->control_lock);
+	tuxedo_kbd_effects_stop_timer(fx);
+	fx->effect = TUXEDO_KBD_EFFECT_NONE;
+	fx->initialized = false;
+	mutex_unlock(&fx->control_lock);
+}
+
+static void tuxedo_kbd_effects_suspend(void)
+{
+	struct tuxedo_kbd_effects_t *fx = &tuxedo_kbd_effects;
+
+	if (!fx->initialized)
+		return;
+
+	mutex_lock(&fx->control_lock);
+	fx->suspended = true;
+	tuxedo_kbd_effects_stop_timer(fx);
+	mutex_unlock(&fx->control_lock);
+}
+
+static void tuxedo_kbd_effects_resume(void)
+{
+	struct tuxedo_kbd_effects_t *fx = &tuxedo_kbd_effects;
+
+	if (!fx->initialized)
+		return;
+
+	mutex_lock(&fx->control_lock);
+	fx->suspended = false;
+	if (fx->effect != TUXEDO_KBD_EFFECT_NONE)
+		tuxedo_kbd_effects_start_timer(fx);
+	mutex_unlock(&fx->control_lock);
+}
+
+#endif // TUXEDO_KBD_EFFECTS_H
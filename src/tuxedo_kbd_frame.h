@@ -0,0 +1,301 @@
+/*!
+ * Copyright (c) 2023 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-keyboard.
+ *
+ * tuxedo-keyboard is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef TUXEDO_KBD_FRAME_H
+#define TUXEDO_KBD_FRAME_H
+
+#include <linux/types.h>
+#include <linux/bitmap.h>
+#include <linux/fs.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/miscdevice.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/srcu.h>
+#include <linux/uaccess.h>
+#include "tuxedo_keyboard_common.h"
+
+/**
+ * Per-key RGB frames
+ *
+ * A frame holds one color per key, 3 bytes (red, green, blue) per key in key
+ * index order. Each frame is diffed against the last applied one and only
+ * changed keys are sent, all within one batch (vendor session). Frames where
+ * every key has the same color go out as a single fill if the backend can.
+ */
+
+#define TUXEDO_KBD_FRAME_MAX_KEYS	256
+#define TUXEDO_KBD_FRAME_BYTES_PER_KEY	3
+
+struct tuxedo_kbd_frame_ops_t {
+	unsigned int keys;
+	// Optional, bracket the writes of one frame
+	void (*batch_begin)(void *priv);
+	void (*batch_end)(void *priv);
+	int (*write_key)(void *priv, unsigned int key, u32 color);
+	// Optional, set all keys to one color at once
+	int (*fill)(void *priv, u32 color);
+};
+
+struct tuxedo_kbd_frame_t {
+	const struct tuxedo_kbd_frame_ops_t *ops;
+	void *priv;
+	// Serializes frames, protects everything below
+	struct mutex lock;
+	u32 applied[TUXEDO_KBD_FRAME_MAX_KEYS];
+	DECLARE_BITMAP(applied_valid, TUXEDO_KBD_FRAME_MAX_KEYS);
+	// Statistics
+	u64 frames;
+	u64 keys_written;
+	u64 keys_skipped;
+	u64 fills;
+	u64 errors;
+	u64 frame_ns_sum;
+	u64 frame_ns_max;
+};
+
+static void tuxedo_kbd_frame_init(struct tuxedo_kbd_frame_t *frame, const struct tuxedo_kbd_frame_ops_t *ops,
+				  void *priv)
+{
+	memset(frame, 0, sizeof(*frame));
+	frame->ops = ops;
+	frame->priv = priv;
+	mutex_init(&frame->lock);
+}
+
+/**
+ * Forget what was applied, e.g. after resume. The next frame is sent in full.
+ */
+static void tuxedo_kbd_frame_invalidate(struct tuxedo_kbd_frame_t *frame)
+{
+	mutex_lock(&frame->lock);
+	bitmap_zero(frame->applied_valid, TUXEDO_KBD_FRAME_MAX_KEYS);
+	mutex_unlock(&frame->lock);
+}
+
+static size_t tuxedo_kbd_frame_size(struct tuxedo_kbd_frame_t *frame)
+{
+	return frame->ops->keys * TUXEDO_KBD_FRAME_BYTES_PER_KEY;
+}
+
+/**
+ * Apply a frame of tuxedo_kbd_frame_size() bytes
+ */
+static int tuxedo_kbd_frame_apply(struct tuxedo_kbd_frame_t *frame, const u8 *data, size_t size)
+{
+	const struct tuxedo_kbd_frame_ops_t *ops = frame->ops;
+	unsigned int key, changed = 0;
+	bool uniform = true;
+	u32 color;
+	ktime_t start;
+	u64 frame_ns;
+	int result = 0, key_result;
+
+	if (size != tuxedo_kbd_frame_size(frame))
+		return -EINVAL;
+
+	mutex_lock(&frame->lock);
+	start = ktime_get();
+
+	for (key = 0; key < ops->keys; ++key) {
+		color = (data[key * 3] << 16) | (data[key * 3 + 1] << 8) | data[key * 3 + 2];
+		if (!test_bit(key, frame->applied_valid) || frame->applied[key] != color)
+			changed++;
+		if (key > 0 && color != ((data[0] << 16) | (data[1] << 8) | data[2]))
+			uniform = false;
+	}
+
+	if (changed == 0) {
+		frame->keys_skipped += ops->keys;
+		goto out;
+	}
+
+	if (ops->batch_begin)
+		ops->batch_begin(frame->priv);
+
+	if (uniform && ops->fill && changed > 1) {
+		color = (data[0] << 16) | (data[1] << 8) | data[2];
+		result = ops->fill(frame->priv, color);
+		if (result) {
+			bitmap_zero(frame->applied_valid, TUXEDO_KBD_FRAME_MAX_KEYS);
+			frame->errors++;
+		} else {
+			for (key = 0; key < ops->keys; ++key)
+				frame->applied[key] = color;
+			bitmap_fill(frame->applied_valid, ops->keys);
+			frame->fills++;
+			frame->keys_skipped += ops->keys - changed;
+		}
+	} else {
+		for (key = 0; key < ops->keys; ++key) {
+			color = (data[key * 3] << 16) | (data[key * 3 + 1] << 8) | data[key * 3 + 2];
+			if (test_bit(key, frame->applied_valid) && frame->applied[key] == color) {
+				frame->keys_skipped++;
+				continue;
+			}
+			key_result = ops->write_key(frame->priv, key, color);
+			if (key_result) {
+				// Keep going, one failing key shouldn't freeze the rest
+				clear_bit(key, frame->applied_valid);
+				frame->errors++;
+				result = key_result;
+				continue;
+			}
+			frame->applied[key] = color;
+			set_bit(key, frame->applied_valid);
+			frame->keys_written++;
+		}
+	}
+
+	if (ops->batch_end)
+		ops->batch_end(frame->priv);
+
+out:
+	frame_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	frame->frames++;
+	frame->frame_ns_sum += frame_ns;
+	if (frame_ns > frame->frame_ns_max)
+		frame->frame_ns_max = frame_ns;
+	mutex_unlock(&frame->lock);
+
+	return result;
+}
+
+/**
+ * Write handler for a frame interface, takes exactly one frame per write
+ */
+static ssize_t tuxedo_kbd_frame_write(struct tuxedo_kbd_frame_t *frame, const char __user *buf, size_t count)
+{
+	u8 *data;
+	int result;
+
+	if (count != tuxedo_kbd_frame_size(frame))
+		return -EINVAL;
+
+	data = memdup_user(buf, count);
+	if (IS_ERR(data))
+		return PTR_ERR(data);
+
+	result = tuxedo_kbd_frame_apply(frame, data, count);
+	kfree(data);
+
+	return result ? result : count;
+}
+
+static void tuxedo_kbd_frame_stats_show(struct seq_file *s, struct tuxedo_kbd_frame_t *frame)
+{
+	u64 frame_ns_avg;
+
+	mutex_lock(&frame->lock);
+	frame_ns_avg = frame->frames ? div64_u64(frame->frame_ns_sum, frame->frames) : 0;
+	seq_printf(s, "keys: %u\n", frame->ops->keys);
+	seq_printf(s, "frames: %llu\n", frame->frames);
+	seq_printf(s, "keys_written: %llu\n", frame->keys_written);
+	seq_printf(s, "keys_skipped: %llu\n", frame->keys_skipped);
+	seq_printf(s, "fills: %llu\n", frame->fills);
+	seq_printf(s, "errors: %llu\n", frame->errors);
+	seq_printf(s, "frame_avg_us: %llu\n", div_u64(frame_ns_avg, NSEC_PER_USEC));
+	seq_printf(s, "frame_max_us: %llu\n", div_u64(frame->frame_ns_max, NSEC_PER_USEC));
+	// Upper bound of the frame rate the backend sustains for this frame mix
+	seq_printf(s, "fps_max: %llu\n", frame_ns_avg ? div64_u64(NSEC_PER_SEC, frame_ns_avg) : 0);
+	mutex_unlock(&frame->lock);
+}
+
+/**
+ * Frame device for the keyboard of the active driver, /dev/tuxedo_kbd_frame
+ *
+ * Files stay open across an unbind of the driver. The frame is published via
+ * SRCU, writes run in a read side section and fail with -ENODEV once the
+ * frame they were opened for is gone. Unregister waits for writes in flight.
+ */
+static struct tuxedo_kbd_frame_t __rcu *tuxedo_kbd_frame_dev_frame;
+DEFINE_STATIC_SRCU(tuxedo_kbd_frame_dev_srcu);
+
+static int tuxedo_kbd_frame_dev_open(struct inode *inode, struct file *file)
+{
+	struct tuxedo_kbd_frame_t *frame;
+	int srcu_idx;
+
+	srcu_idx = srcu_read_lock(&tuxedo_kbd_frame_dev_srcu);
+	frame = srcu_dereference(tuxedo_kbd_frame_dev_frame, &tuxedo_kbd_frame_dev_srcu);
+	file->private_data = frame;
+	srcu_read_unlock(&tuxedo_kbd_frame_dev_srcu, srcu_idx);
+
+	return frame ? 0 : -ENODEV;
+}
+
+static ssize_t tuxedo_kbd_frame_dev_write(struct file *file, const char __user *buf,
+					  size_t count, loff_t *ppos)
+{
+	struct tuxedo_kbd_frame_t *frame;
+	ssize_t result;
+	int srcu_idx;
+
+	srcu_idx = srcu_read_lock(&tuxedo_kbd_frame_dev_srcu);
+	frame = srcu_dereference(tuxedo_kbd_frame_dev_frame, &tuxedo_kbd_frame_dev_srcu);
+	if (frame && frame == file->private_data)
+		result = tuxedo_kbd_frame_write(frame, buf, count);
+	else
+		result = -ENODEV;
+	srcu_read_unlock(&tuxedo_kbd_frame_dev_srcu, srcu_idx);
+
+	return result;
+}
+
+static const struct file_operations tuxedo_kbd_frame_dev_fops = {
+	.owner = THIS_MODULE,
+	.open = tuxedo_kbd_frame_dev_open,
+	.write = tuxedo_kbd_frame_dev_write,
+};
+
+static struct miscdevice tuxedo_kbd_frame_miscdev = {
+	.minor = MISC_DYNAMIC_MINOR,
+	.name = "tuxedo_kbd_frame",
+	.fops = &tuxedo_kbd_frame_dev_fops,
+};
+
+static int tuxedo_kbd_frame_dev_register(struct tuxedo_kbd_frame_t *frame)
+{
+	int result;
+
+	if (rcu_access_pointer(tuxedo_kbd_frame_dev_frame))
+		return -EBUSY;
+
+	rcu_assign_pointer(tuxedo_kbd_frame_dev_frame, frame);
+	result = misc_register(&tuxedo_kbd_frame_miscdev);
+	if (result) {
+		pr_err("Registering keyboard frame device failed\n");
+		RCU_INIT_POINTER(tuxedo_kbd_frame_dev_frame, NULL);
+	}
+
+	return result;
+}
+
+static void tuxedo_kbd_frame_dev_unregister(void)
+{
+	if (!rcu_access_pointer(tuxedo_kbd_frame_dev_frame))
+		return;
+
+	misc_deregister(&tuxedo_kbd_frame_miscdev);
+	RCU_INIT_POINTER(tuxedo_kbd_frame_dev_frame, NULL);
+	synchronize_srcu(&tuxedo_kbd_frame_dev_srcu);
+}
+
+#endif // TUXEDO_KBD_FRAME_H
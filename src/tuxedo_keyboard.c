@@ -21,6 +21,7 @@
 #include "tuxedo_keyboard_common.h"
 #include "clevo_keyboard.h"
 #include "uniwill_keyboard.h"
+#include "tuxedo_quirks_db.h"
 #include <linux/mutex.h>
 #include <asm/cpu_device_id.h>
 #include <asm/intel-family.h>
@@ -295,6 +296,11 @@ static int __init tuxedo_keyboard_init(void)
 		return -ENODEV;
 	}
 
+	tuxedo_quirks_init();
+
+	tuxedo_debugfs_root = debugfs_create_dir(DRIVER_NAME, NULL);
+	tuxedo_led_commit_bench_create(tuxedo_debugfs_root);
+
 	return 0;
 }
 
@@ -304,6 +310,12 @@ static void __exit tuxedo_keyboard_exit(void)
 
 	if (tuxedo_platform_device != NULL)
 		tuxedo_keyboard_remove_driver(NULL);
+
+	tuxedo_led_commit_bench_remove();
+	debugfs_remove_recursive(tuxedo_debugfs_root);
+	tuxedo_debugfs_root = NULL;
+
+	tuxedo_quirks_exit();
 }
 
 module_init(tuxedo_keyboard_init);
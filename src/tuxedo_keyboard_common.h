@@ -26,6 +26,9 @@
 #include <linux/platform_device.h>
 #include <linux/input.h>
 #include <linux/input/sparse-keymap.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/debugfs.h>
 
 /* ::::  Module specific Constants and simple Macros   :::: */
 #define __TUXEDO_PR(lvl, fmt, ...) do { pr_##lvl(fmt, ##__VA_ARGS__); } while (0)
@@ -37,6 +40,67 @@
 #define DRIVER_NAME "tuxedo_keyboard"
 #endif
 
+/**
+ * Lock for a vendor interface that a single task can hold over a sequence of
+ * calls (a "session"). Accessors called from within the session by the
+ * owning task don't take the lock again, everyone else waits for the end of
+ * the session. Sessions nest, the lock is released by the outermost end.
+ */
+struct tuxedo_session_lock_t {
+	struct mutex lock;
+	struct task_struct *owner;
+	// Only touched by the owner
+	unsigned int depth;
+};
+
+#define DEFINE_TUXEDO_SESSION_LOCK(name) \
+	struct tuxedo_session_lock_t name = { \
+		.lock = __MUTEX_INITIALIZER(name.lock), \
+		.owner = NULL, \
+		.depth = 0, \
+	}
+
+static inline void tuxedo_session_begin(struct tuxedo_session_lock_t *session)
+{
+	if (READ_ONCE(session->owner) == current) {
+		session->depth++;
+		return;
+	}
+	mutex_lock(&session->lock);
+	WRITE_ONCE(session->owner, current);
+	session->depth = 1;
+}
+
+static inline void tuxedo_session_end(struct tuxedo_session_lock_t *session)
+{
+	if (--session->depth > 0)
+		return;
+	WRITE_ONCE(session->owner, NULL);
+	mutex_unlock(&session->lock);
+}
+
+/**
+ * Lock for a single access unless the calling task already owns the session.
+ * Only the owner itself can set the owner to current, so the unlocked
+ * comparison is safe.
+ *
+ * Returns true if the lock was taken and must be released with
+ * tuxedo_session_put()
+ */
+static inline bool tuxedo_session_get(struct tuxedo_session_lock_t *session)
+{
+	if (READ_ONCE(session->owner) == current)
+		return false;
+	mutex_lock(&session->lock);
+	return true;
+}
+
+static inline void tuxedo_session_put(struct tuxedo_session_lock_t *session, bool locked)
+{
+	if (locked)
+		mutex_unlock(&session->lock);
+}
+
 struct tuxedo_keyboard_driver {
 	// Platform driver provided by driver
 	struct platform_driver *platform_driver;
@@ -55,6 +119,9 @@ static struct input_dev *tuxedo_input_device = NULL;
 // Currently chosen driver
 static struct tuxedo_keyboard_driver *current_driver = NULL;
 
+// Debug/statistics entries of all drivers, created on module init
+static struct dentry *tuxedo_debugfs_root = NULL;
+
 struct platform_device *tuxedo_keyboard_init_driver(struct tuxedo_keyboard_driver *tk_driver);
 void tuxedo_keyboard_remove_driver(struct tuxedo_keyboard_driver *tk_driver);
 
@@ -0,0 +1,382 @@
+/*!
+ * Copyright (c) 2023 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-keyboard.
+ *
+ * tuxedo-keyboard is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef TUXEDO_LED_COMMIT_H
+#define TUXEDO_LED_COMMIT_H
+
+#include <linux/types.h>
+#include <linux/leds.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/seq_file.h>
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/sort.h>
+#include <linux/uaccess.h>
+
+/**
+ * Deferred "latest wins" commit of LED states
+ *
+ * The LED core calls brightness_set from atomic context (triggers, timers),
+ * but the vendor interfaces sleep. The non-blocking path only records the
+ * requested brightness and kicks a work item, which applies whatever was
+ * requested last. Requests arriving while an older one is still pending
+ * replace it. The blocking path applies synchronously and drops anything
+ * still pending, as it is newer.
+ */
+struct tuxedo_led_commit_t {
+	struct led_classdev *led_cdev;
+	int (*apply)(struct led_classdev *led_cdev, enum led_brightness brightness);
+	struct work_struct work;
+	// Serializes apply() between the work item and the blocking path
+	struct mutex apply_lock;
+	// Protects everything below
+	spinlock_t lock;
+	bool dirty;
+	enum led_brightness pending;
+	// Time of the oldest request not yet applied
+	ktime_t requested;
+	// Statistics
+	u64 requests;
+	u64 superseded;
+	u64 commits;
+	u64 errors;
+	u64 latency_sum_ns;
+	u64 latency_max_ns;
+	// Optional latency samples in us of every commit, used by the benchmark
+	u32 *samples;
+	u32 samples_max;
+	u32 samples_count;
+};
+
+static void tuxedo_led_commit_account(struct tuxedo_led_commit_t *commit, ktime_t requested, int result)
+{
+	unsigned long flags;
+	u64 latency_ns = ktime_to_ns(ktime_sub(ktime_get(), requested));
+
+	spin_lock_irqsave(&commit->lock, flags);
+	commit->commits++;
+	if (result)
+		commit->errors++;
+	commit->latency_sum_ns += latency_ns;
+	if (latency_ns > commit->latency_max_ns)
+		commit->latency_max_ns = latency_ns;
+	if (commit->samples && commit->samples_count < commit->samples_max)
+		commit->samples[commit->samples_count++] = div_u64(latency_ns, NSEC_PER_USEC);
+	spin_unlock_irqrestore(&commit->lock, flags);
+}
+
+static void tuxedo_led_commit_work_func(struct work_struct *work)
+{
+	struct tuxedo_led_commit_t *commit = container_of(work, struct tuxedo_led_commit_t, work);
+	enum led_brightness brightness;
+	unsigned long flags;
+	ktime_t requested;
+	int result;
+
+	mutex_lock(&commit->apply_lock);
+
+	spin_lock_irqsave(&commit->lock, flags);
+	if (!commit->dirty) {
+		// Taken over by the blocking path in the meantime
+		spin_unlock_irqrestore(&commit->lock, flags);
+		mutex_unlock(&commit->apply_lock);
+		return;
+	}
+	brightness = commit->pending;
+	requested = commit->requested;
+	commit->dirty = false;
+	spin_unlock_irqrestore(&commit->lock, flags);
+
+	result = commit->apply(commit->led_cdev, brightness);
+	if (result)
+		pr_debug("Deferred commit of %s failed: %d\n", commit->led_cdev->name, result);
+	tuxedo_led_commit_account(commit, requested, result);
+
+	mutex_unlock(&commit->apply_lock);
+}
+
+static void tuxedo_led_commit_init(struct tuxedo_led_commit_t *commit, struct led_classdev *led_cdev,
+				   int (*apply)(struct led_classdev *, enum led_brightness))
+{
+	commit->led_cdev = led_cdev;
+	commit->apply = apply;
+	INIT_WORK(&commit->work, tuxedo_led_commit_work_func);
+	mutex_init(&commit->apply_lock);
+	spin_lock_init(&commit->lock);
+	commit->dirty = false;
+}
+
+/**
+ * Non-blocking, usable as brightness_set
+ */
+static void tuxedo_led_commit_request(struct tuxedo_led_commit_t *commit, enum led_brightness brightness)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&commit->lock, flags);
+	if (commit->dirty)
+		commit->superseded++;
+	else
+		commit->requested = ktime_get();
+	commit->pending = brightness;
+	commit->dirty = true;
+	commit->requests++;
+	spin_unlock_irqrestore(&commit->lock, flags);
+
+	schedule_work(&commit->work);
+}
+
+/**
+ * Blocking, usable as brightness_set_blocking
+ */
+static int tuxedo_led_commit_sync(struct tuxedo_led_commit_t *commit, enum led_brightness brightness)
+{
+	unsigned long flags;
+	ktime_t requested = ktime_get();
+	int result;
+
+	mutex_lock(&commit->apply_lock);
+
+	spin_lock_irqsave(&commit->lock, flags);
+	if (commit->dirty)
+		commit->superseded++;
+	commit->dirty = false;
+	commit->requests++;
+	spin_unlock_irqrestore(&commit->lock, flags);
+
+	result = commit->apply(commit->led_cdev, brightness);
+	tuxedo_led_commit_account(commit, requested, result);
+
+	mutex_unlock(&commit->apply_lock);
+
+	return result;
+}
+
+/**
+ * Wait for a pending commit to be applied
+ */
+static void tuxedo_led_commit_flush(struct tuxedo_led_commit_t *commit)
+{
+	flush_work(&commit->work);
+}
+
+/**
+ * Drop a pending commit, e.g. before the LED goes away
+ */
+static void tuxedo_led_commit_cancel(struct tuxedo_led_commit_t *commit)
+{
+	unsigned long flags;
+
+	cancel_work_sync(&commit->work);
+	spin_lock_irqsave(&commit->lock, flags);
+	commit->dirty = false;
+	spin_unlock_irqrestore(&commit->lock, flags);
+}
+
+static void tuxedo_led_commit_stats_show(struct seq_file *s, const char *name, struct tuxedo_led_commit_t *commit)
+{
+	unsigned long flags;
+	u64 requests, superseded, commits, errors, latency_sum_ns, latency_max_ns;
+
+	spin_lock_irqsave(&commit->lock, flags);
+	requests = commit->requests;
+	superseded = commit->superseded;
+	commits = commit->commits;
+	errors = commit->errors;
+	latency_sum_ns = commit->latency_sum_ns;
+	latency_max_ns = commit->latency_max_ns;
+	spin_unlock_irqrestore(&commit->lock, flags);
+
+	seq_printf(s, "%s: requests %llu superseded %llu commits %llu errors %llu latency_avg_us %llu latency_max_us %llu\n",
+		   name, requests, superseded, commits, errors,
+		   commits ? div64_u64(latency_sum_ns, commits * NSEC_PER_USEC) : 0,
+		   div_u64(latency_max_ns, NSEC_PER_USEC));
+}
+
+/**
+ * Latency benchmark against a simulated backend
+ *
+ * Write "<requests> [rate_hz [apply_us]]" to led_commit_bench in debugfs:
+ * the writing task issues non-blocking requests at a fixed rate (default
+ * 100/s) to a commit whose apply sleeps for apply_us (default 15 ms, about
+ * one firmware round trip). Read for the request to applied latency of the
+ * commits.
+ */
+#define TUXEDO_LED_COMMIT_BENCH_MAX_REQUESTS	6000
+#define TUXEDO_LED_COMMIT_BENCH_MAX_RATE_HZ	1000
+#define TUXEDO_LED_COMMIT_BENCH_MAX_APPLY_US	1000000
+
+static struct tuxedo_led_commit_bench_t {
+	struct tuxedo_led_commit_t commit;
+	struct led_classdev led_cdev;
+	struct mutex lock;
+	u32 apply_us;
+	// Results of the last run, protected by lock
+	u32 requests;
+	u32 rate_hz;
+	u64 commits;
+	u64 superseded;
+	u32 p50_us;
+	u32 p99_us;
+	u32 max_us;
+	struct dentry *dentry;
+} tuxedo_led_commit_bench = {
+	.led_cdev = { .name = "led_commit_bench" },
+	.lock = __MUTEX_INITIALIZER(tuxedo_led_commit_bench.lock),
+};
+
+static int tuxedo_led_commit_bench_apply(struct led_classdev *led_cdev __always_unused,
+					 enum led_brightness brightness __always_unused)
+{
+	u32 apply_us = tuxedo_led_commit_bench.apply_us;
+
+	usleep_range(apply_us, apply_us + apply_us / 8 + 1);
+	return 0;
+}
+
+static int tuxedo_led_commit_bench_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void tuxedo_led_commit_bench_run(struct tuxedo_led_commit_bench_t *bench, u32 requests, u32 rate_hz)
+{
+	struct tuxedo_led_commit_t *commit = &bench->commit;
+	u64 period_us = USEC_PER_SEC / rate_hz;
+	unsigned long flags;
+	ktime_t start;
+	s64 delay_us;
+	u32 i;
+
+	start = ktime_get();
+	for (i = 0; i < requests && !fatal_signal_pending(current); ++i) {
+		delay_us = ktime_us_delta(ktime_add_us(start, i * period_us), ktime_get());
+		if (delay_us > 0)
+			usleep_range(delay_us, delay_us + 100);
+		tuxedo_led_commit_request(commit, i & 0xff);
+	}
+	tuxedo_led_commit_flush(commit);
+
+	spin_lock_irqsave(&commit->lock, flags);
+	commit->samples = NULL;
+	spin_unlock_irqrestore(&commit->lock, flags);
+
+	bench->requests = i;
+	bench->rate_hz = rate_hz;
+	bench->commits = commit->commits;
+	bench->superseded = commit->superseded;
+}
+
+static ssize_t tuxedo_led_commit_bench_write(struct file *file, const char __user *buffer, size_t count,
+					     loff_t *ppos)
+{
+	struct tuxedo_led_commit_bench_t *bench = &tuxedo_led_commit_bench;
+	u32 requests, rate_hz = 100, apply_us = 15000, samples_count;
+	u32 *samples;
+	char input[32];
+	size_t len = min(count, sizeof(input) - 1);
+
+	if (copy_from_user(input, buffer, len))
+		return -EFAULT;
+	input[len] = '\0';
+	if (sscanf(input, "%u %u %u", &requests, &rate_hz, &apply_us) < 1)
+		return -EINVAL;
+	if (requests == 0 || requests > TUXEDO_LED_COMMIT_BENCH_MAX_REQUESTS ||
+	    rate_hz == 0 || rate_hz > TUXEDO_LED_COMMIT_BENCH_MAX_RATE_HZ ||
+	    apply_us > TUXEDO_LED_COMMIT_BENCH_MAX_APPLY_US)
+		return -EINVAL;
+
+	samples = kvmalloc_array(requests, sizeof(*samples), GFP_KERNEL);
+	if (!samples)
+		return -ENOMEM;
+
+	if (!mutex_trylock(&bench->lock)) {
+		kvfree(samples);
+		return -EBUSY;
+	}
+
+	memset(&bench->commit, 0, sizeof(bench->commit));
+	tuxedo_led_commit_init(&bench->commit, &bench->led_cdev, tuxedo_led_commit_bench_apply);
+	bench->commit.samples = samples;
+	bench->commit.samples_max = requests;
+	bench->apply_us = apply_us;
+
+	tuxedo_led_commit_bench_run(bench, requests, rate_hz);
+
+	samples_count = bench->commit.samples_count;
+	sort(samples, samples_count, sizeof(*samples), tuxedo_led_commit_bench_cmp, NULL);
+	bench->p50_us = samples_count ? samples[samples_count / 2] : 0;
+	bench->p99_us = samples_count ? samples[(samples_count * 99) / 100] : 0;
+	bench->max_us = samples_count ? samples[samples_count - 1] : 0;
+	mutex_unlock(&bench->lock);
+
+	kvfree(samples);
+
+	return count;
+}
+
+static int tuxedo_led_commit_bench_show(struct seq_file *s, void *unused)
+{
+	struct tuxedo_led_commit_bench_t *bench = &tuxedo_led_commit_bench;
+
+	if (!mutex_trylock(&bench->lock))
+		return -EBUSY;
+	seq_printf(s, "requests %u rate_hz %u apply_us %u commits %llu superseded %llu"
+		   " latency_us p50 %u p99 %u max %u\n",
+		   bench->requests, bench->rate_hz, bench->apply_us, bench->commits, bench->superseded,
+		   bench->p50_us, bench->p99_us, bench->max_us);
+	mutex_unlock(&bench->lock);
+
+	return 0;
+}
+
+static int tuxedo_led_commit_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tuxedo_led_commit_bench_show, inode->i_private);
+}
+
+static const struct file_operations tuxedo_led_commit_bench_fops = {
+	.owner = THIS_MODULE,
+	.open = tuxedo_led_commit_bench_open,
+	.read = seq_read,
+	.write = tuxedo_led_commit_bench_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void tuxedo_led_commit_bench_create(struct dentry *parent)
+{
+	tuxedo_led_commit_bench.dentry = debugfs_create_file("led_commit_bench", 0600, parent, NULL,
+							     &tuxedo_led_commit_bench_fops);
+}
+
+static void tuxedo_led_commit_bench_remove(void)
+{
+	debugfs_remove(tuxedo_led_commit_bench.dentry);
+	tuxedo_led_commit_bench.dentry = NULL;
+}
+
+#endif // TUXEDO_LED_COMMIT_H
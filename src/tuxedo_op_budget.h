@@ -0,0 +1,215 @@
+/*!
+ * Copyright (c) 2023 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-keyboard.
+ *
+ * tuxedo-keyboard is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef TUXEDO_OP_BUDGET_H
+#define TUXEDO_OP_BUDGET_H
+
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/seq_file.h>
+#include <linux/debugfs.h>
+
+/**
+ * Firmware op budgets of user visible actions
+ *
+ * Every firmware round trip (EC access, WMI/ACPI method call) costs several
+ * milliseconds, so the cost of an action is mostly the number of them. An
+ * action is measured from begin to end on the calling task, only ops of
+ * that task are counted, nested actions count into each of them. An action
+ * already in flight on another task is not measured a second time.
+ *
+ * Ops count and wall time are checked against a budget per action (0 for
+ * none), going over is counted in the debugfs stats. Budgets are what the
+ * simulated backends of the host build measure plus a small margin, see
+ * "make host-bench". Real firmware latency differs, they can be adjusted in
+ * debugfs.
+ */
+struct tuxedo_op_budget_t {
+	const char *name;
+	u32 ops_budget;
+	u32 us_budget;
+	// Measurement in flight, protected by the account lock
+	struct task_struct *task;
+	unsigned int depth;
+	u32 ops;
+	ktime_t start;
+	// Statistics, protected by the account lock
+	u64 runs;
+	u64 over_budget;
+	u64 busy;
+	u32 ops_last;
+	u32 ops_max;
+	u64 ns_last;
+	u64 ns_max;
+};
+
+struct tuxedo_op_account_t {
+	const char *name;
+	spinlock_t lock;
+	unsigned int active;
+	struct tuxedo_op_budget_t *budgets;
+	unsigned int count;
+	struct dentry *dentry;
+};
+
+#define TUXEDO_OP_BUDGET(action_name, ops, us) { .name = action_name, .ops_budget = ops, .us_budget = us }
+
+#define TUXEDO_OP_ACCOUNT_INIT(account, vendor_name, budget_array) {			\
+	.name = vendor_name,									\
+	.lock = __SPIN_LOCK_UNLOCKED(account.lock),						\
+	.budgets = budget_array,								\
+	.count = ARRAY_SIZE(budget_array)							\
+}
+
+static void tuxedo_op_budget_begin(struct tuxedo_op_account_t *account, unsigned int action)
+{
+	struct tuxedo_op_budget_t *budget;
+	unsigned long flags;
+
+	if (action >= account->count)
+		return;
+	budget = &account->budgets[action];
+
+	spin_lock_irqsave(&account->lock, flags);
+	if (budget->task == current) {
+		budget->depth++;
+	} else if (budget->task) {
+		budget->busy++;
+	} else {
+		budget->task = current;
+		budget->depth = 1;
+		budget->ops = 0;
+		budget->start = ktime_get();
+		WRITE_ONCE(account->active, account->active + 1);
+	}
+	spin_unlock_irqrestore(&account->lock, flags);
+}
+
+static void tuxedo_op_budget_end(struct tuxedo_op_account_t *account, unsigned int action)
+{
+	struct tuxedo_op_budget_t *budget;
+	unsigned long flags;
+	bool over;
+	u32 ops;
+	u64 ns;
+
+	if (action >= account->count)
+		return;
+	budget = &account->budgets[action];
+
+	spin_lock_irqsave(&account->lock, flags);
+	if (budget->task != current || --budget->depth > 0) {
+		spin_unlock_irqrestore(&account->lock, flags);
+		return;
+	}
+	budget->task = NULL;
+	WRITE_ONCE(account->active, account->active - 1);
+
+	ops = budget->ops;
+	ns = ktime_to_ns(ktime_sub(ktime_get(), budget->start));
+	budget->runs++;
+	budget->ops_last = ops;
+	budget->ns_last = ns;
+	if (ops > budget->ops_max)
+		budget->ops_max = ops;
+	if (ns > budget->ns_max)
+		budget->ns_max = ns;
+	over = (budget->ops_budget && ops > budget->ops_budget) ||
+	       (budget->us_budget && ns > (u64)budget->us_budget * NSEC_PER_USEC);
+	if (over)
+		budget->over_budget++;
+	spin_unlock_irqrestore(&account->lock, flags);
+
+	if (over)
+		pr_debug("%s: %s took %u firmware ops in %llu us, budget %u ops in %u us\n",
+			 account->name, budget->name, ops, div_u64(ns, NSEC_PER_USEC),
+			 budget->ops_budget, budget->us_budget);
+}
+
+/**
+ * To be called for every firmware round trip
+ */
+static void tuxedo_op_account_op(struct tuxedo_op_account_t *account)
+{
+	unsigned long flags;
+	unsigned int i;
+
+	if (!READ_ONCE(account->active))
+		return;
+
+	spin_lock_irqsave(&account->lock, flags);
+	for (i = 0; i < account->count; ++i)
+		if (account->budgets[i].task == current)
+			account->budgets[i].ops++;
+	spin_unlock_irqrestore(&account->lock, flags);
+}
+
+static int tuxedo_op_account_stats_show(struct seq_file *s, void *unused)
+{
+	struct tuxedo_op_account_t *account = s->private;
+	struct tuxedo_op_budget_t budget;
+	unsigned long flags;
+	unsigned int i;
+
+	for (i = 0; i < account->count; ++i) {
+		spin_lock_irqsave(&account->lock, flags);
+		budget = account->budgets[i];
+		spin_unlock_irqrestore(&account->lock, flags);
+
+		seq_printf(s, "%s: runs %llu over_budget %llu busy %llu ops last %u max %u budget %u"
+			   " us last %llu max %llu budget %u\n",
+			   budget.name, budget.runs, budget.over_budget, budget.busy,
+			   budget.ops_last, budget.ops_max, budget.ops_budget,
+			   div_u64(budget.ns_last, NSEC_PER_USEC), div_u64(budget.ns_max, NSEC_PER_USEC),
+			   budget.us_budget);
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(tuxedo_op_account_stats);
+
+/**
+ * Creates <vendor>_op_budget/stats and <vendor>_op_budget/<action>_{ops,us}
+ */
+static void tuxedo_op_account_debugfs_create(struct tuxedo_op_account_t *account, struct dentry *parent)
+{
+	char name[48];
+	unsigned int i;
+
+	snprintf(name, sizeof(name), "%s_op_budget", account->name);
+	account->dentry = debugfs_create_dir(name, parent);
+	debugfs_create_file("stats", 0444, account->dentry, account, &tuxedo_op_account_stats_fops);
+	for (i = 0; i < account->count; ++i) {
+		snprintf(name, sizeof(name), "%s_ops", account->budgets[i].name);
+		debugfs_create_u32(name, 0644, account->dentry, &account->budgets[i].ops_budget);
+		snprintf(name, sizeof(name), "%s_us", account->budgets[i].name);
+		debugfs_create_u32(name, 0644, account->dentry, &account->budgets[i].us_budget);
+	}
+}
+
+static void tuxedo_op_account_debugfs_remove(struct tuxedo_op_account_t *account)
+{
+	debugfs_remove_recursive(account->dentry);
+	account->dentry = NULL;
+}
+
+#endif // TUXEDO_OP_BUDGET_H
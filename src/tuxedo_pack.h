@@ -0,0 +1,74 @@
+/*!
+ * Copyright (c) 2023 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-keyboard.
+ *
+ * tuxedo-keyboard is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef TUXEDO_PACK_H
+#define TUXEDO_PACK_H
+
+#include <linux/types.h>
+
+/**
+ * Packing of colors and EC register fields
+ *
+ * Pure functions without kernel API besides the fixed size types, so they
+ * can be built and exercised outside of the kernel as well.
+ */
+
+static inline u32 tuxedo_rgb_pack(u8 red, u8 green, u8 blue)
+{
+	return ((u32)red << 16) | ((u32)green << 8) | blue;
+}
+
+static inline u8 tuxedo_rgb_red(u32 color)
+{
+	return (color >> 16) & 0xff;
+}
+
+static inline u8 tuxedo_rgb_green(u32 color)
+{
+	return (color >> 8) & 0xff;
+}
+
+static inline u8 tuxedo_rgb_blue(u32 color)
+{
+	return color & 0xff;
+}
+
+/**
+ * Scale every channel by brightness / max
+ */
+static inline u32 tuxedo_rgb_scale(u32 color, u32 brightness, u32 max)
+{
+	return tuxedo_rgb_pack((tuxedo_rgb_red(color) * brightness) / max,
+			       (tuxedo_rgb_green(color) * brightness) / max,
+			       (tuxedo_rgb_blue(color) * brightness) / max);
+}
+
+/**
+ * Field of a register, mask is not shifted
+ */
+static inline u8 tuxedo_field_get(u8 data, u8 mask, unsigned int shift)
+{
+	return (data >> shift) & mask;
+}
+
+static inline u8 tuxedo_field_set(u8 data, u8 mask, unsigned int shift, u8 value)
+{
+	return (data & ~(mask << shift)) | ((value & mask) << shift);
+}
+
+#endif // TUXEDO_PACK_H
@@ -0,0 +1,67 @@
+/*!
+ * Copyright (c) 2023 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-keyboard.
+ *
+ * tuxedo-keyboard is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef TUXEDO_QUIRKS_H
+#define TUXEDO_QUIRKS_H
+
+#include <linux/types.h>
+#include <linux/bitops.h>
+
+/**
+ * Device specific behaviour, resolved once from DMI on module init
+ * (see tuxedo_quirks_db.h) and queried by bit afterwards
+ */
+enum tuxedo_quirk {
+	// Uniwill power profile v1 variants
+	TUXEDO_QUIRK_UW_PROFILE_V1_TWO_PROFS = 0,
+	TUXEDO_QUIRK_UW_PROFILE_V1_THREE_PROFS,
+	TUXEDO_QUIRK_UW_PROFILE_V1_THREE_PROFS_LEDS_ONLY,
+	// Devices reporting charging features they don't actually have
+	TUXEDO_QUIRK_UW_NO_CHARGING_PRIO,
+	TUXEDO_QUIRK_UW_NO_CHARGING_PROFILE,
+	TUXEDO_QUIRK_UW_LIGHTBAR,
+	// Firmware not applying the selected perf. profile on its own
+	TUXEDO_QUIRK_CL_PERF_PROFILE_WORKAROUND,
+	TUXEDO_QUIRK_CL_NO_WEBCAM_SW,
+	// 0x1801 (max brightness) scales the RGB channels, usable as dimmer
+	TUXEDO_QUIRK_UW_KBD_BL_GLOBAL_DIMMER,
+	TUXEDO_QUIRK_MAX
+};
+
+#define TUXEDO_TDP_COUNT	3
+
+struct tuxedo_tdp_limits_t {
+	u8 min[TUXEDO_TDP_COUNT];
+	u8 max[TUXEDO_TDP_COUNT];
+};
+
+struct tuxedo_quirks_t {
+	DECLARE_BITMAP(bits, TUXEDO_QUIRK_MAX);
+	// NULL if no TDP limits are known for the device
+	const struct tuxedo_tdp_limits_t *tdp_limits;
+};
+
+const struct tuxedo_quirks_t *tuxedo_quirks_get(void);
+const struct tuxedo_tdp_limits_t *tuxedo_quirks_get_tdp_limits(u8 uw_model);
+
+static inline bool tuxedo_quirk(enum tuxedo_quirk quirk)
+{
+	return test_bit(quirk, tuxedo_quirks_get()->bits);
+}
+
+#endif
@@ -0,0 +1,501 @@
+/*!
+ * Copyright (c) 2023 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-keyboard.
+ *
+ * tuxedo-keyboard is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef TUXEDO_QUIRKS_DB_H
+#define TUXEDO_QUIRKS_DB_H
+
+#include <linux/dmi.h>
+#include <linux/bsearch.h>
+#include <linux/sort.h>
+#include <linux/firmware.h>
+#include <linux/crc32.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/version.h>
+#include "tuxedo_keyboard_common.h"
+#include "tuxedo_quirks.h"
+#include "uniwill_interfaces.h"
+
+#define Q(quirk) BIT(TUXEDO_QUIRK_##quirk)
+
+/*
+ * TDP boundary definitions per device
+ */
+static const struct tuxedo_tdp_limits_t tdp_ph4tux = { { 0x05, 0x05, 0x00 }, { 0x26, 0x26, 0x00 } };
+static const struct tuxedo_tdp_limits_t tdp_ph4trx = { { 0x05, 0x05, 0x00 }, { 0x32, 0x32, 0x00 } };
+static const struct tuxedo_tdp_limits_t tdp_ph4tqx = { { 0x05, 0x05, 0x00 }, { 0x32, 0x32, 0x00 } };
+static const struct tuxedo_tdp_limits_t tdp_ph4axx = { { 0x05, 0x05, 0x00 }, { 0x2d, 0x3c, 0x00 } };
+static const struct tuxedo_tdp_limits_t tdp_phxpxx = { { 0x05, 0x05, 0x05 }, { 0x2d, 0x3c, 0x6e } };
+static const struct tuxedo_tdp_limits_t tdp_pfxluxg = { { 0x05, 0x05, 0x05 }, { 0x23, 0x23, 0x28 } };
+static const struct tuxedo_tdp_limits_t tdp_gmxngxx = { { 0x05, 0x05, 0x05 }, { 0x50, 0x50, 0x5f } };
+static const struct tuxedo_tdp_limits_t tdp_gmxmgxx = { { 0x05, 0x05, 0x05 }, { 0x78, 0x78, 0xc8 } };
+static const struct tuxedo_tdp_limits_t tdp_gmxtgxx = { { 0x05, 0x05, 0x05 }, { 0x78, 0x78, 0xc8 } };
+static const struct tuxedo_tdp_limits_t tdp_gmxzgxx = { { 0x05, 0x05, 0x05 }, { 0x50, 0x50, 0x5f } };
+static const struct tuxedo_tdp_limits_t tdp_gmxagxx = { { 0x05, 0x05, 0x05 }, { 0x78, 0x78, 0xd7 } };
+static const struct tuxedo_tdp_limits_t tdp_gmxrgxx = { { 0x05, 0x05, 0x05 }, { 0x64, 0x64, 0x6e } };
+static const struct tuxedo_tdp_limits_t tdp_gmxpxxx = { { 0x05, 0x05, 0x05 }, { 0x82, 0x82, 0xc8 } };
+static const struct tuxedo_tdp_limits_t tdp_gmxxgxx = { { 0x05, 0x05, 0x05 }, { 0x50, 0x50, 0x64 } };
+
+struct tuxedo_quirk_entry_t {
+	const char *key;
+	unsigned long quirks;
+	const struct tuxedo_tdp_limits_t *tdp_limits;
+};
+
+/*
+ * Quirk tables, one per DMI field. Each table must be sorted by key
+ * (strcmp order), lookup is a binary search on the exact DMI string.
+ */
+static const struct tuxedo_quirk_entry_t tuxedo_quirks_board_name[] = {
+	// Note: XMG Fusion (LAPQC71A/B, A60 MUV) seems to have neither the
+	// profile v1 power profile control nor TDP set
+	{ "LAPQC71A", Q(UW_NO_CHARGING_PRIO) | Q(UW_NO_CHARGING_PROFILE) | Q(UW_LIGHTBAR) },
+	{ "LAPQC71B", Q(UW_NO_CHARGING_PRIO) | Q(UW_NO_CHARGING_PROFILE) | Q(UW_LIGHTBAR) },
+	{ "PF5PU1G", Q(UW_PROFILE_V1_TWO_PROFS) | Q(UW_NO_CHARGING_PRIO) | Q(UW_NO_CHARGING_PROFILE) },
+	{ "POLARIS1501A1650TI", Q(UW_PROFILE_V1_THREE_PROFS) },
+	{ "POLARIS1501A2060", Q(UW_PROFILE_V1_THREE_PROFS) },
+	{ "POLARIS1501I1650TI", Q(UW_PROFILE_V1_THREE_PROFS) },
+	{ "POLARIS1501I2060", Q(UW_PROFILE_V1_THREE_PROFS) },
+	{ "POLARIS1701A1650TI", Q(UW_PROFILE_V1_THREE_PROFS) },
+	{ "POLARIS1701A2060", Q(UW_PROFILE_V1_THREE_PROFS) },
+	{ "POLARIS1701I1650TI", Q(UW_PROFILE_V1_THREE_PROFS) },
+	{ "POLARIS1701I2060", Q(UW_PROFILE_V1_THREE_PROFS) },
+	{ "PULSE1401", Q(UW_PROFILE_V1_TWO_PROFS) },
+	{ "PULSE1501", Q(UW_PROFILE_V1_TWO_PROFS) },
+	{ "TRINITY1501I", Q(UW_LIGHTBAR) },
+	{ "TRINITY1701I", Q(UW_LIGHTBAR) },
+};
+
+static const struct tuxedo_quirk_entry_t tuxedo_quirks_product_name[] = {
+	{ "A60 MUV", Q(UW_NO_CHARGING_PRIO) | Q(UW_NO_CHARGING_PROFILE) | Q(UW_LIGHTBAR) },
+};
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 18, 0)
+static const struct tuxedo_quirk_entry_t tuxedo_quirks_product_sku[] = {
+	{ "AURA14GEN3", Q(CL_NO_WEBCAM_SW) },
+	{ "AURA15GEN3", Q(CL_NO_WEBCAM_SW) },
+	{ "IBP14I08MK2", 0, &tdp_phxpxx },
+	{ "IBP16I08MK2", 0, &tdp_phxpxx },
+	{ "IBP1XI08MK1", 0, &tdp_phxpxx },
+	{ "IBP1XI08MK2", 0, &tdp_phxpxx },
+	{ "OMNIA08IMK2", 0, &tdp_phxpxx },
+	{ "POLARIS1XA02", Q(UW_PROFILE_V1_THREE_PROFS_LEDS_ONLY), &tdp_gmxngxx },
+	{ "POLARIS1XA03", Q(UW_PROFILE_V1_THREE_PROFS_LEDS_ONLY), &tdp_gmxzgxx },
+	{ "POLARIS1XA05", 0, &tdp_gmxxgxx },
+	{ "POLARIS1XI02", Q(UW_PROFILE_V1_THREE_PROFS_LEDS_ONLY), &tdp_gmxmgxx },
+	{ "POLARIS1XI03", Q(UW_PROFILE_V1_THREE_PROFS_LEDS_ONLY), &tdp_gmxtgxx },
+	{ "PULSE1502", 0, &tdp_pfxluxg },
+	{ "STELLARIS1XA03", Q(UW_PROFILE_V1_THREE_PROFS_LEDS_ONLY) | Q(UW_LIGHTBAR), &tdp_gmxzgxx },
+	{ "STELLARIS1XA05", 0, &tdp_gmxxgxx },
+	{ "STELLARIS1XI03", Q(UW_PROFILE_V1_THREE_PROFS_LEDS_ONLY) | Q(UW_LIGHTBAR), &tdp_gmxtgxx },
+	{ "STELLARIS1XI04", Q(UW_PROFILE_V1_THREE_PROFS_LEDS_ONLY) | Q(UW_LIGHTBAR), &tdp_gmxagxx },
+	{ "STELLARIS1XI05", 0, &tdp_gmxpxxx },
+	{ "STEPOL1XA04", Q(UW_PROFILE_V1_THREE_PROFS_LEDS_ONLY) | Q(UW_LIGHTBAR), &tdp_gmxrgxx },
+};
+#endif
+
+struct tuxedo_quirk_index_t {
+	enum dmi_field field;
+	// Field id used in the quirk blob
+	u8 blob_field;
+	const struct tuxedo_quirk_entry_t *builtin;
+	size_t builtin_count;
+	// Active table, the built-in one or the one merged with the quirk blob
+	const struct tuxedo_quirk_entry_t *entries;
+	size_t count;
+};
+
+#define TUXEDO_QUIRK_INDEX(dmi_field, blob_field_id, table) \
+	{ \
+		.field = dmi_field, \
+		.blob_field = blob_field_id, \
+		.builtin = table, \
+		.builtin_count = ARRAY_SIZE(table), \
+		.entries = table, \
+		.count = ARRAY_SIZE(table), \
+	}
+
+static struct tuxedo_quirk_index_t tuxedo_quirk_indices[] = {
+	TUXEDO_QUIRK_INDEX(DMI_BOARD_NAME, 1, tuxedo_quirks_board_name),
+	TUXEDO_QUIRK_INDEX(DMI_PRODUCT_NAME, 2, tuxedo_quirks_product_name),
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 18, 0)
+	TUXEDO_QUIRK_INDEX(DMI_PRODUCT_SKU, 3, tuxedo_quirks_product_sku),
+#endif
+};
+
+/*
+ * Board names matched as substrings (the way they always were matched).
+ * Can't be binary searched, scanned once on init.
+ */
+static const struct tuxedo_quirk_entry_t tuxedo_quirks_board_name_substr[] = {
+	// Aura, XP14, IBS14v5
+	{ "AURA1501", Q(CL_PERF_PROFILE_WORKAROUND) },
+	{ "EDUBOOK1502", Q(CL_PERF_PROFILE_WORKAROUND) },
+	{ "NL5xRU", Q(CL_PERF_PROFILE_WORKAROUND) },
+	{ "NV4XMB,ME,MZ", Q(CL_PERF_PROFILE_WORKAROUND) },
+	{ "L140CU", Q(CL_PERF_PROFILE_WORKAROUND) },
+	{ "NS50MU", Q(CL_PERF_PROFILE_WORKAROUND) },
+	{ "NS50_70MU", Q(CL_PERF_PROFILE_WORKAROUND) },
+	{ "PCX0DX", Q(CL_PERF_PROFILE_WORKAROUND) },
+	{ "PCx0Dx_GN20", Q(CL_PERF_PROFILE_WORKAROUND) },
+	{ "L14xMU", Q(CL_PERF_PROFILE_WORKAROUND) },
+};
+
+/*
+ * Devices identified by the barebone id read from the EC rather than DMI
+ */
+static const struct {
+	u8 model;
+	const struct tuxedo_tdp_limits_t *tdp_limits;
+} tuxedo_quirks_uw_model_tdp[] = {
+	{ UW_MODEL_PH4TUX, &tdp_ph4tux },
+	{ UW_MODEL_PH4TRX, &tdp_ph4trx },
+	{ UW_MODEL_PH4TQF, &tdp_ph4tqx },
+	{ UW_MODEL_PH4AQF_ARX, &tdp_ph4axx },
+};
+
+#undef Q
+
+static struct tuxedo_quirks_t tuxedo_quirks;
+
+static int tuxedo_quirk_entry_cmp(const void *key, const void *elt)
+{
+	return strcmp((const char *)key, ((const struct tuxedo_quirk_entry_t *)elt)->key);
+}
+
+static int tuxedo_quirk_entry_sort_cmp(const void *a, const void *b)
+{
+	return strcmp(((const struct tuxedo_quirk_entry_t *)a)->key,
+		      ((const struct tuxedo_quirk_entry_t *)b)->key);
+}
+
+/*
+ * Optional quirk blob, loaded from the firmware search path (e.g.
+ * /lib/firmware/tuxedo_keyboard/quirks.bin) on module init. Entries are
+ * merged over the built-in tables, a blob entry replaces a built-in entry
+ * with the same key completely.
+ *
+ * Layout (little endian):
+ *   struct tuxedo_quirks_blob_header_t
+ *   struct tuxedo_quirks_blob_entry_t[count]
+ *
+ * crc is the standard CRC-32 (as in zlib) over all entries.
+ */
+#define TUXEDO_QUIRKS_BLOB_NAME			"tuxedo_keyboard/quirks.bin"
+#define TUXEDO_QUIRKS_BLOB_MAGIC		0x4b515854 // "TXQK"
+#define TUXEDO_QUIRKS_BLOB_FORMAT		1
+#define TUXEDO_QUIRKS_BLOB_MAX_ENTRIES		1024
+#define TUXEDO_QUIRKS_BLOB_KEY_LEN		24
+
+#define TUXEDO_QUIRKS_BLOB_FLAG_TDP		0x01
+
+struct tuxedo_quirks_blob_header_t {
+	__le32 magic;
+	__le16 format;
+	__le16 count;
+	__le32 data_version;
+	__le32 crc;
+} __packed;
+
+struct tuxedo_quirks_blob_entry_t {
+	u8 field;
+	u8 flags;
+	u8 tdp_min[TUXEDO_TDP_COUNT];
+	u8 tdp_max[TUXEDO_TDP_COUNT];
+	__le32 quirks;
+	char key[TUXEDO_QUIRKS_BLOB_KEY_LEN];
+} __packed;
+
+// Storage for the merged tables, lives until module exit
+static struct tuxedo_quirks_blob_t {
+	u32 data_version;
+	struct tuxedo_quirks_blob_entry_t *entries;
+	struct tuxedo_tdp_limits_t *tdp_limits;
+	struct tuxedo_quirk_entry_t *merged[ARRAY_SIZE(tuxedo_quirk_indices)];
+	size_t merged_count[ARRAY_SIZE(tuxedo_quirk_indices)];
+} tuxedo_quirks_blob;
+
+static int tuxedo_quirks_blob_validate(const struct firmware *fw)
+{
+	const struct tuxedo_quirks_blob_header_t *header;
+	const struct tuxedo_quirks_blob_entry_t *entries;
+	const struct tuxedo_quirks_blob_entry_t *entry;
+	u16 count;
+	int i, j;
+
+	if (fw->size < sizeof(*header))
+		return -EINVAL;
+
+	header = (const struct tuxedo_quirks_blob_header_t *)fw->data;
+	count = le16_to_cpu(header->count);
+
+	if (le32_to_cpu(header->magic) != TUXEDO_QUIRKS_BLOB_MAGIC)
+		return -EINVAL;
+	if (le16_to_cpu(header->format) != TUXEDO_QUIRKS_BLOB_FORMAT)
+		return -EPROTO;
+	if (count > TUXEDO_QUIRKS_BLOB_MAX_ENTRIES
+	    || fw->size != sizeof(*header) + count * sizeof(*entries))
+		return -EINVAL;
+
+	entries = (const struct tuxedo_quirks_blob_entry_t *)(header + 1);
+	if ((crc32_le(~0, (const u8 *)entries, count * sizeof(*entries)) ^ ~0)
+	    != le32_to_cpu(header->crc))
+		return -EBADMSG;
+
+	for (i = 0; i < count; ++i) {
+		entry = &entries[i];
+
+		for (j = 0; j < ARRAY_SIZE(tuxedo_quirk_indices); ++j) {
+			if (tuxedo_quirk_indices[j].blob_field == entry->field)
+				break;
+		}
+		if (j == ARRAY_SIZE(tuxedo_quirk_indices))
+			return -EINVAL;
+
+		if (entry->key[0] == '\0'
+		    || strnlen(entry->key, sizeof(entry->key)) == sizeof(entry->key))
+			return -EINVAL;
+
+		if (le32_to_cpu(entry->quirks) & ~(BIT(TUXEDO_QUIRK_MAX) - 1))
+			return -EINVAL;
+
+		if (entry->flags & TUXEDO_QUIRKS_BLOB_FLAG_TDP) {
+			for (j = 0; j < TUXEDO_TDP_COUNT; ++j) {
+				if (entry->tdp_min[j] > entry->tdp_max[j])
+					return -EINVAL;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void tuxedo_quirks_blob_free(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tuxedo_quirk_indices); ++i) {
+		tuxedo_quirk_indices[i].entries = tuxedo_quirk_indices[i].builtin;
+		tuxedo_quirk_indices[i].count = tuxedo_quirk_indices[i].builtin_count;
+		kfree(tuxedo_quirks_blob.merged[i]);
+		tuxedo_quirks_blob.merged[i] = NULL;
+		tuxedo_quirks_blob.merged_count[i] = 0;
+	}
+	kfree(tuxedo_quirks_blob.tdp_limits);
+	tuxedo_quirks_blob.tdp_limits = NULL;
+	kfree(tuxedo_quirks_blob.entries);
+	tuxedo_quirks_blob.entries = NULL;
+}
+
+/**
+ * Merge blob entries of one field with the built-in table into a new
+ * sorted table
+ */
+static int tuxedo_quirks_blob_merge(int index_nr, u16 blob_count)
+{
+	struct tuxedo_quirk_index_t *index = &tuxedo_quirk_indices[index_nr];
+	struct tuxedo_quirks_blob_entry_t *blob_entry;
+	struct tuxedo_quirk_entry_t *merged;
+	size_t n = 0, n_blob;
+	int i;
+
+	merged = kcalloc(index->builtin_count + blob_count, sizeof(*merged), GFP_KERNEL);
+	if (!merged)
+		return -ENOMEM;
+
+	for (i = 0; i < blob_count; ++i) {
+		blob_entry = &tuxedo_quirks_blob.entries[i];
+		if (blob_entry->field != index->blob_field)
+			continue;
+
+		merged[n].key = blob_entry->key;
+		merged[n].quirks = le32_to_cpu(blob_entry->quirks);
+		if (blob_entry->flags & TUXEDO_QUIRKS_BLOB_FLAG_TDP)
+			merged[n].tdp_limits = &tuxedo_quirks_blob.tdp_limits[i];
+		++n;
+	}
+	n_blob = n;
+	sort(merged, n_blob, sizeof(*merged), tuxedo_quirk_entry_sort_cmp, NULL);
+
+	for (i = 1; i < n_blob; ++i) {
+		if (strcmp(merged[i - 1].key, merged[i].key) == 0) {
+			kfree(merged);
+			return -EINVAL;
+		}
+	}
+
+	// Built-in entries not overridden by the blob
+	for (i = 0; i < index->builtin_count; ++i) {
+		if (bsearch(index->builtin[i].key, merged, n_blob, sizeof(*merged),
+			    tuxedo_quirk_entry_cmp) == NULL)
+			merged[n++] = index->builtin[i];
+	}
+	sort(merged, n, sizeof(*merged), tuxedo_quirk_entry_sort_cmp, NULL);
+
+	tuxedo_quirks_blob.merged[index_nr] = merged;
+	tuxedo_quirks_blob.merged_count[index_nr] = n;
+
+	return 0;
+}
+
+static void tuxedo_quirks_blob_load(void)
+{
+	const struct firmware *fw;
+	const struct tuxedo_quirks_blob_header_t *header;
+	u16 count;
+	int i, j, status;
+
+	if (request_firmware_direct(&fw, TUXEDO_QUIRKS_BLOB_NAME, NULL) != 0)
+		return;
+
+	status = tuxedo_quirks_blob_validate(fw);
+	if (status < 0) {
+		pr_err("quirks: %s rejected (%d)\n", TUXEDO_QUIRKS_BLOB_NAME, status);
+		goto out_release;
+	}
+
+	header = (const struct tuxedo_quirks_blob_header_t *)fw->data;
+	count = le16_to_cpu(header->count);
+
+	tuxedo_quirks_blob.data_version = le32_to_cpu(header->data_version);
+	tuxedo_quirks_blob.entries = kmemdup(header + 1, count * sizeof(*tuxedo_quirks_blob.entries), GFP_KERNEL);
+	tuxedo_quirks_blob.tdp_limits = kcalloc(count, sizeof(*tuxedo_quirks_blob.tdp_limits), GFP_KERNEL);
+	if (count > 0 && (!tuxedo_quirks_blob.entries || !tuxedo_quirks_blob.tdp_limits)) {
+		status = -ENOMEM;
+		goto out_free;
+	}
+
+	for (i = 0; i < count; ++i) {
+		for (j = 0; j < TUXEDO_TDP_COUNT; ++j) {
+			tuxedo_quirks_blob.tdp_limits[i].min[j] = tuxedo_quirks_blob.entries[i].tdp_min[j];
+			tuxedo_quirks_blob.tdp_limits[i].max[j] = tuxedo_quirks_blob.entries[i].tdp_max[j];
+		}
+	}
+
+	for (i = 0; i < ARRAY_SIZE(tuxedo_quirk_indices); ++i) {
+		status = tuxedo_quirks_blob_merge(i, count);
+		if (status < 0) {
+			pr_err("quirks: %s merge failed (%d)\n", TUXEDO_QUIRKS_BLOB_NAME, status);
+			goto out_free;
+		}
+	}
+
+	// Only switch over once everything is merged
+	for (i = 0; i < ARRAY_SIZE(tuxedo_quirk_indices); ++i) {
+		tuxedo_quirk_indices[i].entries = tuxedo_quirks_blob.merged[i];
+		tuxedo_quirk_indices[i].count = tuxedo_quirks_blob.merged_count[i];
+	}
+
+	TUXEDO_INFO("quirks: %s version %u loaded, %u entries\n", TUXEDO_QUIRKS_BLOB_NAME,
+		    tuxedo_quirks_blob.data_version, count);
+
+	goto out_release;
+
+out_free:
+	tuxedo_quirks_blob_free();
+out_release:
+	release_firmware(fw);
+}
+
+static void tuxedo_quirks_apply(const struct tuxedo_quirk_entry_t *entry)
+{
+	tuxedo_quirks.bits[0] |= entry->quirks;
+	if (tuxedo_quirks.tdp_limits == NULL)
+		tuxedo_quirks.tdp_limits = entry->tdp_limits;
+	pr_debug("quirks: matched %s\n", entry->key);
+}
+
+static void tuxedo_quirks_init(void)
+{
+	const struct tuxedo_quirk_index_t *index;
+	const struct tuxedo_quirk_entry_t *entry;
+	const char *dmi_string;
+	int i, j;
+
+	BUILD_BUG_ON(TUXEDO_QUIRK_MAX > BITS_PER_LONG);
+
+	bitmap_zero(tuxedo_quirks.bits, TUXEDO_QUIRK_MAX);
+	tuxedo_quirks.tdp_limits = NULL;
+
+	tuxedo_quirks_blob_load();
+
+	for (i = 0; i < ARRAY_SIZE(tuxedo_quirk_indices); ++i) {
+		index = &tuxedo_quirk_indices[i];
+
+		for (j = 1; j < index->count; ++j) {
+			if (strcmp(index->entries[j - 1].key, index->entries[j].key) >= 0)
+				pr_err("quirks: table for dmi field %d not sorted at %s\n",
+				       index->field, index->entries[j].key);
+		}
+
+		dmi_string = dmi_get_system_info(index->field);
+		if (dmi_string == NULL)
+			continue;
+
+		entry = bsearch(dmi_string, index->entries, index->count,
+				sizeof(*index->entries), tuxedo_quirk_entry_cmp);
+		if (entry != NULL)
+			tuxedo_quirks_apply(entry);
+	}
+
+	dmi_string = dmi_get_system_info(DMI_BOARD_NAME);
+	if (dmi_string != NULL) {
+		for (i = 0; i < ARRAY_SIZE(tuxedo_quirks_board_name_substr); ++i) {
+			entry = &tuxedo_quirks_board_name_substr[i];
+			if (strstr(dmi_string, entry->key) != NULL)
+				tuxedo_quirks_apply(entry);
+		}
+	}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 18, 0)
+	TUXEDO_ERROR("Warning: Kernel version less that 4.18, device quirks might not be properly recognized.");
+#endif
+
+	pr_debug("quirks: %#lx, tdp limits %s\n", tuxedo_quirks.bits[0],
+		 tuxedo_quirks.tdp_limits != NULL ? "known" : "unknown");
+}
+
+static void tuxedo_quirks_exit(void)
+{
+	tuxedo_quirks_blob_free();
+}
+
+const struct tuxedo_quirks_t *tuxedo_quirks_get(void)
+{
+	return &tuxedo_quirks;
+}
+EXPORT_SYMBOL(tuxedo_quirks_get);
+
+/**
+ * TDP limits for the device, barebone id (if known) takes precedence
+ * over the DMI based lookup
+ */
+const struct tuxedo_tdp_limits_t *tuxedo_quirks_get_tdp_limits(u8 uw_model)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tuxedo_quirks_uw_model_tdp); ++i) {
+		if (tuxedo_quirks_uw_model_tdp[i].model == uw_model)
+			return tuxedo_quirks_uw_model_tdp[i].tdp_limits;
+	}
+
+	return tuxedo_quirks.tdp_limits;
+}
+EXPORT_SYMBOL(tuxedo_quirks_get_tdp_limits);
+
+#endif
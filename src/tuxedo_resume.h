@@ -0,0 +1,125 @@
+/*!
+ * Copyright (c) 2023 TUXEDO Computers GmbH <tux@tuxedocomputers.com>
+ *
+ * This file is part of tuxedo-keyboard.
+ *
+ * tuxedo-keyboard is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef TUXEDO_RESUME_H
+#define TUXEDO_RESUME_H
+
+#include <linux/types.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/moduleparam.h>
+#include <linux/workqueue.h>
+#include <linux/seq_file.h>
+
+/**
+ * Deferred restore on resume
+ *
+ * Restoring keyboard state takes a series of sleeping firmware/EC calls.
+ * The PM callback only queues the restore, which then runs in parallel to
+ * the rest of the system resume. The EC/ACPI interfaces are resumed before
+ * any platform device resume callback runs, so they are available to the
+ * work item. Suspend waits for a restore still in flight.
+ *
+ * Time spent in the PM callback and in the restore itself is recorded, with
+ * deferred_resume=0 the restore runs synchronously for comparison.
+ */
+static bool tuxedo_deferred_resume = true;
+module_param_named(deferred_resume, tuxedo_deferred_resume, bool, S_IRUSR | S_IWUSR);
+MODULE_PARM_DESC(deferred_resume, "Restore keyboard state asynchronously after resume (default: true)");
+
+struct tuxedo_resume_t {
+	void (*restore)(void);
+	struct work_struct work;
+	ktime_t start;
+	// Statistics, written by the PM callback and the work item only
+	u64 count;
+	u64 callback_ns_last;
+	u64 callback_ns_max;
+	u64 restore_ns_last;
+	u64 restore_ns_max;
+	// From PM callback entry to restore complete
+	u64 total_ns_last;
+};
+
+static void tuxedo_resume_restore(struct tuxedo_resume_t *resume)
+{
+	ktime_t start = ktime_get();
+	u64 restore_ns;
+
+	resume->restore();
+
+	restore_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	resume->restore_ns_last = restore_ns;
+	if (restore_ns > resume->restore_ns_max)
+		resume->restore_ns_max = restore_ns;
+	resume->total_ns_last = ktime_to_ns(ktime_sub(ktime_get(), resume->start));
+}
+
+static void tuxedo_resume_work_func(struct work_struct *work)
+{
+	tuxedo_resume_restore(container_of(work, struct tuxedo_resume_t, work));
+}
+
+static void tuxedo_resume_init(struct tuxedo_resume_t *resume, void (*restore)(void))
+{
+	resume->restore = restore;
+	INIT_WORK(&resume->work, tuxedo_resume_work_func);
+}
+
+/**
+ * To be called from the PM resume callback
+ */
+static void tuxedo_resume_run(struct tuxedo_resume_t *resume)
+{
+	u64 callback_ns;
+
+	resume->start = ktime_get();
+	resume->count++;
+
+	if (tuxedo_deferred_resume)
+		schedule_work(&resume->work);
+	else
+		tuxedo_resume_restore(resume);
+
+	callback_ns = ktime_to_ns(ktime_sub(ktime_get(), resume->start));
+	resume->callback_ns_last = callback_ns;
+	if (callback_ns > resume->callback_ns_max)
+		resume->callback_ns_max = callback_ns;
+}
+
+/**
+ * Wait for a restore in flight, e.g. on suspend or remove
+ */
+static void tuxedo_resume_flush(struct tuxedo_resume_t *resume)
+{
+	flush_work(&resume->work);
+}
+
+static void tuxedo_resume_stats_show(struct seq_file *s, struct tuxedo_resume_t *resume)
+{
+	seq_printf(s, "resumes: %llu (%s)\n", resume->count, tuxedo_deferred_resume ? "deferred" : "synchronous");
+	seq_printf(s, "callback_us: last %llu max %llu\n",
+		   div_u64(resume->callback_ns_last, NSEC_PER_USEC),
+		   div_u64(resume->callback_ns_max, NSEC_PER_USEC));
+	seq_printf(s, "restore_us: last %llu max %llu\n",
+		   div_u64(resume->restore_ns_last, NSEC_PER_USEC),
+		   div_u64(resume->restore_ns_max, NSEC_PER_USEC));
+	seq_printf(s, "total_us: last %llu\n", div_u64(resume->total_ns_last, NSEC_PER_USEC));
+}
+
+#endif // TUXEDO_RESUME_H
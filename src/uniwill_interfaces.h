@@ -89,6 +89,24 @@ uniwill_write_ec_ram_t uniwill_write_ec_ram;
 uniwill_write_ec_ram_with_retry_t uniwill_write_ec_ram_with_retry;
 uniwill_read_ec_ram_with_retry_t uniwill_read_ec_ram_with_retry;
 int uniwill_get_active_interface_id(char **id_str);
+void uniwill_ec_session_begin(void);
+void uniwill_ec_session_end(void);
+bool uniwill_kbd_bl_init_wait(unsigned int timeout_ms);
+
+// User visible actions with an EC op budget, see uniwill_action_begin()
+enum uniwill_action {
+	UNIWILL_ACTION_SET_BRIGHTNESS = 0,
+	UNIWILL_ACTION_SET_COLOR,
+	UNIWILL_ACTION_SET_PROFILE,
+	UNIWILL_ACTION_INIT_FAN,
+	UNIWILL_ACTION_SET_CHARGING_PRIORITY,
+	UNIWILL_ACTION_RESUME,
+	UNIWILL_ACTION_PROBE,
+	UNIWILL_ACTION_MAX
+};
+
+void uniwill_action_begin(enum uniwill_action action);
+void uniwill_action_end(enum uniwill_action action);
 
 #define UW_MODEL_PF5LUXG	0x09
 #define UW_MODEL_PH4TUX		0x13
@@ -117,6 +135,8 @@ struct uniwill_device_features_t {
 };
 
 struct uniwill_device_features_t *uniwill_get_device_features(void);
+struct uniwill_device_features_t *uniwill_rescan_device_features(void);
+bool uniwill_device_features_complete(void);
 
 union uw_ec_read_return {
 	u32 dword;
@@ -23,15 +23,22 @@
 #include <linux/acpi.h>
 #include <linux/wmi.h>
 #include <linux/workqueue.h>
-#include <linux/keyboard.h>
+#include <linux/input.h>
 #include <linux/timer.h>
 #include <linux/delay.h>
 #include <linux/leds.h>
 #include <linux/led-class-multicolor.h>
 #include <linux/string.h>
 #include <linux/version.h>
+#include <linux/seq_file.h>
+#include <linux/srcu.h>
 #include "uniwill_interfaces.h"
 #include "uniwill_leds.h"
+#include "tuxedo_quirks.h"
+#include "tuxedo_resume.h"
+#include "tuxedo_event_queue.h"
+#include "tuxedo_pack.h"
+#include "tuxedo_op_budget.h"
 
 #define UNIWILL_OSD_RADIOON			0x01A
 #define UNIWILL_OSD_RADIOOFF			0x01B
@@ -84,22 +91,107 @@ static struct key_entry uniwill_wmi_keymap[] = {
 	{ KE_END,	0 }
 };
 
+/**
+ * Published via SRCU, EC accesses only enter a read side section (they
+ * sleep, so no plain RCU). Removal waits for accesses still in flight.
+ */
 static struct uniwill_interfaces_t {
-	struct uniwill_interface_t *wmi;
+	struct uniwill_interface_t __rcu *wmi;
 } uniwill_interfaces = { .wmi = NULL };
+DEFINE_STATIC_SRCU(uniwill_interface_srcu);
 
 uniwill_event_callb_t uniwill_event_callb;
 
-int uniwill_read_ec_ram(u16 address, u8 *data)
+static DEFINE_TUXEDO_SESSION_LOCK(uniwill_ec_session);
+
+// EC access counters, protected by uniwill_ec_session
+static struct uniwill_ec_stats_t {
+	u64 reads;
+	u64 writes;
+	u64 read_errors;
+	u64 write_errors;
+} uniwill_ec_stats;
+
+// Simulated EC latency per access, debugfs
+static u32 uniwill_ec_sim_delay_us;
+
+/**
+ * EC accesses and time per action, about 12 ms per access
+ */
+static struct tuxedo_op_budget_t uniwill_action_budgets[] = {
+	[UNIWILL_ACTION_SET_BRIGHTNESS] = TUXEDO_OP_BUDGET("set_brightness", 4, 48000),
+	// Three channels, plus 0x1801 with the global dimmer
+	[UNIWILL_ACTION_SET_COLOR] = TUXEDO_OP_BUDGET("set_color", 4, 48000),
+	[UNIWILL_ACTION_SET_PROFILE] = TUXEDO_OP_BUDGET("set_profile", 2, 24000),
+	// Six fan tables of 16 entries, every write is read back
+	[UNIWILL_ACTION_INIT_FAN] = TUXEDO_OP_BUDGET("init_fan", 205, 2460000),
+	[UNIWILL_ACTION_SET_CHARGING_PRIORITY] = TUXEDO_OP_BUDGET("set_charging_priority", 2, 24000),
+	[UNIWILL_ACTION_RESUME] = TUXEDO_OP_BUDGET("resume", 8, 96000),
+	[UNIWILL_ACTION_PROBE] = TUXEDO_OP_BUDGET("probe", 16, 192000),
+};
+
+static struct tuxedo_op_account_t uniwill_op_account =
+	TUXEDO_OP_ACCOUNT_INIT(uniwill_op_account, "uniwill", uniwill_action_budgets);
+
+void uniwill_action_begin(enum uniwill_action action)
 {
-	int status;
+	tuxedo_op_budget_begin(&uniwill_op_account, action);
+}
+EXPORT_SYMBOL(uniwill_action_begin);
+
+void uniwill_action_end(enum uniwill_action action)
+{
+	tuxedo_op_budget_end(&uniwill_op_account, action);
+}
+EXPORT_SYMBOL(uniwill_action_end);
+
+static void uniwill_ec_account(void)
+{
+	u32 sim_delay_us = READ_ONCE(uniwill_ec_sim_delay_us);
+
+	if (sim_delay_us)
+		usleep_range(sim_delay_us, sim_delay_us + sim_delay_us / 8 + 1);
+	tuxedo_op_account_op(&uniwill_op_account);
+}
 
-	if (!IS_ERR_OR_NULL(uniwill_interfaces.wmi))
-		status = uniwill_interfaces.wmi->read_ec_ram(address, data);
+/**
+ * Hold the EC for the calling task over several accesses so that a sequence
+ * of reads/writes can not be interleaved with other EC traffic
+ */
+void uniwill_ec_session_begin(void)
+{
+	tuxedo_session_begin(&uniwill_ec_session);
+}
+EXPORT_SYMBOL(uniwill_ec_session_begin);
+
+void uniwill_ec_session_end(void)
+{
+	tuxedo_session_end(&uniwill_ec_session);
+}
+EXPORT_SYMBOL(uniwill_ec_session_end);
+
+int uniwill_read_ec_ram(u16 address, u8 *data)
+{
+	int status, srcu_idx;
+	struct uniwill_interface_t *interface;
+	bool locked = tuxedo_session_get(&uniwill_ec_session);
+
+	srcu_idx = srcu_read_lock(&uniwill_interface_srcu);
+	interface = srcu_dereference(uniwill_interfaces.wmi, &uniwill_interface_srcu);
+	if (!IS_ERR_OR_NULL(interface))
+		status = interface->read_ec_ram(address, data);
 	else {
 		pr_err("no active interface while read addr 0x%04x\n", address);
 		status = -EIO;
 	}
+	srcu_read_unlock(&uniwill_interface_srcu, srcu_idx);
+
+	uniwill_ec_stats.reads++;
+	if (status)
+		uniwill_ec_stats.read_errors++;
+	uniwill_ec_account();
+
+	tuxedo_session_put(&uniwill_ec_session, locked);
 
 	return status;
 }
@@ -107,7 +199,7 @@ EXPORT_SYMBOL(uniwill_read_ec_ram);
 
 int uniwill_read_ec_ram_with_retry(u16 address, u8 *data, int retries)
 {
-	int status, i;
+	int status = -EIO, i;
 
 	for (i = 0; i < retries; ++i) {
 		status = uniwill_read_ec_ram(address, data);
@@ -123,14 +215,26 @@ EXPORT_SYMBOL(uniwill_read_ec_ram_with_retry);
 
 int uniwill_write_ec_ram(u16 address, u8 data)
 {
-	int status;
-
-	if (!IS_ERR_OR_NULL(uniwill_interfaces.wmi))
-		status = uniwill_interfaces.wmi->write_ec_ram(address, data);
+	int status, srcu_idx;
+	struct uniwill_interface_t *interface;
+	bool locked = tuxedo_session_get(&uniwill_ec_session);
+
+	srcu_idx = srcu_read_lock(&uniwill_interface_srcu);
+	interface = srcu_dereference(uniwill_interfaces.wmi, &uniwill_interface_srcu);
+	if (!IS_ERR_OR_NULL(interface))
+		status = interface->write_ec_ram(address, data);
 	else {
 		pr_err("no active interface while write addr 0x%04x data 0x%02x\n", address, data);
 		status = -EIO;
 	}
+	srcu_read_unlock(&uniwill_interface_srcu, srcu_idx);
+
+	uniwill_ec_stats.writes++;
+	if (status)
+		uniwill_ec_stats.write_errors++;
+	uniwill_ec_account();
+
+	tuxedo_session_put(&uniwill_ec_session, locked);
 
 	return status;
 }
@@ -138,7 +242,7 @@ EXPORT_SYMBOL(uniwill_write_ec_ram);
 
 int uniwill_write_ec_ram_with_retry(u16 address, u8 data, int retries)
 {
-	int status, i;
+	int status = -EIO, i;
 	u8 control_data;
 
 	for (i = 0; i < retries; ++i) {
@@ -168,7 +272,7 @@ int uniwill_add_interface(struct uniwill_interface_t *interface)
 	mutex_lock(&uniwill_interface_modification_lock);
 
 	if (strcmp(interface->string_id, UNIWILL_INTERFACE_WMI_STRID) == 0)
-		uniwill_interfaces.wmi = interface;
+		rcu_assign_pointer(uniwill_interfaces.wmi, interface);
 	else {
 		TUXEDO_DEBUG("trying to add unknown interface\n");
 		mutex_unlock(&uniwill_interface_modification_lock);
@@ -193,7 +297,9 @@ int uniwill_remove_interface(struct uniwill_interface_t *interface)
 		// Remove driver if last interface is removed
 		tuxedo_keyboard_remove_driver(&uniwill_keyboard_driver);
 
-		uniwill_interfaces.wmi = NULL;
+		RCU_INIT_POINTER(uniwill_interfaces.wmi, NULL);
+		// Accesses still running on the interface have to finish before it goes away
+		synchronize_srcu(&uniwill_interface_srcu);
 	} else {
 		mutex_unlock(&uniwill_interface_modification_lock);
 		return -EINVAL;
@@ -207,11 +313,19 @@ EXPORT_SYMBOL(uniwill_remove_interface);
 
 int uniwill_get_active_interface_id(char **id_str)
 {
-	if (IS_ERR_OR_NULL(uniwill_interfaces.wmi))
+	int srcu_idx;
+	struct uniwill_interface_t *interface;
+
+	srcu_idx = srcu_read_lock(&uniwill_interface_srcu);
+	interface = srcu_dereference(uniwill_interfaces.wmi, &uniwill_interface_srcu);
+	if (IS_ERR_OR_NULL(interface)) {
+		srcu_read_unlock(&uniwill_interface_srcu, srcu_idx);
 		return -ENODEV;
+	}
 
 	if (!IS_ERR_OR_NULL(id_str))
-		*id_str = uniwill_interfaces.wmi->string_id;
+		*id_str = interface->string_id;
+	srcu_read_unlock(&uniwill_interface_srcu, srcu_idx);
 
 	return 0;
 }
@@ -227,52 +341,223 @@ static void key_event_work(struct work_struct *work)
 	);
 }
 
-// Previous key codes for detecting longer combination
-static u32 prev_key = 0, prevprev_key = 0;
 static DECLARE_WORK(uniwill_key_event_work, key_event_work);
 
-static int keyboard_notifier_callb(struct notifier_block *nb, unsigned long code, void *_param)
-{
-	struct keyboard_notifier_param *param = _param;
-	int ret = NOTIFY_OK;
-
-	if (!param->down) {
-		if (code == KBD_KEYCODE) {
-			switch (param->value) {
-			case KEY_LEFTMETA:
-				// If the last keys up were 85 -> 29 -> 125
-				// manually report KEY_F21
-				if (prevprev_key == KEY_ZENKAKUHANKAKU && prev_key == KEY_LEFTCTRL) {
-					TUXEDO_DEBUG("Touchpad Toggle\n");
-					schedule_work(&uniwill_key_event_work);
-					ret = NOTIFY_OK;
-				}
-				break;
-			}
-			prevprev_key = prev_key;
-			prev_key = param->value;
+/**
+ * Touchpad toggle detection
+ *
+ * The firmware sends the touchpad toggle as key sequence 85 -> 29 -> 125
+ * (key up) on the internal keyboard. An input handler bound to i8042
+ * keyboards only watches for it, other devices never reach this code.
+ * Events of one device are serialized by the input core, the sequence state
+ * lives in the per-device handle.
+ */
+enum uw_tp_toggle_seq {
+	UW_TP_TOGGLE_SEQ_NONE = 0,
+	UW_TP_TOGGLE_SEQ_ZENKAKUHANKAKU,
+	UW_TP_TOGGLE_SEQ_LEFTCTRL,
+};
+
+struct uw_tp_toggle_handle_t {
+	struct input_handle handle;
+	enum uw_tp_toggle_seq seq;
+};
+
+// Returns true if the sequence completed
+static bool uw_tp_toggle_filter(enum uw_tp_toggle_seq *seq, unsigned int type, unsigned int code, int value)
+{
+	// Key up only
+	if (type != EV_KEY || value != 0)
+		return false;
+
+	switch (code) {
+	case KEY_ZENKAKUHANKAKU:
+		*seq = UW_TP_TOGGLE_SEQ_ZENKAKUHANKAKU;
+		return false;
+	case KEY_LEFTCTRL:
+		*seq = *seq == UW_TP_TOGGLE_SEQ_ZENKAKUHANKAKU ? UW_TP_TOGGLE_SEQ_LEFTCTRL : UW_TP_TOGGLE_SEQ_NONE;
+		return false;
+	case KEY_LEFTMETA:
+		if (*seq == UW_TP_TOGGLE_SEQ_LEFTCTRL) {
+			*seq = UW_TP_TOGGLE_SEQ_NONE;
+			return true;
 		}
+		break;
 	}
+	*seq = UW_TP_TOGGLE_SEQ_NONE;
+	return false;
+}
+
+static void uw_tp_toggle_event(struct input_handle *handle, unsigned int type, unsigned int code, int value)
+{
+	struct uw_tp_toggle_handle_t *tp_handle = container_of(handle, struct uw_tp_toggle_handle_t, handle);
 
-	return ret;
+	if (uw_tp_toggle_filter(&tp_handle->seq, type, code, value)) {
+		TUXEDO_DEBUG("Touchpad Toggle\n");
+		schedule_work(&uniwill_key_event_work);
+	}
 }
 
-static struct notifier_block keyboard_notifier_block = {
-	.notifier_call = keyboard_notifier_callb
+static int uw_tp_toggle_connect(struct input_handler *handler, struct input_dev *dev,
+				const struct input_device_id *id)
+{
+	struct uw_tp_toggle_handle_t *tp_handle;
+	int result;
+
+	tp_handle = kzalloc(sizeof(*tp_handle), GFP_KERNEL);
+	if (!tp_handle)
+		return -ENOMEM;
+
+	tp_handle->handle.dev = dev;
+	tp_handle->handle.handler = handler;
+	tp_handle->handle.name = "tuxedo_tp_toggle";
+
+	result = input_register_handle(&tp_handle->handle);
+	if (result)
+		goto err_free_handle;
+
+	result = input_open_device(&tp_handle->handle);
+	if (result)
+		goto err_unregister_handle;
+
+	return 0;
+
+err_unregister_handle:
+	input_unregister_handle(&tp_handle->handle);
+err_free_handle:
+	kfree(tp_handle);
+	return result;
+}
+
+static void uw_tp_toggle_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(container_of(handle, struct uw_tp_toggle_handle_t, handle));
+}
+
+static const struct input_device_id uw_tp_toggle_ids[] = {
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_BUS | INPUT_DEVICE_ID_MATCH_EVBIT | INPUT_DEVICE_ID_MATCH_KEYBIT,
+		.bustype = BUS_I8042,
+		.evbit = { BIT_MASK(EV_KEY) },
+		.keybit = { [BIT_WORD(KEY_LEFTMETA)] = BIT_MASK(KEY_LEFTMETA) },
+	},
+	{ }
+};
+
+static struct input_handler uw_tp_toggle_handler = {
+	.event = uw_tp_toggle_event,
+	.connect = uw_tp_toggle_connect,
+	.disconnect = uw_tp_toggle_disconnect,
+	.name = "tuxedo_tp_toggle",
+	.id_table = uw_tp_toggle_ids,
 };
 
+static bool uw_tp_toggle_loaded;
+
+/**
+ * Per keystroke cost of the detection, measured on synthetic key events
+ * (write the number of events, read the result)
+ */
+#define UW_TP_TOGGLE_BENCH_MAX_EVENTS	10000000
+// Events between reschedule points, well below a millisecond
+#define UW_TP_TOGGLE_BENCH_CHUNK	4096
+
+static struct uw_tp_toggle_bench_t {
+	u32 events;
+	u64 ns;
+	u32 matches;
+} uw_tp_toggle_bench;
+
+static ssize_t uw_tp_toggle_bench_write(struct file *file, const char __user *buffer, size_t count, loff_t *ppos)
+{
+	static const unsigned int codes[] = { KEY_ZENKAKUHANKAKU, KEY_LEFTCTRL, KEY_LEFTMETA, KEY_LEFTALT };
+	enum uw_tp_toggle_seq seq = UW_TP_TOGGLE_SEQ_NONE;
+	unsigned int events, i, chunk_end, matches = 0;
+	ktime_t start;
+	u64 ns = 0;
+	int result;
+
+	result = kstrtouint_from_user(buffer, count, 0, &events);
+	if (result)
+		return result;
+	if (events == 0 || events > UW_TP_TOGGLE_BENCH_MAX_EVENTS)
+		return -EINVAL;
+
+	for (i = 0; i < events; ) {
+		chunk_end = min(events, i + UW_TP_TOGGLE_BENCH_CHUNK);
+		start = ktime_get();
+		for (; i < chunk_end; ++i) {
+			// Typing: down/up pairs, every 8th key up completes a toggle sequence
+			matches += uw_tp_toggle_filter(&seq, EV_KEY, codes[(i >> 1) & 3], i & 1 ? 0 : 1);
+		}
+		ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+		// Rescheduling between chunks is not part of the measurement
+		cond_resched();
+		if (fatal_signal_pending(current))
+			return -EINTR;
+	}
+	uw_tp_toggle_bench.ns = ns;
+	uw_tp_toggle_bench.events = events;
+	uw_tp_toggle_bench.matches = matches;
+
+	return count;
+}
+
+static int uw_tp_toggle_bench_show(struct seq_file *s, void *unused)
+{
+	struct uw_tp_toggle_bench_t *bench = &uw_tp_toggle_bench;
+
+	seq_printf(s, "bound: %d events: %u matches: %u total_ns: %llu ns_per_event: %llu\n",
+		   uw_tp_toggle_loaded, bench->events, bench->matches, bench->ns,
+		   bench->events ? div_u64(bench->ns, bench->events) : 0);
+	return 0;
+}
+
+static int uw_tp_toggle_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, uw_tp_toggle_bench_show, inode->i_private);
+}
+
+static const struct file_operations uw_tp_toggle_bench_fops = {
+	.owner = THIS_MODULE,
+	.open = uw_tp_toggle_bench_open,
+	.read = seq_read,
+	.write = uw_tp_toggle_bench_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static struct dentry *uw_tp_toggle_bench_dentry;
+
 static void uniwill_write_kbd_bl_enable(u8 enable)
 {
 	u8 backlight_data;
-	enable = enable & 0x01;
 
 	uniwill_read_ec_ram(UW_EC_REG_KBD_BL_STATUS, &backlight_data);
-	backlight_data = backlight_data & ~(1 << 1);
-	backlight_data |= (!enable << 1);
+	// Bit is set to disable
+	backlight_data = tuxedo_field_set(backlight_data, 0x01, 1, !(enable & 0x01));
 	uniwill_write_ec_ram(UW_EC_REG_KBD_BL_STATUS, backlight_data);
 }
 
-void uniwill_event_callb(u32 code)
+/**
+ * Power adapter events come in bursts while the plug is wiggled, the keyboard
+ * state and charging priority are refreshed once things settled
+ */
+#define UW_AC_CHANGE_DEBOUNCE_MS	500
+
+static void uw_ac_change_work_func(struct work_struct *work)
+{
+	// Refresh keyboard state and charging prio on cable switch event
+	uniwill_leds_restore_state_extern();
+	msleep(50);
+	uw_charging_priority_write_state();
+}
+
+static DECLARE_DELAYED_WORK(uw_ac_change_work, uw_ac_change_work_func);
+
+static void uniwill_event_handle(u32 code)
 {
 	switch (code) {
 		case UNIWILL_OSD_MODE_CHANGE_KEY_EVENT:
@@ -288,10 +573,7 @@ void uniwill_event_callb(u32 code)
 			input_sync(uniwill_keyboard_driver.input_device);
 			break;
 		case UNIWILL_OSD_DC_ADAPTER_CHANGE:
-			// Refresh keyboard state and charging prio on cable switch event
-			uniwill_leds_restore_state_extern();
-			msleep(50);
-			uw_charging_priority_write_state();
+			mod_delayed_work(system_wq, &uw_ac_change_work, msecs_to_jiffies(UW_AC_CHANGE_DEBOUNCE_MS));
 			break;
 		case UNIWILL_KEY_KBDILLUMTOGGLE:
 		case UNIWILL_OSD_KB_LED_LEVEL0:
@@ -312,79 +594,231 @@ void uniwill_event_callb(u32 code)
 	}
 }
 
+static u32 uniwill_event_coalesce_class(u32 code)
+{
+	switch (code) {
+	case UNIWILL_KEY_KBDILLUMTOGGLE:
+	case UNIWILL_OSD_KB_LED_LEVEL0:
+	case UNIWILL_OSD_KB_LED_LEVEL1:
+	case UNIWILL_OSD_KB_LED_LEVEL2:
+	case UNIWILL_OSD_KB_LED_LEVEL3:
+	case UNIWILL_OSD_KB_LED_LEVEL4:
+		// Only a brightness read back on white keyboards, key presses otherwise
+		if (uniwill_leds_get_backlight_type() == UNIWILL_KB_BACKLIGHT_TYPE_FIXED_COLOR)
+			return 1;
+		return 0;
+	case UNIWILL_OSD_DC_ADAPTER_CHANGE:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+static struct tuxedo_event_queue_t uniwill_events =
+	TUXEDO_EVENT_QUEUE_INIT(uniwill_events, uniwill_event_handle, uniwill_event_coalesce_class);
+static struct dentry *uniwill_events_dentry;
+
+static int uniwill_events_show(struct seq_file *s, void *unused)
+{
+	tuxedo_event_queue_stats_show(s, &uniwill_events);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(uniwill_events);
+
+/**
+ * Called from the WMI notify handler, handling is deferred to keep the ACPI
+ * notify workqueue free
+ */
+void uniwill_event_callb(u32 code)
+{
+	tuxedo_event_queue_push(&uniwill_events, code);
+}
+
 static void uw_kbd_bl_init_set(struct platform_device *dev)
 {
 	uniwill_leds_init_late(dev);
 	uniwill_write_kbd_bl_enable(1);
+
+	// Effects only after the boot animation, they would fight over the colors otherwise
+	if (uniwill_leds_get_backlight_type() == UNIWILL_KB_BACKLIGHT_TYPE_1_ZONE_RGB)
+		tuxedo_kbd_effects_init(dev, &uniwill_leds_effects_ops);
 }
 
-// Keep track of previous colors on start, init array with different non-colors
-static u32 uw_prev_colors[] = {0x01000000, 0x02000000, 0x03000000};
-static u32 uw_prev_colors_size = 3;
-static u32 uw_prev_colors_index = 0;
+/**
+ * Detection of the end of the firmware boot animation on 1-zone RGB keyboards
+ *
+ * The colors are sampled quickly while they change and less often once they
+ * are stable, the animation counts as done after the colors stayed the same
+ * for UW_KBD_BL_ANIM_STABLE_MS. Uses deferrable work, there is no point in
+ * waking an idle CPU just for this.
+ */
+#define UW_KBD_BL_ANIM_INTERVAL_MIN_MS	50
+#define UW_KBD_BL_ANIM_INTERVAL_MAX_MS	200
+#define UW_KBD_BL_ANIM_STABLE_MS	600
+#define UW_KBD_BL_ANIM_TIMEOUT_MS	20000
+
+enum uw_kbd_bl_anim_state {
+	UW_KBD_BL_ANIM_PENDING,
+	UW_KBD_BL_ANIM_DONE,
+	UW_KBD_BL_ANIM_SKIPPED,
+	UW_KBD_BL_ANIM_TIMEOUT,
+	UW_KBD_BL_ANIM_CANCELLED
+};
 
-// Timer for checking animation colors
-static struct timer_list uw_kbd_bl_init_timer;
-static volatile int uw_kbd_bl_check_count = 40;
-static int uw_kbd_bl_init_check_interval_ms = 500;
+static const char * const uw_kbd_bl_anim_state_names[] = {
+	[UW_KBD_BL_ANIM_PENDING] = "pending",
+	[UW_KBD_BL_ANIM_DONE] = "done",
+	[UW_KBD_BL_ANIM_SKIPPED] = "skipped",
+	[UW_KBD_BL_ANIM_TIMEOUT] = "timeout",
+	[UW_KBD_BL_ANIM_CANCELLED] = "cancelled"
+};
+
+static struct uw_kbd_bl_anim_t {
+	struct platform_device *dev;
+	enum uw_kbd_bl_anim_state state;
+	ktime_t start;
+	// Time of the last observed color change
+	ktime_t last_change;
+	ktime_t end;
+	u32 last_color;
+	bool last_color_valid;
+	unsigned int interval_ms;
+	u32 samples;
+	u32 read_errors;
+} uw_kbd_bl_anim;
+
+// Completed once the keyboard backlight init is through, whatever the outcome
+static DECLARE_COMPLETION(uw_kbd_bl_init_done);
 
 static int uniwill_read_kbd_bl_rgb(u8 *red, u8 *green, u8 *blue)
 {
 	int result = 0;
 
+	// One session for all three, the channels should be from the same animation step
+	uniwill_ec_session_begin();
 	result = uniwill_read_ec_ram(UW_EC_REG_KBD_BL_RGB_RED_BRIGHTNESS, red);
-	if (result) {
-		return result;
-	}
+	if (result)
+		goto out;
 	result = uniwill_read_ec_ram(UW_EC_REG_KBD_BL_RGB_GREEN_BRIGHTNESS, green);
-	if (result) {
-		return result;
-	}
+	if (result)
+		goto out;
 	result = uniwill_read_ec_ram(UW_EC_REG_KBD_BL_RGB_BLUE_BRIGHTNESS, blue);
-	if (result) {
-		return result;
-	}
 
+out:
+	uniwill_ec_session_end();
 	return result;
 }
 
-static struct platform_device *uw_kbd_bl_init_ready_check_work_func_args_dev;
+static void uw_kbd_bl_anim_work_func(struct work_struct *work);
+static DECLARE_DEFERRABLE_WORK(uw_kbd_bl_anim_work, uw_kbd_bl_anim_work_func);
 
-static void uw_kbd_bl_init_ready_check_work_func(struct work_struct *work)
+static void uw_kbd_bl_anim_finish(enum uw_kbd_bl_anim_state state)
 {
-	u8 uw_cur_red, uw_cur_green, uw_cur_blue;
-	int i;
-	bool prev_colors_same;
-	uniwill_read_kbd_bl_rgb(&uw_cur_red, &uw_cur_green, &uw_cur_blue);
-	uw_prev_colors[uw_prev_colors_index] = (uw_cur_red << 0x10) | (uw_cur_green << 0x08) | uw_cur_blue;
-	uw_prev_colors_index = (uw_prev_colors_index + 1) % uw_prev_colors_size;
-
-	prev_colors_same = true;
-	for (i = 1; i < uw_prev_colors_size; ++i) {
-		if (uw_prev_colors[i-1] != uw_prev_colors[i]) prev_colors_same = false;
-	}
+	uw_kbd_bl_anim.state = state;
+	uw_kbd_bl_anim.end = ktime_get();
+	if (state == UW_KBD_BL_ANIM_DONE || state == UW_KBD_BL_ANIM_SKIPPED)
+		uw_kbd_bl_init_set(uw_kbd_bl_anim.dev);
+	else if (state == UW_KBD_BL_ANIM_TIMEOUT)
+		TUXEDO_INFO("uw kbd init timeout, failed to detect end of boot animation\n");
+	complete_all(&uw_kbd_bl_init_done);
+}
 
-	if (prev_colors_same) {
-		uw_kbd_bl_init_set(uw_kbd_bl_init_ready_check_work_func_args_dev);
-		del_timer(&uw_kbd_bl_init_timer);
-	} else {
-		if (uw_kbd_bl_check_count != 0) {
-			mod_timer(&uw_kbd_bl_init_timer, jiffies + msecs_to_jiffies(uw_kbd_bl_init_check_interval_ms));
-		} else {
-			TUXEDO_INFO("uw kbd init timeout, failed to detect end of boot animation\n");
-			del_timer(&uw_kbd_bl_init_timer);
+static void uw_kbd_bl_anim_work_func(struct work_struct *work)
+{
+	struct uw_kbd_bl_anim_t *anim = &uw_kbd_bl_anim;
+	u8 red, green, blue;
+	u32 color;
+	ktime_t now = ktime_get();
+
+	anim->samples++;
+	if (uniwill_read_kbd_bl_rgb(&red, &green, &blue)) {
+		anim->read_errors++;
+	}
+	else {
+		color = (red << 0x10) | (green << 0x08) | blue;
+		if (!anim->last_color_valid || color != anim->last_color) {
+			anim->last_color = color;
+			anim->last_color_valid = true;
+			anim->last_change = now;
+			anim->interval_ms = UW_KBD_BL_ANIM_INTERVAL_MIN_MS;
+		}
+		else if (ktime_ms_delta(now, anim->last_change) >= UW_KBD_BL_ANIM_STABLE_MS) {
+			uw_kbd_bl_anim_finish(UW_KBD_BL_ANIM_DONE);
+			return;
 		}
+		else {
+			anim->interval_ms = min_t(unsigned int, anim->interval_ms * 2, UW_KBD_BL_ANIM_INTERVAL_MAX_MS);
+		}
+	}
+
+	if (ktime_ms_delta(now, anim->start) >= UW_KBD_BL_ANIM_TIMEOUT_MS) {
+		uw_kbd_bl_anim_finish(UW_KBD_BL_ANIM_TIMEOUT);
+		return;
+	}
+
+	schedule_delayed_work(&uw_kbd_bl_anim_work, msecs_to_jiffies(anim->interval_ms));
+}
+
+static void uw_kbd_bl_anim_start(struct platform_device *dev)
+{
+	struct uw_kbd_bl_anim_t *anim = &uw_kbd_bl_anim;
+
+	reinit_completion(&uw_kbd_bl_init_done);
+	anim->dev = dev;
+	anim->state = UW_KBD_BL_ANIM_PENDING;
+	anim->start = ktime_get();
+	anim->last_change = anim->start;
+	anim->last_color_valid = false;
+	anim->interval_ms = UW_KBD_BL_ANIM_INTERVAL_MIN_MS;
+	anim->samples = 0;
+	anim->read_errors = 0;
+
+	// The animation plays right after power on, when loaded later there is
+	// nothing to wait for
+	if (ktime_get_boottime_ns() >= (u64)UW_KBD_BL_ANIM_TIMEOUT_MS * NSEC_PER_MSEC) {
+		uw_kbd_bl_anim_finish(UW_KBD_BL_ANIM_SKIPPED);
+		return;
 	}
 
-	uw_kbd_bl_check_count -= 1;
+	schedule_delayed_work(&uw_kbd_bl_anim_work, 0);
 }
 
-static DECLARE_WORK(uw_kbd_bl_init_ready_check_work, uw_kbd_bl_init_ready_check_work_func);
+static void uw_kbd_bl_anim_cancel(void)
+{
+	if (cancel_delayed_work_sync(&uw_kbd_bl_anim_work)) {
+		uw_kbd_bl_anim.state = UW_KBD_BL_ANIM_CANCELLED;
+		complete_all(&uw_kbd_bl_init_done);
+	}
+}
 
-static void uw_kbd_bl_init_ready_check(struct timer_list *t)
+/**
+ * Wait for the keyboard backlight init to be through, i.e. the user state
+ * has been applied after the boot animation (or detection gave up)
+ *
+ * Returns false on timeout
+ */
+bool uniwill_kbd_bl_init_wait(unsigned int timeout_ms)
 {
-	schedule_work(&uw_kbd_bl_init_ready_check_work);
+	return wait_for_completion_timeout(&uw_kbd_bl_init_done, msecs_to_jiffies(timeout_ms)) != 0;
 }
+EXPORT_SYMBOL(uniwill_kbd_bl_init_wait);
+
+static int uw_kbd_bl_anim_show(struct seq_file *m, void *data)
+{
+	struct uw_kbd_bl_anim_t *anim = &uw_kbd_bl_anim;
+
+	seq_printf(m, "state: %s\n", uw_kbd_bl_anim_state_names[anim->state]);
+	seq_printf(m, "samples: %u\n", anim->samples);
+	seq_printf(m, "read_errors: %u\n", anim->read_errors);
+	if (anim->state != UW_KBD_BL_ANIM_PENDING) {
+		// Animation end relative to the start of the detection
+		seq_printf(m, "animation_end_ms: %lld\n", ktime_ms_delta(anim->last_change, anim->start));
+		seq_printf(m, "detected_ms: %lld\n", ktime_ms_delta(anim->end, anim->start));
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(uw_kbd_bl_anim);
 
 static int uw_kbd_bl_init(struct platform_device *dev)
 {
@@ -398,13 +832,12 @@ static int uw_kbd_bl_init(struct platform_device *dev)
 
 	if (uniwill_leds_get_backlight_type() == UNIWILL_KB_BACKLIGHT_TYPE_1_ZONE_RGB) {
 		// Start periodic checking of animation, set and enable bl when done
-		uw_kbd_bl_init_ready_check_work_func_args_dev = dev;
-		timer_setup(&uw_kbd_bl_init_timer, uw_kbd_bl_init_ready_check, 0);
-		mod_timer(&uw_kbd_bl_init_timer, jiffies + msecs_to_jiffies(uw_kbd_bl_init_check_interval_ms));
+		uw_kbd_bl_anim_start(dev);
 	} else {
 		// For non-RGB versions
 		// Enable keyboard backlight immediately (should it be disabled)
 		uniwill_write_kbd_bl_enable(1);
+		complete_all(&uw_kbd_bl_init_done);
 	}
 
 	return status;
@@ -415,167 +848,223 @@ static int uw_kbd_bl_init(struct platform_device *dev)
 #define UNIWILL_LIGHTBAR_LED_NAME_RGB_GREEN	"lightbar_rgb:2:status"
 #define UNIWILL_LIGHTBAR_LED_NAME_RGB_BLUE	"lightbar_rgb:3:status"
 #define UNIWILL_LIGHTBAR_LED_NAME_ANIMATION	"lightbar_animation::status"
+#define UNIWILL_LIGHTBAR_LED_NAME_MC		"lightbar:rgb:status"
 
-static void uniwill_write_lightbar_rgb(u8 red, u8 green, u8 blue)
+#define UW_EC_REG_LIGHTBAR_ANIMATION		0x0748
+#define UW_EC_REG_LIGHTBAR_ANIMATION_BIT_ON	0x80
+
+static const u16 uw_lightbar_rgb_regs[3] = { 0x0749, 0x074a, 0x074b };
+
+enum uw_lightbar_led_id {
+	UW_LIGHTBAR_LED_RED = 0,
+	UW_LIGHTBAR_LED_GREEN,
+	UW_LIGHTBAR_LED_BLUE,
+	UW_LIGHTBAR_LED_ANIMATION
+};
+
+struct uw_lightbar_led_t {
+	struct led_classdev led_cdev;
+	enum uw_lightbar_led_id id;
+};
+
+/**
+ * Last known animation state, saves the read-modify-write of 0x0748 on every
+ * color change. Protected by the uniwill EC session, invalidated on resume.
+ */
+static struct uw_lightbar_state_t {
+	bool animation;
+	bool animation_valid;
+} uw_lightbar_state;
+
+// Called within the uniwill EC session
+static void uniwill_write_lightbar_channel(int channel, u8 value)
 {
-	if (red <= UNIWILL_LIGHTBAR_LED_MAX_BRIGHTNESS) {
-		uniwill_write_ec_ram(0x0749, red);
-	}
-	if (green <= UNIWILL_LIGHTBAR_LED_MAX_BRIGHTNESS) {
-		uniwill_write_ec_ram(0x074a, green);
-	}
-	if (blue <= UNIWILL_LIGHTBAR_LED_MAX_BRIGHTNESS) {
-		uniwill_write_ec_ram(0x074b, blue);
+	if (value <= UNIWILL_LIGHTBAR_LED_MAX_BRIGHTNESS) {
+		uniwill_write_ec_ram(uw_lightbar_rgb_regs[channel], value);
 	}
 }
 
-static void uniwill_read_lightbar_rgb(u8 *red, u8 *green, u8 *blue)
+static void uniwill_write_lightbar_rgb(u8 red, u8 green, u8 blue)
 {
-	uniwill_read_ec_ram(0x0749, red);
-	uniwill_read_ec_ram(0x074a, green);
-	uniwill_read_ec_ram(0x074b, blue);
+	uniwill_ec_session_begin();
+	uniwill_write_lightbar_channel(UW_LIGHTBAR_LED_RED, red);
+	uniwill_write_lightbar_channel(UW_LIGHTBAR_LED_GREEN, green);
+	uniwill_write_lightbar_channel(UW_LIGHTBAR_LED_BLUE, blue);
+	uniwill_ec_session_end();
 }
 
 static void uniwill_write_lightbar_animation(bool animation_status)
 {
 	u8 value;
 
-	uniwill_read_ec_ram(0x0748, &value);
-	if (animation_status) {
-		value |= 0x80;
-	} else {
-		value &= ~0x80;
+	uniwill_ec_session_begin();
+	if (!uw_lightbar_state.animation_valid || uw_lightbar_state.animation != animation_status) {
+		uniwill_read_ec_ram(UW_EC_REG_LIGHTBAR_ANIMATION, &value);
+		if (animation_status) {
+			value |= UW_EC_REG_LIGHTBAR_ANIMATION_BIT_ON;
+		} else {
+			value &= ~UW_EC_REG_LIGHTBAR_ANIMATION_BIT_ON;
+		}
+		uw_lightbar_state.animation_valid = uniwill_write_ec_ram(UW_EC_REG_LIGHTBAR_ANIMATION, value) == 0;
+		uw_lightbar_state.animation = animation_status;
 	}
-	uniwill_write_ec_ram(0x0748, value);
+	uniwill_ec_session_end();
 }
 
 static void uniwill_read_lightbar_animation(bool *animation_status)
 {
 	u8 lightbar_animation_data;
-	uniwill_read_ec_ram(0x0748, &lightbar_animation_data);
-	*animation_status = (lightbar_animation_data & 0x80) > 0;
+
+	uniwill_ec_session_begin();
+	if (uniwill_read_ec_ram(UW_EC_REG_LIGHTBAR_ANIMATION, &lightbar_animation_data) == 0) {
+		uw_lightbar_state.animation = (lightbar_animation_data & UW_EC_REG_LIGHTBAR_ANIMATION_BIT_ON) > 0;
+		uw_lightbar_state.animation_valid = true;
+	}
+	*animation_status = uw_lightbar_state.animation;
+	uniwill_ec_session_end();
+}
+
+static void uw_lightbar_state_invalidate(void)
+{
+	uniwill_ec_session_begin();
+	uw_lightbar_state.animation_valid = false;
+	uniwill_ec_session_end();
 }
 
 static int lightbar_set_blocking(struct led_classdev *led_cdev, enum led_brightness brightness)
 {
-	u8 red = 0xff, green = 0xff, blue = 0xff;
-	bool led_red = strstr(led_cdev->name, UNIWILL_LIGHTBAR_LED_NAME_RGB_RED) != NULL;
-	bool led_green = strstr(led_cdev->name, UNIWILL_LIGHTBAR_LED_NAME_RGB_GREEN) != NULL;
-	bool led_blue = strstr(led_cdev->name, UNIWILL_LIGHTBAR_LED_NAME_RGB_BLUE) != NULL;
-	bool led_animation = strstr(led_cdev->name, UNIWILL_LIGHTBAR_LED_NAME_ANIMATION) != NULL;
-
-	if (led_red || led_green || led_blue) {
-		if (led_red) {
-			red = brightness;
-		} else if (led_green) {
-			green = brightness;
-		} else if (led_blue) {
-			blue = brightness;
-		}
-		uniwill_write_lightbar_rgb(red, green, blue);
+	struct uw_lightbar_led_t *led = container_of(led_cdev, struct uw_lightbar_led_t, led_cdev);
+
+	if (led->id == UW_LIGHTBAR_LED_ANIMATION) {
+		uniwill_write_lightbar_animation(brightness == 1);
+	} else {
+		uniwill_ec_session_begin();
+		uniwill_write_lightbar_channel(led->id, brightness);
 		// Also make sure the animation is off
 		uniwill_write_lightbar_animation(false);
-	} else if (led_animation) {
-		if (brightness == 1) {
-			uniwill_write_lightbar_animation(true);
-		} else {
-			uniwill_write_lightbar_animation(false);
-		}
+		uniwill_ec_session_end();
 	}
 	return 0;
 }
 
 static enum led_brightness lightbar_get(struct led_classdev *led_cdev)
 {
-	u8 red, green, blue;
+	struct uw_lightbar_led_t *led = container_of(led_cdev, struct uw_lightbar_led_t, led_cdev);
 	bool animation_status;
-	bool led_red = strstr(led_cdev->name, UNIWILL_LIGHTBAR_LED_NAME_RGB_RED) != NULL;
-	bool led_green = strstr(led_cdev->name, UNIWILL_LIGHTBAR_LED_NAME_RGB_GREEN) != NULL;
-	bool led_blue = strstr(led_cdev->name, UNIWILL_LIGHTBAR_LED_NAME_RGB_BLUE) != NULL;
-	bool led_animation = strstr(led_cdev->name, UNIWILL_LIGHTBAR_LED_NAME_ANIMATION) != NULL;
-
-	if (led_red || led_green || led_blue) {
-		uniwill_read_lightbar_rgb(&red, &green, &blue);
-		if (led_red) {
-			return red;
-		} else if (led_green) {
-			return green;
-		} else if (led_blue) {
-			return blue;
-		}
-	} else if (led_animation) {
+	u8 value;
+
+	if (led->id == UW_LIGHTBAR_LED_ANIMATION) {
 		uniwill_read_lightbar_animation(&animation_status);
 		return animation_status ? 1 : 0;
 	}
 
+	if (uniwill_read_ec_ram(uw_lightbar_rgb_regs[led->id], &value))
+		return 0;
+	return value;
+}
+
+/**
+ * All three channels at once, one EC session per color change
+ */
+static int lightbar_mc_set_blocking(struct led_classdev *led_cdev, enum led_brightness brightness)
+{
+	struct led_classdev_mc *mcled_cdev = lcdev_to_mccdev(led_cdev);
+
+	led_mc_calc_color_components(mcled_cdev, brightness);
+
+	uniwill_ec_session_begin();
+	uniwill_write_lightbar_rgb(mcled_cdev->subled_info[0].brightness,
+				   mcled_cdev->subled_info[1].brightness,
+				   mcled_cdev->subled_info[2].brightness);
+	uniwill_write_lightbar_animation(false);
+	uniwill_ec_session_end();
+
 	return 0;
 }
 
 static bool uw_lightbar_loaded;
-static struct led_classdev lightbar_led_classdevs[] = {
+static struct uw_lightbar_led_t lightbar_leds[] = {
 	{
-		.name = UNIWILL_LIGHTBAR_LED_NAME_RGB_RED,
-		.max_brightness = UNIWILL_LIGHTBAR_LED_MAX_BRIGHTNESS,
-		.brightness_set_blocking = &lightbar_set_blocking,
-		.brightness_get = &lightbar_get
+		.id = UW_LIGHTBAR_LED_RED,
+		.led_cdev.name = UNIWILL_LIGHTBAR_LED_NAME_RGB_RED,
+		.led_cdev.max_brightness = UNIWILL_LIGHTBAR_LED_MAX_BRIGHTNESS,
+		.led_cdev.brightness_set_blocking = &lightbar_set_blocking,
+		.led_cdev.brightness_get = &lightbar_get
 	},
 	{
-		.name = UNIWILL_LIGHTBAR_LED_NAME_RGB_GREEN,
-		.max_brightness = UNIWILL_LIGHTBAR_LED_MAX_BRIGHTNESS,
-		.brightness_set_blocking = &lightbar_set_blocking,
-		.brightness_get = &lightbar_get
+		.id = UW_LIGHTBAR_LED_GREEN,
+		.led_cdev.name = UNIWILL_LIGHTBAR_LED_NAME_RGB_GREEN,
+		.led_cdev.max_brightness = UNIWILL_LIGHTBAR_LED_MAX_BRIGHTNESS,
+		.led_cdev.brightness_set_blocking = &lightbar_set_blocking,
+		.led_cdev.brightness_get = &lightbar_get
 	},
 	{
-		.name = UNIWILL_LIGHTBAR_LED_NAME_RGB_BLUE,
-		.max_brightness = UNIWILL_LIGHTBAR_LED_MAX_BRIGHTNESS,
-		.brightness_set_blocking = &lightbar_set_blocking,
-		.brightness_get = &lightbar_get
+		.id = UW_LIGHTBAR_LED_BLUE,
+		.led_cdev.name = UNIWILL_LIGHTBAR_LED_NAME_RGB_BLUE,
+		.led_cdev.max_brightness = UNIWILL_LIGHTBAR_LED_MAX_BRIGHTNESS,
+		.led_cdev.brightness_set_blocking = &lightbar_set_blocking,
+		.led_cdev.brightness_get = &lightbar_get
 	},
 	{
-		.name = UNIWILL_LIGHTBAR_LED_NAME_ANIMATION,
-		.max_brightness = 1,
-		.brightness_set_blocking = &lightbar_set_blocking,
-		.brightness_get = &lightbar_get
+		.id = UW_LIGHTBAR_LED_ANIMATION,
+		.led_cdev.name = UNIWILL_LIGHTBAR_LED_NAME_ANIMATION,
+		.led_cdev.max_brightness = 1,
+		.led_cdev.brightness_set_blocking = &lightbar_set_blocking,
+		.led_cdev.brightness_get = &lightbar_get
 	}
 };
 
+static struct mc_subled lightbar_mcled_subleds[3] = {
+	{
+		.color_index = LED_COLOR_ID_RED,
+		.intensity = UNIWILL_LIGHTBAR_LED_MAX_BRIGHTNESS,
+		.channel = UW_LIGHTBAR_LED_RED
+	},
+	{
+		.color_index = LED_COLOR_ID_GREEN,
+		.intensity = UNIWILL_LIGHTBAR_LED_MAX_BRIGHTNESS,
+		.channel = UW_LIGHTBAR_LED_GREEN
+	},
+	{
+		.color_index = LED_COLOR_ID_BLUE,
+		.intensity = UNIWILL_LIGHTBAR_LED_MAX_BRIGHTNESS,
+		.channel = UW_LIGHTBAR_LED_BLUE
+	}
+};
+
+static struct led_classdev_mc lightbar_mcled_cdev = {
+	.led_cdev.name = UNIWILL_LIGHTBAR_LED_NAME_MC,
+	.led_cdev.max_brightness = UNIWILL_LIGHTBAR_LED_MAX_BRIGHTNESS,
+	.led_cdev.brightness_set_blocking = &lightbar_mc_set_blocking,
+	.led_cdev.brightness = 0,
+	.num_colors = 3,
+	.subled_info = lightbar_mcled_subleds
+};
+static bool uw_lightbar_mc_loaded;
+
 static int uw_lightbar_init(struct platform_device *dev)
 {
 	int i, j, status;
 
-	bool lightbar_supported = false
-		|| dmi_match(DMI_BOARD_NAME, "LAPQC71A")
-		|| dmi_match(DMI_BOARD_NAME, "LAPQC71B")
-		|| dmi_match(DMI_BOARD_NAME, "TRINITY1501I")
-		|| dmi_match(DMI_BOARD_NAME, "TRINITY1701I")
-		|| dmi_match(DMI_PRODUCT_NAME, "A60 MUV")
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 18, 0)
-		|| dmi_match(DMI_PRODUCT_SKU, "STELLARIS1XI03")
-		|| dmi_match(DMI_PRODUCT_SKU, "STELLARIS1XA03")
-		|| dmi_match(DMI_PRODUCT_SKU, "STELLARIS1XI04")
-		|| dmi_match(DMI_PRODUCT_SKU, "STEPOL1XA04")
-
-#endif
-		;
-
-#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 18, 0)
-	TUXEDO_ERROR(
-		"Warning: Kernel version less that 4.18, lightbar might not be properly recognized.");
-#endif
-
-	if (!lightbar_supported)
+	if (!tuxedo_quirk(TUXEDO_QUIRK_UW_LIGHTBAR))
 		return -ENODEV;
 
-	for (i = 0; i < ARRAY_SIZE(lightbar_led_classdevs); ++i) {
-		status = led_classdev_register(&dev->dev, &lightbar_led_classdevs[i]);
+	for (i = 0; i < ARRAY_SIZE(lightbar_leds); ++i) {
+		status = led_classdev_register(&dev->dev, &lightbar_leds[i].led_cdev);
 		if (status < 0) {
 			for (j = 0; j < i; j++)
-				led_classdev_unregister(&lightbar_led_classdevs[j]);
+				led_classdev_unregister(&lightbar_leds[j].led_cdev);
 			return status;
 		}
 	}
 
+	// Optional, the single channel interface is complete on its own
+	uw_lightbar_mc_loaded = led_classdev_multicolor_register(&dev->dev, &lightbar_mcled_cdev) == 0;
+	if (!uw_lightbar_mc_loaded)
+		pr_err("Registering lightbar multicolor leds interface failed\n");
+
 	// Init default state
+	uw_lightbar_state_invalidate();
 	uniwill_write_lightbar_animation(false);
 	uniwill_write_lightbar_rgb(0, 0, 0);
 
@@ -585,8 +1074,13 @@ static int uw_lightbar_init(struct platform_device *dev)
 static int uw_lightbar_remove(struct platform_device *dev)
 {
 	int i;
-	for (i = 0; i < ARRAY_SIZE(lightbar_led_classdevs); ++i) {
-		led_classdev_unregister(&lightbar_led_classdevs[i]);
+
+	if (uw_lightbar_mc_loaded)
+		led_classdev_multicolor_unregister(&lightbar_mcled_cdev);
+	uw_lightbar_mc_loaded = false;
+
+	for (i = 0; i < ARRAY_SIZE(lightbar_leds); ++i) {
+		led_classdev_unregister(&lightbar_leds[i].led_cdev);
 	}
 	return 0;
 }
@@ -632,16 +1126,17 @@ static int uw_set_charging_priority(u8 charging_priority)
 	u8 previous_data, next_data;
 	int result;
 
-	charging_priority = (charging_priority & 0x01) << 7;
+	charging_priority &= 0x01;
 
+	uniwill_action_begin(UNIWILL_ACTION_SET_CHARGING_PRIORITY);
 	result = uniwill_read_ec_ram(0x07cc, &previous_data);
-	if (result != 0)
-		return result;
-
-	next_data = (previous_data & ~(1 << 7)) | charging_priority;
-	result = uniwill_write_ec_ram(0x07cc, next_data);
-	if (result == 0)
-		uw_charging_prio_last_written_value = charging_priority;
+	if (result == 0) {
+		next_data = tuxedo_field_set(previous_data, 0x01, 7, charging_priority);
+		result = uniwill_write_ec_ram(0x07cc, next_data);
+		if (result == 0)
+			uw_charging_prio_last_written_value = charging_priority;
+	}
+	uniwill_action_end(UNIWILL_ACTION_SET_CHARGING_PRIORITY);
 
 	return result;
 }
@@ -649,7 +1144,7 @@ static int uw_set_charging_priority(u8 charging_priority)
 static int uw_get_charging_priority(u8 *charging_priority)
 {
 	int result = uniwill_read_ec_ram(0x07cc, charging_priority);
-	*charging_priority = (*charging_priority >> 7) & 0x01;
+	*charging_priority = tuxedo_field_get(*charging_priority, 0x01, 7);
 	return result;
 }
 
@@ -658,14 +1153,7 @@ static int uw_has_charging_priority(bool *status)
 	u8 data;
 	int result;
 
-	bool not_supported_device = false
-		|| dmi_match(DMI_BOARD_NAME, "PF5PU1G")
-		|| dmi_match(DMI_BOARD_NAME, "LAPQC71A")
-		|| dmi_match(DMI_BOARD_NAME, "LAPQC71B")
-		|| dmi_match(DMI_PRODUCT_NAME, "A60 MUV")
-	;
-
-	if (not_supported_device) {
+	if (tuxedo_quirk(TUXEDO_QUIRK_UW_NO_CHARGING_PRIO)) {
 		*status = false;
 		return 0;
 	}
@@ -704,7 +1192,7 @@ static void uw_charging_priority_init(struct platform_device *dev)
 }
 
 static bool uw_charging_profile_loaded = false;
-static bool uw_charging_profile_last_written_value;
+static u8 uw_charging_profile_last_written_value;
 
 static ssize_t uw_charging_profiles_available_show(struct device *child,
 						   struct device_attribute *attr,
@@ -745,13 +1233,13 @@ static int uw_set_charging_profile(u8 charging_profile)
 	u8 previous_data, next_data;
 	int result;
 
-	charging_profile = (charging_profile & 0x03) << 4;
+	charging_profile &= 0x03;
 
 	result = uniwill_read_ec_ram(0x07a6, &previous_data);
 	if (result != 0)
 		return result;
 
-	next_data = (previous_data & ~(0x03 << 4)) | charging_profile;
+	next_data = tuxedo_field_set(previous_data, 0x03, 4, charging_profile);
 	result = uniwill_write_ec_ram(0x07a6, next_data);
 
 	if (result == 0)
@@ -764,7 +1252,7 @@ static int uw_get_charging_profile(u8 *charging_profile)
 {
 	int result = uniwill_read_ec_ram(0x07a6, charging_profile);
 	if (result == 0)
-		*charging_profile = (*charging_profile >> 4) & 0x03;
+		*charging_profile = tuxedo_field_get(*charging_profile, 0x03, 4);
 	return result;
 }
 
@@ -773,14 +1261,7 @@ static int uw_has_charging_profile(bool *status)
 	u8 data;
 	int result;
 
-	bool not_supported_device = false
-		|| dmi_match(DMI_BOARD_NAME, "PF5PU1G")
-		|| dmi_match(DMI_BOARD_NAME, "LAPQC71A")
-		|| dmi_match(DMI_BOARD_NAME, "LAPQC71B")
-		|| dmi_match(DMI_PRODUCT_NAME, "A60 MUV")
-	;
-
-	if (not_supported_device) {
+	if (tuxedo_quirk(TUXEDO_QUIRK_UW_NO_CHARGING_PROFILE)) {
 		*status = false;
 		return 0;
 	}
@@ -1099,42 +1580,14 @@ struct uniwill_device_features_t *uniwill_get_device_features(void)
 		feats_loaded = false;
 	}
 
-	uw_feats->uniwill_profile_v1_two_profs = false
-		|| dmi_match(DMI_BOARD_NAME, "PF5PU1G")
-		|| dmi_match(DMI_BOARD_NAME, "PULSE1401")
-		|| dmi_match(DMI_BOARD_NAME, "PULSE1501")
-	;
-
-	uw_feats->uniwill_profile_v1_three_profs = false
+	uw_feats->uniwill_profile_v1_two_profs =
+		tuxedo_quirk(TUXEDO_QUIRK_UW_PROFILE_V1_TWO_PROFS);
 	// Devices with "classic" profile support
-		|| dmi_match(DMI_BOARD_NAME, "POLARIS1501A1650TI")
-		|| dmi_match(DMI_BOARD_NAME, "POLARIS1501A2060")
-		|| dmi_match(DMI_BOARD_NAME, "POLARIS1501I1650TI")
-		|| dmi_match(DMI_BOARD_NAME, "POLARIS1501I2060")
-		|| dmi_match(DMI_BOARD_NAME, "POLARIS1701A1650TI")
-		|| dmi_match(DMI_BOARD_NAME, "POLARIS1701A2060")
-		|| dmi_match(DMI_BOARD_NAME, "POLARIS1701I1650TI")
-		|| dmi_match(DMI_BOARD_NAME, "POLARIS1701I2060")
-		// Note: XMG Fusion removed for now, seem to have
-		// neither same power profile control nor TDP set
-		//|| dmi_match(DMI_BOARD_NAME, "LAPQC71A")
-		//|| dmi_match(DMI_BOARD_NAME, "LAPQC71B")
-		//|| dmi_match(DMI_PRODUCT_NAME, "A60 MUV")
-	;
-
-	uw_feats->uniwill_profile_v1_three_profs_leds_only = false
+	uw_feats->uniwill_profile_v1_three_profs =
+		tuxedo_quirk(TUXEDO_QUIRK_UW_PROFILE_V1_THREE_PROFS);
 	// Devices where profile mainly controls power profile LED status
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 18, 0)
-		|| dmi_match(DMI_PRODUCT_SKU, "POLARIS1XA02")
-		|| dmi_match(DMI_PRODUCT_SKU, "POLARIS1XI02")
-		|| dmi_match(DMI_PRODUCT_SKU, "POLARIS1XA03")
-		|| dmi_match(DMI_PRODUCT_SKU, "POLARIS1XI03")
-		|| dmi_match(DMI_PRODUCT_SKU, "STELLARIS1XI03")
-		|| dmi_match(DMI_PRODUCT_SKU, "STELLARIS1XA03")
-		|| dmi_match(DMI_PRODUCT_SKU, "STELLARIS1XI04")
-		|| dmi_match(DMI_PRODUCT_SKU, "STEPOL1XA04")
-#endif
-	;
+	uw_feats->uniwill_profile_v1_three_profs_leds_only =
+		tuxedo_quirk(TUXEDO_QUIRK_UW_PROFILE_V1_THREE_PROFS_LEDS_ONLY);
 
 	uw_feats->uniwill_profile_v1 =
 		uw_feats->uniwill_profile_v1_two_profs ||
@@ -1164,6 +1617,147 @@ struct uniwill_device_features_t *uniwill_get_device_features(void)
 }
 EXPORT_SYMBOL(uniwill_get_device_features);
 
+/**
+ * True once all features could be read, the result of
+ * uniwill_get_device_features() doesn't change afterwards
+ */
+bool uniwill_device_features_complete(void)
+{
+	return uw_feats_loaded;
+}
+EXPORT_SYMBOL(uniwill_device_features_complete);
+
+/**
+ * Drop the stored features and probe them again
+ */
+struct uniwill_device_features_t *uniwill_rescan_device_features(void)
+{
+	uw_feats_loaded = false;
+	return uniwill_get_device_features();
+}
+EXPORT_SYMBOL(uniwill_rescan_device_features);
+
+static int uniwill_ec_stats_show(struct seq_file *m, void *data)
+{
+	struct uniwill_ec_stats_t ec_stats;
+	struct uniwill_leds_stats_t leds_stats;
+
+	uniwill_ec_session_begin();
+	ec_stats = uniwill_ec_stats;
+	leds_stats = uniwill_leds_stats;
+	uniwill_ec_session_end();
+
+	seq_printf(m, "ec_reads: %llu\n", ec_stats.reads);
+	seq_printf(m, "ec_writes: %llu\n", ec_stats.writes);
+	seq_printf(m, "ec_read_errors: %llu\n", ec_stats.read_errors);
+	seq_printf(m, "ec_write_errors: %llu\n", ec_stats.write_errors);
+	seq_printf(m, "kbd_bl_updates: %llu\n", leds_stats.updates);
+	seq_printf(m, "kbd_bl_channel_writes: %llu\n", leds_stats.channel_writes);
+	seq_printf(m, "kbd_bl_channel_writes_skipped: %llu\n", leds_stats.channel_writes_skipped);
+	seq_printf(m, "kbd_bl_dimmer_writes: %llu\n", leds_stats.dimmer_writes);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(uniwill_ec_stats);
+
+/**
+ * EC RAM window dump for diagnostics, e.g. 0x0700 configuration, 0x0f00 fan
+ * tables or 0x1800 backlight. Set start/length, read dump. The session is
+ * held for one row of 16 bytes and released in between so fan control and
+ * other EC users are not starved, dumps are limited to one per interval.
+ */
+#define UNIWILL_EC_DUMP_ROW		16
+#define UNIWILL_EC_DUMP_MAX_LENGTH	0x100
+#define UNIWILL_EC_DUMP_INTERVAL_MS	1000
+
+static u16 uniwill_ec_dump_start = 0x0700;
+static u16 uniwill_ec_dump_length = UNIWILL_EC_DUMP_MAX_LENGTH;
+static DEFINE_MUTEX(uniwill_ec_dump_lock);
+static ktime_t uniwill_ec_dump_last;
+
+static int uniwill_ec_dump_show(struct seq_file *s, void *unused)
+{
+	u8 row[UNIWILL_EC_DUMP_ROW];
+	u16 row_errors;
+	u32 start, length, offset, i;
+
+	if (!mutex_trylock(&uniwill_ec_dump_lock))
+		return -EBUSY;
+	if (uniwill_ec_dump_last &&
+	    ktime_ms_delta(ktime_get(), uniwill_ec_dump_last) < UNIWILL_EC_DUMP_INTERVAL_MS) {
+		mutex_unlock(&uniwill_ec_dump_lock);
+		return -EAGAIN;
+	}
+
+	start = READ_ONCE(uniwill_ec_dump_start);
+	length = min_t(u32, READ_ONCE(uniwill_ec_dump_length), UNIWILL_EC_DUMP_MAX_LENGTH);
+	length = min_t(u32, length, 0x10000 - start);
+
+	for (offset = 0; offset < length; offset += UNIWILL_EC_DUMP_ROW) {
+		row_errors = 0;
+		uniwill_ec_session_begin();
+		for (i = 0; i < UNIWILL_EC_DUMP_ROW && offset + i < length; ++i)
+			if (uniwill_read_ec_ram(start + offset + i, &row[i]))
+				row_errors |= BIT(i);
+		uniwill_ec_session_end();
+
+		seq_printf(s, "%04x:", start + offset);
+		for (i = 0; i < UNIWILL_EC_DUMP_ROW && offset + i < length; ++i) {
+			if (row_errors & BIT(i))
+				seq_puts(s, " --");
+			else
+				seq_printf(s, " %02x", row[i]);
+		}
+		seq_putc(s, '\n');
+	}
+
+	uniwill_ec_dump_last = ktime_get();
+	mutex_unlock(&uniwill_ec_dump_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(uniwill_ec_dump);
+
+static struct dentry *uniwill_ec_dump_dentry;
+
+static void uniwill_ec_dump_debugfs_create(void)
+{
+	uniwill_ec_dump_dentry = debugfs_create_dir("uniwill_ec_dump", tuxedo_debugfs_root);
+	debugfs_create_x16("start", 0600, uniwill_ec_dump_dentry, &uniwill_ec_dump_start);
+	debugfs_create_u16("length", 0600, uniwill_ec_dump_dentry, &uniwill_ec_dump_length);
+	debugfs_create_file("dump", 0400, uniwill_ec_dump_dentry, NULL, &uniwill_ec_dump_fops);
+}
+
+static void uniwill_ec_dump_debugfs_remove(void)
+{
+	debugfs_remove_recursive(uniwill_ec_dump_dentry);
+	uniwill_ec_dump_dentry = NULL;
+}
+
+static struct dentry *uniwill_ec_stats_dentry;
+static struct dentry *uw_kbd_bl_anim_dentry;
+
+static struct tuxedo_resume_t uniwill_keyboard_resume_restore;
+static struct dentry *uniwill_keyboard_resume_dentry;
+
+static void uniwill_keyboard_restore(void)
+{
+	uniwill_action_begin(UNIWILL_ACTION_RESUME);
+	// Still waiting for the boot animation, the state is applied once it ends
+	if (completion_done(&uw_kbd_bl_init_done))
+		uniwill_leds_restore_state_extern();
+	uniwill_write_kbd_bl_enable(1);
+	tuxedo_kbd_effects_resume();
+	uniwill_action_end(UNIWILL_ACTION_RESUME);
+}
+
+static int uniwill_keyboard_resume_show(struct seq_file *s, void *unused)
+{
+	tuxedo_resume_stats_show(s, &uniwill_keyboard_resume_restore);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(uniwill_keyboard_resume);
+
 static int uniwill_keyboard_probe(struct platform_device *dev)
 {
 	u32 i;
@@ -1171,6 +1765,7 @@ static int uniwill_keyboard_probe(struct platform_device *dev)
 	int status;
 	struct uniwill_device_features_t *uw_feats;
 
+	uniwill_action_begin(UNIWILL_ACTION_PROBE);
 	set_rom_id();
 
 	uw_feats = uniwill_get_device_features();
@@ -1201,7 +1796,9 @@ static int uniwill_keyboard_probe(struct platform_device *dev)
 	// Zero second fan temp for detection
 	uniwill_write_ec_ram(0x044f, 0x00);
 
-	status = register_keyboard_notifier(&keyboard_notifier_block);
+	uw_tp_toggle_loaded = input_register_handler(&uw_tp_toggle_handler) == 0;
+	uw_tp_toggle_bench_dentry = debugfs_create_file("uniwill_tp_toggle_bench", 0644, tuxedo_debugfs_root,
+							NULL, &uw_tp_toggle_bench_fops);
 
 	uw_kbd_bl_init(dev);
 
@@ -1210,18 +1807,52 @@ static int uniwill_keyboard_probe(struct platform_device *dev)
 
 	uw_charging_priority_init(dev);
 	uw_charging_profile_init(dev);
+	uniwill_action_end(UNIWILL_ACTION_PROBE);
+
+	tuxedo_op_account_debugfs_create(&uniwill_op_account, tuxedo_debugfs_root);
+	debugfs_create_u32("sim_delay_us", 0644, uniwill_op_account.dentry, &uniwill_ec_sim_delay_us);
+
+	uniwill_ec_stats_dentry = debugfs_create_file("uniwill_ec_stats", 0444, tuxedo_debugfs_root,
+						      NULL, &uniwill_ec_stats_fops);
+	uniwill_ec_dump_debugfs_create();
+	uw_kbd_bl_anim_dentry = debugfs_create_file("uniwill_kbd_bl_init", 0444, tuxedo_debugfs_root,
+						    NULL, &uw_kbd_bl_anim_fops);
+
+	tuxedo_event_queue_start(&uniwill_events);
+	uniwill_events_dentry = debugfs_create_file("uniwill_events", 0444, tuxedo_debugfs_root,
+						    NULL, &uniwill_events_fops);
+
+	tuxedo_resume_init(&uniwill_keyboard_resume_restore, uniwill_keyboard_restore);
+	uniwill_keyboard_resume_dentry = debugfs_create_file("uniwill_resume_stats", 0444, tuxedo_debugfs_root,
+							     NULL, &uniwill_keyboard_resume_fops);
 
 	return 0;
 }
 
 static int uniwill_keyboard_remove(struct platform_device *dev)
 {
+	tuxedo_op_account_debugfs_remove(&uniwill_op_account);
+	debugfs_remove(uniwill_ec_stats_dentry);
+	uniwill_ec_stats_dentry = NULL;
+	uniwill_ec_dump_debugfs_remove();
+	debugfs_remove(uw_kbd_bl_anim_dentry);
+	uw_kbd_bl_anim_dentry = NULL;
+	debugfs_remove(uniwill_keyboard_resume_dentry);
+	uniwill_keyboard_resume_dentry = NULL;
+	debugfs_remove(uniwill_events_dentry);
+	uniwill_events_dentry = NULL;
+	tuxedo_event_queue_stop(&uniwill_events);
+	cancel_delayed_work_sync(&uw_ac_change_work);
+	tuxedo_resume_flush(&uniwill_keyboard_resume_restore);
+
 	if (uw_charging_prio_loaded)
 		sysfs_remove_group(&dev->dev.kobj, &uw_charging_prio_attr_group);
 
 	if (uw_charging_profile_loaded)
 		sysfs_remove_group(&dev->dev.kobj, &uw_charging_profile_attr_group);
 
+	uw_kbd_bl_anim_cancel();
+	tuxedo_kbd_effects_remove(dev);
 	uniwill_leds_remove(dev);
 
 	// Restore previous backlight enable state
@@ -1229,9 +1860,12 @@ static int uniwill_keyboard_remove(struct platform_device *dev)
 		uniwill_write_kbd_bl_enable(uniwill_kbd_bl_enable_state_on_start);
 	}
 
-	unregister_keyboard_notifier(&keyboard_notifier_block);
+	debugfs_remove(uw_tp_toggle_bench_dentry);
+	uw_tp_toggle_bench_dentry = NULL;
+	if (uw_tp_toggle_loaded)
+		input_unregister_handler(&uw_tp_toggle_handler);
+	uw_tp_toggle_loaded = false;
 
-	del_timer(&uw_kbd_bl_init_timer);
 
 	if (uw_lightbar_loaded)
 		uw_lightbar_remove(dev);
@@ -1244,14 +1878,17 @@ static int uniwill_keyboard_remove(struct platform_device *dev)
 
 static int uniwill_keyboard_suspend(struct platform_device *dev, pm_message_t state)
 {
+	tuxedo_resume_flush(&uniwill_keyboard_resume_restore);
+	tuxedo_kbd_effects_suspend();
 	uniwill_write_kbd_bl_enable(0);
 	return 0;
 }
 
 static int uniwill_keyboard_resume(struct platform_device *dev)
 {
-	uniwill_leds_restore_state_extern();
-	uniwill_write_kbd_bl_enable(1);
+	if (uw_lightbar_loaded)
+		uw_lightbar_state_invalidate();
+	tuxedo_resume_run(&uniwill_keyboard_resume_restore);
 	return 0;
 }
 
@@ -59,14 +59,78 @@ void uniwill_leds_set_color_extern(u32 color);
 #include "uniwill_interfaces.h"
 
 #include <linux/led-class-multicolor.h>
+#include <linux/moduleparam.h>
+#include "tuxedo_quirks.h"
+#include "tuxedo_kbd_effects.h"
+#include "tuxedo_led_commit.h"
+#include "tuxedo_kbd_frame.h"
+#include "tuxedo_pack.h"
 
 static enum uniwill_kb_backlight_types uniwill_kb_backlight_type = UNIWILL_KB_BACKLIGHT_TYPE_NONE;
 static bool uw_leds_initialized = false;
 
+static bool uw_kbd_bl_global_dimmer_param = false;
+module_param_named(uw_kbd_bl_global_dimmer, uw_kbd_bl_global_dimmer_param, bool, S_IRUSR);
+MODULE_PARM_DESC(uw_kbd_bl_global_dimmer, "Use 0x1801 as brightness dimmer for 1-zone RGB keyboards (also set by device quirk)");
+
+// Brightness goes to UW_EC_REG_KBD_BL_MAX_BRIGHTNESS, channels carry the color only
+static bool uw_kbd_bl_global_dimmer = false;
+
+static const u16 uw_kbd_bl_rgb_regs[3] = {
+	UW_EC_REG_KBD_BL_RGB_RED_BRIGHTNESS,
+	UW_EC_REG_KBD_BL_RGB_GREEN_BRIGHTNESS,
+	UW_EC_REG_KBD_BL_RGB_BLUE_BRIGHTNESS
+};
+
+/**
+ * Values last written to the EC, writes of unchanged values are skipped.
+ * Protected by the uniwill EC session.
+ */
+static struct uniwill_kbd_bl_shadow_t {
+	u8 rgb[3];
+	u8 rgb_valid; // bit per channel
+	u8 max_brightness;
+	bool max_brightness_valid;
+} uw_kbd_bl_shadow;
+
+// Protected by the uniwill EC session
+static struct uniwill_leds_stats_t {
+	u64 updates;
+	u64 channel_writes;
+	u64 channel_writes_skipped;
+	u64 dimmer_writes;
+} uniwill_leds_stats;
+
+static void uniwill_kbd_bl_shadow_invalidate(void)
+{
+	uniwill_ec_session_begin();
+	uw_kbd_bl_shadow.rgb_valid = 0;
+	uw_kbd_bl_shadow.max_brightness_valid = false;
+	uniwill_ec_session_end();
+}
+
+static int uniwill_write_kbd_bl_max_brightness(u8 max_brightness)
+{
+	int result = 0;
+
+	uniwill_ec_session_begin();
+	if (!uw_kbd_bl_shadow.max_brightness_valid || uw_kbd_bl_shadow.max_brightness != max_brightness) {
+		result = uniwill_write_ec_ram(UW_EC_REG_KBD_BL_MAX_BRIGHTNESS, max_brightness);
+		uw_kbd_bl_shadow.max_brightness = max_brightness;
+		uw_kbd_bl_shadow.max_brightness_valid = (result == 0);
+		uniwill_leds_stats.dimmer_writes++;
+	}
+	uniwill_ec_session_end();
+
+	return result;
+}
+
 static int uniwill_write_kbd_bl_white(u8 brightness)
 {
 	u8 data;
+	int result;
 
+	uniwill_ec_session_begin();
 	uniwill_read_ec_ram(UW_EC_REG_KBD_BL_RGB_BLUE_BRIGHTNESS, &data);
 	// When keyboard backlight  is off, new settings to 0x078c do not get applied automatically
 	// on Pulse Gen1/2 until next keypress or manual change to 0x1808 (immediate brightness
@@ -75,6 +139,7 @@ static int uniwill_write_kbd_bl_white(u8 brightness)
 	// not need this workaround.
 	if (!data && brightness) {
 		uniwill_write_ec_ram(UW_EC_REG_KBD_BL_RGB_BLUE_BRIGHTNESS, 0x01);
+		uw_kbd_bl_shadow.rgb_valid &= ~BIT(2);
 	}
 
 	data = 0;
@@ -82,60 +147,221 @@ static int uniwill_write_kbd_bl_white(u8 brightness)
 	data &= 0x0f; // lower bits must be preserved
 	data |= UW_EC_REG_KBD_BL_STATUS_SUBCMD_RESET;
 	data |= brightness << 5;
-	return uniwill_write_ec_ram(UW_EC_REG_KBD_BL_STATUS, data);
+	result = uniwill_write_ec_ram(UW_EC_REG_KBD_BL_STATUS, data);
+	uniwill_ec_session_end();
+
+	return result;
 }
 
+/**
+ * Write the channels that differ from the last written values
+ */
 static int uniwill_write_kbd_bl_rgb(u8 red, u8 green, u8 blue)
 {
 	int result = 0;
-
-	result = uniwill_write_ec_ram(UW_EC_REG_KBD_BL_RGB_RED_BRIGHTNESS, red);
-	if (result) {
-		return result;
-	}
-	result = uniwill_write_ec_ram(UW_EC_REG_KBD_BL_RGB_GREEN_BRIGHTNESS, green);
-	if (result) {
-		return result;
-	}
-	result = uniwill_write_ec_ram(UW_EC_REG_KBD_BL_RGB_BLUE_BRIGHTNESS, blue);
-	if (result) {
-		return result;
+	int i;
+	u8 values[3] = { red, green, blue };
+
+	uniwill_ec_session_begin();
+	uniwill_leds_stats.updates++;
+	for (i = 0; i < 3; ++i) {
+		if ((uw_kbd_bl_shadow.rgb_valid & BIT(i)) && uw_kbd_bl_shadow.rgb[i] == values[i]) {
+			uniwill_leds_stats.channel_writes_skipped++;
+			continue;
+		}
+		result = uniwill_write_ec_ram(uw_kbd_bl_rgb_regs[i], values[i]);
+		uniwill_leds_stats.channel_writes++;
+		if (result) {
+			uw_kbd_bl_shadow.rgb_valid &= ~BIT(i);
+			break;
+		}
+		uw_kbd_bl_shadow.rgb[i] = values[i];
+		uw_kbd_bl_shadow.rgb_valid |= BIT(i);
 	}
+	uniwill_ec_session_end();
 
-	pr_debug("Wrote kbd color [%0#4x, %0#4x, %0#4x]\n", red, green, blue);
+	if (!result)
+		pr_debug("Wrote kbd color [%0#4x, %0#4x, %0#4x]\n", red, green, blue);
 
 	return result;
 }
 
-static void uniwill_leds_set_brightness(struct led_classdev *led_cdev __always_unused, enum led_brightness brightness) {
-	int ret = uniwill_write_kbd_bl_white(brightness);
+/**
+ * Write color and brightness of the 1-zone RGB keyboard, either scaled into
+ * the channels or with the color unscaled and brightness through the dimmer
+ */
+static int uniwill_write_kbd_bl_mc(struct led_classdev_mc *mcled_cdev, enum led_brightness brightness)
+{
+	int result;
+
+	if (!uw_kbd_bl_global_dimmer) {
+		led_mc_calc_color_components(mcled_cdev, brightness);
+		return uniwill_write_kbd_bl_rgb(mcled_cdev->subled_info[0].brightness,
+						mcled_cdev->subled_info[1].brightness,
+						mcled_cdev->subled_info[2].brightness);
+	}
+
+	led_mc_calc_color_components(mcled_cdev, mcled_cdev->led_cdev.max_brightness);
+	result = uniwill_write_kbd_bl_rgb(mcled_cdev->subled_info[0].brightness,
+					  mcled_cdev->subled_info[1].brightness,
+					  mcled_cdev->subled_info[2].brightness);
+	if (result)
+		return result;
+
+	return uniwill_write_kbd_bl_max_brightness(brightness);
+}
+
+static int uniwill_leds_apply_brightness(struct led_classdev *led_cdev, enum led_brightness brightness) {
+	int ret;
+
+	uniwill_action_begin(UNIWILL_ACTION_SET_BRIGHTNESS);
+	ret = uniwill_write_kbd_bl_white(brightness);
+	uniwill_action_end(UNIWILL_ACTION_SET_BRIGHTNESS);
 	if (ret) {
-		pr_debug("uniwill_leds_set_brightness(): uniwill_write_kbd_bl_white() failed\n");
-		return;
+		pr_debug("uniwill_leds_apply_brightness(): uniwill_write_kbd_bl_white() failed\n");
+		return ret;
 	}
 	led_cdev->brightness = brightness;
+	return 0;
 }
 
-static void uniwill_leds_set_brightness_mc(struct led_classdev *led_cdev, enum led_brightness brightness) {
+static int uniwill_leds_apply_brightness_mc(struct led_classdev *led_cdev, enum led_brightness brightness) {
 	int ret;
 	struct led_classdev_mc *mcled_cdev = lcdev_to_mccdev(led_cdev);
 
-	led_mc_calc_color_components(mcled_cdev, brightness);
-
-	ret = uniwill_write_kbd_bl_rgb(mcled_cdev->subled_info[0].brightness,
-				       mcled_cdev->subled_info[1].brightness,
-				       mcled_cdev->subled_info[2].brightness);
+	uniwill_action_begin(UNIWILL_ACTION_SET_COLOR);
+	ret = uniwill_write_kbd_bl_mc(mcled_cdev, brightness);
+	uniwill_action_end(UNIWILL_ACTION_SET_COLOR);
 	if (ret) {
-		pr_debug("uniwill_leds_set_brightness_mc(): uniwill_write_kbd_bl_rgb() failed\n");
-		return;
+		pr_debug("uniwill_leds_apply_brightness_mc(): uniwill_write_kbd_bl_mc() failed\n");
+		return ret;
 	}
 	led_cdev->brightness = brightness;
+	return 0;
+}
+
+// EC writes sleep, brightness_set only records the state for the commit work
+static struct tuxedo_led_commit_t uniwill_led_commit;
+static struct tuxedo_led_commit_t uniwill_mcled_commit;
+static struct dentry *uniwill_leds_commit_stats_dentry;
+
+static void uniwill_leds_set_brightness(struct led_classdev *led_cdev __always_unused, enum led_brightness brightness) {
+	tuxedo_led_commit_request(&uniwill_led_commit, brightness);
+}
+
+static int uniwill_leds_set_brightness_blocking(struct led_classdev *led_cdev __always_unused, enum led_brightness brightness) {
+	return tuxedo_led_commit_sync(&uniwill_led_commit, brightness);
+}
+
+static void uniwill_leds_set_brightness_mc(struct led_classdev *led_cdev __always_unused, enum led_brightness brightness) {
+	tuxedo_led_commit_request(&uniwill_mcled_commit, brightness);
+}
+
+static int uniwill_leds_set_brightness_mc_blocking(struct led_classdev *led_cdev __always_unused, enum led_brightness brightness) {
+	return tuxedo_led_commit_sync(&uniwill_mcled_commit, brightness);
+}
+
+static int uniwill_leds_commit_stats_show(struct seq_file *s, void *unused)
+{
+	if (uniwill_kb_backlight_type == UNIWILL_KB_BACKLIGHT_TYPE_FIXED_COLOR)
+		tuxedo_led_commit_stats_show(s, "white", &uniwill_led_commit);
+	else if (uniwill_kb_backlight_type == UNIWILL_KB_BACKLIGHT_TYPE_1_ZONE_RGB)
+		tuxedo_led_commit_stats_show(s, "rgb", &uniwill_mcled_commit);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(uniwill_leds_commit_stats);
+
+static struct led_classdev_mc uniwill_mcled_cdev; // forward declaration
+
+/**
+ * Effect frames carry the color only, the LED class brightness still applies
+ */
+static int uniwill_leds_effects_write_zone(int zone __always_unused, u32 color)
+{
+	if (!uw_kbd_bl_global_dimmer)
+		color = tuxedo_rgb_scale(color, uniwill_mcled_cdev.led_cdev.brightness, UNIWILL_KBD_BRIGHTNESS_MAX);
+
+	return uniwill_write_kbd_bl_rgb(tuxedo_rgb_red(color), tuxedo_rgb_green(color), tuxedo_rgb_blue(color));
+}
+
+static void uniwill_leds_effects_restore(void)
+{
+	if (uniwill_write_kbd_bl_mc(&uniwill_mcled_cdev, uniwill_mcled_cdev.led_cdev.brightness))
+		pr_debug("uniwill_leds_effects_restore(): uniwill_write_kbd_bl_mc() failed\n");
+}
+
+static const struct tuxedo_kbd_effects_ops_t uniwill_leds_effects_ops = {
+	.zones = 1,
+	.frame_begin = uniwill_ec_session_begin,
+	.frame_end = uniwill_ec_session_end,
+	.write_zone = uniwill_leds_effects_write_zone,
+	.restore = uniwill_leds_effects_restore
+};
+
+/**
+ * Frame interface of the 1-zone RGB keyboard, one key. A frame costs one EC
+ * session and only the channels that changed. Known per-key devices drive
+ * the keys through their own USB controller, the EC has no per-key register
+ * window.
+ */
+static struct tuxedo_kbd_frame_t uniwill_kbd_frame;
+static bool uniwill_kbd_frame_loaded;
+static struct dentry *uniwill_kbd_frame_stats_dentry;
+
+static void uniwill_kbd_frame_batch_begin(void *priv)
+{
+	uniwill_ec_session_begin();
+}
+
+static void uniwill_kbd_frame_batch_end(void *priv)
+{
+	uniwill_ec_session_end();
+}
+
+static int uniwill_kbd_frame_write_key(void *priv, unsigned int key, u32 color)
+{
+	return uniwill_leds_effects_write_zone(key, color);
+}
+
+static const struct tuxedo_kbd_frame_ops_t uniwill_kbd_frame_ops = {
+	.keys = 1,
+	.batch_begin = uniwill_kbd_frame_batch_begin,
+	.batch_end = uniwill_kbd_frame_batch_end,
+	.write_key = uniwill_kbd_frame_write_key,
+};
+
+static int uniwill_kbd_frame_stats_show(struct seq_file *s, void *unused)
+{
+	tuxedo_kbd_frame_stats_show(s, &uniwill_kbd_frame);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(uniwill_kbd_frame_stats);
+
+static void uniwill_kbd_frame_init(void)
+{
+	tuxedo_kbd_frame_init(&uniwill_kbd_frame, &uniwill_kbd_frame_ops, NULL);
+	uniwill_kbd_frame_loaded = tuxedo_kbd_frame_dev_register(&uniwill_kbd_frame) == 0;
+	if (uniwill_kbd_frame_loaded)
+		uniwill_kbd_frame_stats_dentry = debugfs_create_file("uniwill_kbd_frame_stats", 0444,
+								     tuxedo_debugfs_root, NULL,
+								     &uniwill_kbd_frame_stats_fops);
+}
+
+static void uniwill_kbd_frame_remove(void)
+{
+	if (uniwill_kbd_frame_loaded) {
+		debugfs_remove(uniwill_kbd_frame_stats_dentry);
+		uniwill_kbd_frame_stats_dentry = NULL;
+		tuxedo_kbd_frame_dev_unregister();
+	}
+	uniwill_kbd_frame_loaded = false;
 }
 
 static struct led_classdev uniwill_led_cdev = {
 	.name = "white:" LED_FUNCTION_KBD_BACKLIGHT,
 	.max_brightness = UNIWILL_KBD_BRIGHTNESS_WHITE_MAX,
 	.brightness_set = &uniwill_leds_set_brightness,
+	.brightness_set_blocking = &uniwill_leds_set_brightness_blocking,
 	.brightness = UNIWILL_KBD_BRIGHTNESS_WHITE_DEFAULT,
 	.flags = LED_BRIGHT_HW_CHANGED
 };
@@ -165,6 +391,7 @@ static struct led_classdev_mc uniwill_mcled_cdev = {
 	.led_cdev.name = "rgb:" LED_FUNCTION_KBD_BACKLIGHT,
 	.led_cdev.max_brightness = UNIWILL_KBD_BRIGHTNESS_MAX,
 	.led_cdev.brightness_set = &uniwill_leds_set_brightness_mc,
+	.led_cdev.brightness_set_blocking = &uniwill_leds_set_brightness_mc_blocking,
 	.led_cdev.brightness = UNIWILL_KBD_BRIGHTNESS_DEFAULT,
 	.led_cdev.flags = LED_BRIGHT_HW_CHANGED,
 	.num_colors = 3,
@@ -214,6 +441,13 @@ int uniwill_leds_init_early(struct platform_device *dev)
 	}
 	pr_debug("Keyboard backlight type: 0x%02x\n", uniwill_kb_backlight_type);
 
+	uw_kbd_bl_global_dimmer = uniwill_kb_backlight_type == UNIWILL_KB_BACKLIGHT_TYPE_1_ZONE_RGB &&
+		(uw_kbd_bl_global_dimmer_param || tuxedo_quirk(TUXEDO_QUIRK_UW_KBD_BL_GLOBAL_DIMMER));
+	uniwill_kbd_bl_shadow_invalidate();
+
+	tuxedo_led_commit_init(&uniwill_led_commit, &uniwill_led_cdev, uniwill_leds_apply_brightness);
+	tuxedo_led_commit_init(&uniwill_mcled_commit, &uniwill_mcled_cdev.led_cdev, uniwill_leds_apply_brightness_mc);
+
 	if (uniwill_kb_backlight_type == UNIWILL_KB_BACKLIGHT_TYPE_FIXED_COLOR) {
 		pr_debug("Registering fixed color leds interface\n");
 		ret = led_classdev_register(&dev->dev, &uniwill_led_cdev);
@@ -231,6 +465,9 @@ int uniwill_leds_init_early(struct platform_device *dev)
 		}
 	}
 
+	uniwill_leds_commit_stats_dentry = debugfs_create_file("uniwill_leds_commit_stats", 0444, tuxedo_debugfs_root,
+							       NULL, &uniwill_leds_commit_stats_fops);
+
 	uw_leds_initialized = true;
 	return 0;
 }
@@ -241,7 +478,8 @@ int uniwill_leds_init_late(struct platform_device *dev)
 	// FIXME Use mutexes
 	int ret;
 
-	ret = uniwill_write_ec_ram(UW_EC_REG_KBD_BL_MAX_BRIGHTNESS, 0xff);
+	// With the dimmer in use the restore below sets the actual brightness
+	ret = uniwill_write_kbd_bl_max_brightness(0xff);
 	if (ret) {
 		pr_err("Setting max keyboard brightness value failed\n");
 		uniwill_leds_remove(dev);
@@ -250,6 +488,10 @@ int uniwill_leds_init_late(struct platform_device *dev)
 
 	uniwill_leds_restore_state_extern();
 
+	// Frames would fight the boot animation, bind once it is over
+	if (uniwill_kb_backlight_type == UNIWILL_KB_BACKLIGHT_TYPE_1_ZONE_RGB && !uniwill_kbd_frame_loaded)
+		uniwill_kbd_frame_init();
+
 	return 0;
 }
 EXPORT_SYMBOL(uniwill_leds_init_late);
@@ -262,8 +504,19 @@ int uniwill_leds_remove(struct platform_device *dev)
 	if (uw_leds_initialized) {
 		uw_leds_initialized = false;
 
-		uniwill_leds_set_brightness_extern(0x00);
-		ret = uniwill_write_ec_ram(UW_EC_REG_KBD_BL_MAX_BRIGHTNESS, 0xc8);
+		debugfs_remove(uniwill_leds_commit_stats_dentry);
+		uniwill_leds_commit_stats_dentry = NULL;
+		uniwill_kbd_frame_remove();
+
+		tuxedo_led_commit_cancel(&uniwill_led_commit);
+		tuxedo_led_commit_cancel(&uniwill_mcled_commit);
+
+		if (uniwill_kb_backlight_type == UNIWILL_KB_BACKLIGHT_TYPE_FIXED_COLOR)
+			uniwill_leds_apply_brightness(&uniwill_led_cdev, 0x00);
+		else if (uniwill_kb_backlight_type == UNIWILL_KB_BACKLIGHT_TYPE_1_ZONE_RGB)
+			// Dark channels, the dimmer is reset to full below
+			uniwill_write_kbd_bl_rgb(0x00, 0x00, 0x00);
+		ret = uniwill_write_kbd_bl_max_brightness(0xc8);
 		if (ret) {
 			pr_err("Resetting max keyboard brightness value failed\n");
 		}
@@ -291,7 +544,7 @@ int uniwill_leds_notify_brightness_change_extern(void) {
 	if (uw_leds_initialized) {
 		if (uniwill_kb_backlight_type == UNIWILL_KB_BACKLIGHT_TYPE_FIXED_COLOR) {
 			uniwill_read_ec_ram(UW_EC_REG_KBD_BL_STATUS, &data);
-			data = (data >> 5) & 0x3;
+			data = tuxedo_field_get(data, 0x03, 5);
 			uniwill_led_cdev.brightness = data;
 			led_classdev_notify_brightness_hw_changed(&uniwill_led_cdev, data);
 			return true;
@@ -315,11 +568,12 @@ void uniwill_leds_restore_state_extern(void) {
 			data |= UW_EC_REG_KBD_BL_STATUS_SUBCMD_RESET;
 			uniwill_write_ec_ram(UW_EC_REG_KBD_BL_STATUS, data);
 
-			// write
-			if (uniwill_write_kbd_bl_rgb(uniwill_mcled_cdev.subled_info[0].brightness,
-						     uniwill_mcled_cdev.subled_info[1].brightness,
-						     uniwill_mcled_cdev.subled_info[2].brightness)) {
-				pr_debug("uniwill_leds_restore_state_extern(): uniwill_write_kbd_bl_rgb() failed\n");
+			// write, state of the EC is unknown after reset/resume
+			uniwill_kbd_bl_shadow_invalidate();
+			if (uniwill_kbd_frame_loaded)
+				tuxedo_kbd_frame_invalidate(&uniwill_kbd_frame);
+			if (uniwill_write_kbd_bl_mc(&uniwill_mcled_cdev, uniwill_mcled_cdev.led_cdev.brightness)) {
+				pr_debug("uniwill_leds_restore_state_extern(): uniwill_write_kbd_bl_mc() failed\n");
 			}
 		}
 	}
@@ -329,10 +583,10 @@ EXPORT_SYMBOL(uniwill_leds_restore_state_extern);
 void uniwill_leds_set_brightness_extern(enum led_brightness brightness) {
 	if (uw_leds_initialized) {
 		if (uniwill_kb_backlight_type == UNIWILL_KB_BACKLIGHT_TYPE_FIXED_COLOR) {
-			uniwill_led_cdev.brightness_set(&uniwill_led_cdev, brightness);
+			uniwill_led_cdev.brightness_set_blocking(&uniwill_led_cdev, brightness);
 		}
 		else if (uniwill_kb_backlight_type == UNIWILL_KB_BACKLIGHT_TYPE_1_ZONE_RGB) {
-			uniwill_mcled_cdev.led_cdev.brightness_set(&uniwill_mcled_cdev.led_cdev, brightness);
+			uniwill_mcled_cdev.led_cdev.brightness_set_blocking(&uniwill_mcled_cdev.led_cdev, brightness);
 		}
 	}
 }
@@ -344,7 +598,7 @@ void uniwill_leds_set_color_extern(u32 color) {
 			uniwill_mcled_cdev.subled_info[0].intensity = (color >> 16) & 0xff;
 			uniwill_mcled_cdev.subled_info[1].intensity = (color >> 8) & 0xff;
 			uniwill_mcled_cdev.subled_info[2].intensity = color & 0xff;
-			uniwill_mcled_cdev.led_cdev.brightness_set(&uniwill_mcled_cdev.led_cdev, uniwill_mcled_cdev.led_cdev.brightness);
+			uniwill_mcled_cdev.led_cdev.brightness_set_blocking(&uniwill_mcled_cdev.led_cdev, uniwill_mcled_cdev.led_cdev.brightness);
 		}
 	}
 }